@@ -1,9 +1,6 @@
 #include <jni.h>
 #include <string>
 #include <cstring>
-#include <ctime>
-#include <sys/time.h>
-#include <unistd.h>
 #include <android/log.h>
 #include "lz_logger.h"
 
@@ -11,28 +8,7 @@
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
-// 日志消息缓冲区大小
-#define LOG_MESSAGE_BUFFER_SIZE 4096
-
-// 获取当前线程 ID
-static pid_t get_thread_id() {
-    return gettid();
-}
-
-// 获取当前时间戳字符串（优化：避免 std::string 动态分配）
-static void get_timestamp(char* out_buffer, size_t buffer_size) {
-    char time_buf[32];
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    
-    struct tm tm_info;
-    localtime_r(&tv.tv_sec, &tm_info);
-    
-    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_info);
-    
-    snprintf(out_buffer, buffer_size, "%s.%03d", time_buf, (int)(tv.tv_usec / 1000));
-}
-
+#ifdef DEBUG
 // 日志级别字符串（用于 logcat 输出）
 static const char* get_level_string(int level) {
     switch (level) {
@@ -45,15 +21,7 @@ static const char* get_level_string(int level) {
         default: return "UNKNOWN";
     }
 }
-
-// 截断日志消息（在末尾添加 ...\n）
-static inline void truncate_log_message(char* buffer, size_t buffer_size) {
-    size_t len = buffer_size - 1;
-    buffer[len - 4] = '.';
-    buffer[len - 3] = '.';
-    buffer[len - 2] = '.';
-    buffer[len - 1] = '\n';
-}
+#endif
 
 // FFI 函数前置声明
 extern "C" void lz_logger_ffi_set_handle(lz_logger_handle_t handle);
@@ -143,6 +111,20 @@ Java_io_levili_lzlogger_LzLogger_nativeSetLogLevel(
     LOGI("FFI log level updated: %d", jLogLevel);
 }
 
+/**
+ * 设置当前线程的名称（缓存在 C 核心的线程局部变量中）
+ */
+JNIEXPORT void JNICALL
+Java_io_levili_lzlogger_LzLogger_nativeSetThreadName(
+        JNIEnv* env,
+        jobject /* this */,
+        jstring jName) {
+    
+    const char* name = jName ? env->GetStringUTFChars(jName, nullptr) : nullptr;
+    lz_logger_set_thread_name(name);
+    if (name) env->ReleaseStringUTFChars(jName, name);
+}
+
 /**
  * 写入日志
  */
@@ -169,109 +151,11 @@ Java_io_levili_lzlogger_LzLogger_nativeLog(
     const char* file = jFile ? env->GetStringUTFChars(jFile, nullptr) : nullptr;
     const char* message = jMessage ? env->GetStringUTFChars(jMessage, nullptr) : nullptr;
     
-    // 获取线程 ID
-    pid_t tid = get_thread_id();
-    
-    // 获取时间戳
-    char timestamp[64];
-    get_timestamp(timestamp, sizeof(timestamp));
-    
-    // 文件名由外部保证只传入文件名，无需提取路径
-    const char* fileName = (file && *file) ? file : "unknown";
-    
-    // 构建位置信息：line > 0 时显示 "file:line"，否则只显示 "file"
-    char location[256];
-    if (line > 0) {
-        snprintf(location, sizeof(location), "%s:%d", fileName, line);
-    } else {
-        snprintf(location, sizeof(location), "%s", fileName);
-    }
-    
-    // 获取日志级别字符串
-    const char* levelStr = get_level_string(level);
-    
-    // 构建完整日志消息
+    // 格式化并写入（行格式由 C 核心 lz_logger_log 统一生成，超长不截断）
     // 格式: yyyy-MM-dd HH:mm:ss.SSS [LEVEL] T:1234 [file:line] [func] [tag] message
-    //       如果 function 为空，则省略 [func] 字段
-    char fullMessage[LOG_MESSAGE_BUFFER_SIZE];
-    char* dynamicBuffer = nullptr;
-    char* logBuffer = fullMessage;
-    int len; // snprintf 返回写入的字符数（不包括 null）
-    
-    if (function && *function) {  // 优化：直接检查指针和首字符，无需 strlen
-        len = snprintf(fullMessage, sizeof(fullMessage),
-                       "%s [%s] T:%x [%s] [%s] [%s] %s\n",
-                       timestamp,
-                       levelStr,
-                       tid,
-                       location,
-                       function,
-                       tag ? tag : "",
-                       message ? message : "");
-    } else {
-        len = snprintf(fullMessage, sizeof(fullMessage),
-                       "%s [%s] T:%x [%s] [%s] %s\n",
-                       timestamp,
-                       levelStr,
-                       tid,
-                       location,
-                       tag ? tag : "",
-                       message ? message : "");
-    }
-    
-    // 处理 snprintf 结果：如果出错则跳过
-    if (len < 0) {
-        LOGE("Log formatting error");
-        // 释放字符串后返回
-        if (tag) env->ReleaseStringUTFChars(jTag, tag);
-        if (function) env->ReleaseStringUTFChars(jFunction, function);
-        if (file) env->ReleaseStringUTFChars(jFile, file);
-        if (message) env->ReleaseStringUTFChars(jMessage, message);
-        return;
-    }
-    
-    // 如果超长，根据日志级别决定策略
-    if (len >= (int)sizeof(fullMessage)) {
-        // DEBUG级别(level=1)：动态分配内存，完整输出
-        if (level == 1) {
-            dynamicBuffer = (char*)malloc(len + 1);  // +1 for null terminator
-            if (dynamicBuffer != nullptr) {
-                // 重新格式化到动态缓冲区
-                if (function && *function) {
-                    snprintf(dynamicBuffer, len + 1,
-                             "%s [%s] T:%x [%s] [%s] [%s] %s\n",
-                             timestamp,
-                             levelStr,
-                             tid,
-                             location,
-                             function,
-                             tag ? tag : "",
-                             message ? message : "");
-                } else {
-                    snprintf(dynamicBuffer, len + 1,
-                             "%s [%s] T:%x [%s] [%s] %s\n",
-                             timestamp,
-                             levelStr,
-                             tid,
-                             location,
-                             tag ? tag : "",
-                             message ? message : "");
-                }
-                logBuffer = dynamicBuffer;
-            } else {
-                LOGE("Failed to allocate memory for long log message");
-            }
-        }
-        
-        // 内存分配失败或非DEBUG级别：截断处理
-        if (dynamicBuffer == nullptr) {
-            len = sizeof(fullMessage) - 1;
-            truncate_log_message(fullMessage, sizeof(fullMessage));
-        }
-    }
-    
-    // 写入日志（直接使用计算出的长度，无需再次 strlen）
-    lz_log_error_t ret = lz_logger_write(handle, logBuffer, (uint32_t)len);
+    //       文件名由外部保证只传入文件名；line 为 0 时只显示文件名；function 为空时省略 [func] 字段
+    lz_log_error_t ret = lz_logger_log(handle, (lz_log_level_t)level, tag, file, line, function,
+                                       "%s", message ? message : "");
     
     if (ret != LZ_LOG_SUCCESS) {
         LOGE("Write failed: %s", lz_logger_error_string(ret));
@@ -279,14 +163,10 @@ Java_io_levili_lzlogger_LzLogger_nativeLog(
     
 #ifdef DEBUG
     // Debug 模式下同步输出到 logcat
-    __android_log_print(ANDROID_LOG_INFO, levelStr, "%s", logBuffer);
+    __android_log_print(ANDROID_LOG_INFO, get_level_string(level), "[%s] %s",
+                        tag ? tag : "", message ? message : "");
 #endif
     
-    // 释放动态分配的内存
-    if (dynamicBuffer != nullptr) {
-        free(dynamicBuffer);
-    }
-    
     // 释放字符串
     if (tag) env->ReleaseStringUTFChars(jTag, tag);
     if (function) env->ReleaseStringUTFChars(jFunction, function);
@@ -412,92 +292,16 @@ void lz_logger_ffi(int level, const char* tag, const char* function, const char*
         return;
     }
     
-    // 获取线程 ID
-    pid_t tid = get_thread_id();
-    
-    // 获取时间戳
-    char timestamp[64];
-    get_timestamp(timestamp, sizeof(timestamp));
-    
-    // 构建完整日志消息
-    // 格式: yyyy-MM-dd HH:mm:ss.SSS T:1234 [flutter] [func] [tag] message
+    // 格式化并写入（与 iOS 相同，位置字段固定为 flutter）
+    // 格式: yyyy-MM-dd HH:mm:ss.SSS [LEVEL] T:1234 [flutter] [func] [tag] message
     //       如果 function 为空，则省略 [func] 字段
-    char fullMessage[LOG_MESSAGE_BUFFER_SIZE];
-    char* dynamicBuffer = nullptr;
-    char* logBuffer = fullMessage;
-    int len; // snprintf 返回写入的字符数（不包括 null）
-    
-    if (function && *function) {  // 优化：直接检查指针和首字符，无需 strlen
-        len = snprintf(fullMessage, sizeof(fullMessage),
-                       "%s T:%x [flutter] [%s] [%s] %s\n",
-                       timestamp,
-                       tid,
-                       function,
-                       tag ? tag : "",
-                       message ? message : "");
-    } else {
-        len = snprintf(fullMessage, sizeof(fullMessage),
-                       "%s T:%x [flutter] [%s] %s\n",
-                       timestamp,
-                       tid,
-                       tag ? tag : "",
-                       message ? message : "");
-    }
-    
-    // 处理 snprintf 结果：如果出错则跳过
-    if (len < 0) {
-        LOGE("FFI log formatting error");
-        return;
-    }
-    
-    // 如果超长，根据日志级别决定策略
-    if (len >= (int)sizeof(fullMessage)) {
-        // DEBUG级别(level=1)：动态分配内存，完整输出
-        if (level == 1) {
-            dynamicBuffer = (char*)malloc(len + 1);  // +1 for null terminator
-            if (dynamicBuffer != nullptr) {
-                // 重新格式化到动态缓冲区
-                if (function && *function) {
-                    snprintf(dynamicBuffer, len + 1,
-                             "%s T:%x [flutter] [%s] [%s] %s\n",
-                             timestamp,
-                             tid,
-                             function,
-                             tag ? tag : "",
-                             message ? message : "");
-                } else {
-                    snprintf(dynamicBuffer, len + 1,
-                             "%s T:%x [flutter] [%s] %s\n",
-                             timestamp,
-                             tid,
-                             tag ? tag : "",
-                             message ? message : "");
-                }
-                logBuffer = dynamicBuffer;
-            } else {
-                LOGE("Failed to allocate memory for long FFI log message");
-            }
-        }
-        
-        // 内存分配失败或非DEBUG级别：截断处理
-        if (dynamicBuffer == nullptr) {
-            len = sizeof(fullMessage) - 1;
-            truncate_log_message(fullMessage, sizeof(fullMessage));
-        }
-    }
-    
-    // 写入日志（直接使用计算出的长度，无需再次 strlen）
-    lz_log_error_t ret = lz_logger_write(g_ffi_handle, logBuffer, (uint32_t)len);
+    lz_log_error_t ret = lz_logger_log(g_ffi_handle, (lz_log_level_t)level, tag, "flutter", 0, function,
+                                       "%s", message ? message : "");
     
     if (ret != LZ_LOG_SUCCESS) {
         LOGE("FFI write failed: %s", lz_logger_error_string(ret));
     }
     
-    // 释放动态分配的内存
-    if (dynamicBuffer != nullptr) {
-        free(dynamicBuffer);
-    }
-    
     // 注意：不再输出到 logcat，Dart 层会在 debug 模式用 print() 输出到控制台
 }
 
@@ -512,7 +316,7 @@ extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* /* reserved */) {
         return JNI_ERR;
     }
     
-    // 初始化加密模块 (Android 使用 Java Crypto API)
+    // 初始化加密模块 (密钥派生使用 Java Crypto API，AES-CTR 在本地实现)
     extern int lz_crypto_jni_init(JNIEnv *env, JavaVM *jvm);
     if (lz_crypto_jni_init(env, vm) != 0) {
         LOGE("JNI_OnLoad: lz_crypto_jni_init failed");
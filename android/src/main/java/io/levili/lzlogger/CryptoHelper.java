@@ -59,7 +59,7 @@ public class CryptoHelper {
     }
 
     /**
-     * AES-CTR 加密/解密
+     * AES-CTR 加密/解密（备用实现：native 默认使用本地 AES，只有手动指定系统后端时才调用）
      * @param key 32 字节密钥
      * @param data 待处理数据
      * @param offset 文件偏移量（用于计算 counter）
@@ -154,6 +154,15 @@ object LzLogger : DefaultLifecycleObserver {
         }
     }
 
+    /**
+     * 设置当前线程的名称（之后该线程的日志线程字段为 T:线程ID(名称)）
+     * @param name 名称（null 或空串表示清除）
+     */
+    @JvmStatic
+    fun setThreadName(name: String?) {
+        nativeSetThreadName(name)
+    }
+
     /**
      * 写入日志
      * @param level 日志级别
@@ -280,6 +289,7 @@ object LzLogger : DefaultLifecycleObserver {
     private external fun nativeOpen(logDir: String, encryptKey: String?, outErrors: IntArray): Long
     private external fun nativeSetFfiHandle(handle: Long, logLevel: Int)
     private external fun nativeSetLogLevel(logLevel: Int)
+    private external fun nativeSetThreadName(name: String?)
     private external fun nativeLog(handle: Long, level: Int, tag: String, function: String, file: String, line: Int, message: String)
     private external fun nativeFlush(handle: Long)
     private external fun nativeClose(handle: Long)
@@ -0,0 +1,456 @@
+/**
+ * 二进制日志还原一致性测试
+ *
+ * 同一组日志调用同时写入两个句柄：
+ *   - 参照句柄：未开启字符串字典的内存日志，容量足够大不会回绕，lz_logger_log 写出文本行
+ *   - 被测句柄：开启字符串字典的 1MB 内存日志 / 循环文件，LZ_LOG_BINARY 写二进制记录（0xFE，格式定义 0xFF），
+ *     lz_logger_log 写行记录（0xFD，标签、文件名、函数名查字典；含超过 255 字节的内联标签和超出字典容量的动态标签）
+ * 写入线程设置了线程名（含 UTF-8 名称和中途改名），被测句柄回绕约 4 圈，格式定义、字符串定义和线程名
+ * 只能从之后的半圈重新写入的定义中找到。被测句柄 dump 后用 tools/lz_log_decode 还原，检查：
+ *   - 每一行（除时间戳外）与参照句柄中同一次调用的文本行逐字节一致，时间戳相差不超过 1 秒
+ *   - 每个线程还原出的记录是其写入序列的一段完整后缀（没有丢失、无法还原的记录）
+ *   - 定义只在每半个环第一次使用时写入，最旧的半个环中之后没再用到的字符串的定义会随旧数据一起被覆盖，
+ *     这些记录按设计输出编号占位（<string #N>）；占位只允许出现在每个线程还原范围中较旧的一半
+ *   - 循环文件中途关闭再打开（新会话）后，两个会话的记录都能还原
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o lz_log_decode tools/lz_log_decode.c src/lz_binlog.c src/lz_format.c src/lz_numfmt.c -I. -pthread
+ *   gcc -O2 -Wall -o binlog_decode_test binlog_decode_test.c src/lz_logger.c src/lz_crypto.c src/lz_sink.c \
+ *       src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c \
+ *       src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -lcrypto
+ * 运行：
+ *   ./binlog_decode_test [lz_log_decode 的路径，默认 ./lz_log_decode]
+ */
+#include "src/lz_logger.h"
+#include "src/lz_format.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_DIR "/tmp/lz_binlog_decode_test"
+#define DUMP_PATH TEST_DIR "/dump.log"
+#define DECODED_PATH TEST_DIR "/decoded.log"
+#define REFERENCE_CAPACITY (32 * 1024 * 1024)
+#define SUBJECT_CAPACITY (1024 * 1024)
+#define NUM_THREADS 3
+#define NUM_RECORDS 30000 // 每个线程
+#define RENAME_AT (NUM_RECORDS / 10)
+
+static int failures = 0;
+static const char *g_decoder = "./lz_log_decode";
+
+static void check(int ok, const char *what) {
+    printf("- %s %s\n", ok ? "✅" : "❌", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 删除测试目录中的文件（目录不存在时创建）
+static void reset_dir(void) {
+    mkdir(TEST_DIR, 0755);
+    DIR *dir = opendir(TEST_DIR);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+    }
+    closedir(dir);
+}
+
+// 读取整个文件（末尾额外补一个 0）
+static char *read_file(const char *path, size_t *out_len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *buf = (char *)malloc((size_t)size + 1);
+    if (buf && fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    if (buf) {
+        buf[size] = '\0';
+    }
+    *out_len = (size_t)size;
+    return buf;
+}
+
+/**
+ * dump 未加密的句柄，只保留数据区
+ * @return 原文（调用者释放，末尾补 0），失败返回 NULL
+ */
+static char *dump_data(lz_logger_handle_t handle, size_t *out_len) {
+    size_t len = 0;
+    char *buf = lz_logger_dump(handle, DUMP_PATH) == LZ_LOG_SUCCESS ? read_file(DUMP_PATH, &len) : NULL;
+    if (!buf || len < LZ_LOG_FOOTER_SIZE) {
+        free(buf);
+        return NULL;
+    }
+    const uint8_t *footer = (const uint8_t *)buf + len - LZ_LOG_FOOTER_SIZE;
+    uint32_t used = read_u32(footer + LZ_LOG_SALT_SIZE + 8);
+    if (read_u32(footer + LZ_LOG_SALT_SIZE) != LZ_LOG_MAGIC_ENDX || used > len - LZ_LOG_FOOTER_SIZE) {
+        free(buf);
+        return NULL;
+    }
+    buf[used] = '\0';
+    *out_len = used;
+    return buf;
+}
+
+/**
+ * 用 lz_log_decode 还原被测句柄的 dump
+ * @return 还原出的文本（调用者释放，末尾补 0），失败返回 NULL
+ */
+static char *decode_dump(lz_logger_handle_t handle, size_t *out_len) {
+    if (lz_logger_dump(handle, DUMP_PATH) != LZ_LOG_SUCCESS) {
+        return NULL;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(g_decoder, g_decoder, DUMP_PATH, "-o", DECODED_PATH, (char *)NULL);
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("  %s 退出状态 %d\n", g_decoder, status);
+        return NULL;
+    }
+    return read_file(DECODED_PATH, out_len);
+}
+
+// ============================================================================
+// 写入
+// ============================================================================
+
+static lz_logger_handle_t g_reference;
+static lz_logger_handle_t g_subject;
+
+/** 同一调用点写入两个句柄：参照句柄写文本行，被测句柄写二进制记录（fmt、tag 必须是字符串常量） */
+#define LOG_BINARY_PAIR(level, tag, fmt, ...) do { \
+        lz_logger_log(g_reference, (level), (tag), LZ_LOG_FILE_NAME, __LINE__, __func__, fmt, ##__VA_ARGS__); \
+        LZ_LOG_BINARY(g_subject, (level), tag, fmt, ##__VA_ARGS__); \
+    } while (0)
+
+/** 同样的参数写入两个句柄（被测句柄开启了字符串字典，写出行记录） */
+#define LOG_LINE_PAIR(level, tag, file, line, func, fmt, ...) do { \
+        lz_logger_log(g_reference, (level), (tag), (file), (line), (func), fmt, ##__VA_ARGS__); \
+        lz_logger_log(g_subject, (level), (tag), (file), (line), (func), fmt, ##__VA_ARGS__); \
+    } while (0)
+
+static const char *const k_tags[] = {"Net", "Db", "UI", "Auth", "Cache", "Sync", "Push", "Media"};
+static const char *const k_names[NUM_THREADS] = {"worker-0", "网络线程", NULL};
+
+// 每条日志都以 #T<线程>-<序号># 开头，按它找到参照句柄中同一次调用的文本行
+static void write_record(int thread, int seq, char *dyn_tag, const char *long_tag) {
+    const char *tag = k_tags[seq % 8];
+    switch (seq % 6) {
+    case 0:
+        LOG_BINARY_PAIR(LZ_LOG_LEVEL_INFO, "Bin", "#T%d-%06d# int %d neg %d u %u hex %x %#o %c %%", thread, seq,
+                        seq * 7, -seq, (unsigned)seq * 2654435761u, (unsigned)seq, seq & 0777, 'a' + seq % 26);
+        break;
+    case 1:
+        LOG_BINARY_PAIR(LZ_LOG_LEVEL_WARN, "Bin", "#T%d-%06d# str '%s' prec '%.*s' '%-8s|%8s' %lld %llu", thread,
+                        seq, tag, seq % 5, "abcdefgh", tag, "右对齐", (long long)seq * -1000000007LL,
+                        (unsigned long long)seq << 40);
+        break;
+    case 2:
+        LOG_BINARY_PAIR(LZ_LOG_LEVEL_DEBUG, "BinF", "#T%d-%06d# dbl %.3f %g %e %10.4f w%*d|", thread, seq,
+                        seq / 7.0, seq * 1e-9, -seq * 12345.678, 1.0 / (seq + 1), seq % 9, seq % 100);
+        break;
+    case 3:
+        LOG_LINE_PAIR(LZ_LOG_LEVEL_INFO, tag, "net_client.c", 40 + seq % 3, "send_request", "#T%d-%06d# sent %d bytes",
+                      thread, seq, seq * 3);
+        break;
+    case 4:
+        // 内容变化的同一块缓冲，且编号超出字典容量（768 项）后内联写入
+        snprintf(dyn_tag, 32, "dyn%d", seq % 1000);
+        LOG_LINE_PAIR(LZ_LOG_LEVEL_ERROR, dyn_tag, NULL, 0, "", "#T%d-%06d# dynamic tag", thread, seq);
+        break;
+    default:
+        // 超过 255 字节的标签内联写入；标签为 NULL、没有函数名
+        LOG_LINE_PAIR(LZ_LOG_LEVEL_VERBOSE, seq % 12 == 5 ? long_tag : NULL, "util.c", 7, NULL,
+                      "#T%d-%06d# %s", thread, seq, "plain message");
+        break;
+    }
+}
+
+typedef struct {
+    int thread;
+    int from;
+    int to; // 写入序号 [from, to)
+} writer_arg_t;
+
+static void *writer(void *arg) {
+    writer_arg_t *w = (writer_arg_t *)arg;
+    char dyn_tag[32];
+    char long_tag[301];
+    memset(long_tag, 'L', 300);
+    long_tag[300] = '\0';
+
+    lz_logger_set_thread_name(k_names[w->thread]);
+    for (int seq = w->from; seq < w->to; seq++) {
+        if (w->thread == 0 && seq == RENAME_AT) {
+            lz_logger_set_thread_name("worker-0-renamed");
+        }
+        write_record(w->thread, seq, dyn_tag, long_tag);
+    }
+    return NULL;
+}
+
+static void run_writers(int from, int to) {
+    pthread_t tid[NUM_THREADS];
+    writer_arg_t args[NUM_THREADS];
+    for (int t = 0; t < NUM_THREADS; t++) {
+        args[t] = (writer_arg_t){t, from, to};
+        pthread_create(&tid[t], NULL, writer, &args[t]);
+    }
+    for (int t = 0; t < NUM_THREADS; t++) {
+        pthread_join(tid[t], NULL);
+    }
+}
+
+// ============================================================================
+// 比对
+// ============================================================================
+
+typedef struct {
+    char *line; // 以 0 结尾（原换行处）
+    size_t len;
+} line_ref_t;
+
+/**
+ * 从一行中取出 #T<线程>-<序号># 标记
+ * @return 成功返回 1
+ */
+static int parse_key(const char *line, int *thread, int *seq) {
+    const char *p = strstr(line, "#T");
+    if (!p || p[2] < '0' || p[2] >= '0' + NUM_THREADS || p[3] != '-') {
+        return 0;
+    }
+    int value = 0;
+    *thread = p[2] - '0';
+    p += 4;
+    for (int i = 0; i < 6; i++, p++) {
+        if (*p < '0' || *p > '9') {
+            return 0;
+        }
+        value = value * 10 + (*p - '0');
+    }
+    if (*p != '#' || value >= NUM_RECORDS) {
+        return 0;
+    }
+    *seq = value;
+    return 1;
+}
+
+/** 时间戳 yyyy-MM-dd HH:mm:ss.SSS 换算为毫秒（只用于比较差值） */
+static int64_t parse_timestamp(const char *line) {
+    struct tm tm_info;
+    memset(&tm_info, 0, sizeof(tm_info));
+    int ms = 0;
+    if (sscanf(line, "%4d-%2d-%2d %2d:%2d:%2d.%3d", &tm_info.tm_year, &tm_info.tm_mon, &tm_info.tm_mday,
+               &tm_info.tm_hour, &tm_info.tm_min, &tm_info.tm_sec, &ms) != 7) {
+        return -1;
+    }
+    tm_info.tm_year -= 1900;
+    tm_info.tm_mon -= 1;
+    return (int64_t)timegm(&tm_info) * 1000 + ms;
+}
+
+/**
+ * 把文本切成行，按标记建立 (线程, 序号) → 行 的索引
+ * @param index NUM_THREADS * NUM_RECORDS 项
+ * @return 没有标记的行数
+ */
+static int index_lines(char *text, size_t len, line_ref_t *index) {
+    int unkeyed = 0;
+    char *p = text, *end = text + len;
+    while (p < end) {
+        char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t line_len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        p[line_len] = '\0';
+        int thread = 0, seq = 0;
+        if (parse_key(p, &thread, &seq)) {
+            index[thread * NUM_RECORDS + seq] = (line_ref_t){p, line_len};
+        } else {
+            if (unkeyed++ == 0) {
+                printf("  无法识别的行：%.160s\n", p);
+            }
+        }
+        p += line_len + 1;
+    }
+    return unkeyed;
+}
+
+/**
+ * 还原被测句柄并与参照句柄逐行比对
+ * @param to 每个线程写入的序号上限
+ */
+static void check_decoded(const char *label, int to) {
+    char what[160];
+    size_t ref_len = 0, dec_len = 0;
+    char *reference = dump_data(g_reference, &ref_len);
+    char *decoded = decode_dump(g_subject, &dec_len);
+    snprintf(what, sizeof(what), "%s：dump 并用 lz_log_decode 还原", label);
+    check(reference != NULL && decoded != NULL, what);
+    if (!reference || !decoded) {
+        free(reference);
+        free(decoded);
+        return;
+    }
+
+    line_ref_t *ref_index = (line_ref_t *)calloc(NUM_THREADS * NUM_RECORDS, sizeof(line_ref_t));
+    line_ref_t *dec_index = (line_ref_t *)calloc(NUM_THREADS * NUM_RECORDS, sizeof(line_ref_t));
+    int ref_unkeyed = index_lines(reference, ref_len, ref_index);
+    int dec_unkeyed = index_lines(decoded, dec_len, dec_index);
+    snprintf(what, sizeof(what), "%s：参照句柄未回绕，还原结果中没有无法还原的记录", label);
+    check(ref_unkeyed == 0 && dec_unkeyed == 0 && ref_index[0].line != NULL, what);
+
+    // 每个线程还原出的第一条（最旧的部分已被覆盖，之后的记录必须全部还原）
+    int first[NUM_THREADS];
+    int suffix_ok = 1, decoded_count = 0;
+    printf("  各线程还原出的第一条:");
+    for (int t = 0; t < NUM_THREADS; t++) {
+        first[t] = -1;
+        for (int seq = 0; seq < to; seq++) {
+            if (!dec_index[t * NUM_RECORDS + seq].line) {
+                suffix_ok &= first[t] < 0;
+            } else {
+                first[t] = first[t] < 0 ? seq : first[t];
+                decoded_count++;
+            }
+        }
+        printf(" %d", first[t]);
+        suffix_ok &= first[t] > 0;
+    }
+    printf("，共 %d 条（写入 %d 条）\n", decoded_count, NUM_THREADS * to);
+
+    int mismatches = 0, placeholders = 0, late = 0, named = 0;
+    for (int t = 0; t < NUM_THREADS; t++) {
+        for (int seq = first[t] < 0 ? to : first[t]; seq < to; seq++) {
+            const line_ref_t *dec = &dec_index[t * NUM_RECORDS + seq];
+            const line_ref_t *ref = &ref_index[t * NUM_RECORDS + seq];
+            named += strstr(dec->line, "(worker-0") != NULL || strstr(dec->line, "(网络线程)") != NULL;
+            int64_t diff = ref->line ? parse_timestamp(dec->line) - parse_timestamp(ref->line) : 0;
+            late += diff < -1000 || diff > 1000;
+            if (ref->line && dec->len == ref->len &&
+                memcmp(dec->line + LZ_FORMAT_TIMESTAMP_SIZE, ref->line + LZ_FORMAT_TIMESTAMP_SIZE,
+                       dec->len - LZ_FORMAT_TIMESTAMP_SIZE) == 0) {
+                continue;
+            }
+            // 定义只在每半个环第一次使用时写入：最旧的半个环中的字符串之后没有再用到（或会话已关闭）时，
+            // 定义随最旧的数据一起被覆盖，lz_log_decode 按设计输出编号占位。较新的一半必须全部还原
+            if (seq < first[t] + (to - first[t]) / 2 &&
+                (strstr(dec->line, "<string #") != NULL || strstr(dec->line, "not found]") != NULL)) {
+                placeholders++;
+                continue;
+            }
+            if (mismatches++ == 0) {
+                printf("  不一致：\n    还原 %s\n    参照 %s\n", dec->line, ref->line ? ref->line : "(无)");
+            }
+        }
+    }
+    if (placeholders > 0) {
+        printf("  最旧的半个环中 %d 条记录的定义已被覆盖，输出编号占位\n", placeholders);
+    }
+
+    snprintf(what, sizeof(what), "%s：被测句柄已回绕数圈（还原出的记录不到写入的三分之一）", label);
+    check(decoded_count > 0 && decoded_count * 3 < NUM_THREADS * to, what);
+    snprintf(what, sizeof(what), "%s：每个线程还原出的记录是写入序列的完整后缀", label);
+    check(suffix_ok, what);
+    snprintf(what, sizeof(what), "%s：除时间戳外与 lz_logger_log 的文本行逐字节一致（%d 条不一致）", label,
+             mismatches);
+    check(mismatches == 0, what);
+    snprintf(what, sizeof(what), "%s：时间戳与参照相差不超过 1 秒（%d 条超出）", label, late);
+    check(late == 0, what);
+    snprintf(what, sizeof(what), "%s：线程字段带有线程名", label);
+    check(named > 0, what);
+
+    free(ref_index);
+    free(dec_index);
+    free(reference);
+    free(decoded);
+}
+
+static int open_reference(void) {
+    lz_logger_set_string_interning(0);
+    return lz_logger_open_memory(REFERENCE_CAPACITY, NULL, &g_reference) == LZ_LOG_SUCCESS;
+}
+
+static void test_memory(void) {
+    printf("\n## 内存模式\n\n");
+    reset_dir();
+
+    check(open_reference(), "打开参照句柄");
+    lz_logger_set_string_interning(1);
+    check(lz_logger_open_memory(SUBJECT_CAPACITY, NULL, &g_subject) == LZ_LOG_SUCCESS, "打开开启字符串字典的内存日志");
+    run_writers(0, NUM_RECORDS);
+    check_decoded("内存模式", NUM_RECORDS);
+    lz_logger_close(g_subject);
+    lz_logger_close(g_reference);
+}
+
+static void test_circular_reopen(void) {
+    printf("\n## 循环文件：中途重新打开\n\n");
+    reset_dir();
+
+    check(open_reference(), "打开参照句柄");
+    lz_logger_set_string_interning(1);
+    check(lz_logger_open_circular(TEST_DIR, SUBJECT_CAPACITY, NULL, &g_subject, NULL, NULL) == LZ_LOG_SUCCESS,
+          "新建 circular.log");
+    run_writers(0, NUM_RECORDS * 3 / 4);
+    lz_logger_close(g_subject);
+
+    // 新会话：字典和格式编号重新分配，旧会话的记录在被覆盖前仍按旧会话的定义还原
+    check(lz_logger_open_circular(TEST_DIR, SUBJECT_CAPACITY, NULL, &g_subject, NULL, NULL) == LZ_LOG_SUCCESS,
+          "重新打开 circular.log");
+    run_writers(NUM_RECORDS * 3 / 4, NUM_RECORDS * 3 / 4 + 1500);
+    check_decoded("循环文件", NUM_RECORDS * 3 / 4 + 1500);
+    lz_logger_close(g_subject);
+    lz_logger_close(g_reference);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        g_decoder = argv[1];
+    }
+    if (access(g_decoder, X_OK) != 0) {
+        fprintf(stderr, "找不到 %s，先按文件头的说明编译 lz_log_decode\n", g_decoder);
+        return 2;
+    }
+
+    printf("\n# LZ Logger 二进制日志还原测试\n");
+
+    test_memory();
+    test_circular_reopen();
+
+    printf("\n---\n\n");
+    if (failures != 0) {
+        printf("❌ **%d 项检查失败**\n\n", failures);
+        return 1;
+    }
+    printf("✅ **所有检查通过！**\n\n");
+    return 0;
+}
@@ -5,14 +5,31 @@ echo "🔨 编译 LZ Logger 性能测试工具..."
 # 清理旧的编译产物
 rm -f performance_test
 
-# 编译（macOS 需要链接 Security 框架）
+# 加密依赖：macOS 链接 Security 框架，Linux 链接 OpenSSL libcrypto
+if [ "$(uname)" = "Darwin" ]; then
+    CRYPTO_LIBS="-framework Security"
+else
+    CRYPTO_LIBS="-lcrypto"
+fi
+
+# 编译
 gcc -o performance_test \
     performance_test.c \
     src/lz_logger.c \
     src/lz_crypto.c \
+    src/lz_sink.c \
+    src/lz_uring.c \
+    src/lz_manifest.c \
+    src/lz_housekeeper.c \
+    src/lz_compress.c \
+    src/lz_packer.c \
+    src/lz_keystream.c \
+    src/lz_format.c \
+    src/lz_binlog.c \
+    src/lz_numfmt.c \
     -I. \
     -pthread \
-    -framework Security \
+    $CRYPTO_LIBS \
     -O2 \
     -Wall
 
@@ -22,6 +39,9 @@ if [ $? -eq 0 ]; then
     echo "运行测试："
     echo "  ./performance_test"
     echo ""
+    echo "完整基准测试（加密实现 + 写入路径，输出 JSON）："
+    echo "  cmake -S src -B build && cmake --build build --target lz_logger_bench && ./build/lz_logger_bench"
+    echo ""
 else
     echo "❌ 编译失败"
     exit 1
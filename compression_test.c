@@ -0,0 +1,421 @@
+/**
+ * 封存压缩（EndZ）测试
+ *
+ * 用 lz_logger_open 写出普通日志文件（EndX），再调用后台维护线程使用的 lz_compress_segment 压缩：
+ *   - 未加密文件：压缩 → 逐块解压 / lz_logger_decompress_file 还原，与写入的原文逐字节比对
+ *   - 加密文件：压缩段的盐必须是原文件盐的 COPY 盐（lz_crypto_next_salt），只用该盐解密负载即可还原原文；
+ *     lz_logger_decompress_file 的输出用新盐重新加密，解密后同样与原文一致
+ *   - 压缩中途崩溃：子进程设置 RLIMIT_FSIZE 后压缩，写 .tmp 超过上限时被 SIGXFSZ 杀死，
+ *     原文件必须保持不变，之后重新压缩成功并清理 .tmp；忽略 SIGXFSZ 时写入失败返回错误，同样不改动原文件
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o compression_test compression_test.c src/lz_logger.c src/lz_crypto.c src/lz_sink.c \
+ *       src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c \
+ *       src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -lcrypto
+ */
+#include "src/lz_logger.h"
+#include "src/lz_compress.h"
+#include "src/lz_crypto.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_DIR "/tmp/lz_compression_test"
+#define ENCRYPT_KEY "test_encryption_key_12345"
+#define NUM_LOGS 40000
+#define CRASH_FILE_LIMIT (128 * 1024) // 崩溃测试中 .tmp 最多写入的字节数
+
+static int failures = 0;
+
+static void check(int ok, const char *what) {
+    printf("- %s %s\n", ok ? "✅" : "❌", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+// 读取整个文件
+static uint8_t *read_file(const char *path, size_t *out_len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = (uint8_t *)malloc(size > 0 ? (size_t)size : 1);
+    if (buf && fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    *out_len = (size_t)size;
+    return buf;
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static int salt_is_zero(const uint8_t *salt) {
+    for (int i = 0; i < LZ_LOG_SALT_SIZE; i++) {
+        if (salt[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 删除测试目录中的文件（目录不存在时创建）
+static void reset_dir(void) {
+    mkdir(TEST_DIR, 0755);
+    DIR *dir = opendir(TEST_DIR);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+    }
+    closedir(dir);
+}
+
+// 找到目录中唯一的日志段 yyyy-mm-dd-N.log
+static int find_segment(char *name, size_t cap) {
+    DIR *dir = opendir(TEST_DIR);
+    if (!dir) {
+        return -1;
+    }
+    int found = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len > 4 && strcmp(entry->d_name + len - 4, ".log") == 0 && entry->d_name[0] >= '0' &&
+            entry->d_name[0] <= '9') {
+            snprintf(name, cap, "%s", entry->d_name);
+            found++;
+        }
+    }
+    closedir(dir);
+    return found == 1 ? 0 : -1;
+}
+
+/**
+ * 写出一个日志段并关闭
+ * @param key 加密密钥（NULL 不加密）
+ * @param name 输出日志段文件名
+ * @param cap name 的大小
+ * @param out_len 输出写入的原文长度
+ * @return 写入的原文（调用者释放），失败返回 NULL
+ */
+static char *write_segment(const char *key, char *name, size_t cap, size_t *out_len) {
+    reset_dir();
+    lz_logger_set_max_file_size(16 * 1024 * 1024);
+
+    lz_logger_handle_t handle;
+    if (lz_logger_open(TEST_DIR, key, &handle, NULL, NULL) != LZ_LOG_SUCCESS) {
+        return NULL;
+    }
+
+    size_t cap_text = (size_t)NUM_LOGS * 128;
+    char *text = (char *)malloc(cap_text);
+    size_t len = 0;
+    uint32_t state = 12345;
+    for (int i = 0; i < NUM_LOGS && text; i++) {
+        // 半随机内容：压缩比接近真实日志，压缩后仍有数百 KB
+        state = state * 1103515245u + 12345u;
+        char line[128];
+        int n = snprintf(line, sizeof(line), "2026-01-01 12:00:00.%03d [INFO] [Net] request %d id=%08x took %u us\n",
+                         i % 1000, i, state, state % 9973);
+        if (lz_logger_write(handle, line, (uint32_t)n) != LZ_LOG_SUCCESS) {
+            free(text);
+            text = NULL;
+            break;
+        }
+        memcpy(text + len, line, (size_t)n);
+        len += (size_t)n;
+    }
+    lz_logger_close(handle);
+
+    if (text && find_segment(name, cap) != 0) {
+        free(text);
+        return NULL;
+    }
+    *out_len = len;
+    return text;
+}
+
+/**
+ * 读取普通日志文件（EndX）的原文
+ * @param key 加密密钥（文件未加密时忽略）
+ * @return 原文（调用者释放），格式不对或解密失败返回 NULL
+ */
+static uint8_t *read_plain(const char *path, const char *key, size_t *out_len) {
+    size_t size = 0;
+    uint8_t *buf = read_file(path, &size);
+    if (!buf || size < LZ_LOG_FOOTER_SIZE) {
+        free(buf);
+        return NULL;
+    }
+    const uint8_t *footer = buf + size - LZ_LOG_FOOTER_SIZE;
+    uint32_t used = read_u32(footer + LZ_LOG_SALT_SIZE + 8);
+    if (read_u32(footer + LZ_LOG_SALT_SIZE) != LZ_LOG_MAGIC_ENDX || used > size - LZ_LOG_FOOTER_SIZE) {
+        free(buf);
+        return NULL;
+    }
+    if (!salt_is_zero(footer)) {
+        lz_crypto_context_t ctx;
+        if (key == NULL || lz_crypto_init(&ctx, key, footer) != 0) {
+            free(buf);
+            return NULL;
+        }
+        lz_crypto_process(&ctx, buf, buf, used, 0);
+        lz_crypto_cleanup(&ctx);
+    }
+    *out_len = used;
+    return buf;
+}
+
+/**
+ * 按块索引逐块解密、解压压缩段（EndZ），只使用 footer 中的盐
+ * @param key 加密密钥（压缩段未加密时忽略）
+ * @param out_salt 输出 footer 中的盐
+ * @return 原文（调用者释放），格式不对或数据损坏返回 NULL
+ */
+static uint8_t *read_sealed(const char *path, const char *key, uint8_t *out_salt, size_t *out_len) {
+    size_t size = 0;
+    uint8_t *buf = read_file(path, &size);
+    uint8_t *out = NULL;
+    lz_crypto_context_t ctx;
+    int encrypted = 0;
+
+    do {
+        if (!buf || size < LZ_LOG_FOOTER_SIZE + LZ_COMPRESS_EXT_SIZE) {
+            break;
+        }
+        const uint8_t *footer = buf + size - LZ_LOG_FOOTER_SIZE;
+        const uint8_t *ext = footer - LZ_COMPRESS_EXT_SIZE;
+        uint32_t block_count = read_u32(ext + 4);
+        uint32_t index_offset = read_u32(ext + 8);
+        uint32_t flags = read_u32(ext + 12);
+        memcpy(out_salt, footer, LZ_LOG_SALT_SIZE);
+        if (read_u32(footer + LZ_LOG_SALT_SIZE) != LZ_LOG_MAGIC_ENDZ ||
+            read_u32(footer + LZ_LOG_SALT_SIZE + 4) != size ||
+            (uint64_t)index_offset + (uint64_t)block_count * 4 > size) {
+            break;
+        }
+
+        encrypted = (flags & LZ_COMPRESS_FLAG_ENCRYPTED) != 0;
+        if (encrypted && (key == NULL || lz_crypto_init(&ctx, key, footer) != 0)) {
+            encrypted = 0;
+            break;
+        }
+
+        out = (uint8_t *)malloc((size_t)block_count * LZ_COMPRESS_MAX_BLOCK + 1);
+        size_t len = 0;
+        for (uint32_t b = 0; out && b < block_count; b++) {
+            uint32_t offset = read_u32(buf + index_offset + b * 4);
+            lz_compress_block_header_t header;
+            memcpy(&header, buf + offset, sizeof(header));
+            uint32_t stored = header.stored_size & ~LZ_COMPRESS_BLOCK_STORED;
+            uint8_t *payload = buf + offset + LZ_COMPRESS_BLOCK_HEADER_SIZE;
+            if (encrypted) {
+                lz_crypto_process(&ctx, payload, payload, stored, offset + LZ_COMPRESS_BLOCK_HEADER_SIZE);
+            }
+            if (header.stored_size & LZ_COMPRESS_BLOCK_STORED) {
+                memcpy(out + len, payload, stored);
+            } else if (lz_decompress_block(payload, stored, out + len, header.raw_size) != 0) {
+                free(out);
+                out = NULL;
+                break;
+            }
+            len += header.raw_size;
+        }
+        *out_len = len;
+    } while (0);
+
+    if (encrypted) {
+        lz_crypto_cleanup(&ctx);
+    }
+    free(buf);
+    return out;
+}
+
+static int same_text(const uint8_t *data, size_t len, const char *expected, size_t expected_len) {
+    return data != NULL && len == expected_len && memcmp(data, expected, len) == 0;
+}
+
+// 压缩 → 逐块还原 → lz_logger_decompress_file 还原
+static void test_round_trip(const char *key) {
+    printf("\n## %s文件\n\n", key ? "加密" : "未加密");
+
+    char name[64], path[256], out_path[256];
+    size_t text_len = 0;
+    char *text = write_segment(key, name, sizeof(name), &text_len);
+    check(text != NULL, "写入日志段");
+    if (!text) {
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, name);
+    snprintf(out_path, sizeof(out_path), "%s/restored.txt", TEST_DIR);
+
+    size_t orig_size = 0;
+    uint8_t *orig = read_file(path, &orig_size);
+    uint8_t orig_salt[LZ_LOG_SALT_SIZE];
+    memcpy(orig_salt, orig + orig_size - LZ_LOG_FOOTER_SIZE, LZ_LOG_SALT_SIZE);
+    free(orig);
+
+    size_t plain_len = 0;
+    uint8_t *plain = read_plain(path, key, &plain_len);
+    check(same_text(plain, plain_len, text, text_len), "原文件内容与写入一致");
+    free(plain);
+
+    int dir_fd = open(TEST_DIR, O_RDONLY | O_DIRECTORY);
+    uint32_t file_size = 0, used = 0;
+    lz_log_error_t ret = lz_compress_segment(dir_fd, name, key, &file_size, &used);
+    close(dir_fd);
+    check(ret == LZ_LOG_SUCCESS, "lz_compress_segment 成功");
+
+    struct stat st;
+    stat(path, &st);
+    printf("  原文 %zu 字节 → 压缩段 %lld 字节\n", text_len, (long long)st.st_size);
+    check(st.st_size == (off_t)file_size && file_size < orig_size, "压缩段变小且大小与 footer 一致");
+
+    uint8_t sealed_salt[LZ_LOG_SALT_SIZE];
+    size_t sealed_len = 0;
+    uint8_t *sealed = read_sealed(path, key, sealed_salt, &sealed_len);
+    check(same_text(sealed, sealed_len, text, text_len), "逐块解压与原文一致");
+    free(sealed);
+
+    if (key) {
+        uint8_t copy_salt[LZ_LOG_SALT_SIZE];
+        lz_crypto_next_salt(orig_salt, LZ_CRYPTO_SALT_COPY, copy_salt);
+        check(memcmp(sealed_salt, copy_salt, LZ_LOG_SALT_SIZE) == 0, "压缩段使用原文件盐的 COPY 盐");
+        check(memcmp(sealed_salt, orig_salt, LZ_LOG_SALT_SIZE) != 0, "压缩段不复用原文件的密钥流");
+
+        uint8_t wrong_salt[LZ_LOG_SALT_SIZE];
+        size_t wrong_len = 0;
+        uint8_t *wrong = read_sealed(path, "wrong_key", wrong_salt, &wrong_len);
+        check(!same_text(wrong, wrong_len, text, text_len), "错误密钥无法还原");
+        free(wrong);
+    } else {
+        check(salt_is_zero(sealed_salt), "未加密的压缩段盐为全 0");
+    }
+
+    ret = lz_logger_decompress_file(path, key, out_path);
+    check(ret == LZ_LOG_SUCCESS, "lz_logger_decompress_file 成功");
+    size_t restored_len = 0;
+    uint8_t *restored = read_plain(out_path, key, &restored_len);
+    check(same_text(restored, restored_len, text, text_len), "还原的普通日志文件与原文一致");
+    free(restored);
+
+    free(text);
+}
+
+/**
+ * 在子进程中压缩，写 .tmp 超过 CRASH_FILE_LIMIT 时中止
+ * @param crash 1：SIGXFSZ 杀死子进程；0：忽略 SIGXFSZ，写入失败返回错误
+ * @return waitpid 的状态
+ */
+static int compress_in_child(const char *name, const char *key, int crash) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        struct rlimit limit = {CRASH_FILE_LIMIT, CRASH_FILE_LIMIT};
+        signal(SIGXFSZ, crash ? SIG_DFL : SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limit);
+        int dir_fd = open(TEST_DIR, O_RDONLY | O_DIRECTORY);
+        uint32_t file_size = 0, used = 0;
+        lz_log_error_t ret = lz_compress_segment(dir_fd, name, key, &file_size, &used);
+        _exit(ret == LZ_LOG_SUCCESS ? 0 : 2);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+static void test_abort_mid_seal(void) {
+    printf("\n## 压缩中途中止\n\n");
+
+    char name[64], path[256], tmp_path[300];
+    size_t text_len = 0;
+    char *text = write_segment(ENCRYPT_KEY, name, sizeof(name), &text_len);
+    check(text != NULL, "写入日志段");
+    if (!text) {
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, name);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    size_t orig_size = 0;
+    uint8_t *orig = read_file(path, &orig_size);
+
+    // 崩溃：.tmp 留在目录中，原文件不变
+    int status = compress_in_child(name, ENCRYPT_KEY, 1);
+    check(WIFSIGNALED(status) && WTERMSIG(status) == SIGXFSZ, "子进程在写 .tmp 时被 SIGXFSZ 杀死");
+    size_t after_size = 0;
+    uint8_t *after = read_file(path, &after_size);
+    check(after && after_size == orig_size && memcmp(after, orig, orig_size) == 0, "崩溃后原文件逐字节不变");
+    free(after);
+    check(access(tmp_path, F_OK) == 0, "崩溃留下未完成的 .tmp");
+
+    // 写入失败：返回错误并删除 .tmp，原文件不变
+    status = compress_in_child(name, ENCRYPT_KEY, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 2, "写入失败时 lz_compress_segment 返回错误");
+    after = read_file(path, &after_size);
+    check(after && after_size == orig_size && memcmp(after, orig, orig_size) == 0, "写入失败后原文件逐字节不变");
+    free(after);
+    check(access(tmp_path, F_OK) != 0, "写入失败时删除 .tmp");
+
+    size_t plain_len = 0;
+    uint8_t *plain = read_plain(path, ENCRYPT_KEY, &plain_len);
+    check(same_text(plain, plain_len, text, text_len), "中止后原文件仍可解密");
+    free(plain);
+
+    // 重新压缩：覆盖残留的 .tmp
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        write(fd, "partial", 7);
+        close(fd);
+    }
+    int dir_fd = open(TEST_DIR, O_RDONLY | O_DIRECTORY);
+    uint32_t file_size = 0, used = 0;
+    lz_log_error_t ret = lz_compress_segment(dir_fd, name, ENCRYPT_KEY, &file_size, &used);
+    close(dir_fd);
+    check(ret == LZ_LOG_SUCCESS && access(tmp_path, F_OK) != 0, "之后重新压缩成功，不留 .tmp");
+
+    uint8_t salt[LZ_LOG_SALT_SIZE];
+    size_t sealed_len = 0;
+    uint8_t *sealed = read_sealed(path, ENCRYPT_KEY, salt, &sealed_len);
+    check(same_text(sealed, sealed_len, text, text_len), "重新压缩的压缩段与原文一致");
+    free(sealed);
+
+    free(orig);
+    free(text);
+}
+
+int main() {
+    printf("\n# LZ Logger 封存压缩（EndZ）测试\n");
+
+    test_round_trip(NULL);
+    test_round_trip(ENCRYPT_KEY);
+    test_abort_mid_seal();
+
+    printf("\n---\n\n");
+    if (failures != 0) {
+        printf("❌ **%d 项检查失败**\n\n", failures);
+        return 1;
+    }
+    printf("✅ **所有检查通过！**\n\n");
+    return 0;
+}
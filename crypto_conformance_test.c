@@ -0,0 +1,248 @@
+/**
+ * AES-CTR / ChaCha20 一致性测试
+ *
+ * 以 OpenSSL 的 EVP_aes_256_ctr / EVP_chacha20 为参照，逐字节比对 lz_crypto_process 每个可用实现的输出
+ * （AES: 内置 AES-NI / VAES / ARMv8 / 可移植实现，以及系统库路径；ChaCha20: AVX2 / NEON / 可移植实现）：
+ *   - 随机偏移（含块内偏移、跨 2^32 块号）和随机长度（1 ~ 4096 字节）
+ *   - 原地加密（input == output）
+ *   - 多线程同时加密，并在测试过程中切换密钥
+ * Android 默认使用的可移植实现与桌面平台编译自同一份代码，在 Linux 上验证即可。
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o crypto_conformance_test crypto_conformance_test.c src/lz_crypto.c -I. -pthread -lcrypto
+ */
+#include "src/lz_crypto.h"
+#include <openssl/evp.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define NUM_THREADS 4
+#define CASES_PER_THREAD 20000
+#define MAX_RECORD 4096
+
+static const char *passwords[] = {"test_encryption_key_12345678", "another_key_for_conformance"};
+
+typedef struct {
+    lz_crypto_context_t *ctx;
+    lz_crypto_cipher_t cipher;
+    unsigned int seed;
+    int failures;
+} thread_arg_t;
+
+// OpenSSL 参照实现: counter = 8 字节 0 + 大端块号，跳过块内偏移
+static int reference_ctr(const uint8_t *key, const uint8_t *input, uint8_t *output, size_t len, uint64_t offset) {
+    uint8_t iv[16] = {0};
+    uint64_t block = offset / 16;
+    for (int i = 0; i < 8; i++) {
+        iv[15 - i] = (uint8_t)(block >> (i * 8));
+    }
+
+    EVP_CIPHER_CTX *cipher = EVP_CIPHER_CTX_new();
+    if (!cipher) {
+        return -1;
+    }
+
+    int ok = EVP_EncryptInit_ex(cipher, EVP_aes_256_ctr(), NULL, key, iv) == 1;
+    uint8_t skip[16];
+    int out_len = 0;
+    size_t skip_len = offset % 16;
+    if (ok && skip_len > 0) {
+        ok = EVP_EncryptUpdate(cipher, skip, &out_len, skip, (int)skip_len) == 1;
+    }
+    if (ok) {
+        ok = EVP_EncryptUpdate(cipher, output, &out_len, input, (int)len) == 1;
+    }
+    EVP_CIPHER_CTX_free(cipher);
+    return ok ? 0 : -1;
+}
+
+// OpenSSL 参照实现: IV = 小端 64 位块号 + 8 字节 0 nonce（原始 ChaCha20），跳过块内偏移
+static int reference_chacha20(const uint8_t *key, const uint8_t *input, uint8_t *output, size_t len, uint64_t offset) {
+    uint8_t iv[16] = {0};
+    uint64_t block = offset / LZ_CRYPTO_CHACHA20_BLOCK_SIZE;
+    for (int i = 0; i < 8; i++) {
+        iv[i] = (uint8_t)(block >> (i * 8));
+    }
+
+    EVP_CIPHER_CTX *cipher = EVP_CIPHER_CTX_new();
+    if (!cipher) {
+        return -1;
+    }
+
+    int ok = EVP_EncryptInit_ex(cipher, EVP_chacha20(), NULL, key, iv) == 1;
+    uint8_t skip[LZ_CRYPTO_CHACHA20_BLOCK_SIZE];
+    int out_len = 0;
+    size_t skip_len = offset % LZ_CRYPTO_CHACHA20_BLOCK_SIZE;
+    if (ok && skip_len > 0) {
+        ok = EVP_EncryptUpdate(cipher, skip, &out_len, skip, (int)skip_len) == 1;
+    }
+    if (ok) {
+        ok = EVP_EncryptUpdate(cipher, output, &out_len, input, (int)len) == 1;
+    }
+    EVP_CIPHER_CTX_free(cipher);
+    return ok ? 0 : -1;
+}
+
+// 随机偏移: 大多在文件范围内，少量靠近 2^32 块号（计数器低 32 位进位），block_size 为算法的块大小
+static uint64_t random_offset(unsigned int *seed, uint64_t block_size) {
+    uint64_t base = (uint64_t)rand_r(seed) * 16 + (uint64_t)(rand_r(seed) % 16);
+    if (rand_r(seed) % 8 == 0) {
+        base += (0xFFFFFFF0ull + (uint64_t)(rand_r(seed) % 32)) * block_size;
+    }
+    return base;
+}
+
+static void *conformance_worker(void *arg) {
+    thread_arg_t *targ = (thread_arg_t *)arg;
+    uint8_t input[MAX_RECORD];
+    uint8_t expected[MAX_RECORD];
+    uint8_t actual[MAX_RECORD];
+
+    for (int i = 0; i < CASES_PER_THREAD; i++) {
+        size_t len = (size_t)(rand_r(&targ->seed) % MAX_RECORD) + 1;
+        uint64_t offset = random_offset(&targ->seed, targ->cipher == LZ_CRYPTO_CIPHER_CHACHA20
+                                                          ? LZ_CRYPTO_CHACHA20_BLOCK_SIZE : 16);
+        for (size_t j = 0; j < len; j++) {
+            input[j] = (uint8_t)rand_r(&targ->seed);
+        }
+
+        int ref = targ->cipher == LZ_CRYPTO_CIPHER_CHACHA20
+                      ? reference_chacha20(targ->ctx->key, input, expected, len, offset)
+                      : reference_ctr(targ->ctx->key, input, expected, len, offset);
+        if (ref != 0) {
+            targ->failures++;
+            continue;
+        }
+
+        if (i % 2 == 0) {
+            if (lz_crypto_process(targ->ctx, input, actual, len, offset) != 0) {
+                targ->failures++;
+                continue;
+            }
+        } else {
+            // 原地加密
+            memcpy(actual, input, len);
+            if (lz_crypto_process(targ->ctx, actual, actual, len, offset) != 0) {
+                targ->failures++;
+                continue;
+            }
+        }
+
+        if (memcmp(expected, actual, len) != 0) {
+            if (targ->failures < 5) {
+                printf("  ❌ 不一致: offset=%llu len=%zu\n", (unsigned long long)offset, len);
+            }
+            targ->failures++;
+        }
+    }
+    return NULL;
+}
+
+// 以指定算法和实现运行一轮: 每个密钥各跑一遍多线程随机用例
+static int run_backend(lz_crypto_cipher_t cipher, int backend) {
+    int failures = 0;
+
+    for (size_t k = 0; k < sizeof(passwords) / sizeof(passwords[0]); k++) {
+        lz_crypto_context_t ctx;
+        uint8_t salt[LZ_CRYPTO_SALT_SIZE];
+        if (cipher == LZ_CRYPTO_CIPHER_CHACHA20) {
+            // ChaCha20 由盐的标记选择
+            if (lz_crypto_generate_salt(LZ_CRYPTO_CIPHER_CHACHA20, salt) != 0) {
+                printf("  ❌ 生成盐失败\n");
+                return -1;
+            }
+        } else {
+            for (int i = 0; i < LZ_CRYPTO_SALT_SIZE; i++) {
+                salt[i] = (uint8_t)(i * 17 + k);
+            }
+        }
+        if (lz_crypto_init(&ctx, passwords[k], salt) != 0) {
+            printf("  ❌ 初始化加密上下文失败\n");
+            return -1;
+        }
+
+        pthread_t threads[NUM_THREADS];
+        thread_arg_t args[NUM_THREADS];
+        for (int t = 0; t < NUM_THREADS; t++) {
+            args[t].ctx = &ctx;
+            args[t].cipher = cipher;
+            args[t].seed = (unsigned int)(cipher * 10000 + backend * 1000 + k * 100 + t + 1);
+            args[t].failures = 0;
+            pthread_create(&threads[t], NULL, conformance_worker, &args[t]);
+        }
+        for (int t = 0; t < NUM_THREADS; t++) {
+            pthread_join(threads[t], NULL);
+            failures += args[t].failures;
+        }
+
+        lz_crypto_cleanup(&ctx);
+    }
+
+    return failures;
+}
+
+int main() {
+    printf("\n");
+    printf("# LZ Logger AES-CTR / ChaCha20 一致性测试 (参照: OpenSSL EVP_aes_256_ctr / EVP_chacha20)\n\n");
+
+    lz_crypto_set_backend(LZ_CRYPTO_BACKEND_AUTO);
+    lz_crypto_set_chacha_backend(LZ_CRYPTO_CHACHA_AUTO);
+    printf("**自动选择:** %s / %s  \n", lz_crypto_backend_name(lz_crypto_get_backend()),
+           lz_crypto_chacha_backend_name(lz_crypto_get_chacha_backend()));
+    printf("**每个实现:** %d 个密钥 × %d 线程 × %d 条随机记录\n\n",
+           (int)(sizeof(passwords) / sizeof(passwords[0])), NUM_THREADS, CASES_PER_THREAD);
+
+    int total_failures = 0;
+    int tested = 0;
+    for (int b = LZ_CRYPTO_BACKEND_SYSTEM; b <= LZ_CRYPTO_BACKEND_PORTABLE; b++) {
+        lz_crypto_backend_t backend = (lz_crypto_backend_t)b;
+        const char *name = lz_crypto_backend_name(backend);
+
+        if (lz_crypto_set_backend(backend) != 0) {
+            printf("- %s: 不支持，跳过\n", name);
+            continue;
+        }
+
+        int failures = run_backend(LZ_CRYPTO_CIPHER_AES_CTR, b);
+        if (failures != 0) {
+            printf("- %s: ❌ %d 条记录不一致\n", name, failures);
+            total_failures += failures < 0 ? 1 : failures;
+        } else {
+            printf("- %s: ✅ 一致\n", name);
+        }
+        tested++;
+    }
+
+    for (int b = LZ_CRYPTO_CHACHA_PORTABLE; b <= LZ_CRYPTO_CHACHA_NEON; b++) {
+        lz_crypto_chacha_backend_t backend = (lz_crypto_chacha_backend_t)b;
+        const char *name = lz_crypto_chacha_backend_name(backend);
+
+        if (lz_crypto_set_chacha_backend(backend) != 0) {
+            printf("- %s: 不支持，跳过\n", name);
+            continue;
+        }
+
+        int failures = run_backend(LZ_CRYPTO_CIPHER_CHACHA20, b);
+        if (failures != 0) {
+            printf("- %s: ❌ %d 条记录不一致\n", name, failures);
+            total_failures += failures < 0 ? 1 : failures;
+        } else {
+            printf("- %s: ✅ 一致\n", name);
+        }
+        tested++;
+    }
+
+    // 恢复自动选择
+    lz_crypto_set_backend(LZ_CRYPTO_BACKEND_AUTO);
+    lz_crypto_set_chacha_backend(LZ_CRYPTO_CHACHA_AUTO);
+
+    printf("\n---\n\n");
+    if (total_failures != 0 || tested == 0) {
+        printf("❌ **一致性测试失败**\n\n");
+        return 1;
+    }
+    printf("✅ **所有实现与 OpenSSL 输出一致！**\n\n");
+    return 0;
+}
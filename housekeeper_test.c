@@ -0,0 +1,436 @@
+/**
+ * 后台维护线程（目录清单 + 保留策略 + 压实）测试
+ *
+ * 在测试目录中直接构造 10 个带 EndX footer 的封存日志段（每个 256KB，数据 64KB），
+ * 不经过 lz_logger_open，单独驱动 lz_manifest / lz_housekeeper：
+ *   - 清单重建：清单不存在或校验失败时遍历目录重建，条目顺序、大小、状态与目录中的文件一致
+ *   - 压实：已退役的段截断到数据末尾，footer 紧跟数据且 file_size 与文件大小一致，数据和盐不变，
+ *     清单记录压实后的大小；未退役的段逐字节不变；重建后的清单仍识别为已压实
+ *   - 容量配额：从最旧的段开始删除，恰好删到总大小不超过上限
+ *   - 按天数保留：过期的段全部删除
+ *   - 序号不小于当前段（active_seq）的段在任何策略下都不会被删除或改动，即使超出配额或已过期
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o housekeeper_test housekeeper_test.c src/lz_logger.c src/lz_crypto.c src/lz_sink.c \
+ *       src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c \
+ *       src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -lcrypto
+ */
+#include "src/lz_logger.h"
+#include "src/lz_manifest.h"
+#include "src/lz_housekeeper.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_DIR "/tmp/lz_housekeeper_test"
+#define NUM_SEGMENTS 10
+#define SEGMENT_SIZE (256 * 1024)
+#define SEGMENT_USED (64 * 1024)
+#define WAIT_MS 5000
+
+static int failures = 0;
+
+static void check(int ok, const char *what) {
+    printf("- %s %s\n", ok ? "✅" : "❌", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 删除测试目录中的文件（目录不存在时创建）
+static void reset_dir(void) {
+    mkdir(TEST_DIR, 0755);
+    DIR *dir = opendir(TEST_DIR);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+    }
+    closedir(dir);
+}
+
+// 第 index 个段的文件名（同一天，编号从 1 开始）
+static void segment_path(int index, char *path, size_t cap) {
+    snprintf(path, cap, "%s/2020-01-01-%d.log", TEST_DIR, index + 1);
+}
+
+// 第 index 个段的数据区内容和 footer 盐（每个段不同）
+static void segment_fill(int index, uint8_t *data, uint8_t *salt) {
+    for (size_t i = 0; i < SEGMENT_USED; i++) {
+        data[i] = (uint8_t)(i * 31 + index * 7 + 1);
+    }
+    for (int i = 0; i < LZ_LOG_SALT_SIZE; i++) {
+        salt[i] = (uint8_t)(0xA0 + index + i);
+    }
+}
+
+// 写出一个已封存的段：[数据 SEGMENT_USED][未用空间][footer]
+static int write_segment(int index) {
+    char path[256];
+    segment_path(index, path, sizeof(path));
+
+    uint8_t *buf = (uint8_t *)calloc(1, SEGMENT_SIZE);
+    if (!buf) {
+        return -1;
+    }
+    uint8_t *footer = buf + SEGMENT_SIZE - LZ_LOG_FOOTER_SIZE;
+    segment_fill(index, buf, footer);
+    uint32_t magic = LZ_LOG_MAGIC_ENDX, file_size = SEGMENT_SIZE, used = SEGMENT_USED;
+    memcpy(footer + LZ_LOG_SALT_SIZE, &magic, 4);
+    memcpy(footer + LZ_LOG_SALT_SIZE + 4, &file_size, 4);
+    memcpy(footer + LZ_LOG_SALT_SIZE + 8, &used, 4);
+
+    int ok = -1;
+    FILE *fp = fopen(path, "wb");
+    if (fp) {
+        ok = fwrite(buf, 1, SEGMENT_SIZE, fp) == SEGMENT_SIZE ? 0 : -1;
+        fclose(fp);
+    }
+    free(buf);
+    return ok;
+}
+
+// 读取整个文件
+static uint8_t *read_file(const char *path, size_t *out_len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = (uint8_t *)malloc(size > 0 ? (size_t)size : 1);
+    if (buf && fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    *out_len = (size_t)size;
+    return buf;
+}
+
+static int segment_exists(int index) {
+    char path[256];
+    segment_path(index, path, sizeof(path));
+    return access(path, F_OK) == 0;
+}
+
+// 段是否仍是写出时的原样（未压实、未删除）
+static int segment_untouched(int index) {
+    char path[256];
+    segment_path(index, path, sizeof(path));
+    size_t len = 0;
+    uint8_t *buf = read_file(path, &len);
+    if (!buf) {
+        return 0;
+    }
+    uint8_t data[SEGMENT_USED];
+    uint8_t salt[LZ_LOG_SALT_SIZE];
+    segment_fill(index, data, salt);
+    const uint8_t *footer = buf + len - LZ_LOG_FOOTER_SIZE;
+    int ok = len == SEGMENT_SIZE && memcmp(buf, data, SEGMENT_USED) == 0 &&
+             memcmp(footer, salt, LZ_LOG_SALT_SIZE) == 0 &&
+             read_u32(footer + LZ_LOG_SALT_SIZE) == LZ_LOG_MAGIC_ENDX &&
+             read_u32(footer + LZ_LOG_SALT_SIZE + 4) == SEGMENT_SIZE &&
+             read_u32(footer + LZ_LOG_SALT_SIZE + 8) == SEGMENT_USED;
+    free(buf);
+    return ok;
+}
+
+// 段是否已压实：footer 紧跟数据，大小与文件一致，数据和盐不变
+static int segment_compacted(int index) {
+    char path[256];
+    segment_path(index, path, sizeof(path));
+    size_t len = 0;
+    uint8_t *buf = read_file(path, &len);
+    if (!buf) {
+        return 0;
+    }
+    uint8_t data[SEGMENT_USED];
+    uint8_t salt[LZ_LOG_SALT_SIZE];
+    segment_fill(index, data, salt);
+    const uint8_t *footer = buf + len - LZ_LOG_FOOTER_SIZE;
+    int ok = len == SEGMENT_USED + LZ_LOG_FOOTER_SIZE && memcmp(buf, data, SEGMENT_USED) == 0 &&
+             memcmp(footer, salt, LZ_LOG_SALT_SIZE) == 0 &&
+             read_u32(footer + LZ_LOG_SALT_SIZE) == LZ_LOG_MAGIC_ENDX &&
+             read_u32(footer + LZ_LOG_SALT_SIZE + 4) == (uint32_t)len &&
+             read_u32(footer + LZ_LOG_SALT_SIZE + 8) == SEGMENT_USED;
+    free(buf);
+    return ok;
+}
+
+static lz_manifest_entry_t g_entries[LZ_MANIFEST_CAPACITY];
+
+// 清单中的段数（条目按从旧到新存入 g_entries）
+static uint32_t list_entries(lz_manifest_t *manifest) {
+    return lz_manifest_list(manifest, g_entries, LZ_MANIFEST_CAPACITY);
+}
+
+// 查找序号对应的条目
+static const lz_manifest_entry_t *find_entry(uint32_t count, uint64_t seq) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (g_entries[i].seq == seq) {
+            return &g_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+// 等待清单中的段数降到 expected（超时返回 0）
+static int wait_count(lz_manifest_t *manifest, uint32_t expected) {
+    for (int waited = 0; waited < WAIT_MS; waited += 10) {
+        if (list_entries(manifest) == expected) {
+            return 1;
+        }
+        sleep_ms(10);
+    }
+    return list_entries(manifest) == expected;
+}
+
+// 等待序号小于 retired_seq 的段全部标记为已压实（超时返回 0）
+static int wait_compacted(lz_manifest_t *manifest, uint64_t retired_seq) {
+    for (int waited = 0; waited <= WAIT_MS; waited += 10) {
+        uint32_t count = list_entries(manifest);
+        int done = 1;
+        for (uint32_t i = 0; i < count; i++) {
+            if (g_entries[i].seq < retired_seq && !(g_entries[i].flags & LZ_SEGMENT_FLAG_COMPACTED)) {
+                done = 0;
+            }
+        }
+        if (done) {
+            return 1;
+        }
+        sleep_ms(10);
+    }
+    return 0;
+}
+
+/**
+ * 运行一轮维护并等待结果
+ * @param expected_count 等待清单中剩余的段数（0 表示等待压实）
+ */
+static void run_housekeeper(lz_manifest_t *manifest, uint64_t max_bytes, uint32_t max_days,
+                            uint64_t active_seq, uint64_t retired_seq, uint32_t expected_count) {
+    lz_housekeeper_t *hk = NULL;
+    if (lz_housekeeper_start(TEST_DIR, manifest, max_bytes, max_days, false, NULL, &hk) != LZ_LOG_SUCCESS) {
+        check(0, "启动后台维护线程");
+        return;
+    }
+    lz_housekeeper_notify(hk, active_seq, retired_seq);
+    int done = expected_count == 0 ? wait_compacted(manifest, retired_seq) : wait_count(manifest, expected_count);
+    // 停止时等待正在进行的一轮结束，之后检查的是完整一轮的结果
+    lz_housekeeper_stop(hk);
+    check(done, "后台线程在超时前完成本轮维护");
+}
+
+static void test_rebuild(void) {
+    printf("\n## 清单重建\n\n");
+
+    reset_dir();
+    int written = 0;
+    for (int i = 0; i < NUM_SEGMENTS; i++) {
+        written += write_segment(i) == 0;
+    }
+    check(written == NUM_SEGMENTS, "写出 10 个封存段");
+
+    // 清单不存在：遍历目录重建
+    lz_manifest_t *manifest = NULL;
+    check(lz_manifest_open(TEST_DIR, &manifest) == LZ_LOG_SUCCESS, "清单不存在时打开成功");
+    if (!manifest) {
+        return;
+    }
+    uint32_t count = list_entries(manifest);
+    int ok = count == NUM_SEGMENTS;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        const lz_manifest_entry_t *e = &g_entries[i];
+        ok = e->seq == i && e->date == 20200101 && e->file_num == i + 1 && e->file_size == SEGMENT_SIZE &&
+             e->used_size == SEGMENT_USED && e->state == LZ_SEGMENT_STATE_SEALED &&
+             !(e->flags & LZ_SEGMENT_FLAG_COMPACTED);
+    }
+    check(ok, "重建的条目按 (日期, 编号) 排列，大小、已用大小、状态与文件 footer 一致");
+
+    uint32_t last_date = 0, last_num = 0;
+    check(lz_manifest_last_name(manifest, &last_date, &last_num) && last_date == 20200101 &&
+              last_num == NUM_SEGMENTS,
+          "最近的文件名为目录中最大的 (日期, 编号)");
+    lz_manifest_close(manifest);
+
+    // 清单头部损坏：重新打开时重建出相同的条目
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, LZ_MANIFEST_FILE_NAME);
+    int fd = open(path, O_WRONLY);
+    uint32_t garbage = 0xDEADBEEF;
+    check(fd >= 0 && pwrite(fd, &garbage, sizeof(garbage), 0) == (ssize_t)sizeof(garbage), "破坏清单魔数");
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    lz_manifest_entry_t before[NUM_SEGMENTS];
+    memcpy(before, g_entries, sizeof(before));
+    manifest = NULL;
+    check(lz_manifest_open(TEST_DIR, &manifest) == LZ_LOG_SUCCESS, "清单损坏时打开成功");
+    if (!manifest) {
+        return;
+    }
+    count = list_entries(manifest);
+    ok = count == NUM_SEGMENTS;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        ok = g_entries[i].seq == before[i].seq && g_entries[i].file_num == before[i].file_num &&
+             g_entries[i].file_size == before[i].file_size && g_entries[i].used_size == before[i].used_size;
+    }
+    check(ok, "重建后的条目与首次重建一致");
+    lz_manifest_close(manifest);
+}
+
+static void test_compact(void) {
+    printf("\n## 压实已退役的段\n\n");
+
+    lz_manifest_t *manifest = NULL;
+    if (lz_manifest_open(TEST_DIR, &manifest) != LZ_LOG_SUCCESS) {
+        check(0, "打开清单");
+        return;
+    }
+
+    // 段 0-5 已退役，6-7 仍被映射，8 为当前段
+    run_housekeeper(manifest, 0, 0, 8, 6, 0);
+
+    int compacted = 1, untouched = 1;
+    for (int i = 0; i < NUM_SEGMENTS; i++) {
+        if (i < 6) {
+            compacted &= segment_compacted(i);
+        } else {
+            untouched &= segment_untouched(i);
+        }
+    }
+    check(compacted, "已退役的段截断到数据末尾，footer 有效且 file_size 与文件大小一致，数据和盐不变");
+    check(untouched, "未退役的段逐字节不变");
+
+    uint32_t count = list_entries(manifest);
+    int ok = count == NUM_SEGMENTS;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        const lz_manifest_entry_t *e = &g_entries[i];
+        if (e->seq < 6) {
+            ok = (e->flags & LZ_SEGMENT_FLAG_COMPACTED) && e->file_size == SEGMENT_USED + LZ_LOG_FOOTER_SIZE &&
+                 e->used_size == SEGMENT_USED && e->state == LZ_SEGMENT_STATE_SEALED;
+        } else {
+            ok = !(e->flags & LZ_SEGMENT_FLAG_COMPACTED) && e->file_size == SEGMENT_SIZE;
+        }
+    }
+    check(ok, "清单记录压实后的大小和 LZ_SEGMENT_FLAG_COMPACTED，未压实的段保持原大小");
+    lz_manifest_close(manifest);
+
+    // 删除清单后重建：压实后的文件仍能识别，并标记为已压实
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, LZ_MANIFEST_FILE_NAME);
+    unlink(path);
+    manifest = NULL;
+    if (lz_manifest_open(TEST_DIR, &manifest) != LZ_LOG_SUCCESS) {
+        check(0, "重建清单");
+        return;
+    }
+    count = list_entries(manifest);
+    ok = count == NUM_SEGMENTS;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        const lz_manifest_entry_t *e = &g_entries[i];
+        ok = e->seq == i && ((e->flags & LZ_SEGMENT_FLAG_COMPACTED) != 0) == (i < 6) &&
+             e->file_size == (i < 6 ? SEGMENT_USED + LZ_LOG_FOOTER_SIZE : SEGMENT_SIZE) &&
+             e->used_size == SEGMENT_USED;
+    }
+    check(ok, "重建清单时压实后的文件 footer 有效，识别为已压实");
+    lz_manifest_close(manifest);
+}
+
+static void test_retention(void) {
+    printf("\n## 容量配额和按天数保留\n\n");
+
+    lz_manifest_t *manifest = NULL;
+    if (lz_manifest_open(TEST_DIR, &manifest) != LZ_LOG_SUCCESS) {
+        check(0, "打开清单");
+        return;
+    }
+
+    // 配额恰好要求删除最旧的 3 个段
+    uint32_t count = list_entries(manifest);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += g_entries[i].file_size;
+    }
+    uint64_t max_bytes = total - g_entries[0].file_size - g_entries[1].file_size - g_entries[2].file_size;
+
+    run_housekeeper(manifest, max_bytes, 0, 8, 6, NUM_SEGMENTS - 3);
+    count = list_entries(manifest);
+    total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += g_entries[i].file_size;
+    }
+    check(count == NUM_SEGMENTS - 3 && g_entries[0].seq == 3 && total <= max_bytes,
+          "超出配额时从最旧的段开始删除，恰好删到总大小不超过上限");
+    check(!segment_exists(0) && !segment_exists(1) && !segment_exists(2) && segment_exists(3),
+          "被删除的段的文件已移除，其余文件保留");
+
+    // 文件名日期早已过期：当前段 5 之前的段全部删除
+    run_housekeeper(manifest, 0, 1, 5, 5, NUM_SEGMENTS - 5);
+    count = list_entries(manifest);
+    check(count == NUM_SEGMENTS - 5 && g_entries[0].seq == 5 && !segment_exists(3) && !segment_exists(4),
+          "按天数保留删除当前段之前的过期段");
+    int untouched = segment_compacted(5);
+    for (int i = 6; i < NUM_SEGMENTS; i++) {
+        untouched &= segment_untouched(i);
+    }
+    check(untouched, "已过期但序号不小于当前段的段保持原样（5 为此前压实的结果）");
+
+    // 配额小于任何一个段：当前段 8 之前的段全部删除（6-7 先压实再删除）
+    run_housekeeper(manifest, 1, 0, 8, 8, NUM_SEGMENTS - 8);
+    count = list_entries(manifest);
+    check(count == 2 && find_entry(count, 8) && find_entry(count, 9), "超出配额时只剩当前段和更新的段");
+    check(!segment_exists(5) && !segment_exists(6) && !segment_exists(7), "当前段之前的段的文件已移除");
+    check(segment_untouched(8) && segment_untouched(9), "序号不小于当前段的段超出配额仍逐字节不变");
+
+    // 再次通知同样的当前段：不会继续删除
+    lz_housekeeper_t *hk = NULL;
+    if (lz_housekeeper_start(TEST_DIR, manifest, 1, 1, false, NULL, &hk) == LZ_LOG_SUCCESS) {
+        lz_housekeeper_notify(hk, 8, 8);
+        sleep_ms(200);
+        lz_housekeeper_stop(hk);
+    }
+    check(list_entries(manifest) == 2 && segment_untouched(8) && segment_untouched(9),
+          "重复维护不会删除或改动当前段和更新的段");
+
+    lz_manifest_close(manifest);
+}
+
+int main() {
+    printf("\n# LZ Logger 后台维护线程测试\n");
+
+    test_rebuild();
+    test_compact();
+    test_retention();
+
+    printf("\n---\n\n");
+    if (failures != 0) {
+        printf("❌ **%d 项检查失败**\n\n", failures);
+        return 1;
+    }
+    printf("✅ **所有检查通过！**\n\n");
+    return 0;
+}
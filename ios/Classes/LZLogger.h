@@ -45,6 +45,12 @@ typedef NS_ENUM(NSInteger, LZLogLevel) {
  */
 - (void)setLogLevel:(LZLogLevel)level;
 
+/**
+ * 设置当前线程的名称（之后该线程的日志线程字段为 T:线程ID(名称)）
+ * @param name 名称（nil 或空串表示清除）
+ */
+- (void)setThreadName:(nullable NSString *)name;
+
 /**
  * 写入日志
  * @param level 日志级别
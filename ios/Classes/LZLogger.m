@@ -1,8 +1,6 @@
 #import "LZLogger.h"
 #import "lz_logger.h"
-#import <pthread.h>
 #import <UIKit/UIKit.h>
-#import <sys/time.h>
 
 @interface LZLogger ()
 
@@ -186,48 +184,11 @@
     NSString *message = [[NSString alloc] initWithFormat:format arguments:args];
     va_end(args);
     
-    // 获取当前线程 ID
-    uint64_t tid;
-    pthread_threadid_np(NULL, &tid);
-    
-    // 获取时间戳（使用 C 函数提高性能）
-    char timestampBuf[32];
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    struct tm tm_info;
-    localtime_r(&tv.tv_sec, &tm_info);
-    strftime(timestampBuf, sizeof(timestampBuf), "%Y-%m-%d %H:%M:%S", &tm_info);
-    
-    char timestamp[64];
-    snprintf(timestamp, sizeof(timestamp), "%s.%03d", timestampBuf, (int)(tv.tv_usec / 1000));
-    
-    const char *levelStr = [self levelString:level];
-    
-    // 文件名由外部保证只传入文件名，无需提取路径
-    const char *fileName = (file && *file) ? file : "unknown";
-    
-    // 构建文件位置信息：line 为 0 时只显示文件名
-    NSString *location = line > 0 
-        ? [NSString stringWithFormat:@"%s:%lu", fileName, (unsigned long)line]
-        : [NSString stringWithUTF8String:fileName];
-    
-    // 根据 function 是否为空决定日志格式
+    // 格式化并写入（行格式由 C 核心 lz_logger_log 统一生成，超长不截断）
     // 格式: yyyy-MM-dd HH:mm:ss.SSS [LEVEL] T:1234 [file:line] [func] [tag] xxx
-    //       如果 function 为空，则省略 [func] 字段
-    NSString *fullMessage;
-    if (function && strlen(function) > 0) {
-        fullMessage = [NSString stringWithFormat:@"%s [%s] T:%llx [%@] [%s] [%@] %@\n",
-                       timestamp, levelStr, tid, location, function, tag ?: @"", message];
-    } else {
-        fullMessage = [NSString stringWithFormat:@"%s [%s] T:%llx [%@] [%@] %@\n",
-                       timestamp, levelStr, tid, location, tag ?: @"", message];
-    }
-    
-    // 写入日志
-    const char *messageCStr = [fullMessage UTF8String];
-    uint32_t length = (uint32_t)strlen(messageCStr);
-    
-    lz_log_error_t ret = lz_logger_write(self.handle, messageCStr, length);
+    //       文件名由外部保证只传入文件名；line 为 0 时只显示文件名；function 为空时省略 [func] 字段
+    lz_log_error_t ret = lz_logger_log(self.handle, (lz_log_level_t)level, tag.UTF8String, file,
+                                       (int)line, function, "%s", message.UTF8String ?: "");
     if (ret != LZ_LOG_SUCCESS) {
         // Write 失败用 NSLog，避免递归调用
         NSLog(@"[LZLogger] Write failed: %s", lz_logger_error_string(ret));
@@ -236,8 +197,8 @@
 #ifdef DEBUG
     // Debug 模式下同步输出到控制台
     // 但如果是 FFI 调用（file="flutter"），则跳过 NSLog（Dart 层会用 print 输出）
-    if (strcmp(file, "flutter") != 0) {
-        NSLog(@"[%s] %@", levelStr, fullMessage);
+    if (file == NULL || strcmp(file, "flutter") != 0) {
+        NSLog(@"[%s] [%@] %@", [self levelString:level], tag ?: @"", message);
     }
 #endif
 }
@@ -324,6 +285,10 @@
     self.currentLevel = level;
 }
 
+- (void)setThreadName:(nullable NSString *)name {
+    lz_logger_set_thread_name(name.UTF8String);
+}
+
 - (int32_t)lastInnerError {
     return self.lastInnerErrorValue;
 }
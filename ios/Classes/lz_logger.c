@@ -2,3 +2,13 @@
 // See the comment in ../lz_logger.podspec for more information.
 #include "../../src/lz_logger.c"
 #include "../../src/lz_crypto.c"
+#include "../../src/lz_sink.c"
+#include "../../src/lz_uring.c"
+#include "../../src/lz_manifest.c"
+#include "../../src/lz_housekeeper.c"
+#include "../../src/lz_compress.c"
+#include "../../src/lz_packer.c"
+#include "../../src/lz_keystream.c"
+#include "../../src/lz_format.c"
+#include "../../src/lz_binlog.c"
+#include "../../src/lz_numfmt.c"
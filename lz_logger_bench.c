@@ -0,0 +1,1003 @@
+/**
+ * LZ Logger 基准测试套件（CMake 目标 lz_logger_bench）
+ *
+ * 三组测试，每个组合都逐次计时，统计每次调用耗时的直方图：
+ *   - crypto：lz_crypto_process 的每个可用实现（AES-CTR 系统库 / AES-NI / VAES / ARMv8 / 可移植，
+ *     ChaCha20 AVX2 / NEON / 可移植）× 记录大小 × 起始偏移 % 16
+ *   - write：lz_logger_write（明文 / AES-CTR / ChaCha20）× 记录大小 × 长度 % 16 × 线程数 × 文件大小
+ *     长度 % 16 = 0 时每条记录都从 16 字节对齐的偏移开始，= 1 时起始偏移遍历所有对齐
+ *   - format：时间戳前缀（lz_format_timestamp，对照 gettimeofday + localtime_r + strftime + snprintf
+ *     和只读时钟）、整行格式化（lz_format_line）× 消息长度，以及写入内存句柄的 lz_logger_log（文本行 /
+ *     字符串字典）与 lz_logger_log_binary（输出列为每条记录写入的字节数）、数值转换（lz_numfmt 对照
+ *     snprintf）、lz_logger_log_args 和超过 4KB 的长消息；单次耗时低于计时本身的开销，每 64 次调用计时一次
+ * 输出：
+ *   - 标准输出：Markdown 表格（ns/op、MB/s、p50 / p99 / p99.9 / max，单位纳秒）
+ *   - JSON 文件（默认 lz_logger_bench.json），每个组合一项，便于长期对比
+ * ns/op 和 MB/s 按墙钟时间计算（多线程时为所有线程合计的吞吐），分位数来自每次调用的耗时。
+ * 加密写入前先打开一次日志目录，使主密钥进入缓存，测量不包含 PBKDF2。
+ *
+ * 构建和运行（Linux / macOS）：
+ *   cmake -S src -B build -DCMAKE_BUILD_TYPE=Release
+ *   cmake --build build --target lz_logger_bench
+ *   ./build/lz_logger_bench [--quick] [--suite all|crypto|write|format] [--json 路径] [--dir 测试目录]
+ * 写入测试在每个组合前后删除测试目录中的日志段和目录清单（其他文件不动），--json 不能位于测试目录中。
+ */
+#include "src/lz_logger.h"
+#include "src/lz_crypto.h"
+#include "src/lz_format.h"
+#include "src/lz_binlog.h"
+#include "src/lz_numfmt.h"
+#include "src/lz_manifest.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define DEFAULT_JSON_PATH "lz_logger_bench.json"
+#define DEFAULT_LOG_DIR "/tmp/lz_logger_bench"
+#define BENCH_KEY "test_encryption_key_12345678"
+#define MAX_RECORD 4096
+#define MAX_THREADS 4
+
+// 每个组合处理的数据量（--quick 时缩小为 1/8）
+#define CRYPTO_BYTES_PER_CASE (16 * 1024 * 1024)
+#define WRITE_BYTES_PER_CASE (16 * 1024 * 1024)
+#define FORMAT_OPS_PER_CASE (4 * 1024 * 1024)
+#define FORMAT_BATCH 64
+#define FORMAT_RING_SIZE (4 * 1024 * 1024)
+
+static const size_t crypto_sizes[] = {16, 64, 100, 256, 1024, 4096};
+static const int num_crypto_sizes = 6;
+static const uint32_t crypto_alignments[] = {0, 1, 8, 15};
+static const int num_crypto_alignments = 4;
+
+static const size_t write_sizes[] = {32, 128, 512, 2048};
+static const int num_write_sizes = 4;
+static const uint32_t write_alignments[] = {0, 1};
+static const int num_write_alignments = 2;
+static const int write_threads[] = {1, MAX_THREADS};
+static const int num_write_threads = 2;
+static const uint32_t write_file_sizes[] = {1 * 1024 * 1024, 16 * 1024 * 1024};
+static const int num_write_file_sizes = 2;
+
+static const size_t format_sizes[] = {32, 128, 512, 2048};
+static const int num_format_sizes = 4;
+
+// ============================================================================
+// 延迟直方图
+// ============================================================================
+//
+// 对数-线性分桶：小于 32ns 每纳秒一桶，之后每个 2 的幂区间分 32 桶（相对误差 < 3.2%）。
+// 每个线程一个直方图，结束后合并；最大值单独精确记录。
+
+#define HIST_SUB_BITS 5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} histogram_t;
+
+static int hist_index(uint64_t v) {
+    if (v < HIST_SUB_COUNT) {
+        return (int)v;
+    }
+    int exp = 63 - __builtin_clzll(v);
+    int shift = exp - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_COUNT + (int)((v >> shift) & (HIST_SUB_COUNT - 1));
+}
+
+// 桶的中点
+static uint64_t hist_value(int index) {
+    if (index < HIST_SUB_COUNT) {
+        return (uint64_t)index;
+    }
+    int shift = index / HIST_SUB_COUNT - 1;
+    uint64_t low = (uint64_t)(HIST_SUB_COUNT + index % HIST_SUB_COUNT) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+static void hist_record(histogram_t *h, uint64_t v) {
+    h->counts[hist_index(v)]++;
+    h->total++;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+static void hist_merge(histogram_t *dst, const histogram_t *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+// 分位数（q 为 0 ~ 1），不超过记录到的最大值
+static uint64_t hist_percentile(const histogram_t *h, double q) {
+    if (h->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)h->total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t v = hist_value(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+// ============================================================================
+// 结果输出
+// ============================================================================
+
+typedef struct {
+    const char *suite;   // "crypto" / "write" / "format"
+    const char *variant; // 实现名称或写入模式
+    size_t size;
+    uint32_t alignment;
+    int threads;
+    uint32_t file_size;  // crypto / format 组为 0
+    uint64_t ops;
+    uint64_t elapsed_ns;
+    histogram_t hist;
+} bench_result_t;
+
+static FILE *g_json = NULL;
+static int g_json_items = 0;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void report(const bench_result_t *r) {
+    uint64_t elapsed = r->elapsed_ns > 0 ? r->elapsed_ns : 1;
+    double ns_per_op = (double)elapsed / (double)r->ops;
+    double mb_per_sec = (double)r->size * (double)r->ops / (1024.0 * 1024.0) / ((double)elapsed / 1e9);
+    uint64_t p50 = hist_percentile(&r->hist, 0.50);
+    uint64_t p99 = hist_percentile(&r->hist, 0.99);
+    uint64_t p999 = hist_percentile(&r->hist, 0.999);
+
+    if (strcmp(r->suite, "format") == 0) {
+        printf("| %s | %5zu | %8.1f | %9.1f | %7llu | %7llu | %8llu | %9llu |\n",
+               r->variant, r->size, ns_per_op, mb_per_sec,
+               (unsigned long long)p50, (unsigned long long)p99,
+               (unsigned long long)p999, (unsigned long long)r->hist.max);
+    } else if (r->file_size == 0) {
+        printf("| %s | %5zu | %2u | %10.1f | %9.1f | %7llu | %7llu | %8llu | %9llu |\n",
+               r->variant, r->size, r->alignment, ns_per_op, mb_per_sec,
+               (unsigned long long)p50, (unsigned long long)p99,
+               (unsigned long long)p999, (unsigned long long)r->hist.max);
+    } else {
+        printf("| %s | %5zu | %2u | %d | %2u | %10.1f | %9.1f | %7llu | %7llu | %8llu | %9llu |\n",
+               r->variant, r->size, r->alignment, r->threads, r->file_size / (1024 * 1024),
+               ns_per_op, mb_per_sec,
+               (unsigned long long)p50, (unsigned long long)p99,
+               (unsigned long long)p999, (unsigned long long)r->hist.max);
+    }
+    fflush(stdout);
+
+    if (g_json) {
+        fprintf(g_json,
+                "%s\n    {\"suite\": \"%s\", \"variant\": \"%s\", \"size\": %zu, \"alignment\": %u, "
+                "\"threads\": %d, \"file_size\": %u, \"ops\": %llu, \"ns_per_op\": %.2f, \"mb_per_s\": %.2f, "
+                "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+                g_json_items > 0 ? "," : "", r->suite, r->variant, r->size, r->alignment,
+                r->threads, r->file_size, (unsigned long long)r->ops, ns_per_op, mb_per_sec,
+                (unsigned long long)p50, (unsigned long long)p99,
+                (unsigned long long)p999, (unsigned long long)r->hist.max);
+        g_json_items++;
+    }
+}
+
+// ============================================================================
+// crypto 组：lz_crypto_process
+// ============================================================================
+
+/**
+ * 连续加密递增偏移的记录，每条记录的起始偏移 % 16 固定为 alignment
+ * @param ctx 加密上下文（已选好实现）
+ * @param r 结果（输入 size / alignment，输出 ops / elapsed_ns / hist）
+ * @param total_bytes 数据量
+ */
+static void crypto_case(lz_crypto_context_t *ctx, bench_result_t *r, size_t total_bytes) {
+    static uint8_t input[MAX_RECORD];
+    static uint8_t output[MAX_RECORD];
+    memset(input, 'x', sizeof(input));
+
+    uint64_t stride = (r->size + 15) / 16 * 16;
+    uint64_t ops = total_bytes / r->size;
+    uint64_t offset = r->alignment;
+
+    uint64_t start = now_ns();
+    uint64_t prev = start;
+    for (uint64_t i = 0; i < ops; i++) {
+        lz_crypto_process(ctx, input, output, r->size, offset);
+        offset += stride;
+        uint64_t t = now_ns();
+        hist_record(&r->hist, t - prev);
+        prev = t;
+    }
+
+    r->ops = ops;
+    r->elapsed_ns = prev - start;
+}
+
+static void crypto_table_header(const char *title) {
+    printf("\n### %s\n\n", title);
+    printf("| 实现 | 记录大小 (B) | 偏移 %% 16 | ns/op | MB/s | p50 | p99 | p99.9 | max |\n");
+    printf("|------|------|----|------|------|-----|-----|-------|-----|\n");
+}
+
+/**
+ * 依次测试一种流密码的所有可用实现
+ * @param cipher 流密码
+ * @param first 第一个实现（AES 为 lz_crypto_backend_t，ChaCha20 为 lz_crypto_chacha_backend_t）
+ * @param last 最后一个实现
+ * @param total_bytes 每个组合的数据量
+ * @return 成功返回 0
+ */
+static int run_crypto_cipher(lz_crypto_cipher_t cipher, int first, int last, size_t total_bytes) {
+    lz_crypto_context_t ctx;
+    uint8_t salt[LZ_CRYPTO_SALT_SIZE];
+    if (lz_crypto_generate_salt(cipher, salt) != 0 || lz_crypto_init(&ctx, BENCH_KEY, salt) != 0) {
+        printf("❌ 初始化加密上下文失败\n");
+        return -1;
+    }
+
+    crypto_table_header(cipher == LZ_CRYPTO_CIPHER_CHACHA20 ? "ChaCha20" : "AES-256-CTR");
+    for (int b = first; b <= last; b++) {
+        const char *name;
+        int supported;
+        if (cipher == LZ_CRYPTO_CIPHER_CHACHA20) {
+            name = lz_crypto_chacha_backend_name((lz_crypto_chacha_backend_t)b);
+            supported = lz_crypto_set_chacha_backend((lz_crypto_chacha_backend_t)b) == 0;
+        } else {
+            name = lz_crypto_backend_name((lz_crypto_backend_t)b);
+            supported = lz_crypto_set_backend((lz_crypto_backend_t)b) == 0;
+        }
+        if (!supported) {
+            continue;
+        }
+
+        for (int s = 0; s < num_crypto_sizes; s++) {
+            for (int a = 0; a < num_crypto_alignments; a++) {
+                bench_result_t *r = calloc(1, sizeof(*r));
+                if (!r) {
+                    lz_crypto_cleanup(&ctx);
+                    return -1;
+                }
+                r->suite = "crypto";
+                r->variant = name;
+                r->size = crypto_sizes[s];
+                r->alignment = crypto_alignments[a];
+                r->threads = 1;
+                crypto_case(&ctx, r, total_bytes);
+                report(r);
+                free(r);
+            }
+        }
+    }
+
+    lz_crypto_set_backend(LZ_CRYPTO_BACKEND_AUTO);
+    lz_crypto_set_chacha_backend(LZ_CRYPTO_CHACHA_AUTO);
+    lz_crypto_cleanup(&ctx);
+    return 0;
+}
+
+static int run_crypto_suite(size_t total_bytes) {
+    printf("\n## crypto: lz_crypto_process（每组 %zu MB）\n", total_bytes / (1024 * 1024));
+    if (run_crypto_cipher(LZ_CRYPTO_CIPHER_AES_CTR, LZ_CRYPTO_BACKEND_SYSTEM, LZ_CRYPTO_BACKEND_PORTABLE,
+                          total_bytes) != 0) {
+        return -1;
+    }
+    return run_crypto_cipher(LZ_CRYPTO_CIPHER_CHACHA20, LZ_CRYPTO_CHACHA_PORTABLE, LZ_CRYPTO_CHACHA_NEON,
+                             total_bytes);
+}
+
+// ============================================================================
+// write 组：lz_logger_write
+// ============================================================================
+
+typedef struct {
+    const char *name;
+    const char *key;
+    lz_log_cipher_t cipher;
+} write_mode_t;
+
+static const write_mode_t write_modes[] = {
+    {"plain", NULL, LZ_LOG_CIPHER_AES_CTR},
+    {"aes-ctr", BENCH_KEY, LZ_LOG_CIPHER_AES_CTR},
+    {"chacha20", BENCH_KEY, LZ_LOG_CIPHER_CHACHA20},
+};
+static const int num_write_modes = 3;
+
+typedef struct {
+    lz_logger_handle_t handle;
+    const char *message;
+    uint32_t len;
+    uint64_t ops;
+    pthread_barrier_t *barrier;
+    histogram_t hist;
+    uint64_t failures;
+} write_thread_t;
+
+static void *write_thread_func(void *arg) {
+    write_thread_t *t = (write_thread_t *)arg;
+
+    pthread_barrier_wait(t->barrier);
+    uint64_t prev = now_ns();
+    for (uint64_t i = 0; i < t->ops; i++) {
+        if (lz_logger_write(t->handle, t->message, t->len) != LZ_LOG_SUCCESS) {
+            t->failures++;
+        }
+        uint64_t now = now_ns();
+        hist_record(&t->hist, now - prev);
+        prev = now;
+    }
+    return NULL;
+}
+
+/**
+ * 是否为写入测试产生的文件：日志段 yyyy-mm-dd-N.log（含压缩时的 .tmp）和目录清单
+ * @param name 文件名
+ * @return 是返回 1
+ */
+static int is_bench_file(const char *name) {
+    unsigned int year, month, day, num;
+    int consumed = 0;
+    if (strcmp(name, LZ_MANIFEST_FILE_NAME) == 0) {
+        return 1;
+    }
+    if (sscanf(name, "%4u-%2u-%2u-%u.log%n", &year, &month, &day, &num, &consumed) != 4 || consumed == 0) {
+        return 0;
+    }
+    return name[consumed] == '\0' || strcmp(name + consumed, ".tmp") == 0;
+}
+
+/**
+ * 准备测试目录：不存在时逐级创建；已存在时只删除写入测试产生的文件，其他文件和子目录保持不变
+ * @param dir 测试目录
+ * @return 成功返回 0
+ */
+static int reset_dir(const char *dir) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s", dir) >= (int)sizeof(path)) {
+        return -1;
+    }
+    for (char *p = path + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    DIR *d = opendir(dir);
+    if (!d) {
+        return -1;
+    }
+    int ret = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (is_bench_file(entry->d_name) && unlinkat(dirfd(d), entry->d_name, 0) != 0 && errno != ENOENT) {
+            ret = -1;
+        }
+    }
+    closedir(d);
+    return ret;
+}
+
+/**
+ * 文件是否位于目录（或其子目录）中
+ * @param file 文件路径（所在目录必须存在）
+ * @param dir 目录（不存在时返回 0）
+ * @return 是返回 1
+ */
+static int path_inside(const char *file, const char *dir) {
+    char parent[PATH_MAX];
+    char real_parent[PATH_MAX];
+    char real_dir[PATH_MAX];
+
+    const char *slash = strrchr(file, '/');
+    if (!slash) {
+        snprintf(parent, sizeof(parent), ".");
+    } else if (slash == file) {
+        snprintf(parent, sizeof(parent), "/");
+    } else {
+        snprintf(parent, sizeof(parent), "%.*s", (int)(slash - file), file);
+    }
+    if (!realpath(dir, real_dir) || !realpath(parent, real_parent)) {
+        return 0;
+    }
+    size_t len = strlen(real_dir);
+    return strncmp(real_parent, real_dir, len) == 0 &&
+           (real_parent[len] == '\0' || real_parent[len] == '/' || strcmp(real_dir, "/") == 0);
+}
+
+/**
+ * 运行一个写入组合
+ * @param dir 测试目录
+ * @param mode 写入模式
+ * @param r 结果（输入 size / alignment / threads / file_size，输出 ops / elapsed_ns / hist）
+ * @param total_bytes 数据量
+ * @return 成功返回 0
+ */
+static int write_case(const char *dir, const write_mode_t *mode, bench_result_t *r, size_t total_bytes) {
+    static char message[MAX_RECORD + 16];
+    uint32_t len = (uint32_t)(r->size + r->alignment);
+    memset(message, 'x', len - 1);
+    message[len - 1] = '\n';
+
+    if (reset_dir(dir) != 0) {
+        printf("❌ 创建测试目录失败: %s\n", dir);
+        return -1;
+    }
+
+    lz_logger_set_max_file_size(r->file_size);
+    lz_logger_set_cipher(mode->cipher);
+
+    lz_logger_handle_t handle = NULL;
+    int32_t inner_error = 0, sys_errno = 0;
+    lz_log_error_t ret;
+
+    // 加密时先打开一次：主密钥派生完成并缓存，再次打开续写同一段，不再执行 PBKDF2
+    // （主密钥只在有句柄使用该密码时缓存：两次打开之间由同密码的内存句柄保持）
+    lz_logger_handle_t pin = NULL;
+    if (mode->key != NULL && lz_logger_open_memory(LZ_LOG_MIN_FILE_SIZE, mode->key, &pin) == LZ_LOG_SUCCESS) {
+        ret = lz_logger_open(dir, mode->key, &handle, &inner_error, &sys_errno);
+        if (ret == LZ_LOG_SUCCESS) {
+            lz_logger_close(handle);
+        }
+    }
+
+    ret = lz_logger_open(dir, mode->key, &handle, &inner_error, &sys_errno);
+    if (pin != NULL) {
+        lz_logger_close(pin);
+    }
+    if (ret != LZ_LOG_SUCCESS) {
+        printf("❌ 打开失败: %s (inner=%d, errno=%d)\n", lz_logger_error_string(ret), inner_error, sys_errno);
+        return -1;
+    }
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, (unsigned)r->threads + 1);
+
+    pthread_t tids[MAX_THREADS];
+    write_thread_t *threads = calloc((size_t)r->threads, sizeof(write_thread_t));
+    if (!threads) {
+        pthread_barrier_destroy(&barrier);
+        lz_logger_close(handle);
+        return -1;
+    }
+
+    uint64_t ops_per_thread = total_bytes / len / (uint64_t)r->threads;
+    for (int i = 0; i < r->threads; i++) {
+        threads[i].handle = handle;
+        threads[i].message = message;
+        threads[i].len = len;
+        threads[i].ops = ops_per_thread;
+        threads[i].barrier = &barrier;
+        pthread_create(&tids[i], NULL, write_thread_func, &threads[i]);
+    }
+
+    pthread_barrier_wait(&barrier);
+    uint64_t start = now_ns();
+    uint64_t failures = 0;
+    for (int i = 0; i < r->threads; i++) {
+        pthread_join(tids[i], NULL);
+        hist_merge(&r->hist, &threads[i].hist);
+        failures += threads[i].failures;
+    }
+    r->elapsed_ns = now_ns() - start;
+    r->ops = ops_per_thread * (uint64_t)r->threads;
+
+    lz_logger_close(handle);
+    pthread_barrier_destroy(&barrier);
+    free(threads);
+
+    if (failures > 0) {
+        printf("❌ %llu 次写入失败\n", (unsigned long long)failures);
+        return -1;
+    }
+    return 0;
+}
+
+static int run_write_suite(const char *dir, size_t total_bytes) {
+    printf("\n## write: lz_logger_write（每组 %zu MB）\n\n", total_bytes / (1024 * 1024));
+    printf("| 模式 | 记录大小 (B) | 长度 %% 16 | 线程 | 文件 (MB) | ns/op | MB/s | p50 | p99 | p99.9 | max |\n");
+    printf("|------|------|----|----|----|------|------|-----|-----|-------|-----|\n");
+
+    int failed = 0;
+    for (int m = 0; m < num_write_modes; m++) {
+        for (int s = 0; s < num_write_sizes; s++) {
+            for (int a = 0; a < num_write_alignments; a++) {
+                for (int t = 0; t < num_write_threads; t++) {
+                    for (int f = 0; f < num_write_file_sizes; f++) {
+                        bench_result_t *r = calloc(1, sizeof(*r));
+                        if (!r) {
+                            return -1;
+                        }
+                        r->suite = "write";
+                        r->variant = write_modes[m].name;
+                        r->size = write_sizes[s];
+                        r->alignment = write_alignments[a];
+                        r->threads = write_threads[t];
+                        r->file_size = write_file_sizes[f];
+                        if (write_case(dir, &write_modes[m], r, total_bytes) == 0) {
+                            r->size += r->alignment;
+                            report(r);
+                        } else {
+                            failed = 1;
+                        }
+                        free(r);
+                    }
+                }
+            }
+        }
+    }
+
+    // 恢复默认配置
+    lz_logger_set_max_file_size(LZ_LOG_DEFAULT_FILE_SIZE);
+    lz_logger_set_cipher(LZ_LOG_CIPHER_AES_CTR);
+    reset_dir(dir);
+    return failed ? -1 : 0;
+}
+
+// ============================================================================
+// format 组：时间戳前缀和整行格式化
+// ============================================================================
+
+/** 改动前各平台封装的时间戳写法，作为对照 */
+static size_t legacy_timestamp(char *out, size_t size) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    struct tm tm_info;
+    localtime_r(&tv.tv_sec, &tm_info);
+    char time_buf[32];
+    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_info);
+    return (size_t)snprintf(out, size, "%s.%03d", time_buf, (int)(tv.tv_usec / 1000));
+}
+
+/** 只读取 lz_format_timestamp 使用的时钟，两者之差为前缀生成本身的耗时 */
+static void coarse_clock(char *out) {
+    struct timespec ts;
+#if defined(CLOCK_REALTIME_COARSE)
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+    memcpy(out, &ts, sizeof(ts));
+}
+
+static void bench_format_line(char *out, size_t size, const char *fmt, ...) {
+    static const lz_format_record_t record = {LZ_LOG_LEVEL_INFO, "Bench", "lz_logger_bench.c", 42, "format_case"};
+    va_list args;
+    va_start(args, fmt);
+    lz_format_line(out, size, &record, fmt, args);
+    va_end(args);
+}
+
+/** 整条日志的典型写法：文本行与二进制记录使用同一个格式串和参数 */
+#define BENCH_LOG_FMT "request %d to %s finished: status=%d bytes=%zu elapsed=%.3fms"
+#define BENCH_LOG_ARGS(i) (i), "api.example.com", 200, (size_t)(i) * 16, (i) * 0.125
+
+static lz_logger_handle_t g_log_handle = NULL;
+static lz_logger_handle_t g_intern_handle = NULL;
+static lz_log_site_t g_log_site = {BENCH_LOG_FMT, "Bench", "lz_logger_bench.c", "bench_log", 42, LZ_LOG_LEVEL_INFO, NULL};
+
+static void bench_log_text(int i) {
+    lz_logger_log(g_log_handle, LZ_LOG_LEVEL_INFO, "Bench", "lz_logger_bench.c", 42, "bench_log",
+                  BENCH_LOG_FMT, BENCH_LOG_ARGS(i));
+}
+
+/** 超过 LZ_FORMAT_BUFFER_SIZE 的长消息（线程缓冲扩大后不再分配内存、只格式化一次） */
+#define BENCH_LONG_SIZE 8192
+static char g_long_message[BENCH_LONG_SIZE + 1];
+
+static void bench_log_long(int i) {
+    lz_logger_log(g_log_handle, LZ_LOG_LEVEL_INFO, "Bench", "lz_logger_bench.c", 42, "bench_log",
+                  "#%d %s", i, g_long_message);
+}
+
+static void bench_log_interned(int i) {
+    lz_logger_log(g_intern_handle, LZ_LOG_LEVEL_INFO, "Bench", "lz_logger_bench.c", 42, "bench_log",
+                  BENCH_LOG_FMT, BENCH_LOG_ARGS(i));
+}
+
+static void bench_log_binary(int i) {
+    lz_logger_log_binary(g_log_handle, &g_log_site, BENCH_LOG_ARGS(i));
+}
+
+/** 同一条日志的类型化参数写法（浮点数为最短还原表示） */
+#define BENCH_ARGS_FMT "request {} to {} finished: status={} bytes={} elapsed={}ms"
+#define BENCH_ARGS(i) {lz_arg_i64(i), lz_arg_str("api.example.com"), lz_arg_i64(200), \
+                       lz_arg_u64((uint64_t)(i) * 16), lz_arg_f64((i) * 0.125)}
+
+static void bench_log_args(int i) {
+    lz_arg_t args[] = BENCH_ARGS(i);
+    lz_logger_log_args(g_log_handle, LZ_LOG_LEVEL_INFO, "Bench", "lz_logger_bench.c", 42, "bench_log",
+                       BENCH_ARGS_FMT, args, 5);
+}
+
+/** 每条记录写入的字节数：类型化参数的文本行长度 */
+static size_t bench_args_size(int i) {
+    static const lz_format_record_t record = {LZ_LOG_LEVEL_INFO, "Bench", "lz_logger_bench.c", 42, "bench_log"};
+    lz_arg_t args[] = BENCH_ARGS(i);
+    int64_t len = lz_format_line_args(NULL, 0, &record, BENCH_ARGS_FMT, args, 5);
+    return len > 0 ? (size_t)len : 0;
+}
+
+/** 数值转换的输入：位数、量级各不相同的 FORMAT_BATCH 个值 */
+static uint64_t g_bench_u64[FORMAT_BATCH];
+static double g_bench_f64[FORMAT_BATCH];
+
+static void bench_numbers_init(void) {
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < FORMAT_BATCH; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        g_bench_u64[i] = x >> (i % 64);
+        // 延迟 / 比率类指标：0.001 ~ 1e6，有效数字位数不等
+        g_bench_f64[i] = (double)(x % 1000000007u) / (double)(1u << (i % 20));
+    }
+}
+
+/** 一组数值转换的平均输出长度 */
+static size_t bench_number_size(int kind) {
+    char out[LZ_NUMFMT_MAX_SIZE];
+    size_t total = 0;
+    for (int i = 0; i < FORMAT_BATCH; i++) {
+        total += kind == 0 ? lz_numfmt_u64(out, g_bench_u64[i])
+               : kind == 1 ? lz_numfmt_hex(out, g_bench_u64[i])
+                           : lz_numfmt_f64(out, g_bench_f64[i]);
+    }
+    return total / FORMAT_BATCH;
+}
+
+/** 每条记录写入的字节数：文本行的长度 */
+static size_t bench_text_size(const char *fmt, ...) {
+    static const lz_format_record_t record = {LZ_LOG_LEVEL_INFO, "Bench", "lz_logger_bench.c", 42, "bench_log"};
+    va_list args;
+    va_start(args, fmt);
+    int64_t len = lz_format_line(NULL, 0, &record, fmt, args);
+    va_end(args);
+    return len > 0 ? (size_t)len : 0;
+}
+
+/** 每条记录写入的字节数：行记录的长度（不含每个纪元一次的字符串定义） */
+static size_t bench_interned_size(const char *fmt, ...) {
+    static const lz_format_record_t record = {LZ_LOG_LEVEL_INFO, "Bench", "lz_logger_bench.c", 42, "bench_log"};
+    lz_binlog_state_t state;
+    lz_binlog_line_t line;
+    lz_binlog_state_init(&state);
+    if (!lz_binlog_enable_strings(&state)) {
+        return 0;
+    }
+    lz_binlog_prepare_line(&state, &record, &line);
+    va_list args;
+    va_start(args, fmt);
+    int64_t len = lz_binlog_encode_line(&state, &line, &record, NULL, 0, fmt, args);
+    va_end(args);
+    lz_binlog_state_destroy(&state);
+    return len > 0 ? (size_t)len : 0;
+}
+
+/** 每条记录写入的字节数：二进制记录的长度（不含每个纪元一次的格式定义） */
+static size_t bench_binary_size(int unused, ...) {
+    lz_binlog_state_t state;
+    lz_binlog_stamp_t stamp;
+    lz_binlog_site_t *impl = lz_binlog_site(&g_log_site);
+    if (impl == NULL) {
+        return 0;
+    }
+    lz_binlog_state_init(&state);
+    lz_binlog_stamp(&state, &stamp);
+    va_list args;
+    va_start(args, unused);
+    size_t len = lz_binlog_encode(&state, impl, 0, &stamp, NULL, 0, args);
+    va_end(args);
+    return len;
+}
+
+/**
+ * 每 FORMAT_BATCH 次调用计时一次，直方图记录批内的平均耗时
+ * @param r 结果（输入 variant / size，输出 ops / elapsed_ns / hist）
+ * @param kind 0 = 对照时间戳，1 = 只读粗粒度时钟，2 = lz_format_timestamp，3 = lz_format_line，
+ *             4 = lz_logger_log，5 = lz_logger_log_binary（写入 g_log_handle），
+ *             6 = lz_logger_log（写入开启字符串字典的 g_intern_handle），
+ *             7 / 8 = snprintf %llu / lz_numfmt_u64，9 / 10 = snprintf %llx / lz_numfmt_hex，
+ *             11 / 12 = snprintf %.17g / lz_numfmt_f64，13 = lz_logger_log_args（写入 g_log_handle），
+ *             14 = lz_logger_log 写入 8KB 长消息（写入 g_log_handle）
+ * @param message kind = 3 时的消息
+ * @param total_ops 调用次数
+ */
+static void format_case(bench_result_t *r, int kind, const char *message, uint64_t total_ops) {
+    static char out[MAX_RECORD * 2];
+    uint64_t batches = total_ops / FORMAT_BATCH;
+
+    uint64_t start = now_ns();
+    uint64_t prev = start;
+    for (uint64_t b = 0; b < batches; b++) {
+        for (int i = 0; i < FORMAT_BATCH; i++) {
+            switch (kind) {
+            case 0:
+                legacy_timestamp(out, sizeof(out));
+                break;
+            case 1:
+                coarse_clock(out);
+                break;
+            case 2:
+                lz_format_timestamp(out);
+                break;
+            case 4:
+                bench_log_text(i);
+                break;
+            case 5:
+                bench_log_binary(i);
+                break;
+            case 6:
+                bench_log_interned(i);
+                break;
+            case 7:
+                snprintf(out, sizeof(out), "%" PRIu64, g_bench_u64[i]);
+                break;
+            case 8:
+                lz_numfmt_u64(out, g_bench_u64[i]);
+                break;
+            case 9:
+                snprintf(out, sizeof(out), "%" PRIx64, g_bench_u64[i]);
+                break;
+            case 10:
+                lz_numfmt_hex(out, g_bench_u64[i]);
+                break;
+            case 11:
+                snprintf(out, sizeof(out), "%.17g", g_bench_f64[i]);
+                break;
+            case 12:
+                lz_numfmt_f64(out, g_bench_f64[i]);
+                break;
+            case 13:
+                bench_log_args(i);
+                break;
+            case 14:
+                bench_log_long(i);
+                break;
+            default:
+                bench_format_line(out, sizeof(out), "%s", message);
+                break;
+            }
+        }
+        uint64_t t = now_ns();
+        hist_record(&r->hist, (t - prev) / FORMAT_BATCH);
+        prev = t;
+    }
+
+    r->ops = batches * FORMAT_BATCH;
+    r->elapsed_ns = prev - start;
+}
+
+static int run_format_suite(uint64_t total_ops) {
+    printf("\n## format: 日志行格式化（每组 %llu 次，每 %d 次计时一次）\n\n",
+           (unsigned long long)total_ops, FORMAT_BATCH);
+    printf("| 实现 | 输出 (B) | ns/op | MB/s | p50 | p99 | p99.9 | max |\n");
+    printf("|------|------|------|------|-----|-----|-------|-----|\n");
+
+    static char message[MAX_RECORD];
+    memset(message, 'x', sizeof(message) - 1);
+
+    const char *timestamp_variants[] = {"strftime+snprintf", "clock_gettime", "lz_format_timestamp"};
+    for (int v = 0; v < 3; v++) {
+        bench_result_t *r = calloc(1, sizeof(*r));
+        if (!r) {
+            return -1;
+        }
+        r->suite = "format";
+        r->variant = timestamp_variants[v];
+        r->size = LZ_FORMAT_TIMESTAMP_SIZE;
+        r->threads = 1;
+        format_case(r, v, NULL, total_ops);
+        report(r);
+        free(r);
+    }
+
+    for (int s = 0; s < num_format_sizes; s++) {
+        bench_result_t *r = calloc(1, sizeof(*r));
+        if (!r) {
+            return -1;
+        }
+        message[format_sizes[s]] = '\0';
+        r->suite = "format";
+        r->variant = "lz_format_line";
+        r->size = format_sizes[s];
+        r->threads = 1;
+        format_case(r, 3, message, total_ops);
+        report(r);
+        message[format_sizes[s]] = 'x';
+        free(r);
+    }
+
+    // 数值转换：snprintf 与 lz_numfmt 交替（输出列为平均长度）
+    bench_numbers_init();
+    const char *number_variants[] = {"snprintf %llu", "lz_numfmt_u64", "snprintf %llx", "lz_numfmt_hex",
+                                     "snprintf %.17g", "lz_numfmt_f64"};
+    for (int v = 0; v < 6; v++) {
+        bench_result_t *r = calloc(1, sizeof(*r));
+        if (!r) {
+            return -1;
+        }
+        r->suite = "format";
+        r->variant = number_variants[v];
+        r->size = bench_number_size(v / 2);
+        r->threads = 1;
+        format_case(r, 7 + v, NULL, total_ops);
+        report(r);
+        free(r);
+    }
+
+    // 整条日志：写入内存句柄（不加密，环写满后覆盖）
+    lz_log_error_t ret = lz_logger_open_memory(FORMAT_RING_SIZE, NULL, &g_log_handle);
+    if (ret == LZ_LOG_SUCCESS) {
+        lz_logger_set_string_interning(1);
+        ret = lz_logger_open_memory(FORMAT_RING_SIZE, NULL, &g_intern_handle);
+        lz_logger_set_string_interning(0);
+    }
+    if (ret != LZ_LOG_SUCCESS) {
+        printf("| 打开内存句柄失败 | | | | | | | |\n");
+        lz_logger_close(g_log_handle);
+        return -1;
+    }
+    memset(g_long_message, 'x', BENCH_LONG_SIZE);
+    const char *log_variants[] = {"lz_logger_log", "lz_logger_log_binary", "lz_logger_log (interned)",
+                                  "lz_logger_log_args", "lz_logger_log (8KB)"};
+    size_t log_sizes[] = {bench_text_size(BENCH_LOG_FMT, BENCH_LOG_ARGS(1000)),
+                          bench_binary_size(0, BENCH_LOG_ARGS(1000)),
+                          bench_interned_size(BENCH_LOG_FMT, BENCH_LOG_ARGS(1000)),
+                          bench_args_size(1000),
+                          bench_text_size("#%d %s", 1000, g_long_message)};
+    int kinds[] = {4, 5, 6, 13, 14};
+    int failed = 0;
+    for (int v = 0; v < 5; v++) {
+        bench_result_t *r = calloc(1, sizeof(*r));
+        if (!r) {
+            failed = 1;
+            break;
+        }
+        r->suite = "format";
+        r->variant = log_variants[v];
+        r->size = log_sizes[v];
+        r->threads = 1;
+        format_case(r, kinds[v], NULL, total_ops);
+        report(r);
+        free(r);
+    }
+    lz_logger_close(g_log_handle);
+    lz_logger_close(g_intern_handle);
+    g_log_handle = NULL;
+    g_intern_handle = NULL;
+    return failed ? -1 : 0;
+}
+
+// ============================================================================
+// 入口
+// ============================================================================
+
+static void usage(const char *prog) {
+    printf("用法: %s [--quick] [--suite all|crypto|write|format] [--json 路径] [--dir 测试目录]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int quick = 0;
+    const char *suite = "all";
+    const char *json_path = DEFAULT_JSON_PATH;
+    const char *dir = DEFAULT_LOG_DIR;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = 1;
+        } else if (strcmp(argv[i], "--suite") == 0 && i + 1 < argc) {
+            suite = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    int want_crypto = strcmp(suite, "all") == 0 || strcmp(suite, "crypto") == 0;
+    int want_write = strcmp(suite, "all") == 0 || strcmp(suite, "write") == 0;
+    int want_format = strcmp(suite, "all") == 0 || strcmp(suite, "format") == 0;
+    if (!want_crypto && !want_write && !want_format) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    size_t crypto_bytes = quick ? CRYPTO_BYTES_PER_CASE / 8 : CRYPTO_BYTES_PER_CASE;
+    size_t write_bytes = quick ? WRITE_BYTES_PER_CASE / 8 : WRITE_BYTES_PER_CASE;
+    uint64_t format_ops = quick ? FORMAT_OPS_PER_CASE / 8 : FORMAT_OPS_PER_CASE;
+
+    // 写入测试会清理测试目录，结果文件不能放在其中
+    if (want_write && path_inside(json_path, dir)) {
+        printf("❌ --json 不能位于测试目录 %s 中: %s\n", dir, json_path);
+        return 2;
+    }
+
+    g_json = fopen(json_path, "w");
+    if (!g_json) {
+        printf("❌ 无法写入 %s\n", json_path);
+        return 1;
+    }
+
+    time_t now = time(NULL);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    printf("\n");
+    printf("# LZ Logger 基准测试\n\n");
+    printf("**CPU:** %ld 核，AES 指令: %s  \n", cpus, lz_crypto_has_aes_hardware() ? "有" : "无");
+    printf("**自动选择:** %s / %s  \n", lz_crypto_backend_name(lz_crypto_get_backend()),
+           lz_crypto_chacha_backend_name(lz_crypto_get_chacha_backend()));
+    printf("**延迟单位:** 纳秒（每次调用）  \n");
+
+    fprintf(g_json, "{\n  \"schema\": 1,\n  \"timestamp\": \"%s\",\n  \"quick\": %s,\n", timestamp,
+            quick ? "true" : "false");
+    fprintf(g_json, "  \"cpus\": %ld,\n  \"aes_hardware\": %s,\n", cpus,
+            lz_crypto_has_aes_hardware() ? "true" : "false");
+    fprintf(g_json, "  \"aes_backend\": \"%s\",\n  \"chacha_backend\": \"%s\",\n",
+            lz_crypto_backend_name(lz_crypto_get_backend()),
+            lz_crypto_chacha_backend_name(lz_crypto_get_chacha_backend()));
+    fprintf(g_json, "  \"results\": [");
+
+    int failed = 0;
+    if (want_crypto && run_crypto_suite(crypto_bytes) != 0) {
+        failed = 1;
+    }
+    if (want_write && run_write_suite(dir, write_bytes) != 0) {
+        failed = 1;
+    }
+    if (want_format && run_format_suite(format_ops) != 0) {
+        failed = 1;
+    }
+
+    fprintf(g_json, "\n  ]\n}\n");
+    fclose(g_json);
+
+    printf("\n---\n\n");
+    printf("**JSON:** `%s`\n\n", json_path);
+    if (failed) {
+        printf("❌ **部分测试失败**\n\n");
+        return 1;
+    }
+    printf("✅ **所有测试完成！**\n\n");
+    return 0;
+}
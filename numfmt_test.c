@@ -0,0 +1,434 @@
+/**
+ * 数值格式化（lz_numfmt）一致性测试
+ *
+ * 以 C 库的 snprintf / strtod 为参照：
+ *   - 整数：lz_numfmt_u64 / lz_numfmt_i64 / lz_numfmt_hex 与 "%llu" "%lld" "%llx" 逐字节一致
+ *     （0、两端极值、10 和 2 的幂及其前后相邻值、随机值）
+ *   - 浮点数：lz_numfmt_f64 的输出经 strtod 还原为同一个 double（按位相同，含 -0 的符号），
+ *     且与参照结果逐字节一致。参照：从 1 位起逐位用 "%.*e" 取最接近的十进制，
+ *     它（或另一侧的相邻值）能被 strtod 还原时即为最短；再按 JavaScript Number.prototype.toString 的规则排版
+ *   - 覆盖次正规数（含最小值和最大值）、所有 10 的幂及其前后相邻的 double、
+ *     定点 / 科学计数的切换点（1e-6、1e21 两侧）、-0、nan、inf、-inf 和随机位模式
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o numfmt_test numfmt_test.c src/lz_numfmt.c -I. -lm
+ */
+#include "src/lz_numfmt.h"
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_RANDOM 100000
+
+static int failures = 0;
+
+static void check(int ok, const char *what) {
+    printf("- %s %s\n", ok ? "✅" : "❌", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+
+static uint64_t next_random(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+static uint64_t double_bits(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static double bits_double(uint64_t bits) {
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// ============================================================================
+// 参照实现
+// ============================================================================
+
+// 十进制 m × 10^e 能否被 strtod 还原为 v
+static int round_trips(uint64_t m, int e, double v) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%" PRIu64 "e%d", m, e);
+    return strtod(buf, NULL) == v;
+}
+
+// v（正数）用 p 位有效数字时最接近的十进制 m × 10^e（printf 按精确值舍入）
+static void nearest_decimal(double v, int p, uint64_t *m, int *e) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*e", p - 1, v);
+    uint64_t digits = 0;
+    char *s = buf;
+    for (; *s != 'e'; s++) {
+        if (*s != '.') {
+            digits = digits * 10 + (uint64_t)(*s - '0');
+        }
+    }
+    *m = digits;
+    *e = atoi(s + 1) - (p - 1);
+}
+
+/**
+ * 按 JavaScript Number.prototype.toString 的规则排版正的十进制 m × 10^e（m 不以 0 结尾）
+ * @return 写入的字节数
+ */
+static size_t js_layout(char *out, uint64_t m, int e) {
+    char digits[24];
+    int k = snprintf(digits, sizeof(digits), "%" PRIu64, m);
+    int n = k + e; // 小数点位置
+    size_t len = 0;
+
+    if (k <= n && n <= 21) {
+        memcpy(out, digits, (size_t)k);
+        len = (size_t)k;
+        for (int i = 0; i < n - k; i++) {
+            out[len++] = '0';
+        }
+    } else if (0 < n && n <= 21) {
+        memcpy(out, digits, (size_t)n);
+        out[n] = '.';
+        memcpy(out + n + 1, digits + n, (size_t)(k - n));
+        len = (size_t)k + 1;
+    } else if (-6 < n && n <= 0) {
+        out[len++] = '0';
+        out[len++] = '.';
+        for (int i = 0; i < -n; i++) {
+            out[len++] = '0';
+        }
+        memcpy(out + len, digits, (size_t)k);
+        len += (size_t)k;
+    } else {
+        out[len++] = digits[0];
+        if (k > 1) {
+            out[len++] = '.';
+            memcpy(out + len, digits + 1, (size_t)(k - 1));
+            len += (size_t)(k - 1);
+        }
+        len += (size_t)sprintf(out + len, "e%c%d", n - 1 > 0 ? '+' : '-', abs(n - 1));
+    }
+    return len;
+}
+
+/**
+ * 参照输出：能还原为 v 的最短十进制，同样位数中取最接近 v 的
+ * @return 写入的字节数（out 以 0 结尾）
+ */
+static size_t reference_f64(char *out, double v) {
+    if (isnan(v)) {
+        return (size_t)sprintf(out, "nan");
+    }
+    size_t len = 0;
+    if (signbit(v)) {
+        out[len++] = '-';
+        v = -v;
+    }
+    if (isinf(v)) {
+        return len + (size_t)sprintf(out + len, "inf");
+    }
+    if (v == 0) {
+        out[len++] = '0';
+        out[len] = '\0';
+        return len;
+    }
+
+    uint64_t m = 0;
+    int e = 0;
+    for (int p = 1; p <= 17; p++) {
+        nearest_decimal(v, p, &m, &e);
+        if (round_trips(m, e, v)) {
+            break;
+        }
+        // 2 的幂处下方的舍入区间只有上方的一半：最接近的一侧还原不了时，另一侧仍可能可以
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%" PRIu64 "e%d", m, e);
+        uint64_t other = strtod(buf, NULL) < v ? m + 1 : m - 1;
+        if (round_trips(other, e, v)) {
+            m = other;
+            break;
+        }
+    }
+    while (m % 10 == 0) {
+        m /= 10;
+        e++;
+    }
+
+    len += js_layout(out + len, m, e);
+    out[len] = '\0';
+    return len;
+}
+
+// ============================================================================
+// 测试
+// ============================================================================
+
+static char g_first_mismatch[256];
+static int g_mismatches = 0;
+
+// 比较一个浮点数的输出，记录第一个不一致的值
+static void compare_f64(double v) {
+    char got[LZ_NUMFMT_MAX_SIZE + 1];
+    char want[64];
+    size_t got_len = lz_numfmt_f64(got, v);
+    got[got_len] = '\0';
+    reference_f64(want, v);
+
+    int ok = got_len <= 25 && strcmp(got, want) == 0;
+    if (ok && !isnan(v)) {
+        // 逐字节一致之外再确认还原（-0 的符号也要保留）
+        ok = double_bits(strtod(got, NULL)) == double_bits(v);
+    }
+    if (!ok && g_mismatches++ == 0) {
+        snprintf(g_first_mismatch, sizeof(g_first_mismatch), "%.17g (0x%016" PRIx64 "): got \"%s\", want \"%s\"",
+                 v, double_bits(v), got, want);
+    }
+}
+
+// 汇总一组浮点数的比较结果
+static void report_f64(const char *what, int count) {
+    char line[512];
+    snprintf(line, sizeof(line), "%s（%d 个）", what, count);
+    check(g_mismatches == 0, line);
+    if (g_mismatches != 0) {
+        printf("  - %d 个不一致，首个：%s\n", g_mismatches, g_first_mismatch);
+    }
+    g_mismatches = 0;
+}
+
+// 比较一个双精度数及其前后相邻的 double
+static int compare_neighbors(double v) {
+    compare_f64(v);
+    compare_f64(nextafter(v, 0));
+    compare_f64(nextafter(v, INFINITY));
+    compare_f64(-v);
+    return 4;
+}
+
+static void compare_integers(uint64_t u) {
+    char got[LZ_NUMFMT_MAX_SIZE + 1], want[64];
+    size_t n;
+
+    n = lz_numfmt_u64(got, u);
+    got[n] = '\0';
+    snprintf(want, sizeof(want), "%" PRIu64, u);
+    int ok = strcmp(got, want) == 0;
+
+    n = lz_numfmt_i64(got, (int64_t)u);
+    got[n] = '\0';
+    snprintf(want, sizeof(want), "%" PRId64, (int64_t)u);
+    ok = ok && strcmp(got, want) == 0;
+
+    n = lz_numfmt_hex(got, u);
+    got[n] = '\0';
+    snprintf(want, sizeof(want), "%" PRIx64, u);
+    ok = ok && strcmp(got, want) == 0;
+
+    if (!ok && g_mismatches++ == 0) {
+        snprintf(g_first_mismatch, sizeof(g_first_mismatch), "0x%016" PRIx64 ": got \"%s\", want \"%s\"", u, got,
+                 want);
+    }
+}
+
+static void test_integers(void) {
+    printf("\n## 整数\n\n");
+
+    int count = 0;
+    uint64_t edges[] = {0, 1, 9, 10, 15, 16, 99, 100, INT64_MAX, (uint64_t)INT64_MIN, UINT64_MAX};
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        compare_integers(edges[i]);
+        count++;
+    }
+    uint64_t p10 = 1;
+    for (int i = 0; i < 20; i++, p10 *= 10) {
+        compare_integers(p10 - 1);
+        compare_integers(p10);
+        compare_integers(p10 + 1);
+        compare_integers(0 - p10);
+        count += 4;
+    }
+    for (int i = 0; i < 64; i++) {
+        uint64_t p2 = 1ull << i;
+        compare_integers(p2 - 1);
+        compare_integers(p2);
+        compare_integers(p2 + 1);
+        count += 3;
+    }
+    for (int i = 0; i < NUM_RANDOM; i++) {
+        // 随机位宽，各种长度都能覆盖到
+        uint64_t u = next_random() >> (next_random() & 63);
+        compare_integers(u);
+        count++;
+    }
+
+    char line[256];
+    snprintf(line, sizeof(line), "十进制（无符号 / 有符号）和十六进制与 printf 一致（%d 个）", count);
+    check(g_mismatches == 0, line);
+    if (g_mismatches != 0) {
+        printf("  - %d 个不一致，首个：%s\n", g_mismatches, g_first_mismatch);
+    }
+    g_mismatches = 0;
+}
+
+static void test_special(void) {
+    printf("\n## 特殊值\n\n");
+
+    char out[LZ_NUMFMT_MAX_SIZE + 1];
+    size_t n;
+
+    n = lz_numfmt_f64(out, 0.0);
+    check(n == 1 && memcmp(out, "0", 1) == 0, "0 输出 \"0\"");
+    n = lz_numfmt_f64(out, -0.0);
+    check(n == 2 && memcmp(out, "-0", 2) == 0, "-0 输出 \"-0\"");
+    n = lz_numfmt_f64(out, NAN);
+    check(n == 3 && memcmp(out, "nan", 3) == 0, "nan 输出 \"nan\"");
+    n = lz_numfmt_f64(out, -NAN);
+    check(n == 3 && memcmp(out, "nan", 3) == 0, "符号位为 1 的 nan 输出 \"nan\"");
+    n = lz_numfmt_f64(out, INFINITY);
+    check(n == 3 && memcmp(out, "inf", 3) == 0, "inf 输出 \"inf\"");
+    n = lz_numfmt_f64(out, -INFINITY);
+    check(n == 4 && memcmp(out, "-inf", 4) == 0, "-inf 输出 \"-inf\"");
+}
+
+static void test_thresholds(void) {
+    printf("\n## 定点 / 科学计数切换点\n\n");
+
+    struct {
+        double value;
+        const char *text;
+    } cases[] = {
+        {1e21, "1e+21"},
+        {nextafter(1e21, 0), "999999999999999900000"},
+        {1e20, "100000000000000000000"},
+        {123456789012345678901.0, "123456789012345680000"},
+        {1e-6, "0.000001"},
+        {nextafter(1e-6, 0), "9.999999999999997e-7"},
+        {1e-7, "1e-7"},
+        {1.5e-7, "1.5e-7"},
+        {0.1, "0.1"},
+        {0.001, "0.001"},
+        {1.5, "1.5"},
+        {100, "100"},
+        {-1e21, "-1e+21"},
+        {-1e-7, "-1e-7"},
+        {DBL_MAX, "1.7976931348623157e+308"},
+        {DBL_MIN, "2.2250738585072014e-308"},
+        {5e-324, "5e-324"},
+    };
+
+    int ok = 1;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char out[LZ_NUMFMT_MAX_SIZE + 1];
+        size_t n = lz_numfmt_f64(out, cases[i].value);
+        out[n] = '\0';
+        if (strcmp(out, cases[i].text) != 0) {
+            printf("  - %s: got \"%s\"\n", cases[i].text, out);
+            ok = 0;
+        }
+    }
+    check(ok, "1e-6、1e21 两侧及典型值与 JavaScript 的输出一致");
+
+    // 切换点附近的一段连续 double
+    int count = 0;
+    double starts[] = {1e21, 1e-6, 1e-7};
+    for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        double lo = starts[i], hi = starts[i];
+        for (int j = 0; j < 1000; j++) {
+            compare_f64(lo);
+            compare_f64(hi);
+            lo = nextafter(lo, 0);
+            hi = nextafter(hi, INFINITY);
+            count += 2;
+        }
+    }
+    report_f64("切换点两侧各 1000 个相邻 double 与参照一致并可还原", count);
+}
+
+static void test_powers_of_ten(void) {
+    printf("\n## 10 的幂\n\n");
+
+    int count = 0;
+    for (int e = -323; e <= 308; e++) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "1e%d", e);
+        count += compare_neighbors(strtod(buf, NULL));
+    }
+    report_f64("1e-323 到 1e308 及其前后相邻的 double、负值与参照一致并可还原", count);
+
+    int count2 = 0;
+    for (int e = -1074; e <= 1023; e++) {
+        count2 += compare_neighbors(ldexp(1.0, e));
+    }
+    report_f64("2 的幂（舍入区间不对称）及其前后相邻的 double 与参照一致并可还原", count2);
+}
+
+static void test_subnormals(void) {
+    printf("\n## 次正规数\n\n");
+
+    int count = 0;
+    // 最小的若干个、最大的若干个
+    for (uint64_t bits = 1; bits <= 1000; bits++) {
+        compare_f64(bits_double(bits));
+        compare_f64(bits_double(0x000FFFFFFFFFFFFFull - bits + 1));
+        count += 2;
+    }
+    for (int i = 0; i < NUM_RANDOM / 5; i++) {
+        uint64_t bits = next_random() & 0x800FFFFFFFFFFFFFull;
+        compare_f64(bits_double(bits));
+        count++;
+    }
+    report_f64("次正规数（最小、最大各 1000 个和随机值，含负值）与参照一致并可还原", count);
+}
+
+static void test_random(void) {
+    printf("\n## 随机值\n\n");
+
+    int count = 0;
+    for (int i = 0; i < NUM_RANDOM; i++) {
+        double v = bits_double(next_random());
+        if (isnan(v)) {
+            continue;
+        }
+        compare_f64(v);
+        count++;
+    }
+    report_f64("随机位模式与参照一致并可还原", count);
+
+    count = 0;
+    for (int i = 0; i < NUM_RANDOM / 5; i++) {
+        // 位数较少的十进制（如 0.3、12.5），最短输出即为原文
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%" PRIu64 "e%d", next_random() % 100000, (int)(next_random() % 40) - 20);
+        compare_f64(strtod(buf, NULL));
+        count++;
+    }
+    report_f64("短十进制与参照一致并可还原", count);
+}
+
+int main() {
+    printf("\n# LZ Logger 数值格式化测试\n");
+
+    test_integers();
+    test_special();
+    test_thresholds();
+    test_powers_of_ten();
+    test_subnormals();
+    test_random();
+
+    printf("\n---\n\n");
+    if (failures != 0) {
+        printf("❌ **%d 项检查失败**\n\n", failures);
+        return 1;
+    }
+    printf("✅ **所有检查通过！**\n\n");
+    return 0;
+}
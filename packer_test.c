@@ -0,0 +1,455 @@
+/**
+ * 写入时压缩（EndB 块流）往返测试
+ *
+ *   - 压缩管线：4 个线程经 lz_packer_write 写入（含超过 64KB 的记录），回调收集压缩好的块；
+ *     停止写入后不调用 flush，等待定期提交把未写满的块交出，再逐块解压，检查每个线程的记录完整且顺序不变
+ *   - 日志段（mmap / io_uring 后端，加密）：子进程写入后等待定期提交和空闲刷盘，随后被 SIGKILL 杀死，
+ *     未封存的块流用 lz_logger_decompress_file 还原，崩溃前的记录必须全部在文件中；
+ *     再原地封存为 EndZ 并还原，内容不变
+ *   - 正常关闭：多线程写入、关闭后封存，还原的内容与写入一致
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o packer_test packer_test.c src/lz_logger.c src/lz_crypto.c src/lz_sink.c \
+ *       src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c \
+ *       src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -lcrypto
+ */
+#include "src/lz_logger.h"
+#include "src/lz_compress.h"
+#include "src/lz_crypto.h"
+#include "src/lz_packer.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_DIR "/tmp/lz_packer_test"
+#define ENCRYPT_KEY "test_encryption_key_12345"
+#define NUM_THREADS 4
+#define LOGS_PER_THREAD 20000
+#define HUGE_RECORD (100 * 1024) // 超过一个块的记录
+#define HUGE_EVERY 5000          // 每个线程每隔多少条写一条超大记录
+
+static int failures = 0;
+
+static void check(int ok, const char *what) {
+    printf("- %s %s\n", ok ? "✅" : "❌", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * 生成一条记录："T<线程> <序号> <内容>\n"，内容由线程和序号决定
+ * @return 长度
+ */
+static size_t make_record(char *buf, int thread, int seq) {
+    size_t len = (size_t)sprintf(buf, "T%d %06d ", thread, seq);
+    size_t body = (seq % HUGE_EVERY == HUGE_EVERY - 1) ? HUGE_RECORD : (size_t)(20 + (seq * 7 + thread) % 90);
+    for (size_t i = 0; i < body; i++) {
+        buf[len++] = (char)('a' + (seq + thread * 3 + i / 7) % 26);
+    }
+    buf[len++] = '\n';
+    return len;
+}
+
+/**
+ * 解析记录开头的 "T<线程> <序号> "（数据不以 0 结尾，不能用 sscanf）
+ * @return 成功返回 1
+ */
+static int parse_record(const uint8_t *p, const uint8_t *end, int *thread, int *seq) {
+    int values[2] = {0, 0};
+    if (p >= end || *p++ != 'T') {
+        return 0;
+    }
+    for (int k = 0; k < 2; k++) {
+        const uint8_t *start = p;
+        while (p < end && *p >= '0' && *p <= '9' && p - start < 9) {
+            values[k] = values[k] * 10 + (*p++ - '0');
+        }
+        if (p == start || p >= end || *p++ != ' ') {
+            return 0;
+        }
+    }
+    *thread = values[0];
+    *seq = values[1];
+    return 1;
+}
+
+/**
+ * 检查还原出的数据：每个线程的记录完整、按序号递增且内容正确
+ * @param count 期望的每线程记录数
+ * @return 通过返回 1
+ */
+static int verify_records(const uint8_t *data, size_t len, int threads, const int *count) {
+    char *expected = (char *)malloc(HUGE_RECORD + 64);
+    int next[NUM_THREADS] = {0};
+    int ok = expected != NULL;
+    size_t pos = 0;
+    while (ok && pos < len) {
+        const uint8_t *end = memchr(data + pos, '\n', len - pos);
+        int thread = -1, seq = -1;
+        if (!end || !parse_record(data + pos, end, &thread, &seq) ||
+            thread >= threads || seq != next[thread]) {
+            printf("  ❌ 偏移 %zu 处的记录不符合预期 (线程 %d, 序号 %d)\n", pos, thread, seq);
+            ok = 0;
+            break;
+        }
+        size_t rec_len = (size_t)(end - (data + pos)) + 1;
+        size_t exp_len = make_record(expected, thread, seq);
+        if (rec_len != exp_len || memcmp(expected, data + pos, exp_len) != 0) {
+            printf("  ❌ 线程 %d 序号 %d 内容不一致\n", thread, seq);
+            ok = 0;
+            break;
+        }
+        next[thread]++;
+        pos += rec_len;
+    }
+    for (int t = 0; ok && t < threads; t++) {
+        if (next[t] != count[t]) {
+            printf("  ❌ 线程 %d: %d 条 (预期 %d)\n", t, next[t], count[t]);
+            ok = 0;
+        }
+    }
+    free(expected);
+    return ok;
+}
+
+// ============================================================================
+// 压缩管线
+// ============================================================================
+
+typedef struct {
+    pthread_mutex_t mutex;
+    uint8_t *data; // 还原后的原文
+    size_t len;
+    size_t cap;
+    int blocks;
+    int bad_blocks;
+} collector_t;
+
+static lz_log_error_t collect_block(void *user, const lz_compress_block_header_t *header, uint8_t *payload) {
+    collector_t *col = (collector_t *)user;
+    uint32_t stored = header->stored_size & ~LZ_COMPRESS_BLOCK_STORED;
+    pthread_mutex_lock(&col->mutex);
+    if (col->len + header->raw_size > col->cap) {
+        col->cap = (col->len + header->raw_size) * 2;
+        col->data = (uint8_t *)realloc(col->data, col->cap);
+    }
+    if (header->stored_size & LZ_COMPRESS_BLOCK_STORED) {
+        memcpy(col->data + col->len, payload, stored);
+    } else if (lz_decompress_block(payload, stored, col->data + col->len, header->raw_size) != 0) {
+        col->bad_blocks++;
+    }
+    col->len += header->raw_size;
+    col->blocks++;
+    pthread_mutex_unlock(&col->mutex);
+    return LZ_LOG_SUCCESS;
+}
+
+typedef struct {
+    lz_packer_t *packer;
+    lz_logger_handle_t handle;
+    int thread;
+    int count;
+    size_t bytes;
+    int errors;
+} writer_arg_t;
+
+static void *packer_writer(void *arg) {
+    writer_arg_t *w = (writer_arg_t *)arg;
+    char *buf = (char *)malloc(HUGE_RECORD + 64);
+    for (int i = 0; i < w->count; i++) {
+        size_t len = make_record(buf, w->thread, i);
+        lz_log_error_t ret = w->packer ? lz_packer_write(w->packer, buf, (uint32_t)len)
+                                       : lz_logger_write(w->handle, buf, (uint32_t)len);
+        if (ret != LZ_LOG_SUCCESS) {
+            w->errors++;
+        }
+        w->bytes += len;
+    }
+    free(buf);
+    return NULL;
+}
+
+/**
+ * 多线程写入
+ * @return 写入的总字节数（有写入失败时返回 0）
+ */
+static size_t run_writers(lz_packer_t *packer, lz_logger_handle_t handle, int *count) {
+    pthread_t threads[NUM_THREADS];
+    writer_arg_t args[NUM_THREADS];
+    for (int t = 0; t < NUM_THREADS; t++) {
+        args[t] = (writer_arg_t){packer, handle, t, count[t], 0, 0};
+        pthread_create(&threads[t], NULL, packer_writer, &args[t]);
+    }
+    size_t bytes = 0;
+    int errors = 0;
+    for (int t = 0; t < NUM_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        bytes += args[t].bytes;
+        errors += args[t].errors;
+    }
+    return errors == 0 ? bytes : 0;
+}
+
+static void test_packer(void) {
+    printf("\n## 压缩管线\n\n");
+
+    collector_t col;
+    memset(&col, 0, sizeof(col));
+    pthread_mutex_init(&col.mutex, NULL);
+
+    lz_packer_t *packer = NULL;
+    check(lz_packer_start(collect_block, &col, &packer) == LZ_LOG_SUCCESS, "启动压缩管线");
+    if (!packer) {
+        return;
+    }
+
+    int count[NUM_THREADS];
+    for (int t = 0; t < NUM_THREADS; t++) {
+        count[t] = LOGS_PER_THREAD + t * 37; // 最后的块都写不满
+    }
+    size_t bytes = run_writers(packer, NULL, count);
+    check(bytes > 0, "多线程写入成功");
+
+    // 不调用 flush：未写满的块由定期提交交出
+    usleep((LZ_PACKER_FLUSH_INTERVAL_MS * 2 + 500) * 1000);
+    pthread_mutex_lock(&col.mutex);
+    size_t idle_len = col.len;
+    pthread_mutex_unlock(&col.mutex);
+    printf("  写入 %zu 字节，空闲 %d ms 后已交出 %zu 字节 (%d 块)\n", bytes, LZ_PACKER_FLUSH_INTERVAL_MS * 2 + 500,
+           idle_len, col.blocks);
+    check(idle_len == bytes, "定期提交交出了所有未写满的块");
+
+    lz_packer_stop(packer);
+    check(col.bad_blocks == 0, "所有块都能解压");
+    check(verify_records(col.data, col.len, NUM_THREADS, count), "每个线程的记录完整且顺序不变");
+
+    free(col.data);
+    pthread_mutex_destroy(&col.mutex);
+}
+
+// ============================================================================
+// 日志段
+// ============================================================================
+
+// 删除测试目录中的文件（目录不存在时创建）
+static void reset_dir(void) {
+    mkdir(TEST_DIR, 0755);
+    DIR *dir = opendir(TEST_DIR);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+    }
+    closedir(dir);
+}
+
+// 找到目录中唯一的日志段 yyyy-mm-dd-N.log
+static int find_segment(char *name, size_t cap) {
+    DIR *dir = opendir(TEST_DIR);
+    if (!dir) {
+        return -1;
+    }
+    int found = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len > 4 && strcmp(entry->d_name + len - 4, ".log") == 0 && entry->d_name[0] >= '0' &&
+            entry->d_name[0] <= '9') {
+            snprintf(name, cap, "%s", entry->d_name);
+            found++;
+        }
+    }
+    closedir(dir);
+    return found == 1 ? 0 : -1;
+}
+
+static uint32_t file_magic(const char *path) {
+    uint8_t footer[LZ_LOG_FOOTER_SIZE];
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return 0;
+    }
+    fseek(fp, -LZ_LOG_FOOTER_SIZE, SEEK_END);
+    size_t n = fread(footer, 1, sizeof(footer), fp);
+    fclose(fp);
+    return n == sizeof(footer) ? read_u32(footer + LZ_LOG_SALT_SIZE) : 0;
+}
+
+/**
+ * 用 lz_logger_decompress_file 还原日志段并解密
+ * @return 原文（调用者释放），失败返回 NULL
+ */
+static uint8_t *restore_segment(const char *path, size_t *out_len) {
+    char out_path[300];
+    snprintf(out_path, sizeof(out_path), "%s.restored", path);
+    if (lz_logger_decompress_file(path, ENCRYPT_KEY, out_path) != LZ_LOG_SUCCESS) {
+        return NULL;
+    }
+
+    FILE *fp = fopen(out_path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = (uint8_t *)malloc(size > 0 ? (size_t)size : 1);
+    size_t n = buf ? fread(buf, 1, (size_t)size, fp) : 0;
+    fclose(fp);
+    unlink(out_path);
+    if (!buf || n != (size_t)size || size < LZ_LOG_FOOTER_SIZE) {
+        free(buf);
+        return NULL;
+    }
+
+    const uint8_t *footer = buf + size - LZ_LOG_FOOTER_SIZE;
+    uint32_t used = read_u32(footer + LZ_LOG_SALT_SIZE + 8);
+    lz_crypto_context_t ctx;
+    if (used > (uint32_t)size - LZ_LOG_FOOTER_SIZE || lz_crypto_init(&ctx, ENCRYPT_KEY, footer) != 0) {
+        free(buf);
+        return NULL;
+    }
+    lz_crypto_process(&ctx, buf, buf, used, 0);
+    lz_crypto_cleanup(&ctx);
+    *out_len = used;
+    return buf;
+}
+
+static int seal_segment(const char *name) {
+    int dir_fd = open(TEST_DIR, O_RDONLY | O_DIRECTORY);
+    uint32_t file_size = 0, used = 0;
+    lz_log_error_t ret = lz_compress_segment(dir_fd, name, ENCRYPT_KEY, &file_size, &used);
+    close(dir_fd);
+    return ret == LZ_LOG_SUCCESS;
+}
+
+static lz_log_error_t open_inline(lz_log_sink_type_t sink, lz_logger_handle_t *handle) {
+    lz_logger_set_sink_type(sink);
+    lz_logger_set_compression(LZ_LOG_COMPRESS_INLINE);
+    lz_logger_set_max_file_size(32 * 1024 * 1024);
+    return lz_logger_open(TEST_DIR, ENCRYPT_KEY, handle, NULL, NULL);
+}
+
+// 子进程写入后等待定期提交和空闲刷盘，随后被杀死；块流中应有崩溃前的全部记录
+static void test_crash(lz_log_sink_type_t sink, const char *sink_name) {
+    printf("\n## 日志段：空闲刷盘后崩溃（%s 后端）\n\n", sink_name);
+    reset_dir();
+
+    int count[NUM_THREADS];
+    for (int t = 0; t < NUM_THREADS; t++) {
+        count[t] = 3000 + t * 11;
+    }
+
+    int pipe_fd[2];
+    if (pipe(pipe_fd) != 0) {
+        check(0, "创建管道");
+        return;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(pipe_fd[0]);
+        lz_logger_handle_t handle;
+        char result = 0;
+        if (open_inline(sink, &handle) == LZ_LOG_SUCCESS && run_writers(NULL, handle, count) > 0) {
+            result = 1;
+        }
+        // 等待压缩管线的定期提交和存储后端的空闲刷盘，然后通知父进程杀死自己
+        usleep((LZ_PACKER_FLUSH_INTERVAL_MS * 3 + 500) * 1000);
+        write(pipe_fd[1], &result, 1);
+        pause();
+        _exit(0);
+    }
+    close(pipe_fd[1]);
+    char result = 0;
+    ssize_t n = read(pipe_fd[0], &result, 1);
+    close(pipe_fd[0]);
+    kill(pid, SIGKILL);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    check(n == 1 && result == 1, "子进程写入成功");
+    check(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL, "子进程在关闭前被 SIGKILL 杀死");
+
+    char name[64], path[256];
+    if (find_segment(name, sizeof(name)) != 0) {
+        check(0, "找到日志段");
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, name);
+    check(file_magic(path) == LZ_LOG_MAGIC_ENDB, "未封存的日志段为块流 (EndB)");
+
+    size_t len = 0;
+    uint8_t *data = restore_segment(path, &len);
+    check(data != NULL && verify_records(data, len, NUM_THREADS, count), "块流还原出崩溃前的全部记录");
+    free(data);
+
+    check(seal_segment(name) && file_magic(path) == LZ_LOG_MAGIC_ENDZ, "原地封存为 EndZ");
+    data = restore_segment(path, &len);
+    check(data != NULL && verify_records(data, len, NUM_THREADS, count), "封存后还原的内容不变");
+    free(data);
+}
+
+static void test_close(void) {
+    printf("\n## 日志段：正常关闭后封存\n\n");
+    reset_dir();
+
+    int count[NUM_THREADS];
+    for (int t = 0; t < NUM_THREADS; t++) {
+        count[t] = LOGS_PER_THREAD - t * 13;
+    }
+    lz_logger_handle_t handle;
+    check(open_inline(LZ_LOG_SINK_MMAP, &handle) == LZ_LOG_SUCCESS, "以写入时压缩模式打开");
+    size_t bytes = run_writers(NULL, handle, count);
+    check(bytes > 0, "多线程写入成功");
+    lz_logger_close(handle);
+
+    char name[64], path[256];
+    if (find_segment(name, sizeof(name)) != 0) {
+        check(0, "找到日志段");
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, name);
+    struct stat st;
+    stat(path, &st);
+    printf("  原文 %zu 字节 → 块流 %lld 字节\n", bytes, (long long)st.st_size);
+
+    check(seal_segment(name) && file_magic(path) == LZ_LOG_MAGIC_ENDZ, "封存为 EndZ");
+    size_t len = 0;
+    uint8_t *data = restore_segment(path, &len);
+    check(data != NULL && len == bytes && verify_records(data, len, NUM_THREADS, count), "还原的内容与写入一致");
+    free(data);
+}
+
+int main() {
+    printf("\n# LZ Logger 写入时压缩（EndB）往返测试\n");
+
+    test_packer();
+    test_crash(LZ_LOG_SINK_MMAP, "mmap");
+    test_crash(LZ_LOG_SINK_URING, "io_uring");
+    test_close();
+
+    printf("\n---\n\n");
+    if (failures != 0) {
+        printf("❌ **%d 项检查失败**\n\n", failures);
+        return 1;
+    }
+    printf("✅ **所有检查通过！**\n\n");
+    return 0;
+}
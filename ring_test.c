@@ -0,0 +1,367 @@
+/**
+ * 环形缓冲（内存模式 / 循环文件）测试
+ *
+ *   - 内存模式：单线程和多线程写入数倍于容量的记录后 dump，解密后必须是写入序列的一段完整后缀
+ *     （从记录边界开始，每个线程的序号连续、以该线程最后写入的一条结尾，内容逐字节一致）
+ *   - 循环文件：写满数圈后 dump；关闭后重新打开已有的 circular.log（传入不同容量应被忽略），
+ *     内容与关闭前相同，继续写入时序号接在后面
+ *   - 循环文件崩溃：子进程写入后被 SIGKILL 杀死，重新打开后内容和顺序不变
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o ring_test ring_test.c src/lz_logger.c src/lz_crypto.c src/lz_sink.c \
+ *       src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c \
+ *       src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -lcrypto
+ */
+#include "src/lz_logger.h"
+#include "src/lz_crypto.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_DIR "/tmp/lz_ring_test"
+#define DUMP_PATH TEST_DIR "/dump.log"
+#define ENCRYPT_KEY "test_encryption_key_12345"
+#define CAPACITY (1024 * 1024)
+#define NUM_THREADS 4
+#define MAX_RECORD 256
+
+static int failures = 0;
+
+static void check(int ok, const char *what) {
+    printf("- %s %s\n", ok ? "✅" : "❌", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * 生成一条记录："T<线程> <序号> <内容>\n"，长度和内容由线程和序号决定
+ * @return 长度
+ */
+static size_t make_record(char *buf, int thread, int seq) {
+    size_t len = (size_t)sprintf(buf, "T%d %08d ", thread, seq);
+    size_t body = (size_t)(10 + (seq * 31 + thread * 7) % 180);
+    for (size_t i = 0; i < body; i++) {
+        buf[len++] = (char)('a' + (seq + i) % 26);
+    }
+    buf[len++] = '\n';
+    return len;
+}
+
+/**
+ * 解析记录开头的 "T<线程> <序号> "
+ * @return 成功返回 1
+ */
+static int parse_record(const uint8_t *p, const uint8_t *end, int *thread, int *seq) {
+    int values[2] = {0, 0};
+    if (p >= end || *p++ != 'T') {
+        return 0;
+    }
+    for (int k = 0; k < 2; k++) {
+        const uint8_t *start = p;
+        while (p < end && *p >= '0' && *p <= '9' && p - start < 9) {
+            values[k] = values[k] * 10 + (*p++ - '0');
+        }
+        if (p == start || p >= end || *p++ != ' ') {
+            return 0;
+        }
+    }
+    *thread = values[0];
+    *seq = values[1];
+    return 1;
+}
+
+/**
+ * 检查 dump 的内容是写入序列的完整后缀：出现的每个线程序号连续、以 last[t] 结尾，内容逐字节一致
+ * @param last 每个线程最后写入的序号
+ * @param out_first 输出每个线程保留下来的第一个序号（没有记录为 -1，可为 NULL）
+ * @return 通过返回 1
+ */
+static int verify_suffix(const uint8_t *data, size_t len, int threads, const int *last, int *out_first) {
+    char expected[MAX_RECORD];
+    int next[NUM_THREADS], first[NUM_THREADS];
+    for (int t = 0; t < NUM_THREADS; t++) {
+        next[t] = -1;
+        first[t] = -1;
+    }
+    size_t pos = 0;
+    while (pos < len) {
+        const uint8_t *end = memchr(data + pos, '\n', len - pos);
+        int thread = -1, seq = -1;
+        if (!end || !parse_record(data + pos, end, &thread, &seq) || thread >= threads ||
+            (next[thread] >= 0 && seq != next[thread])) {
+            printf("  ❌ 偏移 %zu 处的记录不符合预期 (线程 %d, 序号 %d)\n", pos, thread, seq);
+            return 0;
+        }
+        size_t rec_len = (size_t)(end - (data + pos)) + 1;
+        size_t exp_len = make_record(expected, thread, seq);
+        if (rec_len != exp_len || memcmp(expected, data + pos, exp_len) != 0) {
+            printf("  ❌ 线程 %d 序号 %d 内容不一致\n", thread, seq);
+            return 0;
+        }
+        if (first[thread] < 0) {
+            first[thread] = seq;
+        }
+        next[thread] = seq + 1;
+        pos += rec_len;
+    }
+    int present = 0;
+    for (int t = 0; t < threads; t++) {
+        if (out_first) {
+            out_first[t] = first[t];
+        }
+        // 较早写完的线程的记录可能已全部被覆盖
+        if (next[t] < 0) {
+            continue;
+        }
+        present++;
+        if (next[t] != last[t] + 1) {
+            printf("  ❌ 线程 %d 最后一条为 %d (预期 %d)\n", t, next[t] - 1, last[t]);
+            return 0;
+        }
+    }
+    return present > 0;
+}
+
+/**
+ * dump 并解密
+ * @return 原文（调用者释放），失败返回 NULL
+ */
+static uint8_t *dump_plain(lz_logger_handle_t handle, size_t *out_len) {
+    if (lz_logger_dump(handle, DUMP_PATH) != LZ_LOG_SUCCESS) {
+        return NULL;
+    }
+    FILE *fp = fopen(DUMP_PATH, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = (uint8_t *)malloc(size > 0 ? (size_t)size : 1);
+    size_t n = buf ? fread(buf, 1, (size_t)size, fp) : 0;
+    fclose(fp);
+    unlink(DUMP_PATH);
+    if (!buf || n != (size_t)size || size < LZ_LOG_FOOTER_SIZE) {
+        free(buf);
+        return NULL;
+    }
+
+    const uint8_t *footer = buf + size - LZ_LOG_FOOTER_SIZE;
+    uint32_t used = read_u32(footer + LZ_LOG_SALT_SIZE + 8);
+    lz_crypto_context_t ctx;
+    if (read_u32(footer + LZ_LOG_SALT_SIZE) != LZ_LOG_MAGIC_ENDX || used > (uint32_t)size - LZ_LOG_FOOTER_SIZE ||
+        lz_crypto_init(&ctx, ENCRYPT_KEY, footer) != 0) {
+        free(buf);
+        return NULL;
+    }
+    lz_crypto_process(&ctx, buf, buf, used, 0);
+    lz_crypto_cleanup(&ctx);
+    *out_len = used;
+    return buf;
+}
+
+typedef struct {
+    lz_logger_handle_t handle;
+    int thread;
+    int from;
+    int to; // 写入序号 [from, to)
+    int errors;
+} writer_arg_t;
+
+static void *ring_writer(void *arg) {
+    writer_arg_t *w = (writer_arg_t *)arg;
+    char buf[MAX_RECORD];
+    for (int i = w->from; i < w->to; i++) {
+        size_t len = make_record(buf, w->thread, i);
+        if (lz_logger_write(w->handle, buf, (uint32_t)len) != LZ_LOG_SUCCESS) {
+            w->errors++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 多线程写入，每个线程写入序号 [from, to)
+ * @return 全部成功返回 1
+ */
+static int run_writers(lz_logger_handle_t handle, int threads, int from, int to) {
+    pthread_t tid[NUM_THREADS];
+    writer_arg_t args[NUM_THREADS];
+    for (int t = 0; t < threads; t++) {
+        args[t] = (writer_arg_t){handle, t, from, to, 0};
+        pthread_create(&tid[t], NULL, ring_writer, &args[t]);
+    }
+    int errors = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tid[t], NULL);
+        errors += args[t].errors;
+    }
+    return errors == 0;
+}
+
+// 删除测试目录中的文件（目录不存在时创建）
+static void reset_dir(void) {
+    mkdir(TEST_DIR, 0755);
+    DIR *dir = opendir(TEST_DIR);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * 写入数圈后 dump，检查 dump 是完整后缀且保留了接近一整圈的数据
+ * @param to 每个线程写入的序号上限
+ */
+static void check_wrapped_dump(lz_logger_handle_t handle, int threads, int to, const char *label) {
+    int last[NUM_THREADS], first[NUM_THREADS];
+    for (int t = 0; t < NUM_THREADS; t++) {
+        last[t] = to - 1;
+    }
+    size_t len = 0;
+    uint8_t *data = dump_plain(handle, &len);
+    char what[128];
+    snprintf(what, sizeof(what), "%s：dump 为写入序列的完整后缀", label);
+    check(data != NULL && verify_suffix(data, len, threads, last, first), what);
+    if (data) {
+        // 回绕后每个线程的第 0 条都已被覆盖
+        int wrapped = 1;
+        printf("  保留 %zu 字节，各线程的第一条:", len);
+        for (int t = 0; t < threads; t++) {
+            printf(" %d", first[t]);
+            wrapped &= first[t] != 0;
+        }
+        printf("\n");
+        snprintf(what, sizeof(what), "%s：环已回绕且保留了至少半圈数据", label);
+        check(wrapped && len >= CAPACITY / 2 && len <= CAPACITY, what);
+    }
+    free(data);
+}
+
+static void test_memory(void) {
+    printf("\n## 内存模式\n\n");
+    reset_dir();
+
+    lz_logger_handle_t handle;
+    check(lz_logger_open_memory(CAPACITY, ENCRYPT_KEY, &handle) == LZ_LOG_SUCCESS, "打开内存日志");
+    check(run_writers(handle, 1, 0, 40000), "单线程写入约 4 圈");
+    check_wrapped_dump(handle, 1, 40000, "单线程");
+    lz_logger_close(handle);
+
+    check(lz_logger_open_memory(CAPACITY, ENCRYPT_KEY, &handle) == LZ_LOG_SUCCESS, "重新打开内存日志");
+    check(run_writers(handle, NUM_THREADS, 0, 10000), "4 线程写入约 4 圈");
+    check_wrapped_dump(handle, NUM_THREADS, 10000, "4 线程");
+    lz_logger_close(handle);
+}
+
+static void test_circular(void) {
+    printf("\n## 循环文件：关闭后重新打开\n\n");
+    reset_dir();
+
+    lz_logger_handle_t handle;
+    check(lz_logger_open_circular(TEST_DIR, CAPACITY, ENCRYPT_KEY, &handle, NULL, NULL) == LZ_LOG_SUCCESS,
+          "新建 circular.log");
+    check(run_writers(handle, NUM_THREADS, 0, 10000), "4 线程写入约 4 圈");
+    check_wrapped_dump(handle, NUM_THREADS, 10000, "关闭前");
+    size_t before_len = 0;
+    uint8_t *before = dump_plain(handle, &before_len);
+    lz_logger_close(handle);
+
+    struct stat st;
+    stat(TEST_DIR "/circular.log", &st);
+    off_t file_size = st.st_size;
+
+    // 传入不同的容量：已有文件沿用原容量
+    check(lz_logger_open_circular(TEST_DIR, CAPACITY * 4, ENCRYPT_KEY, &handle, NULL, NULL) == LZ_LOG_SUCCESS,
+          "重新打开已有的 circular.log");
+    stat(TEST_DIR "/circular.log", &st);
+    check(st.st_size == file_size, "沿用原文件的容量");
+    size_t after_len = 0;
+    uint8_t *after = dump_plain(handle, &after_len);
+    check(before && after && before_len == after_len && memcmp(before, after, before_len) == 0,
+          "重新打开后内容与关闭前逐字节一致");
+    free(before);
+    free(after);
+
+    check(run_writers(handle, NUM_THREADS, 10000, 12000), "继续写入");
+    check_wrapped_dump(handle, NUM_THREADS, 12000, "继续写入后");
+    lz_logger_close(handle);
+}
+
+static void test_circular_crash(void) {
+    printf("\n## 循环文件：崩溃后重新打开\n\n");
+    reset_dir();
+
+    int pipe_fd[2];
+    if (pipe(pipe_fd) != 0) {
+        check(0, "创建管道");
+        return;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(pipe_fd[0]);
+        lz_logger_handle_t handle;
+        char result = 0;
+        if (lz_logger_open_circular(TEST_DIR, CAPACITY, ENCRYPT_KEY, &handle, NULL, NULL) == LZ_LOG_SUCCESS &&
+            run_writers(handle, NUM_THREADS, 0, 9000)) {
+            result = 1;
+        }
+        if (write(pipe_fd[1], &result, 1) != 1) {
+            _exit(1);
+        }
+        pause();
+        _exit(0);
+    }
+    close(pipe_fd[1]);
+    char result = 0;
+    ssize_t n = read(pipe_fd[0], &result, 1);
+    close(pipe_fd[0]);
+    kill(pid, SIGKILL);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    check(n == 1 && result == 1, "子进程写入约 4 圈");
+    check(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL, "子进程在关闭前被 SIGKILL 杀死");
+
+    lz_logger_handle_t handle;
+    check(lz_logger_open_circular(TEST_DIR, CAPACITY, ENCRYPT_KEY, &handle, NULL, NULL) == LZ_LOG_SUCCESS,
+          "重新打开崩溃留下的 circular.log");
+    check_wrapped_dump(handle, NUM_THREADS, 9000, "崩溃后");
+    check(run_writers(handle, NUM_THREADS, 9000, 9500), "继续写入");
+    check_wrapped_dump(handle, NUM_THREADS, 9500, "继续写入后");
+    lz_logger_close(handle);
+}
+
+int main() {
+    printf("\n# LZ Logger 环形缓冲测试\n");
+
+    test_memory();
+    test_circular();
+    test_circular_crash();
+
+    printf("\n---\n\n");
+    if (failures != 0) {
+        printf("❌ **%d 项检查失败**\n\n", failures);
+        return 1;
+    }
+    printf("✅ **所有检查通过！**\n\n");
+    return 0;
+}
@@ -0,0 +1,205 @@
+/**
+ * 存储后端（Sink）对比测试
+ *
+ * 对比 mmap / pwrite 双缓冲 / O_DIRECT / io_uring 四种后端在以下场景的表现：
+ *   1. 单线程写入（明文）
+ *   2. 多线程并发写入（明文）
+ *   3. 单线程写入（加密）
+ *   4. 高频短日志（多线程、每条约 40 字节），对比 io_uring 与 mmap
+ * 每个场景都会触发多次文件切换，统计写入耗时和 close（含最终落盘）耗时。
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o sink_benchmark sink_benchmark.c \
+ *       src/lz_logger.c src/lz_crypto.c src/lz_sink.c src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -lcrypto
+ * 编译（macOS）：
+ *   gcc -O2 -Wall -o sink_benchmark sink_benchmark.c \
+ *       src/lz_logger.c src/lz_crypto.c src/lz_sink.c src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -framework Security
+ */
+#include "src/lz_logger.h"
+#include <pthread.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define TEST_LOG_DIR "/tmp/lz_logger_sink_bench"
+#define BENCH_FILE_SIZE (8 * 1024 * 1024)
+#define SINGLE_THREAD_ITERATIONS 200000
+#define MULTI_THREAD_ITERATIONS 50000
+#define HIGH_RATE_ITERATIONS 500000
+#define NUM_THREADS 8
+
+static const char *test_messages[] = {
+    "2025-11-02 15:30:45.123 T:1a2b3c [MainActivity.kt:45] [onCreate] [App] Application started successfully\n",
+    "2025-11-02 15:30:45.456 T:1a2b3c [NetworkManager.kt:89] [request] [Network] HTTP request to https://api.example.com/data\n",
+    "2025-11-02 15:30:45.789 T:2c3d4e [DatabaseHelper.kt:123] [query] [DB] Query executed: SELECT * FROM users WHERE id=12345\n",
+    "2025-11-02 15:30:46.012 T:3e4f5a [ImageLoader.kt:67] [loadImage] [Image] Loading image from cache: /cache/img_12345.jpg\n",
+    "2025-11-02 15:30:46.345 T:4f5a6b [AnalyticsService.kt:234] [trackEvent] [Analytics] Event tracked: user_login with params {user_id: 67890}\n"
+};
+static const int num_test_messages = 5;
+
+// 高频短日志（模拟打点/埋点类日志）
+static const char *short_messages[] = {
+    "15:30:45.123 T:1a2b [tick] frame=16ms\n",
+    "15:30:45.124 T:2c3d [net] rx=1432B\n",
+    "15:30:45.125 T:3e4f [gc] pause=0.2ms\n",
+    "15:30:45.126 T:4f5a [ui] vsync ok\n"
+};
+static const int num_short_messages = 4;
+
+static const char *sink_names[] = {"mmap", "pwrite", "direct", "uring"};
+
+// 获取当前时间（微秒）
+static uint64_t get_timestamp_us() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// 创建测试目录
+static int create_test_dir() {
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s", TEST_LOG_DIR, TEST_LOG_DIR);
+    return system(cmd);
+}
+
+typedef struct {
+    lz_logger_handle_t handle;
+    int iterations;
+    const char **messages;
+    int num_messages;
+    uint64_t bytes;
+} thread_data_t;
+
+static void *thread_write_func(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+
+    for (int i = 0; i < data->iterations; i++) {
+        const char *msg = data->messages[i % data->num_messages];
+        uint32_t len = (uint32_t)strlen(msg);
+        if (lz_logger_write(data->handle, msg, len) == LZ_LOG_SUCCESS) {
+            data->bytes += len;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * 运行一个场景
+ * @param sink 后端类型
+ * @param threads 线程数
+ * @param iterations 每个线程写入条数
+ * @param key 加密密钥（NULL 表示不加密）
+ * @param messages 日志内容
+ * @param num_messages 日志内容数量
+ */
+static void run_case(lz_log_sink_type_t sink, int threads, int iterations, const char *key,
+                     const char **messages, int num_messages) {
+    if (create_test_dir() != 0) {
+        printf("| %s | 创建测试目录失败 | | | | |\n", sink_names[sink]);
+        return;
+    }
+
+    lz_logger_set_sink_type(sink);
+
+    lz_logger_handle_t handle = NULL;
+    int32_t inner_error = 0, sys_errno = 0;
+    lz_log_error_t ret = lz_logger_open(TEST_LOG_DIR, key, &handle, &inner_error, &sys_errno);
+    if (ret != LZ_LOG_SUCCESS) {
+        printf("| %s | 打开失败: %s (inner=%d, errno=%d) | | | | |\n",
+               sink_names[sink], lz_logger_error_string(ret), inner_error, sys_errno);
+        return;
+    }
+
+    pthread_t tids[NUM_THREADS];
+    thread_data_t data[NUM_THREADS];
+
+    uint64_t start_time = get_timestamp_us();
+
+    for (int i = 0; i < threads; i++) {
+        data[i].handle = handle;
+        data[i].iterations = iterations;
+        data[i].messages = messages;
+        data[i].num_messages = num_messages;
+        data[i].bytes = 0;
+        pthread_create(&tids[i], NULL, thread_write_func, &data[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    uint64_t write_end = get_timestamp_us();
+
+    // close 会把缓冲后端剩余的数据写入文件，单独统计
+    lz_logger_close(handle);
+
+    uint64_t close_end = get_timestamp_us();
+
+    uint64_t total_bytes = 0;
+    for (int i = 0; i < threads; i++) {
+        total_bytes += data[i].bytes;
+    }
+
+    int total_logs = threads * iterations;
+    double write_sec = (write_end - start_time) / 1000000.0;
+    double ns_per_log = (double)(write_end - start_time) * 1000.0 / total_logs;
+    double mb = total_bytes / (1024.0 * 1024.0);
+
+    printf("| %s | %.0f | %.0f | %.2f | %.2f |\n",
+           sink_names[sink],
+           ns_per_log,
+           total_logs / write_sec,
+           mb / write_sec,
+           (close_end - write_end) / 1000.0);
+}
+
+static void print_table_header() {
+    printf("| 后端 | 单条耗时(纳秒) | 吞吐量(条/秒) | 写入速度(MB/秒) | close耗时(毫秒) |\n");
+    printf("|------|----------------|---------------|-----------------|-----------------|\n");
+}
+
+int main() {
+    printf("\n");
+    printf("# LZ Logger 存储后端对比测试\n\n");
+
+    if (lz_logger_set_max_file_size(BENCH_FILE_SIZE) != LZ_LOG_SUCCESS) {
+        printf("❌ 设置文件大小失败\n");
+        return 1;
+    }
+    printf("**文件大小:** %d MB（每个场景都会发生多次文件切换）  \n", BENCH_FILE_SIZE / (1024 * 1024));
+    printf("**测试目录:** `%s`  \n", TEST_LOG_DIR);
+
+    printf("\n## 测试1: 单线程写入（%d 条）\n\n", SINGLE_THREAD_ITERATIONS);
+    print_table_header();
+    for (int s = LZ_LOG_SINK_MMAP; s <= LZ_LOG_SINK_URING; s++) {
+        run_case((lz_log_sink_type_t)s, 1, SINGLE_THREAD_ITERATIONS, NULL, test_messages, num_test_messages);
+    }
+
+    printf("\n## 测试2: %d 线程并发写入（每线程 %d 条）\n\n", NUM_THREADS, MULTI_THREAD_ITERATIONS);
+    print_table_header();
+    for (int s = LZ_LOG_SINK_MMAP; s <= LZ_LOG_SINK_URING; s++) {
+        run_case((lz_log_sink_type_t)s, NUM_THREADS, MULTI_THREAD_ITERATIONS, NULL, test_messages, num_test_messages);
+    }
+
+    printf("\n## 测试3: 单线程加密写入（%d 条）\n\n", SINGLE_THREAD_ITERATIONS);
+    print_table_header();
+    for (int s = LZ_LOG_SINK_MMAP; s <= LZ_LOG_SINK_URING; s++) {
+        run_case((lz_log_sink_type_t)s, 1, SINGLE_THREAD_ITERATIONS, "test_encryption_key_12345678",
+                 test_messages, num_test_messages);
+    }
+
+    printf("\n## 测试4: 高频短日志 %d 线程（每线程 %d 条）\n\n", NUM_THREADS, HIGH_RATE_ITERATIONS);
+    print_table_header();
+    run_case(LZ_LOG_SINK_MMAP, NUM_THREADS, HIGH_RATE_ITERATIONS, NULL, short_messages, num_short_messages);
+    run_case(LZ_LOG_SINK_URING, NUM_THREADS, HIGH_RATE_ITERATIONS, NULL, short_messages, num_short_messages);
+
+    // 恢复默认后端
+    lz_logger_set_sink_type(LZ_LOG_SINK_MMAP);
+
+    printf("\n---\n\n");
+    printf("✅ **所有测试完成！**\n\n");
+
+    return 0;
+}
@@ -0,0 +1,1280 @@
+#include "lz_binlog.h"
+#include "lz_format.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// ============================================================================
+// 编码游标
+// ============================================================================
+
+/** 输出游标：超出容量的部分只计长度不写入 */
+typedef struct
+{
+    uint8_t *buf;
+    size_t cap;
+    size_t pos;
+} binlog_cursor_t;
+
+static inline void binlog_put(binlog_cursor_t *c, const void *src, size_t len)
+{
+    if (c->pos + len <= c->cap)
+    {
+        memcpy(c->buf + c->pos, src, len);
+    }
+    c->pos += len;
+}
+
+static inline void binlog_put_byte(binlog_cursor_t *c, uint8_t value)
+{
+    if (c->pos < c->cap)
+    {
+        c->buf[c->pos] = value;
+    }
+    c->pos++;
+}
+
+static inline void binlog_put_varint(binlog_cursor_t *c, uint64_t value)
+{
+    // 常见情况：剩余空间足够，直接写入缓冲（不经过临时数组和变长 memcpy）
+    if (c->pos + 10 <= c->cap)
+    {
+        uint8_t *p = c->buf + c->pos;
+        while (value >= 0x80)
+        {
+            *p++ = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        *p++ = (uint8_t)value;
+        c->pos = (size_t)(p - c->buf);
+        return;
+    }
+
+    uint8_t tmp[10];
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        tmp[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    tmp[n++] = (uint8_t)value;
+    binlog_put(c, tmp, n);
+}
+
+static inline void binlog_put_zigzag(binlog_cursor_t *c, int64_t value)
+{
+    binlog_put_varint(c, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline void binlog_put_str(binlog_cursor_t *c, const char *s, size_t len)
+{
+    binlog_put_varint(c, len);
+    binlog_put(c, s, len);
+}
+
+/** varint 编码后的字节数 */
+static inline size_t varint_size(uint64_t value)
+{
+    size_t n = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * 在 [start, pos) 的负载前补上 varint 长度（负载从 start + 1 开始写入，预留了 1 字节）
+ * @param c 游标
+ * @param start 长度字段的位置
+ */
+static void binlog_close_frame(binlog_cursor_t *c, size_t start)
+{
+    size_t payload = c->pos - start - 1;
+    size_t len_size = varint_size(payload);
+    size_t extra = len_size - 1;
+
+    if (c->pos + extra <= c->cap)
+    {
+        // 负载 >= 128 字节：后移给长度字段腾出位置
+        if (extra > 0)
+        {
+            memmove(c->buf + start + len_size, c->buf + start + 1, payload);
+        }
+        binlog_cursor_t len_cursor = {c->buf + start, len_size, 0};
+        binlog_put_varint(&len_cursor, payload);
+    }
+    c->pos += extra;
+}
+
+// ============================================================================
+// 格式串解析
+// ============================================================================
+
+/**
+ * 按长度修饰符确定整数参数的读取类型
+ * @param length 长度修饰符（'H' = hh，'h'，'l'，'q' = ll，'j'，'z'，'t'，'L'，0 = 无）
+ * @param is_signed 是否有符号
+ */
+static lz_binlog_arg_t integer_arg(char length, bool is_signed)
+{
+    switch (length)
+    {
+    case 'H':
+        return is_signed ? LZ_BINLOG_ARG_SCHAR : LZ_BINLOG_ARG_UCHAR;
+    case 'h':
+        return is_signed ? LZ_BINLOG_ARG_SHORT : LZ_BINLOG_ARG_USHORT;
+    case 'l':
+        return is_signed ? LZ_BINLOG_ARG_LONG : LZ_BINLOG_ARG_ULONG;
+    case 'q':
+    case 'L':
+        return is_signed ? LZ_BINLOG_ARG_LLONG : LZ_BINLOG_ARG_ULLONG;
+    case 'j':
+        return is_signed ? LZ_BINLOG_ARG_INTMAX : LZ_BINLOG_ARG_UINTMAX;
+    case 'z':
+        return is_signed ? LZ_BINLOG_ARG_SSIZE : LZ_BINLOG_ARG_SIZE;
+    case 't':
+        return is_signed ? LZ_BINLOG_ARG_PTRDIFF : LZ_BINLOG_ARG_UPTRDIFF;
+    default:
+        return is_signed ? LZ_BINLOG_ARG_INT : LZ_BINLOG_ARG_UINT;
+    }
+}
+
+bool lz_binlog_parse_format(const char *fmt, lz_binlog_format_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (fmt == NULL)
+    {
+        return false;
+    }
+
+    size_t fmt_len = strlen(fmt);
+    if (fmt_len > UINT16_MAX)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < fmt_len; i++)
+    {
+        if (fmt[i] != '%')
+        {
+            continue;
+        }
+        if (out->num_specs >= LZ_BINLOG_MAX_ARGS)
+        {
+            return false;
+        }
+
+        lz_binlog_spec_t *spec = &out->specs[out->num_specs++];
+        spec->start = (uint16_t)i;
+        spec->width_arg = -1;
+        spec->precision_arg = -1;
+        spec->value_arg = -1;
+        i++;
+
+        // 标志
+        while (i < fmt_len && strchr("-+ #0'", fmt[i]) != NULL)
+        {
+            i++;
+        }
+
+        // 宽度
+        if (i < fmt_len && fmt[i] == '*')
+        {
+            if (out->num_args >= LZ_BINLOG_MAX_ARGS)
+            {
+                return false;
+            }
+            spec->width_arg = (int8_t)out->num_args;
+            out->string_limit[out->num_args] = -1;
+            out->args[out->num_args++] = LZ_BINLOG_ARG_INT;
+            i++;
+        }
+        else
+        {
+            while (i < fmt_len && fmt[i] >= '0' && fmt[i] <= '9')
+            {
+                i++;
+            }
+        }
+        if (i < fmt_len && fmt[i] == '$')
+        {
+            return false; // 位置参数
+        }
+
+        // 精度
+        int32_t precision = -1;
+        if (i < fmt_len && fmt[i] == '.')
+        {
+            i++;
+            if (i < fmt_len && fmt[i] == '*')
+            {
+                if (out->num_args >= LZ_BINLOG_MAX_ARGS)
+                {
+                    return false;
+                }
+                spec->precision_arg = (int8_t)out->num_args;
+                out->string_limit[out->num_args] = -1;
+                out->args[out->num_args++] = LZ_BINLOG_ARG_INT;
+                precision = -2;
+                i++;
+            }
+            else
+            {
+                precision = 0;
+                while (i < fmt_len && fmt[i] >= '0' && fmt[i] <= '9')
+                {
+                    if (precision < 100000000)
+                    {
+                        precision = precision * 10 + (fmt[i] - '0');
+                    }
+                    i++;
+                }
+            }
+        }
+
+        // 长度修饰符
+        char length = 0;
+        if (i < fmt_len)
+        {
+            switch (fmt[i])
+            {
+            case 'h':
+                length = (i + 1 < fmt_len && fmt[i + 1] == 'h') ? 'H' : 'h';
+                i += (length == 'H') ? 2 : 1;
+                break;
+            case 'l':
+                length = (i + 1 < fmt_len && fmt[i + 1] == 'l') ? 'q' : 'l';
+                i += (length == 'q') ? 2 : 1;
+                break;
+            case 'q':
+            case 'j':
+            case 'z':
+            case 't':
+            case 'L':
+                length = fmt[i];
+                i++;
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (i >= fmt_len)
+        {
+            return false;
+        }
+
+        char conversion = fmt[i];
+        spec->conversion = conversion;
+        spec->end = (uint16_t)(i + 1);
+
+        if (conversion == '%')
+        {
+            continue;
+        }
+        if (out->num_args >= LZ_BINLOG_MAX_ARGS)
+        {
+            return false;
+        }
+
+        lz_binlog_arg_t arg;
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+            arg = integer_arg(length, true);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            arg = integer_arg(length, false);
+            break;
+        case 'c':
+            if (length != 0)
+            {
+                return false; // 宽字符
+            }
+            arg = LZ_BINLOG_ARG_UCHAR;
+            break;
+        case 'p':
+            arg = LZ_BINLOG_ARG_POINTER;
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            arg = (length == 'L') ? LZ_BINLOG_ARG_LDOUBLE : LZ_BINLOG_ARG_DOUBLE;
+            break;
+        case 's':
+            if (length != 0)
+            {
+                return false; // 宽字符
+            }
+            arg = LZ_BINLOG_ARG_STRING;
+            break;
+        default:
+            return false; // %n、%m 及未知转换
+        }
+
+        spec->value_arg = (int8_t)out->num_args;
+        out->string_limit[out->num_args] = (arg == LZ_BINLOG_ARG_STRING) ? precision : -1;
+        out->args[out->num_args++] = (uint8_t)arg;
+    }
+
+    return true;
+}
+
+lz_binlog_wire_t lz_binlog_arg_wire(lz_binlog_arg_t arg)
+{
+    if (arg < LZ_BINLOG_ARG_UINT)
+    {
+        return LZ_BINLOG_WIRE_SIGNED;
+    }
+    if (arg < LZ_BINLOG_ARG_DOUBLE)
+    {
+        return LZ_BINLOG_WIRE_UNSIGNED;
+    }
+    return (arg == LZ_BINLOG_ARG_STRING) ? LZ_BINLOG_WIRE_STRING : LZ_BINLOG_WIRE_DOUBLE;
+}
+
+// ============================================================================
+// 调用点登记
+// ============================================================================
+/*
+ * 登记只发生在每个调用点第一次执行时，用全局互斥锁保护；登记信息发布到 site->impl 后只读。
+ * lz_log_site_t 是公开结构体（C++ 也包含该头文件），impl 不声明为 _Atomic，用 __atomic 内建函数访问。
+ */
+
+static pthread_mutex_t g_site_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t g_next_site_id = 1;
+
+/**
+ * 编码格式定义（完整的控制记录）
+ * @param c 游标
+ * @param id 格式编号
+ * @param site 调用点
+ * @param file 去掉目录的文件名
+ */
+static void put_format_def(binlog_cursor_t *c, uint32_t id, const lz_log_site_t *site, const char *file)
+{
+    const char *func = site->func != NULL ? site->func : "";
+    const char *tag = site->tag != NULL ? site->tag : "";
+    const char *fmt = site->fmt != NULL ? site->fmt : "";
+
+    binlog_put_byte(c, LZ_BINLOG_CONTROL);
+    size_t frame = c->pos;
+    binlog_put_byte(c, 0);
+    binlog_put_byte(c, LZ_BINLOG_CTRL_FORMAT);
+    binlog_put_varint(c, id);
+    binlog_put_byte(c, (uint8_t)site->level);
+    binlog_put_varint(c, site->line > 0 ? (uint64_t)site->line : 0);
+    binlog_put_str(c, file, strlen(file));
+    binlog_put_str(c, func, strlen(func));
+    binlog_put_str(c, tag, strlen(tag));
+    binlog_put_str(c, fmt, strlen(fmt));
+    binlog_close_frame(c, frame);
+}
+
+/**
+ * 登记调用点（持有 g_site_mutex 时调用）
+ * @param site 调用点
+ * @return 登记信息，内存不足时返回 NULL
+ */
+static lz_binlog_site_t *site_register_locked(lz_log_site_t *site)
+{
+    const char *file = site->file;
+    if (file != NULL)
+    {
+        const char *slash = strrchr(file, '/');
+        file = (slash != NULL) ? slash + 1 : file;
+    }
+    file = (file != NULL && *file) ? file : "unknown";
+
+    // 先算格式定义的长度，再分配并写入
+    uint32_t id = g_next_site_id;
+    binlog_cursor_t c = {NULL, 0, 0};
+    put_format_def(&c, id, site, file);
+
+    lz_binlog_site_t *impl = (lz_binlog_site_t *)calloc(1, sizeof(lz_binlog_site_t) + c.pos);
+    if (impl == NULL)
+    {
+        return NULL;
+    }
+    impl->def_len = (uint32_t)c.pos;
+    c = (binlog_cursor_t){impl->def, impl->def_len, 0};
+    put_format_def(&c, id, site, file);
+
+    impl->id = id;
+    impl->file = file;
+    impl->binary = lz_binlog_parse_format(site->fmt, &impl->format);
+    atomic_init(&impl->emitted_epoch, 0);
+    g_next_site_id++;
+    return impl;
+}
+
+lz_binlog_site_t *lz_binlog_site(lz_log_site_t *site)
+{
+    lz_binlog_site_t *impl = (lz_binlog_site_t *)__atomic_load_n(&site->impl, __ATOMIC_ACQUIRE);
+    if (impl != NULL)
+    {
+        return impl;
+    }
+
+    pthread_mutex_lock(&g_site_mutex);
+    impl = (lz_binlog_site_t *)__atomic_load_n(&site->impl, __ATOMIC_ACQUIRE);
+    if (impl == NULL)
+    {
+        impl = site_register_locked(site);
+        if (impl != NULL)
+        {
+            __atomic_store_n(&site->impl, (void *)impl, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&g_site_mutex);
+    return impl;
+}
+
+// ============================================================================
+// 会话与纪元
+// ============================================================================
+
+/** 句柄编号（纪元编号的高 32 位），保证不同句柄的纪元互不相同 */
+static atomic_uint_least32_t g_next_handle = 1;
+
+/** 当前 Unix 毫秒（与时间戳前缀使用同一个粗粒度时钟） */
+static inline int64_t binlog_now_ms(void)
+{
+    struct timespec ts;
+#if defined(CLOCK_REALTIME_COARSE)
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** splitmix64 */
+static uint64_t mix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+void lz_binlog_state_init(lz_binlog_state_t *state)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint32_t handle = atomic_fetch_add(&g_next_handle, 1);
+
+    state->base_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    state->session = mix64(((uint64_t)ts.tv_sec << 30) ^ (uint64_t)ts.tv_nsec ^
+                           ((uint64_t)getpid() << 40) ^ ((uint64_t)handle << 20) ^ (uintptr_t)state);
+    state->dict = NULL;
+    state->roster = NULL;
+    state->epoch_base = (uint64_t)handle << 32;
+    atomic_init(&state->epoch, state->epoch_base);
+    atomic_init(&state->header_epoch, 0);
+
+    // 解码时按设备打开时的时区还原本地时间
+    struct tm tm_info;
+    time_t now = ts.tv_sec;
+    localtime_r(&now, &tm_info);
+    int64_t tz_minutes = (int64_t)tm_info.tm_gmtoff / 60;
+
+    binlog_cursor_t c = {state->header, sizeof(state->header), 0};
+    binlog_put_byte(&c, LZ_BINLOG_CONTROL);
+    size_t frame = c.pos;
+    binlog_put_byte(&c, 0);
+    binlog_put_byte(&c, LZ_BINLOG_CTRL_SESSION);
+    for (int i = 0; i < 8; i++)
+    {
+        binlog_put_byte(&c, (uint8_t)(state->session >> (8 * i)));
+    }
+    binlog_put_varint(&c, (uint64_t)state->base_ms);
+    binlog_put_zigzag(&c, tz_minutes);
+    binlog_close_frame(&c, frame);
+    state->header_len = (uint32_t)c.pos;
+}
+
+void lz_binlog_next_epoch(lz_binlog_state_t *state)
+{
+    atomic_fetch_add_explicit(&state->epoch, 1, memory_order_relaxed);
+}
+
+/*
+ * 线程名定义：未命名的线程也写入空名称，以清除复用同一线程 ID 的旧线程的名称。
+ * 是否已在某个句柄的当前纪元写过由线程自己记录
+ * （线程局部变量，不需要原子操作）；同时记录线程 ID 和线程名版本，fork 或改名后重新写入。
+ * 一个线程交替写入多个句柄时按槽位轮换，超出槽位数时可能重复写入定义（只多几十字节）。
+ * 槽位放在同一个线程局部变量里（动态库中每个线程局部变量的访问都是一次 __tls_get_addr 调用），
+ * 并先检查上一次命中的槽位。
+ */
+
+#define THREAD_DEF_SLOTS 4
+
+typedef struct
+{
+    const lz_binlog_state_t *state;
+    uint64_t epoch;
+    uint64_t tid;
+    uint32_t name_serial;
+} thread_def_slot_t;
+
+typedef struct
+{
+    thread_def_slot_t slots[THREAD_DEF_SLOTS];
+    unsigned last; // 上一次命中的槽位
+    unsigned next; // 下一个替换的槽位
+} thread_defs_t;
+
+static _Thread_local thread_defs_t t_thread_defs;
+
+/*
+ * 线程名登记（只在环形模式开启）：线程每个纪元第一次写入时在这里记下线程 ID、名称和纪元，
+ * 每个纪元第一次写入会话记录的线程再把近期写过日志的其他线程的定义补写一遍，
+ * 这样空闲线程留在环中的旧记录不会因为定义被覆盖而丢失线程名。
+ * 每个线程每个纪元只加锁一次；登记满时替换最久没有写入的线程。
+ */
+
+typedef struct
+{
+    uint64_t tid;
+    uint64_t epoch; // 该线程最近一次写入的纪元
+    uint8_t name_len;
+    char name[LZ_FORMAT_THREAD_NAME_MAX];
+} roster_entry_t;
+
+struct lz_binlog_roster
+{
+    pthread_mutex_t mutex;
+    uint32_t count;
+    roster_entry_t entries[LZ_BINLOG_ROSTER_SLOTS];
+};
+
+/**
+ * 登记当前线程在本纪元写过日志
+ * @param roster 线程名登记
+ * @param thread 当前线程
+ * @param epoch 当前纪元
+ */
+static void roster_note(lz_binlog_roster_t *roster, const lz_format_thread_t *thread, uint64_t epoch)
+{
+    pthread_mutex_lock(&roster->mutex);
+    roster_entry_t *entry = NULL;
+    for (uint32_t i = 0; i < roster->count; i++)
+    {
+        if (roster->entries[i].tid == thread->tid)
+        {
+            entry = &roster->entries[i];
+            break;
+        }
+    }
+    if (entry == NULL && roster->count < LZ_BINLOG_ROSTER_SLOTS)
+    {
+        entry = &roster->entries[roster->count++];
+    }
+    if (entry == NULL)
+    {
+        entry = &roster->entries[0];
+        for (uint32_t i = 1; i < roster->count; i++)
+        {
+            if (roster->entries[i].epoch < entry->epoch)
+            {
+                entry = &roster->entries[i];
+            }
+        }
+    }
+    entry->tid = thread->tid;
+    entry->epoch = epoch;
+    entry->name_len = thread->name_len;
+    memcpy(entry->name, thread->name, thread->name_len);
+    pthread_mutex_unlock(&roster->mutex);
+}
+
+/**
+ * 认领当前线程的线程名定义
+ * @param state 会话状态
+ * @param thread 当前线程
+ * @param epoch 当前纪元
+ * @return 需要写入时返回 LZ_BINLOG_EMIT_THREAD，否则为 0
+ */
+static unsigned claim_thread(const lz_binlog_state_t *state, const lz_format_thread_t *thread, uint64_t epoch)
+{
+    thread_defs_t *defs = &t_thread_defs;
+    thread_def_slot_t *slot = &defs->slots[defs->last];
+    if (slot->state != state)
+    {
+        slot = NULL;
+        for (unsigned i = 0; i < THREAD_DEF_SLOTS; i++)
+        {
+            if (defs->slots[i].state == state)
+            {
+                slot = &defs->slots[i];
+                defs->last = i;
+                break;
+            }
+        }
+    }
+    if (slot == NULL)
+    {
+        defs->last = defs->next++ % THREAD_DEF_SLOTS;
+        slot = &defs->slots[defs->last];
+        slot->state = state;
+    }
+    else if (slot->epoch == epoch && slot->tid == thread->tid && slot->name_serial == thread->name_serial)
+    {
+        return 0;
+    }
+    slot->epoch = epoch;
+    slot->tid = thread->tid;
+    slot->name_serial = thread->name_serial;
+    if (state->roster != NULL)
+    {
+        roster_note(state->roster, thread, epoch);
+    }
+    return LZ_BINLOG_EMIT_THREAD;
+}
+
+/** 写入一个线程名定义 */
+static void put_thread_name(binlog_cursor_t *c, uint64_t tid, const char *name, size_t name_len)
+{
+    binlog_put_byte(c, LZ_BINLOG_CONTROL);
+    size_t frame = c->pos;
+    binlog_put_byte(c, 0);
+    binlog_put_byte(c, LZ_BINLOG_CTRL_THREAD);
+    binlog_put_varint(c, tid);
+    binlog_put_str(c, name, name_len);
+    binlog_close_frame(c, frame);
+}
+
+/** 写入当前线程的线程名定义 */
+static void put_thread_def(binlog_cursor_t *c)
+{
+    const lz_format_thread_t *thread = lz_format_thread();
+    put_thread_name(c, thread->tid, thread->name, thread->name_len);
+}
+
+bool lz_binlog_enable_roster(lz_binlog_state_t *state)
+{
+    lz_binlog_roster_t *roster = (lz_binlog_roster_t *)calloc(1, sizeof(lz_binlog_roster_t));
+    if (roster == NULL)
+    {
+        return false;
+    }
+    if (pthread_mutex_init(&roster->mutex, NULL) != 0)
+    {
+        free(roster);
+        return false;
+    }
+    state->roster = roster;
+    return true;
+}
+
+size_t lz_binlog_encode_roster(const lz_binlog_state_t *state, uint64_t epoch, uint8_t *buf, size_t cap)
+{
+    lz_binlog_roster_t *roster = state->roster;
+    if (roster == NULL)
+    {
+        return 0;
+    }
+    binlog_cursor_t c = {buf, cap, 0};
+    pthread_mutex_lock(&roster->mutex);
+    for (uint32_t i = 0; i < roster->count; i++)
+    {
+        // 本纪元写过的线程已自带定义；两个纪元之前的记录已被覆盖
+        const roster_entry_t *entry = &roster->entries[i];
+        if (entry->epoch != epoch && epoch - entry->epoch <= 2)
+        {
+            put_thread_name(&c, entry->tid, entry->name, entry->name_len);
+        }
+    }
+    pthread_mutex_unlock(&roster->mutex);
+    return c.pos;
+}
+
+unsigned lz_binlog_claim(lz_binlog_state_t *state, lz_binlog_site_t *site, uint64_t epoch,
+                         lz_binlog_stamp_t *out_stamp)
+{
+    const lz_format_thread_t *thread = lz_format_thread();
+    if (out_stamp != NULL)
+    {
+        out_stamp->delta_ms = binlog_now_ms() - state->base_ms;
+        out_stamp->tid = thread->tid;
+    }
+
+    // 先读一次，绝大多数写入在这里就结束；交换保证每个纪元只有一个线程附带定义
+    unsigned flags = 0;
+    if (atomic_load_explicit(&state->header_epoch, memory_order_relaxed) != epoch &&
+        atomic_exchange_explicit(&state->header_epoch, epoch, memory_order_relaxed) != epoch)
+    {
+        flags |= LZ_BINLOG_EMIT_HEADER;
+    }
+    if (atomic_load_explicit(&site->emitted_epoch, memory_order_relaxed) != epoch &&
+        atomic_exchange_explicit(&site->emitted_epoch, epoch, memory_order_relaxed) != epoch)
+    {
+        flags |= LZ_BINLOG_EMIT_FORMAT;
+    }
+    return flags | claim_thread(state, thread, epoch);
+}
+
+// ============================================================================
+// 字符串字典
+// ============================================================================
+/*
+ * 以内容的哈希为键（各平台封装传入的标签、文件名大多不是同一个指针），开放寻址、线性探测。
+ * 插入时先用 CAS 占住空槽的哈希，再发布预先编码好的定义；其他线程看到哈希相同但定义尚未发布时
+ * 把该字段内联写入，不等待。槽位只增不删，编号 = 槽位序号 + 1，关闭句柄时整体释放。
+ */
+
+/** 一个字典项（发布后只读） */
+typedef struct
+{
+    uint16_t str_len;
+    uint16_t str_offset; // 字符串内容在 def 中的位置
+    uint32_t def_len;
+    uint8_t def[];       // 预先编码好的字符串定义（完整的控制记录）
+} dict_entry_t;
+
+typedef struct
+{
+    atomic_uint_least64_t hash;          // 0 表示空槽
+    _Atomic(dict_entry_t *) entry;       // NULL 表示正在插入（或分配失败，该槽不再可用）
+    atomic_uint_least64_t emitted_epoch; // 最近一次写入定义的纪元
+} dict_slot_t;
+
+struct lz_binlog_dict
+{
+    atomic_uint_least32_t count;
+    dict_slot_t slots[LZ_BINLOG_DICT_SLOTS];
+};
+
+/** 64 位哈希（每次处理 8 字节，结果不为 0） */
+static uint64_t dict_hash(const char *s, size_t len)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ (len * 0xFF51AFD7ED558CCDull);
+    while (len >= 8)
+    {
+        uint64_t w;
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 29;
+        s += 8;
+        len -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, s, len);
+    h = mix64(h ^ tail);
+    return h | 1;
+}
+
+/**
+ * 编码字符串定义
+ * @param c 游标
+ * @param id 字符串编号
+ * @param s 内容
+ * @param len 长度
+ * @return 字符串内容在输出中的位置
+ */
+static size_t put_string_def(binlog_cursor_t *c, uint32_t id, const char *s, size_t len)
+{
+    binlog_put_byte(c, LZ_BINLOG_CONTROL);
+    size_t frame = c->pos;
+    binlog_put_byte(c, 0);
+    binlog_put_byte(c, LZ_BINLOG_CTRL_STRING);
+    binlog_put_varint(c, id);
+    binlog_put_str(c, s, len);
+    binlog_close_frame(c, frame);
+    return c->pos - len; // 内容位于记录末尾（close_frame 可能把负载后移）
+}
+
+/**
+ * 创建字典项
+ * @param id 字符串编号
+ * @param s 内容
+ * @param len 长度
+ * @return 字典项，内存不足返回 NULL
+ */
+static dict_entry_t *dict_entry_create(uint32_t id, const char *s, size_t len)
+{
+    binlog_cursor_t c = {NULL, 0, 0};
+    put_string_def(&c, id, s, len);
+
+    dict_entry_t *entry = (dict_entry_t *)malloc(sizeof(dict_entry_t) + c.pos);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+    entry->def_len = (uint32_t)c.pos;
+    c = (binlog_cursor_t){entry->def, entry->def_len, 0};
+    entry->str_offset = (uint16_t)put_string_def(&c, id, s, len);
+    entry->str_len = (uint16_t)len;
+    return entry;
+}
+
+/**
+ * 查找或插入字符串
+ * @param dict 字典
+ * @param s 内容
+ * @return 字符串编号；过长、字典已满或其他线程正在插入时返回 0（调用方内联写入）
+ */
+static uint32_t dict_intern(lz_binlog_dict_t *dict, const char *s)
+{
+    size_t len = strlen(s);
+    if (len > LZ_BINLOG_DICT_MAX_LEN)
+    {
+        return 0;
+    }
+
+    uint64_t hash = dict_hash(s, len);
+    uint32_t mask = LZ_BINLOG_DICT_SLOTS - 1;
+    uint32_t index = (uint32_t)hash & mask;
+    for (uint32_t probe = 0; probe < LZ_BINLOG_DICT_SLOTS; probe++, index = (index + 1) & mask)
+    {
+        dict_slot_t *slot = &dict->slots[index];
+        uint64_t slot_hash = atomic_load_explicit(&slot->hash, memory_order_acquire);
+
+        if (slot_hash == 0)
+        {
+            if (atomic_load_explicit(&dict->count, memory_order_relaxed) >= LZ_BINLOG_DICT_SLOTS / 4 * 3)
+            {
+                return 0;
+            }
+            uint64_t expected = 0;
+            if (atomic_compare_exchange_strong_explicit(&slot->hash, &expected, hash,
+                                                        memory_order_acq_rel, memory_order_acquire))
+            {
+                atomic_fetch_add_explicit(&dict->count, 1, memory_order_relaxed);
+                dict_entry_t *entry = dict_entry_create(index + 1, s, len);
+                if (entry == NULL)
+                {
+                    return 0;
+                }
+                atomic_store_explicit(&slot->entry, entry, memory_order_release);
+                return index + 1;
+            }
+            slot_hash = expected; // 被其他线程抢先占用
+        }
+
+        if (slot_hash == hash)
+        {
+            dict_entry_t *entry = atomic_load_explicit(&slot->entry, memory_order_acquire);
+            if (entry == NULL)
+            {
+                return 0;
+            }
+            if (entry->str_len == len && memcmp(entry->def + entry->str_offset, s, len) == 0)
+            {
+                return index + 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * 线程局部的指针缓存：同一个调用点每次传入的标签、文件名、函数名通常是同一个指针，
+ * 先按指针查到编号，再与字典项的内容比较（指针可能被复用为其他字符串，如 JNI 释放后重新分配），
+ * 相同时省去 strlen、哈希和探测。不同时按内容查字典并更新缓存。
+ */
+
+#define DICT_CACHE_SLOTS 64
+
+typedef struct
+{
+    const lz_binlog_dict_t *dict;
+    const char *s;
+    uint32_t id;
+} dict_cache_slot_t;
+
+static _Thread_local dict_cache_slot_t t_dict_cache[DICT_CACHE_SLOTS];
+
+/**
+ * 查找或插入字符串（先查线程局部的指针缓存）
+ * @param dict 字典
+ * @param s 内容
+ * @return 字符串编号，约定与 dict_intern 相同
+ */
+static uint32_t dict_lookup(lz_binlog_dict_t *dict, const char *s)
+{
+    uintptr_t key = (uintptr_t)s;
+    dict_cache_slot_t *cached = &t_dict_cache[(key ^ (key >> 6) ^ (key >> 12)) & (DICT_CACHE_SLOTS - 1)];
+    if (cached->dict == dict && cached->s == s)
+    {
+        const dict_entry_t *entry = atomic_load_explicit(&dict->slots[cached->id - 1].entry, memory_order_acquire);
+        // strncmp 在 s 的结尾 0 处停止，s 比字典项短时不会越界读取
+        if (entry != NULL && strncmp(s, (const char *)entry->def + entry->str_offset, entry->str_len) == 0 &&
+            s[entry->str_len] == '\0')
+        {
+            return cached->id;
+        }
+    }
+
+    uint32_t id = dict_intern(dict, s);
+    if (id != 0)
+    {
+        cached->dict = dict;
+        cached->s = s;
+        cached->id = id;
+    }
+    return id;
+}
+
+bool lz_binlog_enable_strings(lz_binlog_state_t *state)
+{
+    lz_binlog_dict_t *dict = (lz_binlog_dict_t *)calloc(1, sizeof(lz_binlog_dict_t));
+    if (dict == NULL)
+    {
+        return false;
+    }
+    state->dict = dict;
+    return true;
+}
+
+void lz_binlog_state_destroy(lz_binlog_state_t *state)
+{
+    lz_binlog_roster_t *roster = state->roster;
+    if (roster != NULL)
+    {
+        pthread_mutex_destroy(&roster->mutex);
+        free(roster);
+        state->roster = NULL;
+    }
+
+    lz_binlog_dict_t *dict = state->dict;
+    if (dict == NULL)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < LZ_BINLOG_DICT_SLOTS; i++)
+    {
+        free(atomic_load(&dict->slots[i].entry));
+    }
+    free(dict);
+    state->dict = NULL;
+}
+
+// ============================================================================
+// 编码
+// ============================================================================
+
+/**
+ * 写入一个字符串参数
+ * @param c 游标
+ * @param s 字符串（NULL 按 "(null)" 写入）
+ * @param limit 最多读取的字节数（< 0 表示无限制，与 printf 的 %.Ns 一致）
+ */
+static void put_string_arg(binlog_cursor_t *c, const char *s, int64_t limit)
+{
+    if (s == NULL)
+    {
+        s = "(null)";
+    }
+    size_t len = (limit < 0) ? strlen(s) : strnlen(s, (size_t)limit);
+    binlog_put_str(c, s, len);
+}
+
+void lz_binlog_stamp(const lz_binlog_state_t *state, lz_binlog_stamp_t *out)
+{
+    out->delta_ms = binlog_now_ms() - state->base_ms;
+    out->tid = lz_format_thread_id();
+}
+
+/** 写入 flags 指定的会话记录、线程名和格式定义 */
+static void put_defs(binlog_cursor_t *c, const lz_binlog_state_t *state, const lz_binlog_site_t *site,
+                     unsigned flags)
+{
+    if (flags & LZ_BINLOG_EMIT_HEADER)
+    {
+        binlog_put(c, state->header, state->header_len);
+    }
+    if (flags & LZ_BINLOG_EMIT_THREAD)
+    {
+        put_thread_def(c);
+    }
+    if (flags & LZ_BINLOG_EMIT_FORMAT)
+    {
+        binlog_put(c, site->def, site->def_len);
+    }
+}
+
+size_t lz_binlog_encode_defs(const lz_binlog_state_t *state, const lz_binlog_site_t *site, unsigned flags,
+                             uint8_t *buf, size_t cap)
+{
+    binlog_cursor_t c = {buf, cap, 0};
+    put_defs(&c, state, site, flags);
+    return c.pos;
+}
+
+size_t lz_binlog_encode(const lz_binlog_state_t *state, const lz_binlog_site_t *site, unsigned flags,
+                        const lz_binlog_stamp_t *stamp, uint8_t *buf, size_t cap, va_list args)
+{
+    binlog_cursor_t c = {buf, cap, 0};
+    put_defs(&c, state, site, flags);
+
+    binlog_put_byte(&c, LZ_BINLOG_RECORD);
+    size_t frame = c.pos;
+    binlog_put_byte(&c, 0);
+    binlog_put_varint(&c, site->id);
+    binlog_put_zigzag(&c, stamp->delta_ms);
+    binlog_put_varint(&c, stamp->tid);
+
+    const lz_binlog_format_t *format = &site->format;
+    int64_t last_int = -1;
+    for (uint8_t i = 0; i < format->num_args; i++)
+    {
+        switch ((lz_binlog_arg_t)format->args[i])
+        {
+        case LZ_BINLOG_ARG_INT:
+            last_int = va_arg(args, int);
+            binlog_put_zigzag(&c, last_int);
+            break;
+        case LZ_BINLOG_ARG_SCHAR:
+            binlog_put_zigzag(&c, (signed char)va_arg(args, int));
+            break;
+        case LZ_BINLOG_ARG_SHORT:
+            binlog_put_zigzag(&c, (short)va_arg(args, int));
+            break;
+        case LZ_BINLOG_ARG_LONG:
+            binlog_put_zigzag(&c, va_arg(args, long));
+            break;
+        case LZ_BINLOG_ARG_LLONG:
+            binlog_put_zigzag(&c, va_arg(args, long long));
+            break;
+        case LZ_BINLOG_ARG_INTMAX:
+            binlog_put_zigzag(&c, va_arg(args, intmax_t));
+            break;
+        case LZ_BINLOG_ARG_SSIZE:
+        case LZ_BINLOG_ARG_PTRDIFF:
+            binlog_put_zigzag(&c, va_arg(args, ptrdiff_t));
+            break;
+        case LZ_BINLOG_ARG_UINT:
+            binlog_put_varint(&c, va_arg(args, unsigned int));
+            break;
+        case LZ_BINLOG_ARG_UCHAR:
+            binlog_put_varint(&c, (unsigned char)va_arg(args, int));
+            break;
+        case LZ_BINLOG_ARG_USHORT:
+            binlog_put_varint(&c, (unsigned short)va_arg(args, int));
+            break;
+        case LZ_BINLOG_ARG_ULONG:
+            binlog_put_varint(&c, va_arg(args, unsigned long));
+            break;
+        case LZ_BINLOG_ARG_ULLONG:
+            binlog_put_varint(&c, va_arg(args, unsigned long long));
+            break;
+        case LZ_BINLOG_ARG_UINTMAX:
+            binlog_put_varint(&c, va_arg(args, uintmax_t));
+            break;
+        case LZ_BINLOG_ARG_SIZE:
+        case LZ_BINLOG_ARG_UPTRDIFF:
+            binlog_put_varint(&c, va_arg(args, size_t));
+            break;
+        case LZ_BINLOG_ARG_POINTER:
+            binlog_put_varint(&c, (uintptr_t)va_arg(args, void *));
+            break;
+        case LZ_BINLOG_ARG_DOUBLE:
+        case LZ_BINLOG_ARG_LDOUBLE:
+        {
+            double value = (format->args[i] == LZ_BINLOG_ARG_LDOUBLE) ? (double)va_arg(args, long double)
+                                                                       : va_arg(args, double);
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            for (int b = 0; b < 8; b++)
+            {
+                binlog_put_byte(&c, (uint8_t)(bits >> (8 * b)));
+            }
+            break;
+        }
+        case LZ_BINLOG_ARG_STRING:
+        {
+            int32_t limit = format->string_limit[i];
+            put_string_arg(&c, va_arg(args, const char *), limit == -2 ? last_int : limit);
+            break;
+        }
+        }
+    }
+
+    binlog_close_frame(&c, frame);
+    return c.pos;
+}
+
+// ============================================================================
+// 行记录
+// ============================================================================
+
+/** 行记录长度字段的固定字节数（非最短形式的 varint，消息直接格式化到其后，不需要后移） */
+#define LINE_LEN_SIZE 4
+
+void lz_binlog_prepare_line(lz_binlog_state_t *state, const lz_format_record_t *record, lz_binlog_line_t *line)
+{
+    line->fields[0] = record->file != NULL ? record->file : "";
+    line->fields[1] = record->func != NULL ? record->func : "";
+    line->fields[2] = record->tag != NULL ? record->tag : "";
+    for (int i = 0; i < LZ_BINLOG_LINE_FIELDS; i++)
+    {
+        line->ids[i] = dict_lookup(state->dict, line->fields[i]);
+    }
+    line->flags = 0;
+    line->emit_strings = 0;
+    lz_binlog_stamp(state, &line->stamp);
+}
+
+bool lz_binlog_claim_line(lz_binlog_state_t *state, uint64_t epoch, lz_binlog_line_t *line)
+{
+    line->flags = 0;
+    line->emit_strings = 0;
+    if (atomic_load_explicit(&state->header_epoch, memory_order_relaxed) != epoch &&
+        atomic_exchange_explicit(&state->header_epoch, epoch, memory_order_relaxed) != epoch)
+    {
+        line->flags |= LZ_BINLOG_EMIT_HEADER;
+    }
+    line->flags |= claim_thread(state, lz_format_thread(), epoch);
+    for (int i = 0; i < LZ_BINLOG_LINE_FIELDS; i++)
+    {
+        if (line->ids[i] == 0)
+        {
+            continue;
+        }
+        dict_slot_t *slot = &state->dict->slots[line->ids[i] - 1];
+        if (atomic_load_explicit(&slot->emitted_epoch, memory_order_relaxed) != epoch &&
+            atomic_exchange_explicit(&slot->emitted_epoch, epoch, memory_order_relaxed) != epoch)
+        {
+            line->emit_strings |= 1u << i;
+        }
+    }
+    return line->flags != 0 || line->emit_strings != 0;
+}
+
+/** 写入行记录认领到的会话记录、线程名和字符串定义 */
+static void put_line_defs(binlog_cursor_t *c, const lz_binlog_state_t *state, const lz_binlog_line_t *line)
+{
+    if (line->flags & LZ_BINLOG_EMIT_HEADER)
+    {
+        binlog_put(c, state->header, state->header_len);
+    }
+    if (line->flags & LZ_BINLOG_EMIT_THREAD)
+    {
+        put_thread_def(c);
+    }
+    for (int i = 0; i < LZ_BINLOG_LINE_FIELDS; i++)
+    {
+        if (line->emit_strings & (1u << i))
+        {
+            // 同一条记录的多个字段可能是同一个字符串，只写一次
+            bool duplicate = false;
+            for (int j = 0; j < i; j++)
+            {
+                duplicate |= (line->emit_strings & (1u << j)) && line->ids[j] == line->ids[i];
+            }
+            if (!duplicate)
+            {
+                const dict_entry_t *entry = atomic_load_explicit(&state->dict->slots[line->ids[i] - 1].entry,
+                                                                 memory_order_acquire);
+                binlog_put(c, entry->def, entry->def_len);
+            }
+        }
+    }
+}
+
+size_t lz_binlog_encode_line_defs(const lz_binlog_state_t *state, const lz_binlog_line_t *line,
+                                  uint8_t *buf, size_t cap)
+{
+    binlog_cursor_t c = {buf, cap, 0};
+    put_line_defs(&c, state, line);
+    return c.pos;
+}
+
+/** 写入行记录的一个字段：字符串编号，编号为 0 时后跟内容 */
+static void put_line_field(binlog_cursor_t *c, uint32_t id, const char *s)
+{
+    binlog_put_varint(c, id);
+    if (id == 0)
+    {
+        binlog_put_str(c, s, strlen(s));
+    }
+}
+
+/**
+ * 写入行记录中消息之前的部分（认领到的定义、首字节、长度占位和各字段）
+ * @return 长度占位的偏移
+ */
+static size_t line_begin(binlog_cursor_t *c, const lz_binlog_state_t *state, const lz_binlog_line_t *line,
+                         const lz_format_record_t *record)
+{
+    put_line_defs(c, state, line);
+
+    binlog_put_byte(c, LZ_BINLOG_LINE);
+    size_t frame = c->pos;
+    binlog_put(c, "\0\0\0", LINE_LEN_SIZE);
+    binlog_put_byte(c, (uint8_t)record->level);
+    binlog_put_zigzag(c, line->stamp.delta_ms);
+    binlog_put_varint(c, line->stamp.tid);
+    put_line_field(c, line->ids[0], line->fields[0]);
+    binlog_put_varint(c, record->line > 0 ? (uint64_t)record->line : 0);
+    put_line_field(c, line->ids[1], line->fields[1]);
+    put_line_field(c, line->ids[2], line->fields[2]);
+    return frame;
+}
+
+/**
+ * 消息写完后回填行记录长度
+ * @return 编码后的总长度，超出上限返回 -1
+ */
+static int64_t line_end(binlog_cursor_t *c, size_t frame)
+{
+    size_t payload = c->pos - frame - LINE_LEN_SIZE;
+    if (payload >= (1u << (7 * LINE_LEN_SIZE)))
+    {
+        return -1;
+    }
+    if (c->pos < c->cap)
+    {
+        for (int i = 0; i < LINE_LEN_SIZE; i++)
+        {
+            uint8_t byte = (uint8_t)((payload >> (7 * i)) & 0x7F);
+            c->buf[frame + i] = (i + 1 < LINE_LEN_SIZE) ? (uint8_t)(byte | 0x80) : byte;
+        }
+    }
+    return (int64_t)c->pos;
+}
+
+int64_t lz_binlog_encode_line(const lz_binlog_state_t *state, const lz_binlog_line_t *line,
+                              const lz_format_record_t *record, uint8_t *buf, size_t cap,
+                              const char *fmt, va_list args)
+{
+    binlog_cursor_t c = {buf, cap, 0};
+    size_t frame = line_begin(&c, state, line, record);
+
+    // 消息：直接格式化到剩余空间（vsnprintf 写入的结尾 0 不计入长度）
+    size_t room = c.pos < c.cap ? c.cap - c.pos : 0;
+    int n = vsnprintf(room > 0 ? (char *)c.buf + c.pos : NULL, room, fmt ? fmt : "", args);
+    if (n < 0)
+    {
+        return -1;
+    }
+    c.pos += (size_t)n;
+    return line_end(&c, frame);
+}
+
+int64_t lz_binlog_encode_line_args(const lz_binlog_state_t *state, const lz_binlog_line_t *line,
+                                   const lz_format_record_t *record, uint8_t *buf, size_t cap,
+                                   const char *fmt, const lz_arg_t *args, int32_t count)
+{
+    binlog_cursor_t c = {buf, cap, 0};
+    size_t frame = line_begin(&c, state, line, record);
+
+    size_t room = c.pos < c.cap ? c.cap - c.pos : 0;
+    c.pos += lz_format_args(room > 0 ? (char *)c.buf + c.pos : NULL, room, fmt, args, count);
+    return line_end(&c, frame);
+}
@@ -0,0 +1,360 @@
+#ifndef LZ_BINLOG_H
+#define LZ_BINLOG_H
+
+#include "lz_logger.h"
+#include "lz_format.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 二进制日志（延迟格式化）
+// ============================================================================
+/*
+ * LZ_LOG_BINARY 的调用点第一次执行时登记格式串，得到一个进程内唯一的编号；之后每条日志
+ * 只写入编号、时间差、线程 ID 和原始参数，由离线工具（tools/lz_log_decode、decrypt_log.py）
+ * 还原为与 lz_logger_log 相同的文本行。二进制记录与文本行混在同一个数据流中，
+ * 以 UTF-8 中不会出现的字节开头：
+ *
+ *   记录：0xFE varint(长度) | varint(格式编号) zigzag(时间差 ms) varint(线程ID) 参数...
+ *   控制：0xFF varint(长度) | 类型(1字节) 内容...
+ *     会话（类型 1）：会话 ID(8字节, LE) varint(基准时间 Unix ms) zigzag(时区偏移, 分钟)
+ *     格式（类型 2）：varint(格式编号) 级别(1字节) varint(行号) str(文件) str(函数) str(标签) str(格式串)
+ *     字符串（类型 3）：varint(字符串编号) str(内容)
+ *     线程名（类型 4）：varint(线程ID) str(名称，未命名时为空)
+ *   参数：有符号整数 zigzag varint；无符号整数 / 字符 / 指针 varint；浮点数 8 字节 IEEE 754 (LE)；
+ *         字符串 str = varint(长度) + 内容
+ *
+ * 开启字符串字典（lz_logger_set_string_interning）后，lz_logger_log 写入的文本行改为行记录：
+ *
+ *   行记录：0xFD varint(长度，固定 4 字节) | 级别(1字节) zigzag(时间差 ms) varint(线程ID)
+ *           field(文件) varint(行号) field(函数) field(标签) 消息（帧的剩余部分，不含换行）
+ *   field：varint(字符串编号)，编号为 0 时后跟 str(内容)（字符串过长或字典已满时内联）
+ *
+ * 字符串编号在句柄内唯一，定义与格式定义一样按纪元写入。
+ * 每个线程在每个纪元第一次写入时（以及改名后，见 lz_logger_set_thread_name）附带一次线程名定义，
+ * 记录中仍只有线程 ID；线程 ID 可能被新线程复用，解码时按数据流中的顺序应用线程名定义。
+ * 环形模式下一段时间不写日志的线程的定义会被覆盖，而它较早的记录还在，因此每个纪元写入会话记录后
+ * 再补写最近两个纪元内写过日志的其他线程的线程名定义（最多 LZ_BINLOG_ROSTER_SLOTS 个线程）。
+ *
+ * 会话 = 一次打开（lz_logger_open*），时间差相对会话的基准时间。
+ * 格式定义按「纪元」写入：打开、每次切换文件、环形模式每写过半个环都开始新纪元，
+ * 每个格式在每个纪元第一次使用时把定义和记录一起写入（同一次写入，不会被拆到两个文件），
+ * 因此每个文件都能单独还原。解码时先收集整个文件中同一会话的定义，再逐条还原。
+ */
+
+/** 二进制记录 / 控制记录的首字节 */
+#define LZ_BINLOG_LINE 0xFD
+#define LZ_BINLOG_RECORD 0xFE
+#define LZ_BINLOG_CONTROL 0xFF
+
+/** 控制记录类型 */
+#define LZ_BINLOG_CTRL_SESSION 1
+#define LZ_BINLOG_CTRL_FORMAT 2
+#define LZ_BINLOG_CTRL_STRING 3
+#define LZ_BINLOG_CTRL_THREAD 4
+
+/** 字符串字典的槽位数（2 的幂）和可以入字典的最大长度；填满 3/4 后新字符串内联写入 */
+#define LZ_BINLOG_DICT_SLOTS 1024
+#define LZ_BINLOG_DICT_MAX_LEN 255
+
+/** 环形模式登记的线程数，以及补写这些线程名定义的最大长度 */
+#define LZ_BINLOG_ROSTER_SLOTS 64
+#define LZ_BINLOG_ROSTER_MAX_BYTES (LZ_BINLOG_ROSTER_SLOTS * (14 + LZ_FORMAT_THREAD_NAME_MAX))
+
+/** 单个格式串最多的参数个数（含 * 宽度 / 精度），超过时回退为文本 */
+#define LZ_BINLOG_MAX_ARGS 32
+
+/** 参数的读取类型（va_arg 的类型）与写入方式 */
+typedef enum
+{
+    LZ_BINLOG_ARG_INT = 0,     // int（含 char / short 提升），有符号
+    LZ_BINLOG_ARG_SCHAR,       // %hhd：int 截断为 signed char
+    LZ_BINLOG_ARG_SHORT,       // %hd：int 截断为 short
+    LZ_BINLOG_ARG_LONG,        // long
+    LZ_BINLOG_ARG_LLONG,       // long long
+    LZ_BINLOG_ARG_INTMAX,      // intmax_t
+    LZ_BINLOG_ARG_SSIZE,       // %zd：与 size_t 等宽的有符号数
+    LZ_BINLOG_ARG_PTRDIFF,     // ptrdiff_t
+    LZ_BINLOG_ARG_UINT,        // unsigned int
+    LZ_BINLOG_ARG_UCHAR,       // %hhu / %c：截断为 unsigned char
+    LZ_BINLOG_ARG_USHORT,      // %hu：截断为 unsigned short
+    LZ_BINLOG_ARG_ULONG,       // unsigned long
+    LZ_BINLOG_ARG_ULLONG,      // unsigned long long
+    LZ_BINLOG_ARG_UINTMAX,     // uintmax_t
+    LZ_BINLOG_ARG_SIZE,        // size_t
+    LZ_BINLOG_ARG_UPTRDIFF,    // %tu
+    LZ_BINLOG_ARG_POINTER,     // void *
+    LZ_BINLOG_ARG_DOUBLE,      // double
+    LZ_BINLOG_ARG_LDOUBLE,     // long double（按 double 写入）
+    LZ_BINLOG_ARG_STRING,      // const char *
+} lz_binlog_arg_t;
+
+/** 参数在数据流中的编码（解码方解析同一个格式串即可知道每个参数的编码） */
+typedef enum
+{
+    LZ_BINLOG_WIRE_SIGNED = 0,
+    LZ_BINLOG_WIRE_UNSIGNED,
+    LZ_BINLOG_WIRE_DOUBLE,
+    LZ_BINLOG_WIRE_STRING,
+} lz_binlog_wire_t;
+
+/** 格式串中的一个转换说明 */
+typedef struct
+{
+    uint16_t start;       // 在格式串中的起始位置（'%'）
+    uint16_t end;         // 结束位置（转换字符之后）
+    int8_t width_arg;     // 宽度为 * 时对应的参数序号，否则为 -1
+    int8_t precision_arg; // 精度为 * 时对应的参数序号，否则为 -1
+    int8_t value_arg;     // 值对应的参数序号（%% 为 -1）
+    char conversion;      // 转换字符
+} lz_binlog_spec_t;
+
+/** 格式串解析结果 */
+typedef struct
+{
+    uint8_t num_args;
+    uint8_t num_specs;
+    uint8_t args[LZ_BINLOG_MAX_ARGS];          // lz_binlog_arg_t
+    int32_t string_limit[LZ_BINLOG_MAX_ARGS];  // %s 的精度：-1 无，-2 由前一个参数（*）给出，否则为固定值
+    lz_binlog_spec_t specs[LZ_BINLOG_MAX_ARGS]; // 含 %%
+} lz_binlog_format_t;
+
+/** 已登记的调用点（lz_log_site_t.impl 指向它，登记后只读，进程退出前不释放） */
+typedef struct
+{
+    uint32_t id;                         // 格式编号（从 1 开始）
+    bool binary;                         // false：格式串不支持二进制写入，回退为文本
+    const char *file;                    // 去掉目录的文件名
+    lz_binlog_format_t format;           // 参数列表
+    atomic_uint_least64_t emitted_epoch; // 最近一次写入定义的纪元
+    uint32_t def_len;                    // 预先编码好的格式定义（完整的控制记录）
+    uint8_t def[];
+} lz_binlog_site_t;
+
+/** 字符串字典（每个句柄一个，无锁开放寻址，只增不删，关闭句柄时释放） */
+typedef struct lz_binlog_dict lz_binlog_dict_t;
+
+/** 线程名登记（环形模式每个纪元补写，关闭句柄时释放） */
+typedef struct lz_binlog_roster lz_binlog_roster_t;
+
+/** 每个日志句柄的会话状态 */
+typedef struct
+{
+    lz_binlog_dict_t *dict;             // 字符串字典（NULL 表示未开启）
+    lz_binlog_roster_t *roster;         // 线程名登记（NULL 表示不补写，文件模式）
+    uint64_t session;                   // 会话 ID
+    int64_t base_ms;                    // 基准时间（Unix ms）
+    uint64_t epoch_base;                // 纪元编号的高 32 位（进程内每个句柄不同）
+    atomic_uint_least64_t epoch;        // 文件模式的当前纪元（低 32 位每次切换文件 +1）
+    atomic_uint_least64_t header_epoch; // 最近一次写入会话记录的纪元
+    uint32_t header_len;
+    uint8_t header[32];                 // 预先编码好的会话记录
+} lz_binlog_state_t;
+
+/** lz_binlog_claim 的结果：本次写入需要带上的内容 */
+#define LZ_BINLOG_EMIT_HEADER 0x1
+#define LZ_BINLOG_EMIT_FORMAT 0x2
+#define LZ_BINLOG_EMIT_THREAD 0x4
+
+/** 一条记录的时间和线程（编码前取一次，超长重新编码时保持不变） */
+typedef struct
+{
+    int64_t delta_ms; // 相对会话基准时间的毫秒数
+    uint64_t tid;     // 线程 ID
+} lz_binlog_stamp_t;
+
+/** 行记录的字段：文件、函数、标签 */
+#define LZ_BINLOG_LINE_FIELDS 3
+
+/** 一条行记录的编码信息（编码前准备一次，超长重新编码时保持不变） */
+typedef struct
+{
+    const char *fields[LZ_BINLOG_LINE_FIELDS]; // 文件、函数、标签（NULL 按空串）
+    uint32_t ids[LZ_BINLOG_LINE_FIELDS];       // 字符串编号（0 表示内联）
+    unsigned flags;                            // LZ_BINLOG_EMIT_HEADER / LZ_BINLOG_EMIT_THREAD
+    unsigned emit_strings;                     // 第 i 位：ids[i] 的定义随本次写入
+    lz_binlog_stamp_t stamp;
+} lz_binlog_line_t;
+
+/**
+ * 解析 printf 格式串
+ * @param fmt 格式串
+ * @param out 解析结果
+ * @return 可以二进制写入返回 true；含 %n、位置参数、宽字符、超过 LZ_BINLOG_MAX_ARGS 个参数等返回 false
+ */
+bool lz_binlog_parse_format(const char *fmt, lz_binlog_format_t *out);
+
+/**
+ * 参数的编码方式
+ * @param arg 参数的读取类型
+ * @return 编码方式
+ */
+lz_binlog_wire_t lz_binlog_arg_wire(lz_binlog_arg_t arg);
+
+/**
+ * 取得调用点的登记信息（第一次调用时登记）
+ * @param site 调用点
+ * @return 登记信息，内存不足时返回 NULL
+ */
+lz_binlog_site_t *lz_binlog_site(lz_log_site_t *site);
+
+/**
+ * 初始化一个句柄的会话状态（打开时调用）
+ * @param state 会话状态
+ */
+void lz_binlog_state_init(lz_binlog_state_t *state);
+
+/**
+ * 开启字符串字典（打开时调用）
+ * @param state 会话状态
+ * @return 成功返回 true；内存不足返回 false（保持文本行）
+ */
+bool lz_binlog_enable_strings(lz_binlog_state_t *state);
+
+/**
+ * 开启线程名登记（环形模式打开时调用）
+ * @param state 会话状态
+ * @return 成功返回 true；内存不足返回 false（不补写线程名定义）
+ */
+bool lz_binlog_enable_roster(lz_binlog_state_t *state);
+
+/**
+ * 释放会话状态持有的内存（关闭句柄时调用）
+ * @param state 会话状态
+ */
+void lz_binlog_state_destroy(lz_binlog_state_t *state);
+
+/**
+ * 开始新纪元（文件模式切换到新文件后调用，之后的写入重新带上会话和格式定义）
+ * @param state 会话状态
+ */
+void lz_binlog_next_epoch(lz_binlog_state_t *state);
+
+/**
+ * 认领本次写入需要附带的会话记录、格式定义（每个纪元只有一个写入线程认领成功）和
+ * 当前线程的线程名定义（每个线程在每个纪元一次），同时取当前记录的时间和线程
+ * @param state 会话状态
+ * @param site 调用点
+ * @param epoch 当前纪元
+ * @param out_stamp 输出当前记录的时间和线程（只补写定义时传 NULL）
+ * @return LZ_BINLOG_EMIT_HEADER / LZ_BINLOG_EMIT_FORMAT / LZ_BINLOG_EMIT_THREAD 的组合
+ */
+unsigned lz_binlog_claim(lz_binlog_state_t *state, lz_binlog_site_t *site, uint64_t epoch,
+                         lz_binlog_stamp_t *out_stamp);
+
+/**
+ * 取当前记录的时间和线程
+ * @param state 会话状态
+ * @param out 输出
+ */
+void lz_binlog_stamp(const lz_binlog_state_t *state, lz_binlog_stamp_t *out);
+
+/**
+ * 只编码会话记录和格式定义
+ * @param state 会话状态
+ * @param site 调用点
+ * @param flags lz_binlog_claim 的结果
+ * @param buf 输出缓冲
+ * @param cap 缓冲大小
+ * @return 编码后的总长度；大于 cap 时只计算了长度
+ */
+size_t lz_binlog_encode_defs(const lz_binlog_state_t *state, const lz_binlog_site_t *site, unsigned flags,
+                             uint8_t *buf, size_t cap);
+
+/**
+ * 编码一次写入（flags 指定的会话记录、格式定义在前，日志记录在后）
+ * @param state 会话状态
+ * @param site 调用点
+ * @param flags lz_binlog_claim 的结果
+ * @param stamp 时间和线程
+ * @param buf 输出缓冲
+ * @param cap 缓冲大小
+ * @param args 日志参数
+ * @return 编码后的总长度；大于 cap 时只计算了长度，需要用更大的缓冲以同样的参数重新编码
+ */
+size_t lz_binlog_encode(const lz_binlog_state_t *state, const lz_binlog_site_t *site, unsigned flags,
+                        const lz_binlog_stamp_t *stamp, uint8_t *buf, size_t cap, va_list args);
+
+/**
+ * 准备一条行记录：查字典得到各字段的字符串编号，取时间和线程
+ * @param state 会话状态（dict 不为 NULL）
+ * @param record 元信息
+ * @param line 输出
+ */
+void lz_binlog_prepare_line(lz_binlog_state_t *state, const lz_format_record_t *record, lz_binlog_line_t *line);
+
+/**
+ * 认领行记录需要附带的会话记录、线程名定义和字符串定义
+ * @param state 会话状态
+ * @param epoch 当前纪元
+ * @param line 行记录（输入 ids，输出 flags / emit_strings）
+ * @return 有需要附带的内容返回 true
+ */
+bool lz_binlog_claim_line(lz_binlog_state_t *state, uint64_t epoch, lz_binlog_line_t *line);
+
+/**
+ * 编码一次行写入（认领到的会话记录、字符串定义在前，行记录在后，消息直接格式化到缓冲中）
+ * @param state 会话状态
+ * @param line 行记录
+ * @param record 元信息（取级别和行号）
+ * @param buf 输出缓冲（可为 NULL，此时 cap 必须为 0）
+ * @param cap 缓冲大小
+ * @param fmt 消息格式串
+ * @param args 格式化参数
+ * @return 编码后的总长度；返回值 >= cap 时需要用至少 返回值 + 1 字节的缓冲以同样的参数重新编码；
+ *         格式化失败返回 -1
+ */
+int64_t lz_binlog_encode_line(const lz_binlog_state_t *state, const lz_binlog_line_t *line,
+                              const lz_format_record_t *record, uint8_t *buf, size_t cap,
+                              const char *fmt, va_list args);
+
+/**
+ * 以类型化参数编码一次行写入（返回值约定与 lz_binlog_encode_line 相同）
+ * @param state 会话状态
+ * @param line 行记录
+ * @param record 元信息（取级别和行号）
+ * @param buf 输出缓冲（可为 NULL，此时 cap 必须为 0）
+ * @param cap 缓冲大小
+ * @param fmt 消息模板（"{}" 依次替换为参数）
+ * @param args 参数数组
+ * @param count 参数个数
+ * @return 编码后的总长度；长度超出行记录的上限时返回 -1
+ */
+int64_t lz_binlog_encode_line_args(const lz_binlog_state_t *state, const lz_binlog_line_t *line,
+                                   const lz_format_record_t *record, uint8_t *buf, size_t cap,
+                                   const char *fmt, const lz_arg_t *args, int32_t count);
+
+/**
+ * 只编码行记录认领到的会话记录和字符串定义
+ * @param state 会话状态
+ * @param line 行记录
+ * @param buf 输出缓冲
+ * @param cap 缓冲大小
+ * @return 编码后的总长度；大于 cap 时只计算了长度
+ */
+size_t lz_binlog_encode_line_defs(const lz_binlog_state_t *state, const lz_binlog_line_t *line,
+                                  uint8_t *buf, size_t cap);
+
+/**
+ * 编码最近两个纪元内写过日志、本纪元还没有写过的线程的线程名定义
+ * （认领到 LZ_BINLOG_EMIT_HEADER 的写入线程在记录之后写入）
+ * @param state 会话状态（roster 为 NULL 时返回 0）
+ * @param epoch 当前纪元
+ * @param buf 输出缓冲
+ * @param cap 缓冲大小（至少 LZ_BINLOG_ROSTER_MAX_BYTES）
+ * @return 编码后的总长度
+ */
+size_t lz_binlog_encode_roster(const lz_binlog_state_t *state, uint64_t epoch, uint8_t *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_BINLOG_H
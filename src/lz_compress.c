@@ -0,0 +1,972 @@
+#include "lz_compress.h"
+#include "lz_crypto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef LZ_DEBUG_LOG
+#define LZ_DEBUG_LOG(fmt, ...)                                       \
+    fprintf(stderr, "[LZLogger] lz_compress.c:%d %s() - " fmt "\n", \
+            __LINE__, __func__, ##__VA_ARGS__)
+#endif
+
+// ============================================================================
+// Internal Constants
+// ============================================================================
+
+/** 哈希表大小：2^12 项 */
+#define COMPRESS_HASH_LOG 12
+
+/** 最短匹配长度 */
+#define COMPRESS_MIN_MATCH 4
+
+/** 最后一个匹配必须在块末尾 12 字节之前开始（LZ4 格式要求） */
+#define COMPRESS_MFLIMIT 12
+
+/** 块末尾至少保留 5 字节字面量（LZ4 格式要求） */
+#define COMPRESS_LAST_LITERALS 5
+
+/** 未命中时的跳跃加速：每连续未命中 2^6 字节，步长加 1 */
+#define COMPRESS_SKIP_TRIGGER 6
+
+// ============================================================================
+// Utility Functions
+// ============================================================================
+
+static inline uint32_t compress_read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * 计算从 a、b 开始的公共前缀长度（每次比较 8 字节）
+ * @param limit a 可读的上限（b 在 a 之前，同样可读）
+ */
+static inline uint32_t compress_count(const uint8_t *a, const uint8_t *b, const uint8_t *limit)
+{
+    const uint8_t *start = a;
+    while (limit - a >= 8)
+    {
+        uint64_t x, y;
+        memcpy(&x, a, sizeof(x));
+        memcpy(&y, b, sizeof(y));
+        uint64_t diff = x ^ y;
+        if (diff != 0)
+        {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return (uint32_t)(a - start) + (uint32_t)(__builtin_ctzll(diff) >> 3);
+#else
+            break;
+#endif
+        }
+        a += 8;
+        b += 8;
+    }
+    while (a < limit && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return (uint32_t)(a - start);
+}
+
+static inline uint32_t compress_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - COMPRESS_HASH_LOG);
+}
+
+/**
+ * 写入长度的扩展字节（每个 255 表示继续）
+ * @return 新的输出位置；越界返回 NULL
+ */
+static inline uint8_t *compress_put_length(uint8_t *op, const uint8_t *oend, uint32_t len)
+{
+    while (len >= 255)
+    {
+        if (op >= oend)
+        {
+            return NULL;
+        }
+        *op++ = 255;
+        len -= 255;
+    }
+    if (op >= oend)
+    {
+        return NULL;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/**
+ * 输出一个序列：字面量 + （可选）匹配
+ * @param match_len 匹配长度（0 表示只有字面量，即最后一个序列）
+ * @return 新的输出位置；越界返回 NULL
+ */
+static uint8_t *compress_emit(uint8_t *op, const uint8_t *oend,
+                              const uint8_t *literals, uint32_t lit_len,
+                              uint32_t offset, uint32_t match_len)
+{
+    if (op >= oend)
+    {
+        return NULL;
+    }
+
+    uint8_t *token = op++;
+    uint32_t ml_code = match_len ? match_len - COMPRESS_MIN_MATCH : 0;
+
+    *token = (uint8_t)(((lit_len >= 15 ? 15 : lit_len) << 4) | (ml_code >= 15 ? 15 : ml_code));
+
+    if (lit_len >= 15 && (op = compress_put_length(op, oend, lit_len - 15)) == NULL)
+    {
+        return NULL;
+    }
+
+    if ((uint32_t)(oend - op) < lit_len)
+    {
+        return NULL;
+    }
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if (match_len == 0)
+    {
+        return op;
+    }
+
+    if (oend - op < 2)
+    {
+        return NULL;
+    }
+    *op++ = (uint8_t)(offset & 0xFF);
+    *op++ = (uint8_t)(offset >> 8);
+
+    if (ml_code >= 15 && (op = compress_put_length(op, oend, ml_code - 15)) == NULL)
+    {
+        return NULL;
+    }
+
+    return op;
+}
+
+/**
+ * 写入全部数据（处理短写和 EINTR）
+ * @return 成功返回 true
+ */
+static bool compress_write_full(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * 读取全部数据（处理短读和 EINTR）
+ * @return 成功返回 true（文件提前结束返回 false）
+ */
+static bool compress_read_full(int fd, void *buf, size_t len, off_t offset)
+{
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0)
+    {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return true;
+}
+
+/**
+ * 盐是否全为 0（未加密的文件不生成盐）
+ */
+static bool compress_salt_is_zero(const uint8_t *salt)
+{
+    for (int i = 0; i < LZ_LOG_SALT_SIZE; i++)
+    {
+        if (salt[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * 组装 footer：[盐16字节][魔数4字节][文件大小4字节][已用大小4字节]
+ */
+static void compress_build_footer(uint8_t *footer, const uint8_t *salt,
+                                  uint32_t magic, uint32_t file_size, uint32_t used)
+{
+    if (salt != NULL)
+    {
+        memcpy(footer, salt, LZ_LOG_SALT_SIZE);
+    }
+    else
+    {
+        memset(footer, 0, LZ_LOG_SALT_SIZE);
+    }
+    memcpy(footer + LZ_LOG_SALT_SIZE, &magic, sizeof(magic));
+    memcpy(footer + LZ_LOG_SALT_SIZE + 4, &file_size, sizeof(file_size));
+    memcpy(footer + LZ_LOG_SALT_SIZE + 8, &used, sizeof(used));
+}
+
+/**
+ * 沿块头部遍历块流（EndB），建立块索引
+ * @param fd 文件描述符
+ * @param used 数据区已用大小
+ * @param out_index 输出块索引（调用者 free）
+ * @param out_count 输出块数
+ * @param out_end 输出最后一个完整块的末尾
+ * @return 错误码
+ * @note 遇到无效的块头部（崩溃时预留了空间但未写完）即停止
+ */
+static lz_log_error_t compress_scan_stream(int fd, uint32_t used, uint32_t **out_index,
+                                           uint32_t *out_count, uint32_t *out_end)
+{
+    uint32_t *index = NULL;
+    uint32_t count = 0;
+    uint32_t cap = 0;
+    uint32_t pos = 0;
+
+    while ((uint64_t)pos + LZ_COMPRESS_BLOCK_HEADER_SIZE <= used)
+    {
+        lz_compress_block_header_t header;
+        if (!compress_read_full(fd, &header, LZ_COMPRESS_BLOCK_HEADER_SIZE, pos))
+        {
+            break;
+        }
+
+        bool stored = (header.stored_size & LZ_COMPRESS_BLOCK_STORED) != 0;
+        uint32_t payload_len = header.stored_size & ~LZ_COMPRESS_BLOCK_STORED;
+        if (header.raw_size == 0 || header.raw_size > LZ_COMPRESS_MAX_BLOCK ||
+            payload_len == 0 || payload_len > LZ_COMPRESS_MAX_BLOCK ||
+            (stored && payload_len != header.raw_size) ||
+            (uint64_t)pos + LZ_COMPRESS_BLOCK_HEADER_SIZE + payload_len > used)
+        {
+            break;
+        }
+
+        if (count == cap)
+        {
+            uint32_t new_cap = cap == 0 ? 64 : cap * 2;
+            uint32_t *grown = (uint32_t *)realloc(index, new_cap * sizeof(uint32_t));
+            if (grown == NULL)
+            {
+                free(index);
+                return LZ_LOG_ERROR_OUT_OF_MEMORY;
+            }
+            index = grown;
+            cap = new_cap;
+        }
+        index[count++] = pos;
+        pos += LZ_COMPRESS_BLOCK_HEADER_SIZE + payload_len;
+    }
+
+    *out_index = index;
+    *out_count = count;
+    *out_end = pos;
+    return LZ_LOG_SUCCESS;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+uint32_t lz_compress_block(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_cap)
+{
+    if (src == NULL || dst == NULL || src_len == 0 || src_len > LZ_COMPRESS_MAX_BLOCK)
+    {
+        return 0;
+    }
+
+    uint8_t *op = dst;
+    const uint8_t *oend = dst + dst_cap;
+    uint32_t anchor = 0;
+
+    // 太短的块只输出字面量
+    if (src_len > COMPRESS_MFLIMIT)
+    {
+        uint16_t table[1 << COMPRESS_HASH_LOG];
+        memset(table, 0, sizeof(table));
+
+        const uint32_t limit = src_len - COMPRESS_MFLIMIT;
+        const uint32_t match_limit = src_len - COMPRESS_LAST_LITERALS;
+        uint32_t ip = 1;
+        uint32_t misses = 0;
+
+        while (ip < limit)
+        {
+            uint32_t seq = compress_read32(src + ip);
+            uint32_t h = compress_hash(seq);
+            uint32_t ref = table[h];
+            table[h] = (uint16_t)ip;
+
+            if (ref >= ip || compress_read32(src + ref) != seq)
+            {
+                ip += 1 + (misses++ >> COMPRESS_SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+
+            // 向前扩展匹配
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+            {
+                ip--;
+                ref--;
+            }
+
+            // 向后扩展匹配
+            uint32_t match_len = COMPRESS_MIN_MATCH +
+                                 compress_count(src + ip + COMPRESS_MIN_MATCH, src + ref + COMPRESS_MIN_MATCH,
+                                                src + match_limit);
+
+            op = compress_emit(op, oend, src + anchor, ip - anchor, ip - ref, match_len);
+            if (op == NULL)
+            {
+                return 0;
+            }
+
+            ip += match_len;
+            anchor = ip;
+
+            // 补充匹配末尾附近的哈希，提高下一次命中率
+            if (ip < limit)
+            {
+                table[compress_hash(compress_read32(src + ip - 2))] = (uint16_t)(ip - 2);
+            }
+        }
+    }
+
+    op = compress_emit(op, oend, src + anchor, src_len - anchor, 0, 0);
+    if (op == NULL)
+    {
+        return 0;
+    }
+
+    return (uint32_t)(op - dst);
+}
+
+int lz_decompress_block(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len)
+{
+    if (src == NULL || dst == NULL || src_len == 0)
+    {
+        return -1;
+    }
+
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + src_len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_len;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+
+        // 字面量
+        uint32_t lit_len = token >> 4;
+        if (lit_len == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= iend)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                lit_len += b;
+            } while (b == 255);
+        }
+        if ((uint32_t)(iend - ip) < lit_len || (uint32_t)(oend - op) < lit_len)
+        {
+            return -1;
+        }
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        // 最后一个序列只有字面量
+        if (ip == iend)
+        {
+            break;
+        }
+
+        // 匹配
+        if (iend - ip < 2)
+        {
+            return -1;
+        }
+        uint32_t offset = (uint32_t)ip[0] | ((uint32_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - dst))
+        {
+            return -1;
+        }
+
+        uint32_t match_len = token & 0x0F;
+        if (match_len == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= iend)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += COMPRESS_MIN_MATCH;
+        if ((uint32_t)(oend - op) < match_len)
+        {
+            return -1;
+        }
+
+        // 匹配可能与输出重叠（offset < match_len），逐字节复制
+        const uint8_t *match = op - offset;
+        if (offset >= match_len)
+        {
+            memcpy(op, match, match_len);
+            op += match_len;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < match_len; i++)
+            {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return op == oend ? 0 : -1;
+}
+
+lz_log_error_t lz_compress_seal_stream(int fd,
+                                       const uint8_t *footer,
+                                       uint32_t *out_file_size,
+                                       uint32_t *out_used)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    uint32_t *index = NULL;
+    uint8_t *trailer = NULL;
+
+    do
+    {
+        uint32_t magic = 0, file_size = 0, used = 0;
+        memcpy(&magic, footer + LZ_LOG_SALT_SIZE, sizeof(magic));
+        memcpy(&file_size, footer + LZ_LOG_SALT_SIZE + 4, sizeof(file_size));
+        memcpy(&used, footer + LZ_LOG_SALT_SIZE + 8, sizeof(used));
+        if (magic != LZ_LOG_MAGIC_ENDB || file_size < LZ_LOG_FOOTER_SIZE)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+        if (used > file_size - LZ_LOG_FOOTER_SIZE)
+        {
+            used = file_size - LZ_LOG_FOOTER_SIZE;
+        }
+
+        uint32_t count = 0, end = 0;
+        ret = compress_scan_stream(fd, used, &index, &count, &end);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        // [块索引][扩展区][footer] 一次写在数据末尾（原为预留空间），落盘后再截断
+        uint32_t trailer_size = LZ_COMPRESS_TRAILER_SIZE(count);
+        trailer = (uint8_t *)malloc(trailer_size);
+        if (trailer == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        uint32_t new_size = end + trailer_size;
+        uint32_t ext[4] = {LZ_COMPRESS_MAX_BLOCK, count, end,
+                           compress_salt_is_zero(footer) ? 0 : LZ_COMPRESS_FLAG_ENCRYPTED};
+        if (count > 0)
+        {
+            memcpy(trailer, index, count * sizeof(uint32_t));
+        }
+        memcpy(trailer + count * sizeof(uint32_t), ext, sizeof(ext));
+        compress_build_footer(trailer + trailer_size - LZ_LOG_FOOTER_SIZE, footer,
+                              LZ_LOG_MAGIC_ENDZ, new_size, end);
+
+        if (pwrite(fd, trailer, trailer_size, end) != (ssize_t)trailer_size ||
+            fdatasync(fd) != 0 ||
+            (new_size < file_size && ftruncate(fd, (off_t)new_size) != 0))
+        {
+            ret = LZ_LOG_ERROR_FILE_WRITE;
+            break;
+        }
+
+        *out_file_size = new_size;
+        *out_used = end;
+
+    } while (0);
+
+    free(index);
+    free(trailer);
+    return ret;
+}
+
+lz_log_error_t lz_compress_segment(int dir_fd,
+                                   const char *name,
+                                   const char *encrypt_key,
+                                   uint32_t *out_file_size,
+                                   uint32_t *out_used)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    int fd = -1;
+    int out_fd = -1;
+    bool tmp_created = false;
+    uint8_t *raw = NULL;
+    uint8_t *packed = NULL;
+    uint32_t *index = NULL;
+    lz_crypto_context_t src_crypto;
+    lz_crypto_context_t dst_crypto;
+    memset(&src_crypto, 0, sizeof(src_crypto));
+    memset(&dst_crypto, 0, sizeof(dst_crypto));
+
+    uint8_t footer[LZ_LOG_FOOTER_SIZE];
+    uint8_t new_salt[LZ_LOG_SALT_SIZE];
+    char tmp_name[128];
+
+    do
+    {
+        if (name == NULL || out_file_size == NULL || out_used == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+        snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", name);
+
+        fd = openat(dir_fd, name, O_RDWR | O_CLOEXEC);
+        if (fd < 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_OPEN;
+            break;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < LZ_LOG_FOOTER_SIZE ||
+            !compress_read_full(fd, footer, sizeof(footer), st.st_size - LZ_LOG_FOOTER_SIZE))
+        {
+            ret = LZ_LOG_ERROR_FILE_OPEN;
+            break;
+        }
+
+        uint32_t magic = 0, file_size = 0, used = 0;
+        memcpy(&magic, footer + LZ_LOG_SALT_SIZE, sizeof(magic));
+        memcpy(&file_size, footer + LZ_LOG_SALT_SIZE + 4, sizeof(file_size));
+        memcpy(&used, footer + LZ_LOG_SALT_SIZE + 8, sizeof(used));
+
+        // 写入时已压缩的块流：原地补写块索引即可
+        if (magic == LZ_LOG_MAGIC_ENDB && file_size == (uint32_t)st.st_size)
+        {
+            ret = lz_compress_seal_stream(fd, footer, out_file_size, out_used);
+            break;
+        }
+
+        if (magic != LZ_LOG_MAGIC_ENDX || file_size != (uint32_t)st.st_size)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+        if (used > file_size - LZ_LOG_FOOTER_SIZE)
+        {
+            used = file_size - LZ_LOG_FOOTER_SIZE;
+        }
+
+        // 原文件已加密：用原盐解密，压缩后用新段盐加密（沿用主盐，段编号置最高位，不需要再执行 PBKDF2）
+        bool encrypted = !compress_salt_is_zero(footer);
+        if (encrypted)
+        {
+            if (encrypt_key == NULL || encrypt_key[0] == '\0')
+            {
+                ret = LZ_LOG_ERROR_INVALID_PARAM;
+                break;
+            }
+            if (lz_crypto_init(&src_crypto, encrypt_key, footer) != 0 ||
+                lz_crypto_next_salt(footer, LZ_CRYPTO_SALT_COPY, new_salt) != 0 ||
+                lz_crypto_init(&dst_crypto, encrypt_key, new_salt) != 0)
+            {
+                ret = LZ_LOG_ERROR_SYSTEM;
+                break;
+            }
+        }
+
+        uint32_t block_count = (used + LZ_COMPRESS_MAX_BLOCK - 1) / LZ_COMPRESS_MAX_BLOCK;
+        raw = (uint8_t *)malloc(LZ_COMPRESS_MAX_BLOCK);
+        packed = (uint8_t *)malloc(LZ_COMPRESS_BOUND(LZ_COMPRESS_MAX_BLOCK));
+        index = (uint32_t *)malloc(sizeof(uint32_t) * (block_count + 1));
+        if (raw == NULL || packed == NULL || index == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        out_fd = openat(dir_fd, tmp_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out_fd < 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_CREATE;
+            break;
+        }
+        tmp_created = true;
+
+        uint32_t out_offset = 0;
+        for (uint32_t b = 0; b < block_count && ret == LZ_LOG_SUCCESS; b++)
+        {
+            uint32_t pos = b * LZ_COMPRESS_MAX_BLOCK;
+            uint32_t len = used - pos < LZ_COMPRESS_MAX_BLOCK ? used - pos : LZ_COMPRESS_MAX_BLOCK;
+
+            if (!compress_read_full(fd, raw, len, pos))
+            {
+                ret = LZ_LOG_ERROR_FILE_OPEN;
+                break;
+            }
+            if (encrypted && lz_crypto_process(&src_crypto, raw, raw, len, pos) != 0)
+            {
+                ret = LZ_LOG_ERROR_SYSTEM;
+                break;
+            }
+
+            // 压缩后不变小的块原样存储
+            uint32_t packed_len = lz_compress_block(raw, len, packed, len);
+            uint8_t *payload = packed_len > 0 ? packed : raw;
+            uint32_t payload_len = packed_len > 0 ? packed_len : len;
+
+            lz_compress_block_header_t header;
+            memset(&header, 0, sizeof(header));
+            header.stored_size = payload_len | (packed_len > 0 ? 0 : LZ_COMPRESS_BLOCK_STORED);
+            header.raw_size = len;
+
+            uint64_t payload_offset = (uint64_t)out_offset + LZ_COMPRESS_BLOCK_HEADER_SIZE;
+            if (encrypted && lz_crypto_process(&dst_crypto, payload, payload, payload_len, payload_offset) != 0)
+            {
+                ret = LZ_LOG_ERROR_SYSTEM;
+                break;
+            }
+
+            if (!compress_write_full(out_fd, &header, LZ_COMPRESS_BLOCK_HEADER_SIZE) ||
+                !compress_write_full(out_fd, payload, payload_len))
+            {
+                ret = LZ_LOG_ERROR_FILE_WRITE;
+                break;
+            }
+
+            index[b] = out_offset;
+            out_offset += LZ_COMPRESS_BLOCK_HEADER_SIZE + payload_len;
+        }
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        // [块索引][扩展区][footer]
+        uint32_t ext[4] = {LZ_COMPRESS_MAX_BLOCK, block_count, out_offset,
+                           encrypted ? LZ_COMPRESS_FLAG_ENCRYPTED : 0};
+        uint32_t new_size = out_offset + block_count * (uint32_t)sizeof(uint32_t) +
+                            LZ_COMPRESS_EXT_SIZE + LZ_LOG_FOOTER_SIZE;
+        compress_build_footer(footer, encrypted ? new_salt : NULL, LZ_LOG_MAGIC_ENDZ, new_size, out_offset);
+
+        if (!compress_write_full(out_fd, index, block_count * sizeof(uint32_t)) ||
+            !compress_write_full(out_fd, ext, sizeof(ext)) ||
+            !compress_write_full(out_fd, footer, sizeof(footer)))
+        {
+            ret = LZ_LOG_ERROR_FILE_WRITE;
+            break;
+        }
+
+        // 保留原文件的修改时间：清单重建时按它排序同一天的文件
+#if defined(__APPLE__)
+        struct timespec times[2] = {st.st_atimespec, st.st_mtimespec};
+#else
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+#endif
+        futimens(out_fd, times);
+
+        if (fdatasync(out_fd) != 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_WRITE;
+            break;
+        }
+
+        close(out_fd);
+        out_fd = -1;
+
+        // 原子替换：中途崩溃时原文件保持完整
+        if (renameat(dir_fd, tmp_name, dir_fd, name) != 0)
+        {
+            ret = LZ_LOG_ERROR_SYSTEM;
+            break;
+        }
+        tmp_created = false;
+        fsync(dir_fd);
+
+        *out_file_size = new_size;
+        *out_used = out_offset;
+
+    } while (0);
+
+    if (ret != LZ_LOG_SUCCESS)
+    {
+        LZ_DEBUG_LOG("Failed to compress %s: %d (errno=%d)", name != NULL ? name : "", ret, errno);
+    }
+
+    if (out_fd >= 0)
+    {
+        close(out_fd);
+    }
+    if (tmp_created)
+    {
+        unlinkat(dir_fd, tmp_name, 0);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    lz_crypto_cleanup(&src_crypto);
+    lz_crypto_cleanup(&dst_crypto);
+    free(raw);
+    free(packed);
+    free(index);
+
+    return ret;
+}
+
+lz_log_error_t lz_decompress_segment(const char *src_path,
+                                     const char *encrypt_key,
+                                     const char *dst_path)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    int fd = -1;
+    int out_fd = -1;
+    uint8_t *raw = NULL;
+    uint8_t *packed = NULL;
+    uint32_t *index = NULL;
+    lz_crypto_context_t src_crypto;
+    lz_crypto_context_t dst_crypto;
+    memset(&src_crypto, 0, sizeof(src_crypto));
+    memset(&dst_crypto, 0, sizeof(dst_crypto));
+
+    uint8_t footer[LZ_LOG_FOOTER_SIZE];
+    uint8_t new_salt[LZ_LOG_SALT_SIZE];
+
+    do
+    {
+        if (src_path == NULL || dst_path == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        fd = open(src_path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_NOT_FOUND;
+            break;
+        }
+
+        struct stat st;
+        uint32_t ext[4];
+        if (fstat(fd, &st) != 0 || st.st_size < LZ_LOG_FOOTER_SIZE + LZ_COMPRESS_EXT_SIZE ||
+            !compress_read_full(fd, footer, sizeof(footer), st.st_size - LZ_LOG_FOOTER_SIZE) ||
+            !compress_read_full(fd, ext, sizeof(ext), st.st_size - LZ_LOG_FOOTER_SIZE - LZ_COMPRESS_EXT_SIZE))
+        {
+            ret = LZ_LOG_ERROR_FILE_OPEN;
+            break;
+        }
+
+        uint32_t magic = 0, stream_used = 0;
+        memcpy(&magic, footer + LZ_LOG_SALT_SIZE, sizeof(magic));
+        memcpy(&stream_used, footer + LZ_LOG_SALT_SIZE + 8, sizeof(stream_used));
+        uint32_t block_count = ext[1];
+        uint32_t index_offset = ext[2];
+        bool encrypted = (ext[3] & LZ_COMPRESS_FLAG_ENCRYPTED) != 0;
+
+        if (magic == LZ_LOG_MAGIC_ENDB)
+        {
+            // 尚未封存的块流：沿块头部建立索引
+            if (stream_used > (uint32_t)st.st_size - LZ_LOG_FOOTER_SIZE)
+            {
+                stream_used = (uint32_t)st.st_size - LZ_LOG_FOOTER_SIZE;
+            }
+            ret = compress_scan_stream(fd, stream_used, &index, &block_count, &index_offset);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                break;
+            }
+            encrypted = !compress_salt_is_zero(footer);
+        }
+        else if (magic != LZ_LOG_MAGIC_ENDZ || ext[0] > LZ_COMPRESS_MAX_BLOCK ||
+                 (uint64_t)index_offset + (uint64_t)block_count * sizeof(uint32_t) +
+                         LZ_COMPRESS_EXT_SIZE + LZ_LOG_FOOTER_SIZE != (uint64_t)st.st_size)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        if (encrypted)
+        {
+            if (encrypt_key == NULL || encrypt_key[0] == '\0')
+            {
+                ret = LZ_LOG_ERROR_INVALID_PARAM;
+                break;
+            }
+            if (lz_crypto_init(&src_crypto, encrypt_key, footer) != 0 ||
+                lz_crypto_next_salt(footer, LZ_CRYPTO_SALT_SNAPSHOT, new_salt) != 0 ||
+                lz_crypto_init(&dst_crypto, encrypt_key, new_salt) != 0)
+            {
+                ret = LZ_LOG_ERROR_SYSTEM;
+                break;
+            }
+        }
+
+        raw = (uint8_t *)malloc(LZ_COMPRESS_MAX_BLOCK);
+        packed = (uint8_t *)malloc(LZ_COMPRESS_MAX_BLOCK);
+        if (index == NULL)
+        {
+            index = (uint32_t *)malloc(sizeof(uint32_t) * (block_count + 1));
+            if (index != NULL &&
+                !compress_read_full(fd, index, block_count * sizeof(uint32_t), index_offset))
+            {
+                ret = LZ_LOG_ERROR_FILE_OPEN;
+                break;
+            }
+        }
+        if (raw == NULL || packed == NULL || index == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        out_fd = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out_fd < 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_CREATE;
+            break;
+        }
+
+        uint64_t out_offset = 0;
+        for (uint32_t b = 0; b < block_count; b++)
+        {
+            lz_compress_block_header_t header;
+            if (index[b] + (uint64_t)LZ_COMPRESS_BLOCK_HEADER_SIZE > index_offset ||
+                !compress_read_full(fd, &header, LZ_COMPRESS_BLOCK_HEADER_SIZE, index[b]))
+            {
+                ret = LZ_LOG_ERROR_FILE_OPEN;
+                break;
+            }
+
+            bool stored = (header.stored_size & LZ_COMPRESS_BLOCK_STORED) != 0;
+            uint32_t payload_len = header.stored_size & ~LZ_COMPRESS_BLOCK_STORED;
+            uint64_t payload_offset = (uint64_t)index[b] + LZ_COMPRESS_BLOCK_HEADER_SIZE;
+            if (header.raw_size > LZ_COMPRESS_MAX_BLOCK || payload_len > LZ_COMPRESS_MAX_BLOCK ||
+                (stored && payload_len != header.raw_size) ||
+                payload_offset + payload_len > index_offset)
+            {
+                ret = LZ_LOG_ERROR_INVALID_PARAM;
+                break;
+            }
+
+            uint8_t *payload = stored ? raw : packed;
+            if (!compress_read_full(fd, payload, payload_len, (off_t)payload_offset))
+            {
+                ret = LZ_LOG_ERROR_FILE_OPEN;
+                break;
+            }
+            if (encrypted && payload_len > 0 &&
+                lz_crypto_process(&src_crypto, payload, payload, payload_len, payload_offset) != 0)
+            {
+                ret = LZ_LOG_ERROR_SYSTEM;
+                break;
+            }
+            if (!stored && lz_decompress_block(packed, payload_len, raw, header.raw_size) != 0)
+            {
+                LZ_DEBUG_LOG("Corrupted block %u in %s", b, src_path);
+                ret = LZ_LOG_ERROR_INVALID_PARAM;
+                break;
+            }
+
+            // 输出为普通日志文件，计数器使用原文偏移
+            if (encrypted && header.raw_size > 0 &&
+                lz_crypto_process(&dst_crypto, raw, raw, header.raw_size, out_offset) != 0)
+            {
+                ret = LZ_LOG_ERROR_SYSTEM;
+                break;
+            }
+            if (!compress_write_full(out_fd, raw, header.raw_size))
+            {
+                ret = LZ_LOG_ERROR_FILE_WRITE;
+                break;
+            }
+            out_offset += header.raw_size;
+        }
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        uint32_t used = (uint32_t)out_offset;
+        compress_build_footer(footer, encrypted ? new_salt : NULL, LZ_LOG_MAGIC_ENDX,
+                              used + LZ_LOG_FOOTER_SIZE, used);
+        if (!compress_write_full(out_fd, footer, sizeof(footer)))
+        {
+            ret = LZ_LOG_ERROR_FILE_WRITE;
+            break;
+        }
+
+    } while (0);
+
+    if (out_fd >= 0)
+    {
+        close(out_fd);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            unlink(dst_path);
+        }
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    lz_crypto_cleanup(&src_crypto);
+    lz_crypto_cleanup(&dst_crypto);
+    free(raw);
+    free(packed);
+    free(index);
+
+    return ret;
+}
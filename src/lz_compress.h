@@ -0,0 +1,142 @@
+#ifndef LZ_COMPRESS_H
+#define LZ_COMPRESS_H
+
+#include "lz_logger.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 块压缩（LZ4 block 格式）
+// ============================================================================
+/*
+ * 自带的 LZ4 block 格式编解码实现，不依赖系统库：
+ * - 压缩：单路哈希表（4096 项）贪心匹配，未命中时按距离加速跳过，速度优先
+ * - 输出为标准 LZ4 block（无帧头），可用任意 LZ4 实现的 block 解码函数解压
+ * - 单块最大 LZ_COMPRESS_MAX_BLOCK 字节，保证匹配偏移不超过 16 位
+ */
+
+/** 单块最大输入长度 */
+#define LZ_COMPRESS_MAX_BLOCK (64 * 1024)
+
+/**
+ * 压缩输出缓冲区的最坏情况大小
+ * @param src_len 输入长度
+ */
+#define LZ_COMPRESS_BOUND(src_len) ((src_len) + (src_len) / 255 + 16)
+
+/**
+ * 压缩一个块
+ * @param src 输入数据
+ * @param src_len 输入长度（不超过 LZ_COMPRESS_MAX_BLOCK）
+ * @param dst 输出缓冲区
+ * @param dst_cap 输出缓冲区大小
+ * @return 压缩后长度；输出放不下或参数无效时返回 0（调用者应原样存储）
+ */
+uint32_t lz_compress_block(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_cap);
+
+/**
+ * 解压一个块
+ * @param src 压缩数据
+ * @param src_len 压缩数据长度
+ * @param dst 输出缓冲区
+ * @param dst_len 期望的解压长度（即输出缓冲区大小）
+ * @return 成功返回 0，数据损坏或长度不符返回 -1
+ */
+int lz_decompress_block(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len);
+
+// ============================================================================
+// 压缩段文件格式（魔数 EndZ）
+// ============================================================================
+/*
+ * [块 0][块 1]...[块 N-1]      每块：块头部 24 字节 + 负载
+ * [块索引 N × 4 字节]          每块在文件中的偏移
+ * [扩展区 16 字节]             块大小、块数、块索引偏移、标记
+ * [footer 28 字节]             盐、魔数 EndZ、文件大小、已用大小（= 块索引偏移）
+ *
+ * - 每块最多 LZ_COMPRESS_MAX_BLOCK 字节原文，独立压缩，可随机访问、并行解压
+ * - 压缩后不变小的块原样存储（stored_size 最高位置 1）
+ * - 加密时先压缩再加密：只加密负载，计数器使用负载在文件中的偏移，
+ *   盐为压缩时新生成的（不与原文件复用密钥流）；块头部、块索引和扩展区为明文
+ *
+ * 写入时压缩（LZ_LOG_COMPRESS_INLINE）的文件在写入期间是块流（魔数 EndB）：
+ * 预分配的数据区内连续存放块，footer 与普通文件相同；读取方沿块头部遍历到已用大小。
+ * 封存后在数据末尾补写块索引和扩展区并截断，变为 EndZ（写入时已为此预留空间）。
+ */
+
+/** 块头部大小 */
+#define LZ_COMPRESS_BLOCK_HEADER_SIZE 24
+
+/** stored_size 最高位：负载为原文 */
+#define LZ_COMPRESS_BLOCK_STORED 0x80000000u
+
+/** 扩展区大小（块大小4字节 + 块数4字节 + 块索引偏移4字节 + 标记4字节） */
+#define LZ_COMPRESS_EXT_SIZE 16
+
+/** 扩展区标记：负载已加密 */
+#define LZ_COMPRESS_FLAG_ENCRYPTED 0x1
+
+/** 块头部 */
+typedef struct lz_compress_block_header_t
+{
+    uint32_t stored_size; // 负载大小（最高位为 LZ_COMPRESS_BLOCK_STORED）
+    uint32_t raw_size;    // 原文大小
+    uint64_t first_ms;    // 块内第一条记录的时间（Unix 毫秒，未知为 0）
+    uint64_t last_ms;     // 块内最后一条记录的时间（Unix 毫秒，未知为 0）
+} lz_compress_block_header_t;
+
+/**
+ * 块流（EndB）封存时需要在数据之后预留的空间
+ * @param block_count 块数
+ */
+#define LZ_COMPRESS_TRAILER_SIZE(block_count) \
+    ((block_count) * (uint32_t)sizeof(uint32_t) + LZ_COMPRESS_EXT_SIZE + LZ_LOG_FOOTER_SIZE)
+
+/**
+ * 把块流文件（EndB）原地封存为压缩段文件（EndZ）：补写块索引、扩展区和 footer 后截断
+ * @param fd 可读写的文件描述符
+ * @param footer 文件当前的 footer（28 字节）
+ * @param out_file_size 输出封存后的文件大小
+ * @param out_used 输出封存后的已用大小（块索引偏移）
+ * @return 错误码
+ * @note 崩溃留下的不完整块被丢弃
+ */
+lz_log_error_t lz_compress_seal_stream(int fd,
+                                       const uint8_t *footer,
+                                       uint32_t *out_file_size,
+                                       uint32_t *out_used);
+
+/**
+ * 把已封存的普通日志文件（EndX）压缩为压缩段文件（EndZ）
+ * @param dir_fd 日志目录 fd
+ * @param name 文件名（先写入 name.tmp，落盘后原子替换原文件；块流文件原地封存）
+ * @param encrypt_key 加密密钥（原文件未加密时忽略；原文件已加密时必须提供）
+ * @param out_file_size 输出压缩后的文件大小
+ * @param out_used 输出压缩后的已用大小（块索引偏移）
+ * @return 错误码
+ * @note 原文件盐为全 0 视为未加密
+ */
+lz_log_error_t lz_compress_segment(int dir_fd,
+                                   const char *name,
+                                   const char *encrypt_key,
+                                   uint32_t *out_file_size,
+                                   uint32_t *out_used);
+
+/**
+ * 把压缩段文件（EndZ / EndB）还原为普通日志文件（EndX）
+ * @param src_path 压缩段文件路径
+ * @param encrypt_key 加密密钥（压缩段已加密时必须提供，输出用新盐加密）
+ * @param dst_path 输出文件路径（已存在则覆盖）
+ * @return 错误码
+ */
+lz_log_error_t lz_decompress_segment(const char *src_path,
+                                     const char *encrypt_key,
+                                     const char *dst_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_COMPRESS_H
@@ -10,10 +10,10 @@ extern "C" {
 #endif
 
 // ============================================================================
-// AES-CTR 加密模块
+// 加密模块 (AES-256-CTR / ChaCha20)
 // ============================================================================
 
-/** AES 密钥长度 (256-bit) */
+/** 密钥长度 (256-bit, AES-256 与 ChaCha20 相同) */
 #define LZ_CRYPTO_KEY_SIZE 32
 
 /** AES 块大小 */
@@ -25,11 +25,67 @@ extern "C" {
 /** PBKDF2 迭代次数 */
 #define LZ_CRYPTO_PBKDF2_ITERATIONS 10000
 
+/**
+ * 段盐 (版本 2, 16 字节): [标记 "LZK2" 4字节][主盐 8字节][段编号 4字节, 大端]
+ * - 标记同时表示该段的流密码: "LZK2" 为 AES-256-CTR, "LZC2" 为 ChaCha20
+ * - 主密钥 = PBKDF2(密码, 标记 + 主盐 + 4 字节 0), 同一主盐的所有段共用, 进程内缓存
+ * - 段密钥 = HKDF-SHA256(主密钥, salt = 段盐, info = LZ_CRYPTO_HKDF_INFO)
+ * - 日志段的段编号依次递增 (最高位为 0); 压缩副本置最高位; 快照不沿用主盐, 使用新的随机主盐和段编号
+ * 不带标记的非零盐为旧版格式: 密钥 = PBKDF2(密码, 盐), 所有段共用一个密钥
+ */
+#define LZ_CRYPTO_SALT_TAG "LZK2"
+#define LZ_CRYPTO_SALT_TAG_CHACHA20 "LZC2"
+#define LZ_CRYPTO_SALT_TAG_SIZE 4
+#define LZ_CRYPTO_MASTER_SALT_SIZE 8
+#define LZ_CRYPTO_SEGMENT_COPY 0x80000000u
+
+/** HKDF 的 info 参数 */
+#define LZ_CRYPTO_HKDF_INFO "lz_logger segment key"
+
+/** ChaCha20 块大小 (计数器 = 偏移 / 64, 64 位; nonce 为 0, 每段密钥不同) */
+#define LZ_CRYPTO_CHACHA20_BLOCK_SIZE 64
+
+/** 每次批量生成的密钥流块数 */
+#define LZ_CRYPTO_BATCH_BLOCKS 16
+
+/** AES-CTR 实现 */
+typedef enum {
+    LZ_CRYPTO_BACKEND_AUTO = 0,     // 按 CPU 特性自动选择
+    LZ_CRYPTO_BACKEND_SYSTEM = 1,   // 系统库 (CommonCrypto / OpenSSL; Android 为 Java Crypto API, 只在手动指定时使用)
+    LZ_CRYPTO_BACKEND_AESNI = 2,    // 内置 x86 AES-NI
+    LZ_CRYPTO_BACKEND_VAES = 3,     // 内置 x86 VAES + AVX2
+    LZ_CRYPTO_BACKEND_ARMV8 = 4,    // 内置 ARMv8 Crypto Extensions
+    LZ_CRYPTO_BACKEND_PORTABLE = 5  // 内置可移植 C 实现 (查表, 没有 AES 指令时 Android 默认使用)
+} lz_crypto_backend_t;
+
+/** 流密码 (记录在段盐的标记中, 解密时按标记选择) */
+typedef enum {
+    LZ_CRYPTO_CIPHER_AES_CTR = 0,   // AES-256-CTR (默认)
+    LZ_CRYPTO_CIPHER_CHACHA20 = 1   // ChaCha20 (没有 AES 指令的 CPU 上更快, 且没有查表的缓存计时问题)
+} lz_crypto_cipher_t;
+
+/** ChaCha20 实现 */
+typedef enum {
+    LZ_CRYPTO_CHACHA_AUTO = 0,      // 按 CPU 特性自动选择
+    LZ_CRYPTO_CHACHA_PORTABLE = 1,  // 可移植 C 实现
+    LZ_CRYPTO_CHACHA_AVX2 = 2,      // x86 AVX2, 每次 8 块
+    LZ_CRYPTO_CHACHA_NEON = 3       // ARM NEON, 每次 4 块
+} lz_crypto_chacha_backend_t;
+
+/** 由已有段盐派生新段盐的用途 */
+typedef enum {
+    LZ_CRYPTO_SALT_NEXT = 0,     // 下一个日志段 (段编号 +1)
+    LZ_CRYPTO_SALT_COPY = 1,     // 该段的压缩副本 (段编号置最高位; 每个段只压缩一次)
+    LZ_CRYPTO_SALT_SNAPSHOT = 2  // 快照 (新的随机主盐和段编号, 初始化时需要执行一次 PBKDF2)
+} lz_crypto_salt_kind_t;
+
 /** 加密上下文 */
 typedef struct lz_crypto_context_t {
-    uint8_t key[LZ_CRYPTO_KEY_SIZE];     // AES-256 密钥
+    uint8_t key[LZ_CRYPTO_KEY_SIZE];     // 段密钥
+    lz_crypto_cipher_t cipher;            // 流密码 (由段盐的标记决定)
     uint8_t *salt_ptr;                    // 盐值指针(指向mmap文件尾部)
     bool is_initialized;                  // 是否已初始化
+    uint64_t key_id;                      // 密钥编号(每次初始化唯一,线程缓存据此判断是否需要重新展开密钥)
 } lz_crypto_context_t;
 
 /**
@@ -51,8 +107,9 @@ int lz_crypto_derive_key(
  * 初始化加密上下文
  * @param ctx 加密上下文
  * @param password 用户密码 (NULL 表示不加密)
- * @param salt 盐值 (NULL 则自动生成)
+ * @param salt 段盐 (版本 2 派生段密钥, 旧版直接作为 PBKDF2 的盐)
  * @return 成功返回 0, 失败返回 -1
+ * @note 主密钥未缓存时执行一次 PBKDF2 (移动设备上约数十毫秒), 否则只需两次 HMAC
  */
 int lz_crypto_init(
     lz_crypto_context_t *ctx,
@@ -61,7 +118,7 @@ int lz_crypto_init(
 );
 
 /**
- * AES-CTR 加密/解密 (流式操作)
+ * 加密/解密 (流式操作, 按上下文的流密码选择 AES-CTR 或 ChaCha20)
  * @param ctx 加密上下文
  * @param input 输入数据
  * @param output 输出数据 (可与 input 相同,原地操作)
@@ -69,7 +126,12 @@ int lz_crypto_init(
  * @param offset 文件偏移量 (用于计算 counter)
  * @return 成功返回 0, 失败返回 -1
  * 
- * 注意: AES-CTR 加密和解密是同一个操作 (XOR)
+ * 注意: 两种流密码的加密和解密都是同一个操作 (XOR), 都可以从任意偏移开始
+ * 注意: ChaCha20 的块号 = 偏移 / 64 (64 位计数器), 按 CPU 特性使用 AVX2 / NEON / 可移植实现
+ * 注意: 优先使用内置的 AES-NI / VAES / ARMv8 实现 (运行时按 CPU 特性选择), 否则使用系统库
+ *       (Android 使用内置可移植实现, 不经过 JNI);
+ *       每个线程缓存一份已展开密钥的 AES 状态, 每次调用只按偏移重新计算计数器;
+ *       记录末尾不满一块的密钥流留在线程缓存中, 下一次从同一块中间开始时直接复用
  */
 int lz_crypto_process(
     lz_crypto_context_t *ctx,
@@ -80,11 +142,67 @@ int lz_crypto_process(
 );
 
 /**
- * 生成随机盐值
+ * 生成新的段盐 (随机主盐 + 随机起始段编号)
+ * @param cipher 流密码 (写入段盐的标记, 由该盐派生的段沿用)
  * @param salt 输出盐值 (16字节)
  * @return 成功返回 0, 失败返回 -1
  */
-int lz_crypto_generate_salt(uint8_t *salt);
+int lz_crypto_generate_salt(lz_crypto_cipher_t cipher, uint8_t *salt);
+
+/**
+ * 沿用已有段盐的主盐和流密码派生新段盐 (初始化时不需要再执行 PBKDF2; 快照只沿用流密码)
+ * @param salt 已有段盐 (旧版盐时生成新的主盐, 使用 AES-CTR)
+ * @param kind 用途
+ * @param out_salt 输出盐值 (16字节, 可与 salt 相同)
+ * @return 成功返回 0, 失败返回 -1
+ */
+int lz_crypto_next_salt(const uint8_t *salt, lz_crypto_salt_kind_t kind, uint8_t *out_salt);
+
+/**
+ * 获取盐的版本
+ * @param salt 盐值 (16字节)
+ * @return 0: 全 0 (未加密); 1: 旧版; 2: 段盐
+ */
+int lz_crypto_salt_version(const uint8_t *salt);
+
+/**
+ * 获取段盐记录的流密码
+ * @param salt 盐值 (16字节)
+ * @return 流密码 (旧版盐为 AES-CTR)
+ */
+lz_crypto_cipher_t lz_crypto_salt_cipher(const uint8_t *salt);
+
+/**
+ * 主密钥是否已缓存 (为 true 时 lz_crypto_init 不需要执行 PBKDF2)
+ * @param password 用户密码
+ * @param salt 段盐
+ * @return 已缓存或不需要加密返回 true
+ */
+bool lz_crypto_key_cached(const char *password, const uint8_t *salt);
+
+/**
+ * 清空进程内缓存的主密钥 (之后的 lz_crypto_init 重新执行 PBKDF2)
+ */
+void lz_crypto_clear_cache(void);
+
+/**
+ * 登记一个使用该密码的句柄 (有引用时 lz_crypto_init 才缓存主密钥)
+ * @param password 用户密码 (NULL 或空串时忽略)
+ */
+void lz_crypto_cache_retain(const char *password);
+
+/**
+ * 释放 lz_crypto_cache_retain 的引用; 最后一个引用释放时安全擦除该密码缓存的所有主密钥
+ * @param password 用户密码 (NULL 或空串时忽略)
+ */
+void lz_crypto_cache_release(const char *password);
+
+/**
+ * 安全擦除内存 (不会被编译器优化掉)
+ * @param ptr 地址
+ * @param len 字节数
+ */
+void lz_crypto_secure_zero(void *ptr, size_t len);
 
 /**
  * 清理加密上下文 (安全擦除密钥)
@@ -92,6 +210,54 @@ int lz_crypto_generate_salt(uint8_t *salt);
  */
 void lz_crypto_cleanup(lz_crypto_context_t *ctx);
 
+/**
+ * 指定 AES-CTR 实现 (默认首次加密时按 CPU 特性自动选择)
+ * @param backend 实现 (AUTO 表示重新自动选择)
+ * @return 成功返回 0, 未编译或 CPU 不支持返回 -1
+ * @note 各实现输出逐字节一致, 主要用于基准测试和排查问题
+ */
+int lz_crypto_set_backend(lz_crypto_backend_t backend);
+
+/**
+ * 获取当前使用的 AES-CTR 实现
+ * @return 实现 (不会返回 AUTO)
+ */
+lz_crypto_backend_t lz_crypto_get_backend(void);
+
+/**
+ * 获取实现名称
+ * @param backend 实现
+ * @return 名称字符串 (静态存储)
+ */
+const char *lz_crypto_backend_name(lz_crypto_backend_t backend);
+
+/**
+ * CPU 是否有可用的 AES 指令 (AES-NI / ARMv8 Crypto Extensions)
+ * @return 有则返回 true (没有时 AES-CTR 使用查表实现或系统库, 可考虑使用 ChaCha20)
+ */
+bool lz_crypto_has_aes_hardware(void);
+
+/**
+ * 指定 ChaCha20 实现 (默认首次加密时按 CPU 特性自动选择)
+ * @param backend 实现 (AUTO 表示重新自动选择)
+ * @return 成功返回 0, 未编译或 CPU 不支持返回 -1
+ * @note 各实现输出逐字节一致, 主要用于基准测试和排查问题
+ */
+int lz_crypto_set_chacha_backend(lz_crypto_chacha_backend_t backend);
+
+/**
+ * 获取当前使用的 ChaCha20 实现
+ * @return 实现 (不会返回 AUTO)
+ */
+lz_crypto_chacha_backend_t lz_crypto_get_chacha_backend(void);
+
+/**
+ * 获取 ChaCha20 实现名称
+ * @param backend 实现
+ * @return 名称字符串 (静态存储)
+ */
+const char *lz_crypto_chacha_backend_name(lz_crypto_chacha_backend_t backend);
+
 #if defined(__ANDROID__)
 // Android JNI 初始化函数 (从 lz_logger_jni.cpp 的 JNI_OnLoad 调用)
 #include <jni.h>
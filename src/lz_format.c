@@ -0,0 +1,576 @@
+#include "lz_format.h"
+#include "lz_numfmt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+// ============================================================================
+// 字段
+// ============================================================================
+
+static const char *const g_level_names[LZ_LOG_LEVEL_COUNT] = {
+    "VERBOSE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL",
+};
+
+const char *lz_format_level_name(lz_log_level_t level)
+{
+    return ((unsigned)level < LZ_LOG_LEVEL_COUNT) ? g_level_names[level] : "UNKNOWN";
+}
+
+/** 写入两位十进制数（value < 100） */
+static inline void format_2digits(char *out, unsigned value)
+{
+    memcpy(out, lz_numfmt_digit_pairs + value * 2, 2);
+}
+
+/** 写入三位十进制数（value < 1000） */
+static inline void format_3digits(char *out, unsigned value)
+{
+    out[0] = (char)('0' + value / 100);
+    format_2digits(out + 1, value % 100);
+}
+
+// ============================================================================
+// 时间戳
+// ============================================================================
+/*
+ * 每个线程缓存当前这一分钟的前缀 "yyyy-MM-dd HH:mm:"，只有跨分钟（或时钟回拨）时
+ * 才调用 localtime_r（可能持有时区锁）重新生成；秒和毫秒查表写入。
+ * 时钟使用 CLOCK_REALTIME_COARSE（vDSO 直接读取，不进入内核），毫秒位的精度为时钟节拍
+ * （通常 1 ~ 4ms），同一节拍内的调用直接复制上次的结果；
+ * 没有粗粒度时钟的平台（Apple）使用 CLOCK_REALTIME。
+ */
+
+#define TIMESTAMP_PREFIX_SIZE 17 // "yyyy-MM-dd HH:mm:"
+
+typedef struct
+{
+    int64_t last_sec;                    // 上次读到的时钟
+    long last_nsec;                      // （-1 表示无）
+    int64_t minute_start;                // text 中前缀对应分钟的起始 Unix 秒
+    int64_t minute_end;                  // minute_start + 60（0 表示前缀无效）
+    char text[LZ_FORMAT_TIMESTAMP_SIZE]; // 上次的完整时间戳，不含结尾 0
+} timestamp_cache_t;
+
+static _Thread_local timestamp_cache_t t_timestamp_cache = {.last_nsec = -1};
+
+/**
+ * 重新生成本线程缓存的分钟前缀
+ * @param cache 本线程的缓存
+ * @param sec 当前 Unix 秒
+ */
+static void timestamp_cache_refresh(timestamp_cache_t *cache, int64_t sec)
+{
+    struct tm tm_info;
+    time_t t = (time_t)sec;
+    localtime_r(&t, &tm_info);
+
+    char *out = cache->text;
+    unsigned year = (unsigned)(tm_info.tm_year + 1900);
+    format_2digits(out, year / 100 % 100);
+    format_2digits(out + 2, year % 100);
+    out[4] = '-';
+    format_2digits(out + 5, (unsigned)(tm_info.tm_mon + 1));
+    out[7] = '-';
+    format_2digits(out + 8, (unsigned)tm_info.tm_mday);
+    out[10] = ' ';
+    format_2digits(out + 11, (unsigned)tm_info.tm_hour);
+    out[13] = ':';
+    format_2digits(out + 14, (unsigned)tm_info.tm_min);
+    out[16] = ':';
+    out[19] = '.';
+
+    // 闰秒时 tm_sec 可能为 60，按 59 处理，下一秒重新生成
+    int tm_sec = tm_info.tm_sec < 60 ? tm_info.tm_sec : 59;
+    cache->minute_start = sec - tm_sec;
+    cache->minute_end = cache->minute_start + 60;
+}
+
+size_t lz_format_timestamp(char *out)
+{
+    struct timespec ts;
+#if defined(CLOCK_REALTIME_COARSE)
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+    int64_t sec = (int64_t)ts.tv_sec;
+
+    // yyyy-MM-dd HH:mm:ss.SSS
+    timestamp_cache_t *cache = &t_timestamp_cache;
+    if (ts.tv_nsec != cache->last_nsec || sec != cache->last_sec)
+    {
+        if (sec < cache->minute_start || sec >= cache->minute_end)
+        {
+            timestamp_cache_refresh(cache, sec);
+        }
+        format_2digits(cache->text + 17, (unsigned)(sec - cache->minute_start));
+        format_3digits(cache->text + 20, (unsigned)(ts.tv_nsec / 1000000));
+        cache->last_sec = sec;
+        cache->last_nsec = ts.tv_nsec;
+    }
+    memcpy(out, cache->text, LZ_FORMAT_TIMESTAMP_SIZE);
+    return LZ_FORMAT_TIMESTAMP_SIZE;
+}
+
+// ============================================================================
+// 线程标识
+// ============================================================================
+/*
+ * 线程 ID 每个线程只读取一次（Linux 上 gettid 是一次系统调用），与线程名和预先拼好的线程字段
+ * 一起缓存在线程局部变量中。fork 后子进程里的线程 ID 会变化而线程局部变量被原样复制：
+ * pthread_atfork 的子进程回调把全局的 fork 代数 +1，缓存的代数不同时重新读取。
+ */
+
+static atomic_uint g_fork_generation = 1;
+static pthread_once_t g_fork_once = PTHREAD_ONCE_INIT;
+static _Thread_local lz_format_thread_t t_thread;
+
+static void thread_after_fork_child(void)
+{
+    atomic_fetch_add_explicit(&g_fork_generation, 1, memory_order_relaxed);
+}
+
+static void thread_register_fork(void)
+{
+    pthread_atfork(NULL, NULL, thread_after_fork_child);
+}
+
+/** 向系统查询当前线程 ID */
+static uint64_t thread_query_id(void)
+{
+#if defined(__APPLE__)
+    uint64_t tid = 0;
+    pthread_threadid_np(NULL, &tid);
+    return tid;
+#elif defined(__linux__)
+    return (uint64_t)syscall(SYS_gettid);
+#else
+    return (uint64_t)(uintptr_t)pthread_self();
+#endif
+}
+
+/** 重新拼接线程字段："tid" 或 "tid(name)" */
+static void thread_update_text(lz_format_thread_t *thread)
+{
+    size_t n = lz_numfmt_hex(thread->text, thread->tid);
+    if (thread->name_len > 0)
+    {
+        thread->text[n++] = '(';
+        memcpy(thread->text + n, thread->name, thread->name_len);
+        n += thread->name_len;
+        thread->text[n++] = ')';
+    }
+    thread->text_len = (uint8_t)n;
+}
+
+const lz_format_thread_t *lz_format_thread(void)
+{
+    lz_format_thread_t *thread = &t_thread;
+    unsigned generation = atomic_load_explicit(&g_fork_generation, memory_order_relaxed);
+    if (thread->generation != generation)
+    {
+        // 本线程第一次使用，或 fork 后的子进程
+        pthread_once(&g_fork_once, thread_register_fork);
+        thread->tid = thread_query_id();
+        thread->generation = generation;
+        thread_update_text(thread);
+    }
+    return thread;
+}
+
+uint64_t lz_format_thread_id(void)
+{
+    return lz_format_thread()->tid;
+}
+
+void lz_format_set_thread_name(const char *name)
+{
+    lz_format_thread_t *thread = (lz_format_thread_t *)lz_format_thread();
+    size_t len = name != NULL ? strnlen(name, LZ_FORMAT_THREAD_NAME_MAX + 1) : 0;
+    if (len > LZ_FORMAT_THREAD_NAME_MAX)
+    {
+        len = LZ_FORMAT_THREAD_NAME_MAX;
+    }
+    // 去掉结尾不完整的 UTF-8 字符（截断产生的或名称本身残缺的）
+    size_t lead = len;
+    while (lead > 0 && ((unsigned char)name[lead - 1] & 0xC0) == 0x80)
+    {
+        lead--;
+    }
+    if (lead > 0 && (unsigned char)name[lead - 1] >= 0xC0)
+    {
+        unsigned char ch = (unsigned char)name[lead - 1];
+        size_t need = ch >= 0xF0 ? 4 : (ch >= 0xE0 ? 3 : 2);
+        if (len - (lead - 1) < need)
+        {
+            len = lead - 1;
+        }
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char ch = (unsigned char)name[i];
+        thread->name[i] = (ch < 0x20 || ch == 0x7F) ? '?' : (char)ch;
+    }
+    thread->name[len] = '\0';
+    thread->name_len = (uint8_t)len;
+    thread->name_serial++;
+    thread_update_text(thread);
+}
+
+// ============================================================================
+// 整行拼接
+// ============================================================================
+
+/** 输出游标：超出容量的部分只计长度不写入 */
+typedef struct
+{
+    char *buf;
+    size_t cap;
+    size_t pos;
+} format_cursor_t;
+
+static void cursor_put(format_cursor_t *c, const char *src, size_t len)
+{
+    if (c->pos < c->cap)
+    {
+        size_t room = c->cap - c->pos;
+        memcpy(c->buf + c->pos, src, len < room ? len : room);
+    }
+    c->pos += len;
+}
+
+static void cursor_put_str(format_cursor_t *c, const char *s)
+{
+    cursor_put(c, s, strlen(s));
+}
+
+static void cursor_put_char(format_cursor_t *c, char ch)
+{
+    if (c->pos < c->cap)
+    {
+        c->buf[c->pos] = ch;
+    }
+    c->pos++;
+}
+
+/** 数值：剩余空间足够时直接写入缓冲，否则经临时缓冲按容量截取 */
+#define CURSOR_PUT_NUMBER(c, convert, value)                    \
+    do                                                          \
+    {                                                           \
+        if ((c)->pos + LZ_NUMFMT_MAX_SIZE <= (c)->cap)          \
+        {                                                       \
+            (c)->pos += convert((c)->buf + (c)->pos, value);    \
+        }                                                       \
+        else                                                    \
+        {                                                       \
+            char tmp_[LZ_NUMFMT_MAX_SIZE];                      \
+            cursor_put((c), tmp_, convert(tmp_, value));        \
+        }                                                       \
+    } while (0)
+
+/** 一个类型化参数 */
+static void cursor_put_arg(format_cursor_t *c, const lz_arg_t *arg)
+{
+    switch (arg->type)
+    {
+    case LZ_ARG_I64:
+        CURSOR_PUT_NUMBER(c, lz_numfmt_i64, arg->value.i64);
+        break;
+    case LZ_ARG_U64:
+        CURSOR_PUT_NUMBER(c, lz_numfmt_u64, arg->value.u64);
+        break;
+    case LZ_ARG_HEX:
+        CURSOR_PUT_NUMBER(c, lz_numfmt_hex, arg->value.u64);
+        break;
+    case LZ_ARG_F64:
+        CURSOR_PUT_NUMBER(c, lz_numfmt_f64, arg->value.f64);
+        break;
+    case LZ_ARG_STR:
+        if (arg->value.str == NULL)
+        {
+            cursor_put(c, "(null)", 6);
+        }
+        else if (arg->len < 0)
+        {
+            cursor_put_str(c, arg->value.str);
+        }
+        else
+        {
+            cursor_put(c, arg->value.str, (size_t)arg->len);
+        }
+        break;
+    default:
+        cursor_put(c, "{?}", 3);
+        break;
+    }
+}
+
+/** 按模板依次把 "{}" 替换为参数 */
+static void cursor_put_args(format_cursor_t *c, const char *fmt, const lz_arg_t *args, int32_t count)
+{
+    if (fmt == NULL)
+    {
+        return;
+    }
+    int32_t next = 0;
+    const char *p = fmt;
+    for (;;)
+    {
+        const char *brace = strchr(p, '{');
+        if (brace == NULL)
+        {
+            cursor_put_str(c, p);
+            return;
+        }
+        if (brace[1] == '}' && next < count)
+        {
+            cursor_put(c, p, (size_t)(brace - p));
+            cursor_put_arg(c, &args[next++]);
+        }
+        else
+        {
+            // 不是占位符，或参数已用完：原样输出
+            cursor_put(c, p, (size_t)(brace - p) + (brace[1] == '}' ? 2 : 1));
+        }
+        p = brace + (brace[1] == '}' ? 2 : 1);
+    }
+}
+
+/** 行首字段：时间戳 [LEVEL] T:tid [file:line] [func] [tag] */
+static void cursor_put_header(format_cursor_t *c, const lz_format_record_t *record)
+{
+    char timestamp[LZ_FORMAT_TIMESTAMP_SIZE];
+    cursor_put(c, timestamp, lz_format_timestamp(timestamp));
+    cursor_put(c, " [", 2);
+    cursor_put_str(c, lz_format_level_name(record->level));
+    cursor_put(c, "] T:", 4);
+    const lz_format_thread_t *thread = lz_format_thread();
+    cursor_put(c, thread->text, thread->text_len);
+    cursor_put(c, " [", 2);
+    cursor_put_str(c, (record->file && *record->file) ? record->file : "unknown");
+    if (record->line > 0)
+    {
+        cursor_put_char(c, ':');
+        CURSOR_PUT_NUMBER(c, lz_numfmt_u64, (uint64_t)record->line);
+    }
+    cursor_put(c, "] [", 3);
+    if (record->func && *record->func)
+    {
+        cursor_put_str(c, record->func);
+        cursor_put(c, "] [", 3);
+    }
+    cursor_put_str(c, record->tag ? record->tag : "");
+    cursor_put(c, "] ", 2);
+}
+
+/** 行尾换行和结尾 0，返回整行长度 */
+static int64_t cursor_finish_line(format_cursor_t *c)
+{
+    cursor_put_char(c, '\n');
+    if (c->pos < c->cap)
+    {
+        c->buf[c->pos] = '\0';
+    }
+    return (int64_t)c->pos;
+}
+
+int64_t lz_format_line(char *buf, size_t cap, const lz_format_record_t *record,
+                       const char *fmt, va_list args)
+{
+    format_cursor_t c = {buf, cap, 0};
+
+    cursor_put_header(&c, record);
+
+    // message：直接格式化到剩余空间（vsnprintf 会占用 1 字节写结尾 0，随后被换行覆盖）
+    size_t room = c.pos < c.cap ? c.cap - c.pos : 0;
+    int n = vsnprintf(room > 0 ? c.buf + c.pos : NULL, room, fmt ? fmt : "", args);
+    if (n < 0)
+    {
+        return -1;
+    }
+    c.pos += (size_t)n;
+    return cursor_finish_line(&c);
+}
+
+int64_t lz_format_line_args(char *buf, size_t cap, const lz_format_record_t *record,
+                            const char *fmt, const lz_arg_t *args, int32_t count)
+{
+    format_cursor_t c = {buf, cap, 0};
+    cursor_put_header(&c, record);
+    cursor_put_args(&c, fmt, args, count);
+    return cursor_finish_line(&c);
+}
+
+size_t lz_format_args(char *buf, size_t cap, const char *fmt, const lz_arg_t *args, int32_t count)
+{
+    format_cursor_t c = {buf, cap, 0};
+    cursor_put_args(&c, fmt, args, count);
+    return c.pos;
+}
+
+// ============================================================================
+// 线程局部格式化缓冲
+// ============================================================================
+
+typedef struct
+{
+    char *buf;
+    size_t cap;
+    bool busy;         // 已借出（重入时改用临时分配）
+    bool registered;   // 已登记线程退出时的释放回调
+    int64_t large_sec; // 最近一次用到超出初始大小部分的时间（单调时钟，秒）
+} scratch_state_t;
+
+static _Thread_local scratch_state_t t_scratch;
+static pthread_key_t g_scratch_key;
+static pthread_once_t g_scratch_once = PTHREAD_ONCE_INIT;
+static bool g_scratch_key_ready = false;
+
+/** 线程退出时释放（之后再次使用会重新分配并登记） */
+static void scratch_destroy(void *arg)
+{
+    scratch_state_t *state = (scratch_state_t *)arg;
+    free(state->buf);
+    state->buf = NULL;
+    state->cap = 0;
+    state->registered = false;
+}
+
+static void scratch_key_init(void)
+{
+    g_scratch_key_ready = (pthread_key_create(&g_scratch_key, scratch_destroy) == 0);
+}
+
+static int64_t scratch_now_sec(void)
+{
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC_COARSE)
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (int64_t)ts.tv_sec;
+}
+
+/** 把线程缓冲换成 cap 字节（不保留内容） */
+static bool scratch_resize(scratch_state_t *state, size_t cap)
+{
+    char *buf = (char *)malloc(cap);
+    if (buf == NULL)
+    {
+        return false;
+    }
+    free(state->buf);
+    state->buf = buf;
+    state->cap = cap;
+    if (!state->registered)
+    {
+        pthread_once(&g_scratch_once, scratch_key_init);
+        state->registered = g_scratch_key_ready && pthread_setspecific(g_scratch_key, state) == 0;
+    }
+    return true;
+}
+
+bool lz_format_scratch_acquire(lz_format_scratch_t *scratch)
+{
+    scratch_state_t *state = &t_scratch;
+    memset(scratch, 0, sizeof(*scratch));
+
+    // 扩大过的缓冲长时间没用到超出部分：借出前先缩回初始大小（缩小失败时沿用原缓冲）
+    if (!state->busy && state->cap > LZ_FORMAT_BUFFER_SIZE &&
+        scratch_now_sec() - state->large_sec >= LZ_FORMAT_SCRATCH_IDLE_SEC)
+    {
+        scratch_resize(state, LZ_FORMAT_BUFFER_SIZE);
+    }
+
+    if (!state->busy && (state->buf != NULL || scratch_resize(state, LZ_FORMAT_BUFFER_SIZE)))
+    {
+        state->busy = true;
+        scratch->data = state->buf;
+        scratch->cap = state->cap;
+        scratch->local = true;
+        return true;
+    }
+
+    // 重入（例如在信号处理函数中写日志）：临时分配
+    scratch->data = (char *)malloc(LZ_FORMAT_BUFFER_SIZE);
+    if (scratch->data == NULL)
+    {
+        return false;
+    }
+    scratch->cap = LZ_FORMAT_BUFFER_SIZE;
+    scratch->owned = true;
+    return true;
+}
+
+bool lz_format_scratch_reserve(lz_format_scratch_t *scratch, size_t size)
+{
+    if (size <= scratch->cap)
+    {
+        return true;
+    }
+
+    if (scratch->local && !scratch->owned && size <= LZ_FORMAT_SCRATCH_MAX)
+    {
+        scratch_state_t *state = &t_scratch;
+        size_t cap = state->cap;
+        while (cap < size)
+        {
+            cap *= 2;
+        }
+        if (cap > LZ_FORMAT_SCRATCH_MAX)
+        {
+            cap = LZ_FORMAT_SCRATCH_MAX;
+        }
+        if (!scratch_resize(state, cap))
+        {
+            return false;
+        }
+        scratch->data = state->buf;
+        scratch->cap = state->cap;
+        return true;
+    }
+
+    // 超过上限（或本来就是临时分配）：临时分配，归还时释放
+    char *buf = (char *)malloc(size);
+    if (buf == NULL)
+    {
+        return false;
+    }
+    if (scratch->owned)
+    {
+        free(scratch->data);
+    }
+    scratch->data = buf;
+    scratch->cap = size;
+    scratch->owned = true;
+    return true;
+}
+
+void lz_format_scratch_release(lz_format_scratch_t *scratch, size_t used)
+{
+    if (scratch->owned)
+    {
+        free(scratch->data);
+    }
+    if (scratch->local)
+    {
+        scratch_state_t *state = &t_scratch;
+        state->busy = false;
+        // 本次用到了超出初始大小的部分：记下时间（下次借用时据此判断是否缩回）
+        if (used > LZ_FORMAT_BUFFER_SIZE && state->cap > LZ_FORMAT_BUFFER_SIZE)
+        {
+            state->large_sec = scratch_now_sec();
+        }
+    }
+    memset(scratch, 0, sizeof(*scratch));
+}
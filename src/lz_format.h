@@ -0,0 +1,186 @@
+#ifndef LZ_FORMAT_H
+#define LZ_FORMAT_H
+
+#include "lz_logger.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 日志行格式化
+// ============================================================================
+/*
+ * 各平台封装（JNI nativeLog、Android / iOS 的 lz_logger_ffi、LZLogger.m）共用的行格式：
+ *
+ *   yyyy-MM-dd HH:mm:ss.SSS [LEVEL] T:线程ID(十六进制) [file:line] [func] [tag] message\n
+ *
+ * - 线程设置了名称（lz_logger_set_thread_name）时线程字段为 T:线程ID(名称)
+ *
+ * - line 为 0 时位置只有文件名；file 为空时为 "unknown"
+ * - func 为空时省略 [func] 字段
+ * - 时间戳、级别、线程 ID 和各字段由本模块直接拼接，只有 message 经过一次 vsnprintf
+ * - lz_logger_log_args 的消息由模板和类型化参数拼接，数值转换见 lz_numfmt.h
+ */
+
+/** 时间戳长度（"yyyy-MM-dd HH:mm:ss.SSS"，不含结尾 0） */
+#define LZ_FORMAT_TIMESTAMP_SIZE 23
+
+/** 格式化缓冲的初始大小（见 lz_format_scratch_acquire，超出时扩大，不截断） */
+#define LZ_FORMAT_BUFFER_SIZE 4096
+
+/** 一条日志的元信息 */
+typedef struct
+{
+    lz_log_level_t level; // 日志级别
+    const char *tag;      // 标签（可为 NULL）
+    const char *file;     // 文件名（可为 NULL，调用方只传文件名不带路径）
+    int line;             // 行号（0 表示不显示）
+    const char *func;     // 函数名（可为 NULL 或空串）
+} lz_format_record_t;
+
+/**
+ * 写入当前本地时间（每个线程缓存分钟前缀，只有跨分钟时调用 localtime_r；
+ * 时钟为 CLOCK_REALTIME_COARSE，毫秒位的精度为时钟节拍）
+ * @param out 输出缓冲（至少 LZ_FORMAT_TIMESTAMP_SIZE 字节，不写结尾 0）
+ * @return 写入的字节数（LZ_FORMAT_TIMESTAMP_SIZE）
+ */
+size_t lz_format_timestamp(char *out);
+
+/** 线程名的最大长度（字节，不含结尾 0，超出时按 UTF-8 字符边界截断） */
+#define LZ_FORMAT_THREAD_NAME_MAX 31
+
+/** 当前线程的标识（每个线程缓存一份，fork 后的子进程中第一次使用时重新读取线程 ID） */
+typedef struct
+{
+    uint64_t tid;                                  // 线程 ID
+    uint32_t generation;                           // 读取 tid 时的 fork 代数（0 表示尚未读取）
+    uint32_t name_serial;                          // 每次设置线程名时 +1（用于判断定义是否需要重新写入）
+    uint8_t name_len;                              // 线程名长度（0 表示未设置）
+    uint8_t text_len;                              // text 的长度
+    char name[LZ_FORMAT_THREAD_NAME_MAX + 1];      // 线程名（以 0 结尾）
+    char text[16 + LZ_FORMAT_THREAD_NAME_MAX + 2]; // 行格式中的线程字段（不含 "T:"）："1a2b" 或 "1a2b(name)"
+} lz_format_thread_t;
+
+/**
+ * 当前线程的标识（第一次调用时读取线程 ID，之后只读线程局部变量）
+ * @return 本线程的缓存（只在本线程内有效）
+ */
+const lz_format_thread_t *lz_format_thread(void);
+
+/**
+ * 获取当前线程 ID（Linux / Android 为 tid，Apple 为 pthread_threadid_np；每个线程缓存）
+ * @return 线程 ID
+ */
+uint64_t lz_format_thread_id(void);
+
+/**
+ * 设置当前线程的名称
+ * @param name 名称（NULL 或空串表示清除；控制字符替换为 '?'）
+ */
+void lz_format_set_thread_name(const char *name);
+
+/**
+ * 日志级别名称
+ * @param level 日志级别
+ * @return "VERBOSE" / "DEBUG" / "INFO" / "WARN" / "ERROR" / "FATAL"，超出范围为 "UNKNOWN"
+ */
+const char *lz_format_level_name(lz_log_level_t level);
+
+/**
+ * 格式化一条完整的日志行（含结尾换行）
+ * @param buf 输出缓冲（可为 NULL，此时 cap 必须为 0）
+ * @param cap 缓冲大小
+ * @param record 元信息
+ * @param fmt message 的格式串（printf 语法）
+ * @param args 格式化参数
+ * @return 日志行的完整长度（不含结尾 0）；返回值 < cap 时整行已写入并以 0 结尾，
+ *         否则只写入了前 cap 字节，需要用至少 返回值 + 1 字节的缓冲重新格式化；格式化失败返回 -1
+ */
+int64_t lz_format_line(char *buf, size_t cap, const lz_format_record_t *record,
+                       const char *fmt, va_list args);
+
+/**
+ * 按类型化参数格式化一条完整的日志行（含结尾换行；返回值和缓冲约定与 lz_format_line 相同）
+ * @param buf 输出缓冲（可为 NULL，此时 cap 必须为 0）
+ * @param cap 缓冲大小
+ * @param record 元信息
+ * @param fmt 消息模板（"{}" 依次替换为参数）
+ * @param args 参数数组
+ * @param count 参数个数
+ * @return 日志行的完整长度（不含结尾 0）
+ */
+int64_t lz_format_line_args(char *buf, size_t cap, const lz_format_record_t *record,
+                            const char *fmt, const lz_arg_t *args, int32_t count);
+
+/**
+ * 只格式化消息部分（不写结尾 0）
+ * @param buf 输出缓冲（可为 NULL，此时 cap 必须为 0）
+ * @param cap 缓冲大小
+ * @param fmt 消息模板（"{}" 依次替换为参数）
+ * @param args 参数数组
+ * @param count 参数个数
+ * @return 消息的完整长度；大于 cap 时只写入了前 cap 字节
+ */
+size_t lz_format_args(char *buf, size_t cap, const char *fmt, const lz_arg_t *args, int32_t count);
+
+// ============================================================================
+// 线程局部格式化缓冲
+// ============================================================================
+/*
+ * 日志行、行记录和二进制记录都先格式化到当前线程的缓冲中，缓冲跨调用复用：
+ *
+ * - 初始 LZ_FORMAT_BUFFER_SIZE 字节，放不下时按 2 倍扩大到所需大小后重新格式化一次，
+ *   之后同样长度的日志只格式化一次，不再分配内存
+ * - 保留的容量不超过 LZ_FORMAT_SCRATCH_MAX；更长的日志临时分配，写入后释放
+ * - 扩大后连续 LZ_FORMAT_SCRATCH_IDLE_SEC 秒没有用到超出初始大小的部分时缩回初始大小；线程退出时释放。
+ *   缩回只在该线程下一次借用缓冲（写日志）时进行，之后不再写日志的线程保留扩大的缓冲直到退出
+ * - 同一线程重入（缓冲正在使用）时临时分配，不会覆盖正在使用的内容
+ */
+
+/** 每个线程保留的缓冲上限（字节） */
+#define LZ_FORMAT_SCRATCH_MAX (1024 * 1024)
+
+/** 扩大的缓冲多久没用到超出部分后缩回初始大小（秒） */
+#define LZ_FORMAT_SCRATCH_IDLE_SEC 30
+
+/** 一次借用的缓冲 */
+typedef struct
+{
+    char *data;  // 缓冲
+    size_t cap;  // 容量
+    bool local;  // 借用的是线程缓冲（释放时归还）
+    bool owned;  // data 为临时分配（释放时 free）
+} lz_format_scratch_t;
+
+/**
+ * 借用当前线程的格式化缓冲
+ * @param scratch 输出：缓冲（容量至少 LZ_FORMAT_BUFFER_SIZE）
+ * @return 成功返回 true；内存不足返回 false（scratch 仍需传给 lz_format_scratch_release）
+ */
+bool lz_format_scratch_acquire(lz_format_scratch_t *scratch);
+
+/**
+ * 把借用的缓冲扩大到至少 size 字节（原有内容不保留）
+ * @param scratch 缓冲
+ * @param size 所需大小
+ * @return 成功返回 true；内存不足返回 false
+ */
+bool lz_format_scratch_reserve(lz_format_scratch_t *scratch, size_t size);
+
+/**
+ * 归还缓冲（未借用成功时只清理临时分配）
+ * @param scratch 缓冲
+ * @param used 本次实际用到的字节数（用于判断扩大的缓冲是否仍在使用）
+ */
+void lz_format_scratch_release(lz_format_scratch_t *scratch, size_t used);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_FORMAT_H
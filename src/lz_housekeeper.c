@@ -0,0 +1,516 @@
+#include "lz_housekeeper.h"
+#include "lz_compress.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#ifndef LZ_DEBUG_LOG
+#define LZ_DEBUG_LOG(fmt, ...)                                         \
+    fprintf(stderr, "[LZLogger] lz_housekeeper.c:%d %s() - " fmt "\n", \
+            __LINE__, __func__, ##__VA_ARGS__)
+#endif
+
+// ============================================================================
+// Internal Structures
+// ============================================================================
+
+/** 后台维护线程上下文 */
+struct lz_housekeeper_t
+{
+    lz_manifest_t *manifest;       // 目录清单（账本）
+    int dir_fd;                    // 日志目录 fd（openat / unlinkat 使用）
+    uint64_t max_bytes;            // 总大小上限（0 表示不限制）
+    uint32_t max_days;             // 保留天数（0 表示不限制）
+    bool compress;                 // 是否压缩已退役的段
+    char encrypt_key[256];         // 加密密钥副本（压缩加密的段时使用）
+    lz_manifest_entry_t *entries;  // 清单快照缓冲（LZ_MANIFEST_CAPACITY 项）
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint64_t active_seq;  // 当前写入的段序号（mutex 保护）
+    uint64_t retired_seq; // 小于它的段已退役（mutex 保护）
+    uint32_t swept_cutoff; // 上次扫描目录删除未跟踪文件时的截止日期（仅后台线程访问）
+    unsigned kicks;       // 通知计数（mutex 保护）
+    bool stop;            // 停止标记（mutex 保护）
+};
+
+// ============================================================================
+// Utility Functions
+// ============================================================================
+
+/**
+ * 降低当前线程的调度优先级
+ */
+static void housekeeper_lower_priority(void)
+{
+#if defined(__APPLE__)
+    pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+#elif defined(__linux__)
+    // Linux 的 nice 值按线程生效
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+#endif
+}
+
+/**
+ * 计算按天数保留的截止日期
+ * @return yyyymmdd，日期不晚于它的段过期（max_days 为 0 时返回 0）
+ */
+static uint32_t housekeeper_cutoff_date(uint32_t max_days)
+{
+    if (max_days == 0)
+    {
+        return 0;
+    }
+
+    time_t now = time(NULL);
+    struct tm tm_cutoff;
+    localtime_r(&now, &tm_cutoff);
+    tm_cutoff.tm_mday -= (int)max_days;
+    tm_cutoff.tm_hour = 12; // 使用中午12点避免夏令时问题
+    tm_cutoff.tm_isdst = -1;
+    if (mktime(&tm_cutoff) == -1)
+    {
+        return 0;
+    }
+
+    return (uint32_t)((tm_cutoff.tm_year + 1900) * 10000 +
+                      (tm_cutoff.tm_mon + 1) * 100 + tm_cutoff.tm_mday);
+}
+
+/**
+ * 压实一个已退役的段：footer 移到数据末尾并截断文件（写入时压缩的块流补写块索引）
+ * @param entry 清单条目
+ * @param out_file_size 输出压实后的文件大小
+ * @param out_used 输出已用大小
+ * @param out_compressed 输出文件是否为块流封存后的压缩段
+ * @return 文件是否已处于压实状态（需要更新清单）
+ */
+static bool housekeeper_compact(lz_housekeeper_t *hk, const lz_manifest_entry_t *entry,
+                                uint32_t *out_file_size, uint32_t *out_used, bool *out_compressed)
+{
+    bool compacted = false;
+    char name[64];
+    lz_manifest_build_name(entry, name, sizeof(name));
+
+    int fd = openat(hk->dir_fd, name, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    do
+    {
+        struct stat st;
+        uint8_t footer[LZ_LOG_FOOTER_SIZE];
+        if (fstat(fd, &st) != 0 || st.st_size < LZ_LOG_FOOTER_SIZE ||
+            pread(fd, footer, sizeof(footer), st.st_size - LZ_LOG_FOOTER_SIZE) != (ssize_t)sizeof(footer))
+        {
+            break;
+        }
+
+        uint32_t magic = 0, file_size = 0, used = 0;
+        memcpy(&magic, footer + LZ_LOG_SALT_SIZE, sizeof(magic));
+        memcpy(&file_size, footer + LZ_LOG_SALT_SIZE + 4, sizeof(file_size));
+        memcpy(&used, footer + LZ_LOG_SALT_SIZE + 8, sizeof(used));
+        if (file_size != (uint32_t)st.st_size)
+        {
+            break;
+        }
+        if (magic == LZ_LOG_MAGIC_ENDB)
+        {
+            compacted = lz_compress_seal_stream(fd, footer, out_file_size, out_used) == LZ_LOG_SUCCESS;
+            *out_compressed = compacted;
+            break;
+        }
+        if (magic != LZ_LOG_MAGIC_ENDX)
+        {
+            break;
+        }
+
+        // 写满后的越界预留会使 used_size 超过数据区容量
+        uint32_t capacity = file_size - LZ_LOG_FOOTER_SIZE;
+        if (used > capacity)
+        {
+            used = capacity;
+        }
+
+        uint32_t new_size = used + LZ_LOG_FOOTER_SIZE;
+        if (new_size < file_size)
+        {
+            // 新 footer 写在数据末尾（原为未用空间），落盘后再截断
+            memcpy(footer + LZ_LOG_SALT_SIZE + 4, &new_size, sizeof(new_size));
+            memcpy(footer + LZ_LOG_SALT_SIZE + 8, &used, sizeof(used));
+            if (pwrite(fd, footer, sizeof(footer), used) != (ssize_t)sizeof(footer) ||
+                fdatasync(fd) != 0 ||
+                ftruncate(fd, (off_t)new_size) != 0)
+            {
+                LZ_DEBUG_LOG("Failed to compact %s (errno=%d)", name, errno);
+                break;
+            }
+        }
+
+        *out_file_size = new_size;
+        *out_used = used;
+        compacted = true;
+
+    } while (0);
+
+    close(fd);
+    return compacted;
+}
+
+/**
+ * 压缩一个已退役的段
+ * @param entry 清单条目
+ * @param out_file_size 输出压缩后的文件大小
+ * @param out_used 输出压缩后的已用大小
+ * @return 是否压缩成功（需要更新清单）
+ */
+static bool housekeeper_compress(lz_housekeeper_t *hk, const lz_manifest_entry_t *entry,
+                                 uint32_t *out_file_size, uint32_t *out_used)
+{
+    char name[64];
+    lz_manifest_build_name(entry, name, sizeof(name));
+
+    return lz_compress_segment(hk->dir_fd, name, hk->encrypt_key, out_file_size, out_used) == LZ_LOG_SUCCESS;
+}
+
+/**
+ * 压实（或压缩）所有已退役且尚未处理的段
+ * @param count 清单快照中的条目数
+ * @param retired_seq 小于它的段已退役
+ */
+static void housekeeper_compact_all(lz_housekeeper_t *hk, uint32_t count, uint64_t retired_seq)
+{
+    uint32_t batch_count = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        lz_manifest_entry_t *entry = &hk->entries[i];
+        if (entry->seq >= retired_seq)
+        {
+            break;
+        }
+        if (entry->state == LZ_SEGMENT_STATE_COMPRESSED)
+        {
+            continue;
+        }
+
+        uint32_t file_size = 0, used = 0;
+        bool compressed = false;
+        if (hk->compress)
+        {
+            // 压缩包含了压实：新文件只有数据本身
+            if (housekeeper_compress(hk, entry, &file_size, &used))
+            {
+                LZ_DEBUG_LOG("Compressed segment %llu: %u -> %u bytes",
+                             (unsigned long long)entry->seq, entry->file_size, file_size);
+                lz_manifest_mark_compressed(hk->manifest, entry->seq, file_size, used);
+                entry->file_size = file_size;
+                entry->used_size = used;
+                entry->state = LZ_SEGMENT_STATE_COMPRESSED;
+                entry->flags |= LZ_SEGMENT_FLAG_COMPACTED;
+            }
+        }
+        else if (entry->flags & LZ_SEGMENT_FLAG_COMPACTED)
+        {
+            continue;
+        }
+        else if (housekeeper_compact(hk, entry, &file_size, &used, &compressed))
+        {
+            LZ_DEBUG_LOG("Compacted segment %llu: %u -> %u bytes",
+                         (unsigned long long)entry->seq, entry->file_size, file_size);
+            if (compressed)
+            {
+                // 写入时压缩的块流：补写块索引后即为压缩段
+                lz_manifest_mark_compressed(hk->manifest, entry->seq, file_size, used);
+                entry->state = LZ_SEGMENT_STATE_COMPRESSED;
+            }
+            else
+            {
+                lz_manifest_mark_compacted(hk->manifest, entry->seq, file_size, used);
+            }
+            entry->file_size = file_size;
+            entry->used_size = used;
+            entry->flags |= LZ_SEGMENT_FLAG_COMPACTED;
+        }
+
+        if (++batch_count == LZ_HOUSEKEEPER_BATCH)
+        {
+            batch_count = 0;
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * 执行一轮维护：压实已退役的段，再从最旧的段开始分批删除，直到满足容量和天数限制
+ * @param active_seq 当前写入的段序号
+ * @param retired_seq 小于它的段已退役
+ */
+static void housekeeper_run(lz_housekeeper_t *hk, uint64_t active_seq, uint64_t retired_seq)
+{
+    uint32_t count = lz_manifest_list(hk->manifest, hk->entries, LZ_MANIFEST_CAPACITY);
+
+    // 先压实，保留策略按压实后的大小计算
+    housekeeper_compact_all(hk, count, retired_seq);
+
+    if (hk->max_bytes == 0 && hk->max_days == 0)
+    {
+        return;
+    }
+
+    uint32_t cutoff = housekeeper_cutoff_date(hk->max_days);
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        total += hk->entries[i].file_size;
+    }
+
+    uint64_t batch[LZ_HOUSEKEEPER_BATCH];
+    uint32_t batch_count = 0;
+    uint32_t deleted = 0;
+
+    // 清单按从旧到新排列
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const lz_manifest_entry_t *entry = &hk->entries[i];
+        if (entry->seq >= active_seq)
+        {
+            break;
+        }
+
+        bool over_quota = hk->max_bytes != 0 && total > hk->max_bytes;
+        bool expired = cutoff != 0 && entry->date <= cutoff;
+        if (!over_quota && !expired)
+        {
+            continue;
+        }
+
+        char name[64];
+        lz_manifest_build_name(entry, name, sizeof(name));
+        if (unlinkat(hk->dir_fd, name, 0) != 0 && errno != ENOENT)
+        {
+            // 删除失败的段保留在清单中，下一轮重试
+            LZ_DEBUG_LOG("Failed to delete %s (errno=%d)", name, errno);
+            continue;
+        }
+
+        total -= entry->file_size;
+        batch[batch_count++] = entry->seq;
+        deleted++;
+
+        if (batch_count == LZ_HOUSEKEEPER_BATCH)
+        {
+            lz_manifest_remove_batch(hk->manifest, batch, batch_count);
+            batch_count = 0;
+            sched_yield();
+        }
+    }
+
+    if (batch_count > 0)
+    {
+        lz_manifest_remove_batch(hk->manifest, batch, batch_count);
+    }
+
+    // 清单之外的过期文件：截止日期每天只变化一次，变化时（含首轮）遍历一次目录
+    if (cutoff != 0 && cutoff != hk->swept_cutoff)
+    {
+        deleted += lz_manifest_sweep_untracked(hk->manifest, cutoff);
+        hk->swept_cutoff = cutoff;
+    }
+
+    if (deleted > 0)
+    {
+        LZ_DEBUG_LOG("Retention deleted %u segments, total=%llu",
+                     deleted, (unsigned long long)total);
+    }
+}
+
+/**
+ * 后台维护线程：收到通知或定期检查时执行一轮保留策略
+ */
+static void *housekeeper_thread(void *arg)
+{
+    lz_housekeeper_t *hk = (lz_housekeeper_t *)arg;
+    unsigned seen_kicks = 0;
+
+    housekeeper_lower_priority();
+
+    pthread_mutex_lock(&hk->mutex);
+    while (!hk->stop)
+    {
+        if (hk->kicks == seen_kicks)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += LZ_HOUSEKEEPER_INTERVAL_SEC;
+            pthread_cond_timedwait(&hk->cond, &hk->mutex, &deadline);
+            if (hk->stop)
+            {
+                break;
+            }
+        }
+        seen_kicks = hk->kicks;
+        uint64_t active_seq = hk->active_seq;
+        uint64_t retired_seq = hk->retired_seq;
+        pthread_mutex_unlock(&hk->mutex);
+
+        housekeeper_run(hk, active_seq, retired_seq);
+
+        pthread_mutex_lock(&hk->mutex);
+    }
+    pthread_mutex_unlock(&hk->mutex);
+
+    return NULL;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+lz_log_error_t lz_housekeeper_start(const char *log_dir,
+                                    lz_manifest_t *manifest,
+                                    uint64_t max_bytes,
+                                    uint32_t max_days,
+                                    bool compress,
+                                    const char *encrypt_key,
+                                    lz_housekeeper_t **out_housekeeper)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_housekeeper_t *hk = NULL;
+    int init_step = 0;
+
+    do
+    {
+        if (log_dir == NULL || manifest == NULL || out_housekeeper == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        hk = (lz_housekeeper_t *)calloc(1, sizeof(lz_housekeeper_t));
+        if (hk == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        hk->manifest = manifest;
+        hk->max_bytes = max_bytes;
+        hk->max_days = max_days;
+        hk->compress = compress;
+        if (encrypt_key != NULL)
+        {
+            strncpy(hk->encrypt_key, encrypt_key, sizeof(hk->encrypt_key) - 1);
+        }
+        hk->dir_fd = -1;
+
+        hk->entries = (lz_manifest_entry_t *)malloc(sizeof(lz_manifest_entry_t) * LZ_MANIFEST_CAPACITY);
+        if (hk->entries == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        hk->dir_fd = open(log_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (hk->dir_fd < 0)
+        {
+            ret = LZ_LOG_ERROR_DIR_ACCESS;
+            break;
+        }
+
+        if (pthread_mutex_init(&hk->mutex, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 1;
+
+        if (pthread_cond_init(&hk->cond, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 2;
+
+        if (pthread_create(&hk->thread, NULL, housekeeper_thread, hk) != 0)
+        {
+            ret = LZ_LOG_ERROR_SYSTEM;
+            break;
+        }
+
+        *out_housekeeper = hk;
+
+    } while (0);
+
+    if (ret != LZ_LOG_SUCCESS && hk != NULL)
+    {
+        if (init_step >= 2)
+        {
+            pthread_cond_destroy(&hk->cond);
+        }
+        if (init_step >= 1)
+        {
+            pthread_mutex_destroy(&hk->mutex);
+        }
+        if (hk->dir_fd >= 0)
+        {
+            close(hk->dir_fd);
+        }
+        memset(hk->encrypt_key, 0, sizeof(hk->encrypt_key));
+        free(hk->entries);
+        free(hk);
+    }
+
+    return ret;
+}
+
+void lz_housekeeper_notify(lz_housekeeper_t *housekeeper, uint64_t active_seq, uint64_t retired_seq)
+{
+    if (housekeeper == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&housekeeper->mutex);
+    housekeeper->active_seq = active_seq;
+    housekeeper->retired_seq = retired_seq;
+    housekeeper->kicks++;
+    pthread_cond_signal(&housekeeper->cond);
+    pthread_mutex_unlock(&housekeeper->mutex);
+}
+
+void lz_housekeeper_stop(lz_housekeeper_t *housekeeper)
+{
+    if (housekeeper == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&housekeeper->mutex);
+    housekeeper->stop = true;
+    pthread_cond_signal(&housekeeper->cond);
+    pthread_mutex_unlock(&housekeeper->mutex);
+    pthread_join(housekeeper->thread, NULL);
+
+    pthread_cond_destroy(&housekeeper->cond);
+    pthread_mutex_destroy(&housekeeper->mutex);
+    close(housekeeper->dir_fd);
+    memset(housekeeper->encrypt_key, 0, sizeof(housekeeper->encrypt_key));
+    free(housekeeper->entries);
+    free(housekeeper);
+}
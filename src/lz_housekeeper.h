@@ -0,0 +1,77 @@
+#ifndef LZ_HOUSEKEEPER_H
+#define LZ_HOUSEKEEPER_H
+
+#include "lz_logger.h"
+#include "lz_manifest.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 后台维护线程（Housekeeper）
+// ============================================================================
+/*
+ * 每个普通文件模式的句柄启动一个低优先级后台线程，在打开和每次文件切换后：
+ *
+ * 1. 压实已退役的段：预分配文件的数据区之后往往还有大段未用空间，
+ *    把 footer 写到数据末尾后截断文件，封存的段只占用数据本身的磁盘空间。
+ *    先写新 footer 并落盘再截断：中途崩溃时文件末尾的旧 footer 仍然有效。
+ *    开启压缩时改为把段压缩为块压缩格式（见 lz_compress.h），写入临时文件落盘后原子替换。
+ * 2. 执行保留策略（配置了容量/天数时）：从最旧的段开始删除。
+ *
+ * - 以目录清单为账本：总占用由清单条目的文件大小累加得出，不 stat、不遍历目录
+ * - 清单只跟踪最近 LZ_MANIFEST_CAPACITY 个段：更早的文件不计入容量配额，
+ *   按天数保留时由截止日期变化后的一次目录扫描删除（lz_manifest_sweep_untracked）
+ * - 文件操作使用打开时保存的目录 fd（openat / unlinkat），不再拼接完整路径
+ * - 每批最多处理 LZ_HOUSEKEEPER_BATCH 个文件，整批更新清单后让出 CPU 再处理下一批
+ * - 写入线程只在文件切换后发出一次通知（不等待），后台线程不持有 switch_mutex
+ * - 当前正在写入的段及其之后的段永远不会被删除；仍被句柄映射的段不会被压实
+ */
+
+/** 每批最多处理的文件数 */
+#define LZ_HOUSEKEEPER_BATCH 16
+
+/** 没有文件切换时的定期检查间隔（秒），保证按天数保留在低频写入时也会执行 */
+#define LZ_HOUSEKEEPER_INTERVAL_SEC 3600
+
+typedef struct lz_housekeeper_t lz_housekeeper_t;
+
+/**
+ * 启动后台维护线程
+ * @param log_dir 日志目录
+ * @param manifest 目录清单（调用者保证在 lz_housekeeper_stop 之前不关闭）
+ * @param max_bytes 日志文件总大小上限（0 表示不删除）
+ * @param max_days 保留天数（0 表示不删除）
+ * @param compress 是否压缩已退役的段（否则只压实）
+ * @param encrypt_key 加密密钥（压缩加密的段时使用，可为NULL；内部保存副本）
+ * @param out_housekeeper 输出句柄
+ * @return 错误码
+ */
+lz_log_error_t lz_housekeeper_start(const char *log_dir,
+                                    lz_manifest_t *manifest,
+                                    uint64_t max_bytes,
+                                    uint32_t max_days,
+                                    bool compress,
+                                    const char *encrypt_key,
+                                    lz_housekeeper_t **out_housekeeper);
+
+/**
+ * 通知当前写入的段（打开和每次文件切换后调用，不阻塞）
+ * @param active_seq 当前段序号，小于它的段才允许删除
+ * @param retired_seq 句柄仍映射的最旧段序号，小于它的段已退役，可以压实
+ */
+void lz_housekeeper_notify(lz_housekeeper_t *housekeeper, uint64_t active_seq, uint64_t retired_seq);
+
+/**
+ * 停止后台线程并释放资源（等待正在进行的一批删除完成）
+ */
+void lz_housekeeper_stop(lz_housekeeper_t *housekeeper);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_HOUSEKEEPER_H
@@ -0,0 +1,474 @@
+#include "lz_keystream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifndef LZ_DEBUG_LOG
+#define LZ_DEBUG_LOG(fmt, ...)                                        \
+    fprintf(stderr, "[LZLogger] lz_keystream.c:%d %s() - " fmt "\n", \
+            __LINE__, __func__, ##__VA_ARGS__)
+#endif
+
+/** 生产线程空闲时的最长等待（毫秒），正常由写入线程唤醒 */
+#define LZ_KEYSTREAM_IDLE_MS 1000
+
+/** 标签中块号占用的位数（其余高位为密钥编号） */
+#define LZ_KEYSTREAM_TAG_CHUNK_BITS 40
+
+// ============================================================================
+// Internal Structures
+// ============================================================================
+
+/** 密钥流环上下文 */
+struct lz_keystream_t
+{
+    uint8_t *ring;                 // 密钥流环（块数 × LZ_KEYSTREAM_CHUNK_SIZE）
+    atomic_uint_least64_t *tags;   // 每块的标签（0 表示空或正在生成）
+    uint32_t chunk_mask;           // 块数 - 1
+    uint32_t lookahead_chunks;     // 预生成距离（块）
+    lz_log_keystream_fallback_t fallback; // 游标追上生产线程时的处理方式
+
+    atomic_uint_least64_t cursor;   // 写入游标提示（字节偏移）
+    atomic_uint_least64_t produced; // 生产线程下一个要检查的块号
+    atomic_bool sleeping;           // 生产线程已生成到预生成距离，正在等待
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;   // 游标前进 / 重置 / 有线程等待 / 停止
+    pthread_cond_t ready_cond;  // 有新块发布（WAIT 模式）
+    lz_crypto_context_t crypto; // 密钥副本（mutex 保护）
+    uint64_t epoch;             // 重置次数（mutex 保护）
+    uint32_t waiters;           // 等待新块的写入线程数（mutex 保护）
+    bool stop;                  // 停止标记（mutex 保护）
+};
+
+// ============================================================================
+// Utility Functions
+// ============================================================================
+
+/**
+ * 块标签：密钥编号 + 块号（+1，使 0 表示无效）
+ */
+static inline uint64_t keystream_tag(uint64_t key_id, uint64_t chunk)
+{
+    return (key_id << LZ_KEYSTREAM_TAG_CHUNK_BITS) |
+           ((chunk + 1) & ((1ULL << LZ_KEYSTREAM_TAG_CHUNK_BITS) - 1));
+}
+
+/**
+ * output = input ^ keystream（每次 64 字节，编译为 SSE2 / NEON）
+ */
+static inline void keystream_xor_bytes(uint8_t *output, const uint8_t *input,
+                                       const uint8_t *keystream, uint32_t len)
+{
+    uint32_t i = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+    typedef uint8_t vec_t __attribute__((vector_size(16)));
+    for (; i + 64 <= len; i += 64)
+    {
+        vec_t a[4], b[4];
+        memcpy(a, input + i, 64);
+        memcpy(b, keystream + i, 64);
+        a[0] ^= b[0];
+        a[1] ^= b[1];
+        a[2] ^= b[2];
+        a[3] ^= b[3];
+        memcpy(output + i, a, 64);
+    }
+    for (; i + 16 <= len; i += 16)
+    {
+        vec_t a, b;
+        memcpy(&a, input + i, 16);
+        memcpy(&b, keystream + i, 16);
+        a ^= b;
+        memcpy(output + i, &a, 16);
+    }
+#endif
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t a, b;
+        memcpy(&a, input + i, 8);
+        memcpy(&b, keystream + i, 8);
+        a ^= b;
+        memcpy(output + i, &a, 8);
+    }
+    for (; i < len; i++)
+    {
+        output[i] = input[i] ^ keystream[i];
+    }
+}
+
+/**
+ * 计算 ms 毫秒之后的绝对时间
+ */
+static void keystream_deadline(struct timespec *deadline, long ms)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_nsec += ms * 1000000L;
+    deadline->tv_sec += deadline->tv_nsec / 1000000000L;
+    deadline->tv_nsec %= 1000000000L;
+}
+
+/**
+ * 写入线程跨块时更新游标提示；剩余的预生成量不足一半时唤醒生产线程
+ */
+static inline void keystream_advance(lz_keystream_t *ks, uint64_t end)
+{
+    uint64_t end_chunk = end >> LZ_KEYSTREAM_CHUNK_SHIFT;
+    uint64_t cursor = atomic_load_explicit(&ks->cursor, memory_order_relaxed);
+    if ((cursor >> LZ_KEYSTREAM_CHUNK_SHIFT) == end_chunk)
+    {
+        return;
+    }
+
+    // 与生产线程「先置 sleeping 再读游标」配对，保证不会漏掉唤醒
+    atomic_store(&ks->cursor, end);
+    if (!atomic_load(&ks->sleeping))
+    {
+        return;
+    }
+
+    uint64_t produced = atomic_load_explicit(&ks->produced, memory_order_relaxed);
+    if (produced < end_chunk + ks->lookahead_chunks / 2 ||
+        produced > end_chunk + ks->lookahead_chunks)
+    {
+        pthread_mutex_lock(&ks->mutex);
+        pthread_cond_signal(&ks->work_cond);
+        pthread_mutex_unlock(&ks->mutex);
+    }
+}
+
+/**
+ * 等待生产线程生成指定块（WAIT 模式）
+ * @return 最后看到的标签
+ */
+static uint64_t keystream_wait(lz_keystream_t *ks, atomic_uint_least64_t *tag,
+                               uint64_t expected, uint64_t chunk)
+{
+    // 只等待生产线程马上就会生成的块；已被覆盖的旧块或更远的块直接计算
+    uint64_t produced = atomic_load_explicit(&ks->produced, memory_order_relaxed);
+    if (chunk < produced || chunk >= produced + LZ_KEYSTREAM_WAIT_CHUNKS)
+    {
+        return atomic_load_explicit(tag, memory_order_acquire);
+    }
+
+    struct timespec deadline;
+    keystream_deadline(&deadline, LZ_KEYSTREAM_WAIT_MS);
+
+    uint64_t seen;
+    pthread_mutex_lock(&ks->mutex);
+    ks->waiters++;
+    pthread_cond_signal(&ks->work_cond);
+    while ((seen = atomic_load_explicit(tag, memory_order_acquire)) != expected && !ks->stop)
+    {
+        if (pthread_cond_timedwait(&ks->ready_cond, &ks->mutex, &deadline) == ETIMEDOUT)
+        {
+            seen = atomic_load_explicit(tag, memory_order_acquire);
+            break;
+        }
+    }
+    ks->waiters--;
+    pthread_mutex_unlock(&ks->mutex);
+
+    return seen;
+}
+
+/**
+ * 生产线程：生成 [游标, 游标 + 预生成距离) 内缺少的块
+ */
+static void *keystream_thread(void *arg)
+{
+    lz_keystream_t *ks = (lz_keystream_t *)arg;
+
+    pthread_mutex_lock(&ks->mutex);
+    while (!ks->stop)
+    {
+        uint64_t start = atomic_load(&ks->cursor) >> LZ_KEYSTREAM_CHUNK_SHIFT;
+        uint64_t end = start + ks->lookahead_chunks;
+        uint64_t key_id = ks->crypto.key_id;
+
+        // 不在窗口内（落后于游标，或游标回退）时从游标重新检查；已有的块直接跳过
+        uint64_t next = atomic_load_explicit(&ks->produced, memory_order_relaxed);
+        if (next < start || next > end)
+        {
+            next = start;
+        }
+        while (next < end &&
+               atomic_load_explicit(&ks->tags[next & ks->chunk_mask], memory_order_relaxed) ==
+                   keystream_tag(key_id, next))
+        {
+            next++;
+        }
+        atomic_store_explicit(&ks->produced, next, memory_order_relaxed);
+
+        if (next >= end)
+        {
+            // 先置 sleeping 再读游标（与 keystream_advance 配对），游标已前进则继续生成
+            atomic_store(&ks->sleeping, true);
+            if ((atomic_load(&ks->cursor) >> LZ_KEYSTREAM_CHUNK_SHIFT) == start)
+            {
+                struct timespec deadline;
+                keystream_deadline(&deadline, LZ_KEYSTREAM_IDLE_MS);
+                pthread_cond_timedwait(&ks->work_cond, &ks->mutex, &deadline);
+            }
+            atomic_store(&ks->sleeping, false);
+            continue;
+        }
+
+        // 覆盖之前先作废标签，读取中的写入线程据此发现密钥流已变化
+        uint32_t slot = (uint32_t)(next & ks->chunk_mask);
+        uint8_t *dst = ks->ring + ((size_t)slot << LZ_KEYSTREAM_CHUNK_SHIFT);
+        lz_crypto_context_t crypto = ks->crypto;
+        uint64_t epoch = ks->epoch;
+        atomic_store_explicit(&ks->tags[slot], 0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        pthread_mutex_unlock(&ks->mutex);
+
+        // 密钥流 = 全 0 明文的 CTR 加密结果
+        memset(dst, 0, LZ_KEYSTREAM_CHUNK_SIZE);
+        int result = lz_crypto_process(&crypto, dst, dst, LZ_KEYSTREAM_CHUNK_SIZE,
+                                       next << LZ_KEYSTREAM_CHUNK_SHIFT);
+        lz_crypto_cleanup(&crypto);
+
+        pthread_mutex_lock(&ks->mutex);
+        if (result != 0)
+        {
+            // 生成失败时写入线程会直接计算，这里稍后重试
+            LZ_DEBUG_LOG("Failed to generate keystream chunk %llu", (unsigned long long)next);
+            struct timespec deadline;
+            keystream_deadline(&deadline, LZ_KEYSTREAM_IDLE_MS);
+            pthread_cond_timedwait(&ks->work_cond, &ks->mutex, &deadline);
+            continue;
+        }
+        if (key_id == ks->crypto.key_id)
+        {
+            atomic_store_explicit(&ks->tags[slot], keystream_tag(key_id, next), memory_order_release);
+        }
+        if (epoch == ks->epoch)
+        {
+            atomic_store_explicit(&ks->produced, next + 1, memory_order_relaxed);
+        }
+        if (ks->waiters > 0)
+        {
+            pthread_cond_broadcast(&ks->ready_cond);
+        }
+    }
+    pthread_mutex_unlock(&ks->mutex);
+
+    return NULL;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+lz_log_error_t lz_keystream_start(uint32_t ring_size,
+                                  uint32_t lookahead,
+                                  lz_log_keystream_fallback_t fallback,
+                                  const lz_crypto_context_t *crypto,
+                                  uint64_t offset,
+                                  lz_keystream_t **out_keystream)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_keystream_t *ks = NULL;
+    int init_step = 0;
+
+    do
+    {
+        if (crypto == NULL || !crypto->is_initialized || out_keystream == NULL ||
+            ring_size < LZ_LOG_KEYSTREAM_MIN_SIZE || ring_size > LZ_LOG_KEYSTREAM_MAX_SIZE ||
+            (ring_size & (ring_size - 1)) != 0 ||
+            lookahead == 0 || lookahead > ring_size - LZ_KEYSTREAM_CHUNK_SIZE ||
+            (fallback != LZ_LOG_KEYSTREAM_FALLBACK_COMPUTE && fallback != LZ_LOG_KEYSTREAM_FALLBACK_WAIT))
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        ks = (lz_keystream_t *)calloc(1, sizeof(lz_keystream_t));
+        if (ks == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        uint32_t chunks = ring_size >> LZ_KEYSTREAM_CHUNK_SHIFT;
+        ks->chunk_mask = chunks - 1;
+        ks->lookahead_chunks = (lookahead + LZ_KEYSTREAM_CHUNK_SIZE - 1) >> LZ_KEYSTREAM_CHUNK_SHIFT;
+        ks->fallback = fallback;
+        ks->crypto = *crypto;
+        atomic_init(&ks->cursor, offset);
+        atomic_init(&ks->produced, offset >> LZ_KEYSTREAM_CHUNK_SHIFT);
+        atomic_init(&ks->sleeping, false);
+
+        ks->ring = (uint8_t *)malloc(ring_size);
+        ks->tags = (atomic_uint_least64_t *)calloc(chunks, sizeof(atomic_uint_least64_t));
+        if (ks->ring == NULL || ks->tags == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        if (pthread_mutex_init(&ks->mutex, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 1;
+
+        if (pthread_cond_init(&ks->work_cond, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 2;
+
+        if (pthread_cond_init(&ks->ready_cond, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 3;
+
+        if (pthread_create(&ks->thread, NULL, keystream_thread, ks) != 0)
+        {
+            ret = LZ_LOG_ERROR_SYSTEM;
+            break;
+        }
+
+        LZ_DEBUG_LOG("Keystream started: ring=%u, lookahead=%u chunks, fallback=%d",
+                     ring_size, ks->lookahead_chunks, (int)fallback);
+        *out_keystream = ks;
+
+    } while (0);
+
+    if (ret != LZ_LOG_SUCCESS && ks != NULL)
+    {
+        if (init_step >= 3)
+        {
+            pthread_cond_destroy(&ks->ready_cond);
+        }
+        if (init_step >= 2)
+        {
+            pthread_cond_destroy(&ks->work_cond);
+        }
+        if (init_step >= 1)
+        {
+            pthread_mutex_destroy(&ks->mutex);
+        }
+        lz_crypto_cleanup(&ks->crypto);
+        free(ks->tags);
+        free(ks->ring);
+        free(ks);
+    }
+
+    return ret;
+}
+
+void lz_keystream_reset(lz_keystream_t *keystream, const lz_crypto_context_t *crypto, uint64_t offset)
+{
+    if (keystream == NULL || crypto == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&keystream->mutex);
+    keystream->crypto = *crypto;
+    keystream->epoch++;
+    atomic_store(&keystream->cursor, offset);
+    atomic_store_explicit(&keystream->produced, offset >> LZ_KEYSTREAM_CHUNK_SHIFT, memory_order_relaxed);
+    pthread_cond_signal(&keystream->work_cond);
+    pthread_mutex_unlock(&keystream->mutex);
+}
+
+int lz_keystream_xor(lz_keystream_t *keystream,
+                     lz_crypto_context_t *crypto,
+                     const uint8_t *input,
+                     uint8_t *output,
+                     uint32_t len,
+                     uint64_t offset)
+{
+    lz_keystream_t *ks = keystream;
+
+    if (input == output)
+    {
+        return lz_crypto_process(crypto, input, output, len, offset);
+    }
+
+    keystream_advance(ks, offset + len);
+
+    while (len > 0)
+    {
+        uint64_t chunk = offset >> LZ_KEYSTREAM_CHUNK_SHIFT;
+        uint32_t in_chunk = (uint32_t)(offset & (LZ_KEYSTREAM_CHUNK_SIZE - 1));
+        uint32_t piece = LZ_KEYSTREAM_CHUNK_SIZE - in_chunk;
+        if (piece > len)
+        {
+            piece = len;
+        }
+
+        uint32_t slot = (uint32_t)(chunk & ks->chunk_mask);
+        atomic_uint_least64_t *tag = &ks->tags[slot];
+        uint64_t expected = keystream_tag(crypto->key_id, chunk);
+
+        uint64_t seen = atomic_load_explicit(tag, memory_order_acquire);
+        if (seen != expected && ks->fallback == LZ_LOG_KEYSTREAM_FALLBACK_WAIT)
+        {
+            seen = keystream_wait(ks, tag, expected, chunk);
+        }
+
+        // 命中：XOR 后再核对标签（seqlock），期间被生产线程覆盖则改为直接计算
+        bool hit = false;
+        if (seen == expected)
+        {
+            keystream_xor_bytes(output, input,
+                                ks->ring + ((size_t)slot << LZ_KEYSTREAM_CHUNK_SHIFT) + in_chunk, piece);
+            atomic_thread_fence(memory_order_acquire);
+            hit = atomic_load_explicit(tag, memory_order_relaxed) == expected;
+        }
+        if (!hit && lz_crypto_process(crypto, input, output, piece, offset) != 0)
+        {
+            return -1;
+        }
+
+        input += piece;
+        output += piece;
+        offset += piece;
+        len -= piece;
+    }
+
+    return 0;
+}
+
+void lz_keystream_stop(lz_keystream_t *keystream)
+{
+    if (keystream == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&keystream->mutex);
+    keystream->stop = true;
+    pthread_cond_broadcast(&keystream->work_cond);
+    pthread_cond_broadcast(&keystream->ready_cond);
+    pthread_mutex_unlock(&keystream->mutex);
+
+    pthread_join(keystream->thread, NULL);
+
+    pthread_cond_destroy(&keystream->ready_cond);
+    pthread_cond_destroy(&keystream->work_cond);
+    pthread_mutex_destroy(&keystream->mutex);
+
+    // 擦除密钥和密钥流
+    memset(keystream->ring, 0, (size_t)(keystream->chunk_mask + 1) << LZ_KEYSTREAM_CHUNK_SHIFT);
+    lz_crypto_cleanup(&keystream->crypto);
+    free(keystream->tags);
+    free(keystream->ring);
+    free(keystream);
+}
@@ -0,0 +1,96 @@
+#ifndef LZ_KEYSTREAM_H
+#define LZ_KEYSTREAM_H
+
+#include "lz_logger.h"
+#include "lz_crypto.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 预生成的 CTR 密钥流（Keystream Ring）
+// ============================================================================
+/*
+ * CTR 模式的密钥流只取决于密钥和块号（偏移/16），与数据无关。
+ * 后台线程在写入游标前方预先生成密钥流，写入线程加密时只做一次 XOR：
+ *
+ *   生产线程:   按块（LZ_KEYSTREAM_CHUNK_SIZE）生成 [游标, 游标 + 预生成距离) 的密钥流，
+ *               存入环中 (块号 % 块数) 的位置，并发布带密钥编号和块号的标签
+ *   lz_keystream_xor:  按标签确认环中的块就是所需的密钥流 → SIMD XOR
+ *               → 读完再核对一次标签（生产线程已覆盖时改为直接计算）
+ *
+ * - 游标由写入线程在跨块时顺带更新，只是提示：乱序写入、文件切换只影响命中率，不影响正确性
+ * - 游标追上生产线程时按配置直接计算（LZ_LOG_KEYSTREAM_FALLBACK_COMPUTE）
+ *   或等待生产线程（LZ_LOG_KEYSTREAM_FALLBACK_WAIT）。只等待生产线程接下来
+ *   LZ_KEYSTREAM_WAIT_CHUNKS 块之内的块，最多 LZ_KEYSTREAM_WAIT_MS 毫秒：写入线程等待时
+ *   持有日志段中的预留空间，不能长时间阻塞（文件切换只为迟到的写入保留一个旧段）
+ * - 原地加密（input == output）无法在读到被覆盖的密钥流后重做，总是直接计算
+ */
+
+/** 密钥流块大小（2^12 = 4KB） */
+#define LZ_KEYSTREAM_CHUNK_SHIFT 12
+#define LZ_KEYSTREAM_CHUNK_SIZE (1u << LZ_KEYSTREAM_CHUNK_SHIFT)
+
+/** WAIT 模式下只等待生产线程接下来的几块，更远的块直接计算 */
+#define LZ_KEYSTREAM_WAIT_CHUNKS 2
+
+/** WAIT 模式下等待生产线程的最长时间（毫秒），超时后直接计算 */
+#define LZ_KEYSTREAM_WAIT_MS 1
+
+typedef struct lz_keystream_t lz_keystream_t;
+
+/**
+ * 启动密钥流生产线程
+ * @param ring_size 环大小（字节，2 的幂，范围见 LZ_LOG_KEYSTREAM_MIN_SIZE / LZ_LOG_KEYSTREAM_MAX_SIZE）
+ * @param lookahead 预生成距离（字节，向上取整到块大小，不超过 ring_size - LZ_KEYSTREAM_CHUNK_SIZE）
+ * @param fallback 游标追上生产线程时的处理方式
+ * @param crypto 加密上下文（复制密钥，调用后可独立清理）
+ * @param offset 初始写入偏移
+ * @param out_keystream 输出句柄
+ * @return 错误码
+ */
+lz_log_error_t lz_keystream_start(uint32_t ring_size,
+                                  uint32_t lookahead,
+                                  lz_log_keystream_fallback_t fallback,
+                                  const lz_crypto_context_t *crypto,
+                                  uint64_t offset,
+                                  lz_keystream_t **out_keystream);
+
+/**
+ * 从新的偏移重新开始预生成（文件切换后偏移回到 0 时调用）
+ * @param keystream 句柄
+ * @param crypto 加密上下文（密钥变化时环中已有的密钥流全部失效）
+ * @param offset 新的写入偏移
+ */
+void lz_keystream_reset(lz_keystream_t *keystream, const lz_crypto_context_t *crypto, uint64_t offset);
+
+/**
+ * AES-CTR 加密/解密：命中预生成的密钥流时只做 XOR，否则按配置等待或直接计算
+ * @param keystream 句柄
+ * @param crypto 加密上下文（与 start/reset 传入的为同一密钥）
+ * @param input 输入数据
+ * @param output 输出数据（可与 input 相同，此时直接计算）
+ * @param len 数据长度
+ * @param offset 文件偏移量（用于计算 counter）
+ * @return 成功返回 0，失败返回 -1
+ */
+int lz_keystream_xor(lz_keystream_t *keystream,
+                     lz_crypto_context_t *crypto,
+                     const uint8_t *input,
+                     uint8_t *output,
+                     uint32_t len,
+                     uint64_t offset);
+
+/**
+ * 停止生产线程并释放资源（擦除环中的密钥流）
+ * @param keystream 句柄（可为NULL）
+ */
+void lz_keystream_stop(lz_keystream_t *keystream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_KEYSTREAM_H
@@ -1,5 +1,13 @@
 #include "lz_logger.h"
 #include "lz_crypto.h"
+#include "lz_sink.h"
+#include "lz_manifest.h"
+#include "lz_housekeeper.h"
+#include "lz_packer.h"
+#include "lz_compress.h"
+#include "lz_keystream.h"
+#include "lz_format.h"
+#include "lz_binlog.h"
 #include <string.h>
 #include <time.h>
 #include <errno.h>
@@ -7,10 +15,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
-#include <dirent.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <sched.h>
 
 // ============================================================================
 // Debug Logging (set to 0 to disable)
@@ -43,10 +51,10 @@
  * 3. ✅ 双重检查锁定 - 切换前后都检查偏移量
  * 4. ✅ 延迟 munmap - 旧 mmap 在切换后仍可被写入线程使用
  * 5. ✅ mmap/fd 独立性 - close(fd) 后 mmap 仍然有效
- * 6. ✅ 原子操作 - cur_offset_ptr, is_closed 使用 atomic 类型
- * 7. ✅ 指针替换顺序 - 先创建新 mmap，再替换指针，最后延迟清理
- * 8. ✅ 原子指针方案 - cur_offset_ptr 为 atomic(atomic_uint_least32_t*)
- * 9. ✅ 上下文一致性 - 写入时先原子读取 offset_ptr，通过指针反推 mmap_base
+ * 6. ✅ 原子操作 - cur_segment, is_closed 使用 atomic 类型
+ * 7. ✅ 指针替换顺序 - 先创建新段，再替换指针，最后延迟清理
+ * 8. ✅ 原子指针方案 - cur_segment 为 atomic(lz_segment_t*)
+ * 9. ✅ 上下文一致性 - 写入时先原子读取 cur_segment，偏移/基址/容量都取自同一个段
  *
  * 潜在问题（已修复）：
  * 1. ✅ 已修复：错误处理中销毁未初始化的 mutex
@@ -60,13 +68,25 @@
  * 场景1: 多个线程同时写入
  *   - 安全：CAS 保证只有一个线程能预留空间
  * 场景2: 写入时发生文件切换
- *   - 安全：原子指针 + 延迟 munmap 保证读取一致的 offset_ptr 和 mmap_base
+ *   - 安全：原子段指针 + 延迟释放保证读取一致的 offset_ptr 和写入地址
  * 场景3: 切换时多个线程都检测到需要切换
  *   - 安全：双重检查锁定，第二个线程会发现已经切换完成
  * 场景4: close 时仍有线程在写入
  *   - 安全：atomic is_closed 标志阻止新写入，已开始的写入完成后自然结束
  * 场景5: CAS 成功后读取 mmap_ptr（已消除）
- *   - 完美：原子读取 offset_ptr 后，通过指针反推 mmap_base，保证完全一致
+ *   - 完美：原子读取 cur_segment 后，所有地址都由该段计算，保证完全一致
+ * 场景6: 缓冲后端（PWRITE/DIRECT）槽位尚未回收
+ *   - 安全：写入线程在 lz_sink_acquire 中等待后台线程落盘回收，
+ *     等待只依赖更早的块，不会形成环
+ * 场景7: 内存模式 dump 时仍有线程在写入
+ *   - 安全：dump 先置 ring_frozen，等 ring_writers 归零后把环拷贝到快照，
+ *     随即解除冻结；写入线程只在这次内存拷贝期间让出 CPU，
+ *     加密和写文件都在快照上进行
+ * 场景8: 段密钥在后台派生期间写入
+ *   - 安全：写入线程在 key_mutex 下把记录追加到暂存区；派生线程持同一把锁
+ *     按顺序写出暂存区后才把 key_state 置为就绪，之后的写入直接写段，不会乱序
+ * 场景9: 写入线程在旧段中预留空间、文件切换后才加密
+ *   - 安全：段密钥保存在段内（lz_segment_t.crypto），加密使用预留空间所在段的密钥
  */
 
 // ============================================================================
@@ -91,8 +111,10 @@ typedef struct lz_logger_context_t
     char encrypt_key[256];       // 加密密钥
     char current_file_path[768]; // 当前日志文件路径
 
-    _Atomic(atomic_uint_least32_t *) cur_offset_ptr; // 原子指针：指向当前 offset（footer中的used_size字段）
-    _Atomic(atomic_uint_least32_t *) old_offset_ptr; // 旧文件的offset指针（延迟销毁）
+    _Atomic(lz_segment_t *) cur_segment; // 原子指针：当前日志段（offset_ptr 即写入游标）
+    _Atomic(lz_segment_t *) old_segment; // 旧日志段（延迟销毁）
+
+    lz_sink_t *sink; // 存储后端
 
     pthread_mutex_t switch_mutex; // 文件切换互斥锁
 
@@ -100,60 +122,157 @@ typedef struct lz_logger_context_t
 
     atomic_bool is_closed; // 是否已关闭
 
-    lz_crypto_context_t crypto_ctx; // 加密上下文
+    lz_crypto_context_t crypto_ctx; // 加密上下文（环形模式；普通文件模式的段密钥在 lz_segment_t.crypto 中）
+    lz_crypto_cipher_t cipher;      // 新建文件使用的流密码（打开时按全局配置确定，已有文件沿用自己的）
+    uint8_t memory_salt[LZ_LOG_SALT_SIZE]; // 内存模式：dump 沿用的流密码标记（环内为明文）
+    lz_keystream_t *keystream;      // 预生成的密钥流（未启用时为 NULL）
+
+    // 后台密钥派生（主密钥未缓存时 PBKDF2 移出 lz_logger_open，派生完成前的记录暂存在内存中）
+    atomic_int key_state;           // 段密钥状态（LZ_LOG_KEY_READY / PENDING / FAILED）
+    bool key_thread_started;        // 派生线程是否已启动（关闭时 join）
+    pthread_t key_thread;           // 派生线程
+    pthread_mutex_t key_mutex;      // 保护暂存区
+    pthread_cond_t key_cond;        // 派生完成
+    uint8_t *key_backlog;           // 暂存的记录：[长度4字节][内容]...
+    uint32_t key_backlog_used;      // 暂存区已用字节数
+
+    uint32_t rotate_interval;               // 按时间轮转的间隔（秒，0 表示不按时间轮转）
+    atomic_int_least64_t rotate_deadline;   // 下一个轮转边界（Unix 秒，0 表示无）
+
+    // 目录清单（普通文件模式；环形模式下为 NULL）
+    lz_manifest_t *manifest;                              // 目录清单
+    uint64_t manifest_seq;                                // 当前日志段序号
+    _Atomic(atomic_uint_least32_t *) level_counts;        // 当前日志段的级别计数器
+    lz_housekeeper_t *housekeeper;                        // 保留策略后台线程（未配置时为 NULL）
+
+    // 写入时压缩（LZ_LOG_COMPRESS_INLINE；其他模式下 packer 为 NULL）
+    lz_packer_t *packer;   // 压缩管线（记录先进暂存块，由压缩线程压缩后追加）
+    uint32_t inline_blocks; // 当前段已追加的块数（只在压缩线程中访问，用于预留块索引空间）
+
+    // 环形模式（lz_logger_open_memory / lz_logger_open_circular；普通文件模式下 ring_base 为 NULL）
+    uint8_t *ring_base;                 // 映射：[数据区][块索引][扩展区][footer]
+    uint32_t ring_capacity;             // 数据区容量（2 的幂）
+    uint32_t ring_map_size;             // 映射总大小（循环文件即文件大小）
+    bool ring_persistent;               // 是否映射到循环日志文件
+    atomic_uint_least64_t *ring_cursor; // 已预留的总字节数（单调递增，不回绕，位于扩展区）
+    atomic_uint_least64_t *ring_oldest; // 最旧的完整记录的逻辑偏移（位于扩展区）
+    atomic_uint_least64_t *ring_index;  // 每个索引块内第一条记录的逻辑偏移
+    atomic_uint ring_writers;           // 正在写入环的线程数
+    atomic_bool ring_frozen;            // dump 正在拍快照，新写入暂缓
+
+    lz_binlog_state_t binlog; // 二进制日志的会话与纪元（LZ_LOG_BINARY）
 } lz_logger_context_t;
 
 // ============================================================================
 // Global Configuration
 // ============================================================================
 
-/** 当天最大日志文件数量 */
-#define LZ_LOG_MAX_DAILY_FILES 5
+/** 循环日志文件名 */
+#define LZ_LOG_CIRCULAR_FILE_NAME "circular.log"
+
+/** 环形模式块索引粒度：4KB（2^12） */
+#define LZ_LOG_RING_BLOCK_SHIFT 12
 
 /** 全局配置：最大文件大小 */
 static atomic_uint_least32_t g_max_file_size = LZ_LOG_DEFAULT_FILE_SIZE;
 
+/** 全局配置：存储后端 */
+static atomic_int g_sink_type = LZ_LOG_SINK_MMAP;
+
+/** 全局配置：按时间轮转的间隔（秒） */
+static atomic_uint_least32_t g_rotate_interval = LZ_LOG_ROTATE_DAILY;
+
+/** 全局配置：保留策略（0 表示不限制） */
+static atomic_uint_least64_t g_retention_bytes = 0;
+static atomic_uint_least32_t g_retention_days = 0;
+
+/** 全局配置：压缩模式 */
+static atomic_int g_compress_mode = LZ_LOG_COMPRESS_NONE;
+
+/** 全局配置：预生成密钥流（环大小为 0 表示关闭） */
+static atomic_uint_least32_t g_keystream_size = 0;
+static atomic_uint_least32_t g_keystream_lookahead = 0;
+static atomic_int g_keystream_fallback = LZ_LOG_KEYSTREAM_FALLBACK_COMPUTE;
+
+/** 全局配置：流密码 */
+static atomic_int g_cipher = LZ_LOG_CIPHER_AES_CTR;
+
+/** 全局配置：字符串字典（lz_logger_log 写入行记录） */
+static atomic_bool g_intern_strings = false;
+
+/** 按时间轮转失败后的重试间隔（秒），避免每次写入都重试 */
+#define LZ_LOG_ROTATE_RETRY_SEC 10
+
+/** 后台派生段密钥期间暂存记录的上限（字节），暂存区满后写入线程等待派生完成 */
+#define LZ_LOG_KEY_BACKLOG_SIZE (256 * 1024)
+
+/** 二进制记录先编码到栈上的缓冲大小（放不下时才借用线程缓冲） */
+#define LZ_LOG_BINLOG_STACK_SIZE 256
+
+/** 段密钥状态 */
+#define LZ_LOG_KEY_READY 0   // 已就绪（或不加密）
+#define LZ_LOG_KEY_PENDING 1 // 后台派生中，写入暂存
+#define LZ_LOG_KEY_FAILED 2  // 派生失败，写入返回错误
+
 // ============================================================================
 // Utility Functions
 // ============================================================================
 
 /**
- * 从 offset_ptr 读取文件大小
- * @param offset_ptr 指向 used_size 的指针
- * @return 文件大小
+ * 获取粗粒度的当前时间（写入路径使用，精度为时钟节拍）
+ * @return Unix 秒
  */
-static inline uint32_t get_file_size_from_offset_ptr(atomic_uint_least32_t *offset_ptr)
+static inline int64_t get_coarse_time_sec(void)
 {
-    // offset_ptr 指向 used_size（footer最后4字节）
-    // file_size 在 used_size 前面4字节
-    uint32_t *file_size_ptr = (uint32_t *)offset_ptr - 1;
-    return *file_size_ptr;
+    struct timespec ts;
+#if defined(CLOCK_REALTIME_COARSE)
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+    return (int64_t)ts.tv_sec;
 }
 
 /**
- * 从 offset_ptr 反推 mmap_base
- * @param offset_ptr 指向 used_size 的指针
- * @return mmap 基地址
+ * 计算下一个按时间轮转的边界
+ * @param interval 轮转间隔（秒，0 表示不按时间轮转）
+ * @return 边界的 Unix 秒（0 表示无）
+ *
+ * 边界从本地零点起按 interval 对齐，并且不晚于下一个零点（跨天总会轮转）。
+ * 零点用 mktime 计算，夏令时切换当天同样正确。
  */
-static inline void *get_mmap_base_from_offset_ptr(atomic_uint_least32_t *offset_ptr)
+static int64_t next_rotate_deadline(uint32_t interval)
 {
-    uint32_t file_size = get_file_size_from_offset_ptr(offset_ptr);
-    // offset_ptr 指向 footer 最后4字节 = mmap_base + file_size - 4
-    // 所以 mmap_base = offset_ptr - file_size + 4
-    return (uint8_t *)offset_ptr - file_size + sizeof(uint32_t);
-}
+    if (interval == 0)
+    {
+        return 0;
+    }
 
-/**
- * 获取当前日期字符串
- * @param out_date 输出缓冲区，格式：yyyy-mm-dd
- * @param buf_size 缓冲区大小
- */
-static void get_current_date_string(char *out_date, size_t buf_size)
-{
-    memset(out_date, 0, buf_size);
     time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-    strftime(out_date, buf_size, "%Y-%m-%d", tm_info);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+
+    tm_info.tm_hour = 0;
+    tm_info.tm_min = 0;
+    tm_info.tm_sec = 0;
+    tm_info.tm_isdst = -1;
+    time_t midnight = mktime(&tm_info);
+
+    tm_info.tm_mday += 1;
+    tm_info.tm_hour = 0;
+    tm_info.tm_min = 0;
+    tm_info.tm_sec = 0;
+    tm_info.tm_isdst = -1;
+    time_t next_midnight = mktime(&tm_info);
+
+    if (midnight == (time_t)-1 || next_midnight == (time_t)-1)
+    {
+        return (int64_t)now + interval;
+    }
+
+    int64_t elapsed = (int64_t)now - (int64_t)midnight;
+    int64_t deadline = (int64_t)midnight + (elapsed / interval + 1) * (int64_t)interval;
+    return deadline < (int64_t)next_midnight ? deadline : (int64_t)next_midnight;
 }
 
 /**
@@ -193,70 +312,80 @@ static lz_log_error_t check_directory_access(const char *dir_path)
 }
 
 /**
- * 查找今日最新的日志文件编号（优化版：顺序查找而非遍历目录）
- * @param log_dir 日志目录
- * @param date_prefix 日期前缀（如 "2025-10-30"）
- * @param out_max_num 输出最大编号（如果不存在返回-1）
- * @return 错误码
+ * 获取当前日期数值
+ * @return yyyymmdd
  */
-static lz_log_error_t find_latest_log_number(const char *log_dir,
-                                             const char *date_prefix,
-                                             int *out_max_num)
+static uint32_t get_current_date_value(void)
 {
-    lz_log_error_t ret = LZ_LOG_SUCCESS;
-    int max_num = -1;
-    char file_path[768];
-    struct stat st;
-
-    do
-    {
-        // 从 0 开始顺序查找，找到最后一个存在的文件
-        for (int i = 0; i < LZ_LOG_MAX_DAILY_FILES; i++)
-        {
-            // 构造文件路径
-            int written = snprintf(file_path, sizeof(file_path),
-                                   "%s%c%s-%d.log",
-                                   log_dir, PATH_SEPARATOR, date_prefix, i);
-
-            if (written < 0 || written >= (int)sizeof(file_path))
-            {
-                ret = LZ_LOG_ERROR_INVALID_PARAM;
-                break;
-            }
-
-            // 检查文件是否存在
-            if (stat(file_path, &st) == 0)
-            {
-                max_num = i; // 更新最大编号
-            }
-        }
-
-        *out_max_num = max_num;
-
-    } while (0);
-
-    LZ_DEBUG_LOG("Find latest log number: %d (date=%s)", max_num, date_prefix);
+    time_t now = time(NULL);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    return (uint32_t)((tm_info.tm_year + 1900) * 10000 + (tm_info.tm_mon + 1) * 100 + tm_info.tm_mday);
+}
 
-    return ret;
+/**
+ * 获取当前时间（Unix 毫秒）
+ */
+static uint64_t get_current_time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
 }
 
 /**
  * 构造日志文件路径
  * @param log_dir 日志目录
- * @param date_str 日期字符串
+ * @param date 日期 yyyymmdd
  * @param file_num 文件编号
  * @param out_path 输出路径缓冲区
  * @param path_size 缓冲区大小
  */
 static void build_log_file_path(const char *log_dir,
-                                const char *date_str,
-                                int file_num,
+                                uint32_t date,
+                                uint32_t file_num,
                                 char *out_path,
                                 size_t path_size)
 {
     memset(out_path, 0, path_size);
-    snprintf(out_path, path_size, "%s%c%s-%d.log",
-             log_dir, PATH_SEPARATOR, date_str, file_num);
+    snprintf(out_path, path_size, "%s%c%04u-%02u-%02u-%u.log",
+             log_dir, PATH_SEPARATOR, date / 10000, (date / 100) % 100, date % 100, file_num);
+}
+
+/**
+ * 确定下一个日志文件编号
+ * @param manifest 目录清单
+ * @param log_dir 日志目录
+ * @param date 日期 yyyymmdd
+ * @param out_path 输出新文件路径
+ * @param path_size 缓冲区大小
+ * @return 新文件编号
+ *
+ * 编号在同一天内单调递增、不回绕，已删除文件的编号也不会复用（清单头部记录最近的文件名）；
+ * 日期变化后从 0 开始。清单之外残留的同名文件（例如清单被淘汰的条目）不会被覆盖，编号顺延。
+ */
+static uint32_t next_log_file_num(lz_manifest_t *manifest,
+                                  const char *log_dir,
+                                  uint32_t date,
+                                  char *out_path,
+                                  size_t path_size)
+{
+    uint32_t last_date = 0, last_num = 0;
+    uint32_t file_num = 0;
+    if (lz_manifest_last_name(manifest, &last_date, &last_num) && last_date == date)
+    {
+        file_num = last_num + 1;
+    }
+
+    build_log_file_path(log_dir, date, file_num, out_path, path_size);
+    while (access(out_path, F_OK) == 0)
+    {
+        LZ_DEBUG_LOG("Log file exists outside manifest, skipping: %s", out_path);
+        file_num++;
+        build_log_file_path(log_dir, date, file_num, out_path, path_size);
+    }
+
+    return file_num;
 }
 
 /**
@@ -316,13 +445,17 @@ static lz_log_error_t lz_file_preallocate(int fd, uint32_t size)
  * 创建并扩展日志文件
  * @param file_path 文件路径
  * @param file_size 文件大小
+ * @param magic 尾部魔数（普通文件 EndX，写入时压缩的块流 EndB）
  * @param out_fd 输出文件描述符
+ * @param salt 段盐（NULL 表示不加密，写入全0）
  * @return 错误码
+ * @note 盐随 footer 一起在这里 fsync，打开段之后不需要再同步
  */
 static lz_log_error_t create_and_extend_file(const char *file_path,
                                              uint32_t file_size,
+                                             uint32_t magic,
                                              int *out_fd,
-                                             lz_crypto_context_t *crypto_ctx)
+                                             const uint8_t *salt)
 {
     int fd = -1;
     lz_log_error_t ret = LZ_LOG_SUCCESS;
@@ -344,7 +477,7 @@ static lz_log_error_t create_and_extend_file(const char *file_path,
             break;
         }
 
-        // 写入文件尾部元数据：[盐16字节][ENDX魔数4字节][文件大小4字节][已用大小4字节]
+        // 写入文件尾部元数据：[盐16字节][魔数4字节][文件大小4字节][已用大小4字节]
         off_t footer_offset = file_size - LZ_LOG_FOOTER_SIZE;
 
         if (lseek(fd, footer_offset, SEEK_SET) != footer_offset)
@@ -354,20 +487,19 @@ static lz_log_error_t create_and_extend_file(const char *file_path,
         }
 
         // 写入盐值（如果启用加密则写入真实盐,否则写入全0）
-        uint8_t salt[LZ_LOG_SALT_SIZE] = {0};
-        if (crypto_ctx != NULL && crypto_ctx->is_initialized && crypto_ctx->salt_ptr != NULL)
+        uint8_t footer_salt[LZ_LOG_SALT_SIZE] = {0};
+        if (salt != NULL)
         {
-            memcpy(salt, crypto_ctx->salt_ptr, LZ_LOG_SALT_SIZE);
+            memcpy(footer_salt, salt, LZ_LOG_SALT_SIZE);
         }
 
-        if (write(fd, salt, LZ_LOG_SALT_SIZE) != LZ_LOG_SALT_SIZE)
+        if (write(fd, footer_salt, LZ_LOG_SALT_SIZE) != LZ_LOG_SALT_SIZE)
         {
             ret = LZ_LOG_ERROR_FILE_WRITE;
             break;
         }
 
         // 写入魔数
-        uint32_t magic = LZ_LOG_MAGIC_ENDX;
         if (write(fd, &magic, sizeof(magic)) != sizeof(magic))
         {
             ret = LZ_LOG_ERROR_FILE_WRITE;
@@ -417,15 +549,17 @@ static lz_log_error_t create_and_extend_file(const char *file_path,
  * 打开已存在的日志文件
  * @param file_path 文件路径
  * @param out_fd 输出文件描述符
+ * @param out_file_size 输出文件大小
  * @param out_used_size 输出已使用大小
+ * @param out_salt 输出盐值（16字节）
  * @return 错误码
  */
 static lz_log_error_t open_existing_file(const char *file_path,
                                          int *out_fd,
+                                         uint32_t *out_file_size,
                                          uint32_t *out_used_size,
-                                         lz_crypto_context_t *crypto_ctx)
+                                         uint8_t *out_salt)
 {
-    (void)crypto_ctx; // May be used in future for validation
     int fd = -1;
     lz_log_error_t ret = LZ_LOG_SUCCESS;
 
@@ -461,7 +595,7 @@ static lz_log_error_t open_existing_file(const char *file_path,
             break;
         }
 
-        // 跳过盐值读取(稍后通过mmap访问)
+        // 读取盐值（续写前检查与当前加密配置是否一致）
         uint8_t salt_buffer[LZ_LOG_SALT_SIZE];
         if (read(fd, salt_buffer, LZ_LOG_SALT_SIZE) != LZ_LOG_SALT_SIZE)
         {
@@ -518,7 +652,9 @@ static lz_log_error_t open_existing_file(const char *file_path,
         }
 
         *out_fd = fd;
+        *out_file_size = file_size_from_footer;
         *out_used_size = used_size;
+        memcpy(out_salt, salt_buffer, LZ_LOG_SALT_SIZE);
 
     } while (0);
 
@@ -531,37 +667,146 @@ static lz_log_error_t open_existing_file(const char *file_path,
 }
 
 /**
- * 执行 mmap 映射
- * @param fd 文件描述符
- * @param file_size 文件大小
- * @param out_offset_ptr 输出偏移量指针（指向footer中的used_size字段）
+ * 计算环形映射的总大小（数据区 + 块索引 + 扩展区 + footer，按页对齐）
+ * @param capacity 数据区容量（2 的幂）
+ * @return 映射总大小
+ */
+static uint32_t ring_map_size_for(uint32_t capacity)
+{
+    uint32_t meta = (capacity >> LZ_LOG_RING_BLOCK_SHIFT) * (uint32_t)sizeof(uint64_t) +
+                    LZ_LOG_CIRCULAR_EXT_SIZE + LZ_LOG_FOOTER_SIZE;
+    meta = (meta + 4095u) & ~4095u;
+    return capacity + meta;
+}
+
+/**
+ * 把环形模式的指针指向映射中的各个区域
+ * @param ctx 日志上下文
+ * @param base 映射起始地址
+ * @param capacity 数据区容量
+ * @param map_size 映射总大小
+ */
+static void ring_attach(lz_logger_context_t *ctx, uint8_t *base, uint32_t capacity, uint32_t map_size)
+{
+    // 映射大小按页对齐，扩展区起始 = map_size - 48，8 字节对齐
+    uint8_t *ext = base + map_size - LZ_LOG_FOOTER_SIZE - LZ_LOG_CIRCULAR_EXT_SIZE;
+
+    ctx->ring_base = base;
+    ctx->ring_capacity = capacity;
+    ctx->ring_map_size = map_size;
+    ctx->ring_cursor = (atomic_uint_least64_t *)ext;
+    ctx->ring_oldest = (atomic_uint_least64_t *)(ext + 8);
+    ctx->ring_index = (atomic_uint_least64_t *)(base + capacity);
+}
+
+/**
+ * 初始化新映射的扩展区和 footer（游标、最旧记录、块索引均为 0）
+ * @param base 映射起始地址（内容已清零）
+ * @param capacity 数据区容量
+ * @param map_size 映射总大小
+ */
+static void ring_format(uint8_t *base, uint32_t capacity, uint32_t map_size)
+{
+    uint8_t *ext = base + map_size - LZ_LOG_FOOTER_SIZE - LZ_LOG_CIRCULAR_EXT_SIZE;
+    uint8_t *footer = base + map_size - LZ_LOG_FOOTER_SIZE;
+    uint32_t block_size = 1u << LZ_LOG_RING_BLOCK_SHIFT;
+    uint32_t magic = LZ_LOG_MAGIC_ENDC;
+
+    memcpy(ext + 16, &block_size, sizeof(block_size));
+    memcpy(footer + LZ_LOG_SALT_SIZE, &magic, sizeof(magic));
+    memcpy(footer + LZ_LOG_SALT_SIZE + 4, &map_size, sizeof(map_size));
+    memcpy(footer + LZ_LOG_SALT_SIZE + 8, &capacity, sizeof(capacity));
+}
+
+/**
+ * 打开或创建循环日志文件
+ * @param file_path 文件路径
+ * @param map_size 新建时的文件大小
+ * @param capacity 新建时的数据区容量
+ * @param out_fd 输出文件描述符
+ * @param out_map_size 输出文件大小（沿用已存在文件时为其原大小）
+ * @param out_capacity 输出数据区容量
+ * @param out_created 输出是否新建
  * @return 错误码
+ * @note 已存在的文件格式无效（损坏或不是循环日志）时删除后重新创建
  */
-static lz_log_error_t do_mmap_mapping(int fd,
-                                      uint32_t file_size,
-                                      atomic_uint_least32_t **out_offset_ptr)
+static lz_log_error_t open_circular_file(const char *file_path,
+                                         uint32_t map_size,
+                                         uint32_t capacity,
+                                         int *out_fd,
+                                         uint32_t *out_map_size,
+                                         uint32_t *out_capacity,
+                                         bool *out_created)
 {
-    void *ptr = NULL;
+    int fd = -1;
     lz_log_error_t ret = LZ_LOG_SUCCESS;
 
     do
     {
-        // 执行 mmap 映射（读写、共享）
-        ptr = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-        if (ptr == MAP_FAILED)
+        fd = open(file_path, O_RDWR);
+        if (fd >= 0)
         {
-            ret = LZ_LOG_ERROR_MMAP_FAILED;
+            // 校验 footer: [盐16字节][魔数 EndC 4字节][文件大小4字节][数据区容量4字节]
+            struct stat st;
+            uint8_t footer[LZ_LOG_FOOTER_SIZE];
+            uint32_t magic = 0;
+            uint32_t footer_file_size = 0;
+            uint32_t footer_capacity = 0;
+
+            if (fstat(fd, &st) == 0 && st.st_size > LZ_LOG_FOOTER_SIZE &&
+                pread(fd, footer, sizeof(footer), st.st_size - LZ_LOG_FOOTER_SIZE) == (ssize_t)sizeof(footer))
+            {
+                memcpy(&magic, footer + LZ_LOG_SALT_SIZE, sizeof(magic));
+                memcpy(&footer_file_size, footer + LZ_LOG_SALT_SIZE + 4, sizeof(footer_file_size));
+                memcpy(&footer_capacity, footer + LZ_LOG_SALT_SIZE + 8, sizeof(footer_capacity));
+            }
+
+            if (magic == LZ_LOG_MAGIC_ENDC &&
+                footer_file_size == (uint32_t)st.st_size &&
+                footer_capacity >= LZ_LOG_MIN_FILE_SIZE &&
+                (footer_capacity & (footer_capacity - 1)) == 0 &&
+                ring_map_size_for(footer_capacity) == footer_file_size)
+            {
+                *out_fd = fd;
+                *out_map_size = footer_file_size;
+                *out_capacity = footer_capacity;
+                *out_created = false;
+                break;
+            }
+
+            LZ_DEBUG_LOG("Invalid circular log file, recreating: magic=0x%x, size=%u", magic, footer_file_size);
+            close(fd);
+            fd = -1;
+            unlink(file_path);
+        }
+
+        // 创建新文件（预分配防止 SIGBUS，内容全部为 0）
+        fd = open(file_path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_CREATE;
             break;
         }
 
-        // 计算偏移量指针位置：footer 最后4字节（used_size字段）
-        atomic_uint_least32_t *offset_ptr =
-            (atomic_uint_least32_t *)((uint8_t *)ptr + file_size - sizeof(uint32_t));
+        ret = lz_file_preallocate(fd, map_size);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
 
-        *out_offset_ptr = offset_ptr;
+        *out_fd = fd;
+        *out_map_size = map_size;
+        *out_capacity = capacity;
+        *out_created = true;
 
     } while (0);
 
+    if (ret != LZ_LOG_SUCCESS && fd >= 0)
+    {
+        close(fd);
+        unlink(file_path); // 删除不完整的文件
+    }
+
     return ret;
 }
 
@@ -569,6 +814,34 @@ static lz_log_error_t do_mmap_mapping(int fd,
 // Public API Implementation
 // ============================================================================
 
+/**
+ * 按全局配置启动预生成密钥流（未配置或未加密时不启动）
+ * @param ctx 日志上下文
+ * @param crypto 当前段（环）的加密上下文
+ * @param offset 当前写入偏移（循环文件为逻辑偏移）
+ * @return 错误码
+ */
+static lz_log_error_t start_keystream(lz_logger_context_t *ctx, const lz_crypto_context_t *crypto, uint64_t offset)
+{
+    uint32_t ring_size = atomic_load(&g_keystream_size);
+    if (ring_size == 0 || !crypto->is_initialized)
+    {
+        return LZ_LOG_SUCCESS;
+    }
+
+    return lz_keystream_start(ring_size, atomic_load(&g_keystream_lookahead),
+                              (lz_log_keystream_fallback_t)atomic_load(&g_keystream_fallback),
+                              crypto, offset, &ctx->keystream);
+}
+
+// 写入时压缩的块追加回调（见 Write Implementation）
+static lz_log_error_t inline_emit_block(void *user,
+                                        const lz_compress_block_header_t *header,
+                                        uint8_t *payload);
+
+// 在后台线程中派生当前段的密钥（见 Key Derivation）
+static void start_key_derivation(lz_logger_context_t *ctx);
+
 lz_log_error_t lz_logger_set_max_file_size(uint32_t size)
 {
     do
@@ -589,6 +862,131 @@ lz_log_error_t lz_logger_set_max_file_size(uint32_t size)
     return LZ_LOG_SUCCESS;
 }
 
+lz_log_error_t lz_logger_set_rotate_interval(uint32_t seconds)
+{
+    if (seconds != 0 &&
+        (seconds < LZ_LOG_MIN_ROTATE_INTERVAL || seconds > LZ_LOG_ROTATE_DAILY))
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    atomic_store(&g_rotate_interval, seconds);
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_logger_set_retention(uint64_t max_total_bytes, uint32_t max_days)
+{
+    atomic_store(&g_retention_bytes, max_total_bytes);
+    atomic_store(&g_retention_days, max_days);
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_logger_set_compression(lz_log_compress_mode_t mode)
+{
+    if (mode != LZ_LOG_COMPRESS_NONE && mode != LZ_LOG_COMPRESS_SEALED &&
+        mode != LZ_LOG_COMPRESS_INLINE)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    atomic_store(&g_compress_mode, (int)mode);
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_logger_set_string_interning(int32_t enabled)
+{
+    atomic_store(&g_intern_strings, enabled != 0);
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_logger_set_thread_name(const char *name)
+{
+    lz_format_set_thread_name(name);
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_logger_clear_key_cache(void)
+{
+    lz_crypto_clear_cache();
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_logger_set_keystream(uint32_t ring_size,
+                                       uint32_t lookahead,
+                                       lz_log_keystream_fallback_t fallback)
+{
+    if (ring_size != 0 &&
+        (ring_size < LZ_LOG_KEYSTREAM_MIN_SIZE || ring_size > LZ_LOG_KEYSTREAM_MAX_SIZE ||
+         (ring_size & (ring_size - 1)) != 0 ||
+         lookahead == 0 || lookahead > ring_size - LZ_KEYSTREAM_CHUNK_SIZE))
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+    if (fallback != LZ_LOG_KEYSTREAM_FALLBACK_COMPUTE && fallback != LZ_LOG_KEYSTREAM_FALLBACK_WAIT)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    atomic_store(&g_keystream_size, ring_size);
+    atomic_store(&g_keystream_lookahead, lookahead);
+    atomic_store(&g_keystream_fallback, (int)fallback);
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_logger_set_cipher(lz_log_cipher_t cipher)
+{
+    if (cipher != LZ_LOG_CIPHER_AES_CTR && cipher != LZ_LOG_CIPHER_CHACHA20 &&
+        cipher != LZ_LOG_CIPHER_AUTO)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    atomic_store(&g_cipher, (int)cipher);
+    return LZ_LOG_SUCCESS;
+}
+
+/**
+ * 按全局配置确定新建文件使用的流密码
+ * @return 流密码（AUTO 时没有 AES 指令则选 ChaCha20）
+ */
+static lz_crypto_cipher_t resolve_cipher(void)
+{
+    switch (atomic_load(&g_cipher))
+    {
+    case LZ_LOG_CIPHER_CHACHA20:
+        return LZ_CRYPTO_CIPHER_CHACHA20;
+    case LZ_LOG_CIPHER_AUTO:
+        return lz_crypto_has_aes_hardware() ? LZ_CRYPTO_CIPHER_AES_CTR : LZ_CRYPTO_CIPHER_CHACHA20;
+    default:
+        return LZ_CRYPTO_CIPHER_AES_CTR;
+    }
+}
+
+/**
+ * 释放句柄对主密钥缓存的引用并擦除句柄保存的密码（关闭和打开失败时调用）
+ * @param ctx 日志上下文
+ */
+static void release_key(lz_logger_context_t *ctx)
+{
+    if (ctx->encrypt_key[0] != '\0')
+    {
+        lz_crypto_cache_release(ctx->encrypt_key);
+        lz_crypto_secure_zero(ctx->encrypt_key, sizeof(ctx->encrypt_key));
+    }
+}
+
+lz_log_error_t lz_logger_set_sink_type(lz_log_sink_type_t type)
+{
+    if (type != LZ_LOG_SINK_MMAP && type != LZ_LOG_SINK_PWRITE &&
+        type != LZ_LOG_SINK_DIRECT && type != LZ_LOG_SINK_URING)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    atomic_store(&g_sink_type, (int)type);
+    return LZ_LOG_SUCCESS;
+}
+
 lz_log_error_t lz_logger_open(const char *log_dir,
                               const char *encrypt_key,
                               lz_logger_handle_t *out_handle,
@@ -625,9 +1023,15 @@ lz_log_error_t lz_logger_open(const char *log_dir,
             ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
             break;
         }
+        lz_binlog_state_init(&ctx->binlog);
+        if (atomic_load(&g_intern_strings) && !lz_binlog_enable_strings(&ctx->binlog))
+        {
+            LZ_DEBUG_LOG("String dictionary disabled: out of memory");
+        }
 
         // 初始化字段（calloc 已经清零，这里设置特殊值）
-        atomic_store(&ctx->old_offset_ptr, NULL);
+        atomic_store(&ctx->cur_segment, NULL);
+        atomic_store(&ctx->old_segment, NULL);
 
         // 初始化互斥锁
         if (pthread_mutex_init(&ctx->switch_mutex, NULL) != 0)
@@ -636,6 +1040,20 @@ lz_log_error_t lz_logger_open(const char *log_dir,
             ret = LZ_LOG_ERROR_MUTEX_LOCK;
             break;
         }
+        if (pthread_mutex_init(&ctx->key_mutex, NULL) != 0)
+        {
+            pthread_mutex_destroy(&ctx->switch_mutex);
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        if (pthread_cond_init(&ctx->key_cond, NULL) != 0)
+        {
+            pthread_mutex_destroy(&ctx->key_mutex);
+            pthread_mutex_destroy(&ctx->switch_mutex);
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        atomic_store(&ctx->key_state, LZ_LOG_KEY_READY);
 
         // 初始化上下文
         strncpy(ctx->log_dir, log_dir, sizeof(ctx->log_dir) - 1);
@@ -644,61 +1062,101 @@ lz_log_error_t lz_logger_open(const char *log_dir,
         if (encrypt_key != NULL && strlen(encrypt_key) > 0)
         {
             strncpy(ctx->encrypt_key, encrypt_key, sizeof(ctx->encrypt_key) - 1);
+            lz_crypto_cache_retain(ctx->encrypt_key);
             LZ_DEBUG_LOG("Encryption key provided");
         }
+        ctx->cipher = resolve_cipher();
 
-        ctx->max_file_size = atomic_load(&g_max_file_size);
+        lz_log_sink_type_t sink_type = (lz_log_sink_type_t)atomic_load(&g_sink_type);
+        ctx->max_file_size = lz_sink_adjust_file_size(sink_type, atomic_load(&g_max_file_size));
+        ctx->rotate_interval = atomic_load(&g_rotate_interval);
         atomic_store(&ctx->is_closed, false);
+        lz_log_compress_mode_t compress_mode = (lz_log_compress_mode_t)atomic_load(&g_compress_mode);
+        bool inline_mode = (compress_mode == LZ_LOG_COMPRESS_INLINE);
 
-        LZ_DEBUG_LOG("Context initialized: log_dir=%s, max_file_size=%u, encrypted=%d",
-                     log_dir, ctx->max_file_size, ctx->crypto_ctx.is_initialized);
-
-        // 获取当前日期
-        char date_str[16];
-        get_current_date_string(date_str, sizeof(date_str));
+        // 创建存储后端
+        ret = lz_sink_create(sink_type, &ctx->sink);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            sys_errno = errno;
+            LZ_DEBUG_LOG("Failed to create sink: %d", ret);
+            break;
+        }
 
-        LZ_DEBUG_LOG("Current date: %s", date_str);
+        LZ_DEBUG_LOG("Context initialized: log_dir=%s, max_file_size=%u, sink=%d, encrypted=%d",
+                     log_dir, ctx->max_file_size, sink_type, ctx->encrypt_key[0] != '\0');
 
-        // 查找今日最新的日志文件编号
-        int max_num = -1;
-        ret = find_latest_log_number(log_dir, date_str, &max_num);
+        // 打开目录清单（不存在或损坏时遍历目录重建）
+        ret = lz_manifest_open(log_dir, &ctx->manifest);
         if (ret != LZ_LOG_SUCCESS)
         {
-            LZ_DEBUG_LOG("Failed to find latest log number: %d", ret);
+            sys_errno = errno;
+            LZ_DEBUG_LOG("Failed to open manifest: %d", ret);
             break;
         }
 
-        LZ_DEBUG_LOG("Found max log number: %d", max_num);
+        // 获取当前日期
+        uint32_t date = get_current_date_value();
+
+        LZ_DEBUG_LOG("Current date: %u", date);
+
+        // 从清单中取最新的日志段（不再逐个 stat 探测文件）
+        lz_manifest_entry_t newest;
+        // 写入时压缩不续写已有文件（块流不能接在原文之后，上次未提交的块也无从补齐）
+        bool has_today = !inline_mode &&
+                         lz_manifest_newest(ctx->manifest, &newest) && newest.date == date;
 
-        // 尝试打开已存在的文件或创建新文件
-        int file_num = (max_num >= 0) ? max_num : 0;
+        LZ_DEBUG_LOG("Newest segment today: %d (num=%u)", has_today, has_today ? newest.file_num : 0);
+
+        // 尝试续写今日最新的文件，否则创建新文件
+        uint32_t file_num = 0;
+        uint32_t file_size = ctx->max_file_size;
         uint32_t used_size = 0;
-        if (max_num >= 0)
+        bool reuse_entry = false;
+        bool encrypted = (ctx->encrypt_key[0] != '\0');
+        if (has_today)
         {
             // 尝试打开已存在的文件
-            build_log_file_path(log_dir, date_str, file_num,
+            file_num = newest.file_num;
+            build_log_file_path(log_dir, date, file_num,
                                 ctx->current_file_path, sizeof(ctx->current_file_path));
 
-            ret = open_existing_file(ctx->current_file_path, &fd, &used_size, NULL);
+            uint8_t existing_salt[LZ_LOG_SALT_SIZE];
+            ret = open_existing_file(ctx->current_file_path, &fd, &file_size, &used_size, existing_salt);
 
-            // 如果文件已满，创建新文件
+            // 如果文件已满（或不满足当前后端的要求），创建新文件
+            // 加密配置或流密码不一致（含旧版盐：所有段共用一个密钥，不再续写）时同样创建新文件
             if (ret == LZ_LOG_SUCCESS &&
-                used_size >= ctx->max_file_size - LZ_LOG_FOOTER_SIZE)
+                (used_size >= lz_sink_capacity(sink_type, file_size) ||
+                 lz_crypto_salt_version(existing_salt) != (encrypted ? 2 : 0) ||
+                 (encrypted && lz_crypto_salt_cipher(existing_salt) != ctx->cipher)))
             {
                 close(fd);
                 fd = -1;
-                file_num++;
                 ret = LZ_LOG_ERROR_FILE_NOT_FOUND; // 标记需要创建新文件
             }
+            reuse_entry = (fd >= 0);
         }
 
         // 如果需要创建新文件
         if (fd < 0)
         {
-            build_log_file_path(log_dir, date_str, file_num,
-                                ctx->current_file_path, sizeof(ctx->current_file_path));
+            file_num = next_log_file_num(ctx->manifest, log_dir, date,
+                                         ctx->current_file_path, sizeof(ctx->current_file_path));
+
+            // 新文件使用新的主盐（盐随 footer 一起写入并 fsync）
+            uint8_t salt[LZ_LOG_SALT_SIZE];
+            if (encrypted && lz_crypto_generate_salt(ctx->cipher, salt) != 0)
+            {
+                LZ_DEBUG_LOG("Failed to generate salt");
+                ret = LZ_LOG_ERROR_FILE_CREATE;
+                break;
+            }
 
-            ret = create_and_extend_file(ctx->current_file_path, ctx->max_file_size, &fd, NULL);
+            file_size = ctx->max_file_size;
+            ret = create_and_extend_file(ctx->current_file_path, file_size,
+                                         inline_mode ? LZ_LOG_MAGIC_ENDB : LZ_LOG_MAGIC_ENDX, &fd,
+                                         encrypted ? salt : NULL);
             if (ret != LZ_LOG_SUCCESS)
             {
                 sys_errno = errno;
@@ -708,83 +1166,121 @@ lz_log_error_t lz_logger_open(const char *log_dir,
             used_size = 0; // 新文件初始偏移为0
         }
 
-        // 执行 mmap 映射
-        atomic_uint_least32_t *offset_ptr = NULL;
-        ret = do_mmap_mapping(fd, ctx->max_file_size, &offset_ptr);
+        // 在文件上打开日志段（mmap 映射或分配写缓冲，fd 所有权转移给 sink）
+        lz_segment_t *segment = NULL;
+        ret = lz_sink_open_segment(ctx->sink, ctx->current_file_path, fd,
+                                   file_size, used_size, &segment);
         if (ret != LZ_LOG_SUCCESS)
         {
             sys_errno = errno;
-            LZ_DEBUG_LOG("Failed to mmap: %d, errno=%d", ret, sys_errno);
+            LZ_DEBUG_LOG("Failed to open segment: %d, errno=%d", ret, sys_errno);
             break;
         }
-
-        // mmap 完成后即可关闭文件描述符
-        close(fd);
         fd = -1;
 
-        // 原子初始化 cur_offset_ptr
-        atomic_store(&ctx->cur_offset_ptr, offset_ptr);
-
-        uint32_t file_size = get_file_size_from_offset_ptr(offset_ptr);
-        void *mmap_base = get_mmap_base_from_offset_ptr(offset_ptr);
+        // 原子初始化 cur_segment
+        atomic_store(&ctx->cur_segment, segment);
 
-        LZ_DEBUG_LOG("mmap succeeded: mmap_base=%p, file_size=%u", mmap_base, file_size);
+        LZ_DEBUG_LOG("Segment opened: file_size=%u, capacity=%u", segment->file_size, segment->capacity);
 
-        // 初始化加密上下文(如果提供了密钥)
-        if (ctx->encrypt_key[0] != '\0')
+        // 初始化段密钥(如果提供了密钥)：主密钥已缓存时只需 HKDF，
+        // 否则 PBKDF2 在后台线程中执行（返回前启动，见 start_key_derivation）
+        bool key_async = false;
+        if (encrypted)
         {
-            // 设置salt_ptr指向mmap中footer的盐区域
-            ctx->crypto_ctx.salt_ptr = (uint8_t *)mmap_base + file_size - LZ_LOG_FOOTER_SIZE;
-
-            // 如果是新文件,需要生成新盐
-            if (used_size == 0)
-            {
-                uint8_t temp_salt[LZ_LOG_SALT_SIZE];
-                if (lz_crypto_generate_salt(temp_salt) != 0)
-                {
-                    LZ_DEBUG_LOG("Failed to generate salt");
-                    ret = LZ_LOG_ERROR_FILE_CREATE;
-                    break;
-                }
-                memcpy(ctx->crypto_ctx.salt_ptr, temp_salt, LZ_LOG_SALT_SIZE);
-                msync(mmap_base, file_size, MS_SYNC);
-                LZ_DEBUG_LOG("Generated new salt for file");
-            }
-
-            // 使用盐初始化加密上下文
-            if (lz_crypto_init(&ctx->crypto_ctx, ctx->encrypt_key, ctx->crypto_ctx.salt_ptr) != 0)
+            key_async = !lz_crypto_key_cached(ctx->encrypt_key, segment->footer);
+            if (!key_async &&
+                lz_crypto_init(&segment->crypto, ctx->encrypt_key, segment->footer) != 0)
             {
                 LZ_DEBUG_LOG("Failed to initialize encryption");
                 ret = LZ_LOG_ERROR_FILE_CREATE;
                 break;
             }
 
-            LZ_DEBUG_LOG("Encryption initialized");
+            LZ_DEBUG_LOG("Encryption initialized: async=%d", key_async);
         }
 
         // 同步文件中的偏移量（如果不一致则更新）
-        atomic_uint_least32_t *current_offset_ptr = atomic_load(&ctx->cur_offset_ptr);
-        uint32_t file_offset = atomic_load(current_offset_ptr);
+        uint32_t file_offset = atomic_load(segment->offset_ptr);
         if (file_offset != used_size)
         {
             LZ_DEBUG_LOG("Sync offset: file=%u, expected=%u", file_offset, used_size);
-            atomic_store(current_offset_ptr, used_size);
-            msync(mmap_base, file_size, MS_SYNC);
+            atomic_store(segment->offset_ptr, used_size);
+            lz_sink_sync(segment, true);
         }
 
-        LZ_DEBUG_LOG("Logger opened successfully: file=%s, offset=%u",
-                     ctx->current_file_path, used_size);
+        // 登记到清单：续写已有文件时复用其条目，否则追加新条目
+        uint64_t now_ms = get_current_time_ms();
+        if (reuse_entry)
+        {
+            ctx->manifest_seq = newest.seq;
+            lz_manifest_update(ctx->manifest, newest.seq, used_size, LZ_SEGMENT_STATE_ACTIVE, now_ms);
+        }
+        else
+        {
+            lz_manifest_append(ctx->manifest, date, file_num, file_size, used_size,
+                               now_ms, &ctx->manifest_seq);
+        }
+        atomic_store(&ctx->level_counts, lz_manifest_level_counts(ctx->manifest, ctx->manifest_seq));
 
-        *out_handle = ctx;
-        ret = LZ_LOG_SUCCESS;
+        // 按时间轮转的第一个边界
+        atomic_store(&ctx->rotate_deadline, next_rotate_deadline(ctx->rotate_interval));
 
-    } while (0);
+        // 启动后台维护线程（压实或压缩已封存的段、执行保留策略），并立即执行一轮
+        ret = lz_housekeeper_start(log_dir, ctx->manifest,
+                                   atomic_load(&g_retention_bytes), atomic_load(&g_retention_days),
+                                   compress_mode != LZ_LOG_COMPRESS_NONE, ctx->encrypt_key,
+                                   &ctx->housekeeper);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            sys_errno = errno;
+            LZ_DEBUG_LOG("Failed to start housekeeper: %d", ret);
+            break;
+        }
+        lz_housekeeper_notify(ctx->housekeeper, ctx->manifest_seq, ctx->manifest_seq);
 
-    if (fd >= 0)
-    {
-        close(fd);
-        fd = -1;
-    }
+        // 写入时压缩：启动压缩线程（之后的写入都经由暂存块）
+        if (inline_mode)
+        {
+            ret = lz_packer_start(inline_emit_block, ctx, &ctx->packer);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                sys_errno = errno;
+                LZ_DEBUG_LOG("Failed to start packer: %d", ret);
+                break;
+            }
+        }
+        else if (!key_async)
+        {
+            // 预生成密钥流（写入时压缩模式下加密在压缩线程中进行，不需要；后台派生时由派生线程启动）
+            ret = start_keystream(ctx, &segment->crypto, used_size);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                sys_errno = errno;
+                LZ_DEBUG_LOG("Failed to start keystream: %d", ret);
+                break;
+            }
+        }
+
+        // 最后启动后台派生（之后不会再失败，派生线程不需要在错误路径中回收）
+        if (key_async)
+        {
+            start_key_derivation(ctx);
+        }
+
+        LZ_DEBUG_LOG("Logger opened successfully: file=%s, offset=%u, seq=%llu",
+                     ctx->current_file_path, used_size, (unsigned long long)ctx->manifest_seq);
+
+        *out_handle = ctx;
+        ret = LZ_LOG_SUCCESS;
+
+    } while (0);
+
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
 
     // 错误处理：清理资源
     if (ret != LZ_LOG_SUCCESS)
@@ -792,20 +1288,33 @@ lz_log_error_t lz_logger_open(const char *log_dir,
         LZ_DEBUG_LOG("Open failed with error: %d", ret);
         if (ctx != NULL)
         {
-            // 如果已经创建了 mmap，需要清理
-            atomic_uint_least32_t *offset_ptr = atomic_load(&ctx->cur_offset_ptr);
-            if (offset_ptr != NULL)
+            lz_housekeeper_stop(ctx->housekeeper);
+            lz_keystream_stop(ctx->keystream);
+
+            // 如果已经打开了日志段，需要清理
+            lz_segment_t *segment = atomic_load(&ctx->cur_segment);
+            if (segment != NULL)
+            {
+                lz_sink_release_segment(segment, false);
+            }
+            if (ctx->sink != NULL)
             {
-                void *mmap_base = get_mmap_base_from_offset_ptr(offset_ptr);
-                uint32_t file_size = get_file_size_from_offset_ptr(offset_ptr);
-                munmap(mmap_base, file_size);
+                lz_sink_destroy(ctx->sink);
+            }
+            if (ctx->manifest != NULL)
+            {
+                lz_manifest_close(ctx->manifest);
             }
             // 只有在成功初始化后才销毁 mutex
             // calloc 已清零，检查 log_dir 是否被设置来判断 mutex 是否已初始化
             if (ctx->log_dir[0] != '\0')
             {
+                pthread_cond_destroy(&ctx->key_cond);
+                pthread_mutex_destroy(&ctx->key_mutex);
                 pthread_mutex_destroy(&ctx->switch_mutex);
             }
+            release_key(ctx);
+            lz_binlog_state_destroy(&ctx->binlog);
             free(ctx);
         }
 
@@ -828,403 +1337,1657 @@ lz_log_error_t lz_logger_open(const char *log_dir,
     return ret;
 }
 
-const char *lz_logger_error_string(lz_log_error_t error)
-{
-    switch (error)
-    {
-    case LZ_LOG_SUCCESS:
-        return "Success";
-    case LZ_LOG_ERROR_INVALID_PARAM:
-        return "Invalid parameter";
-    case LZ_LOG_ERROR_INVALID_HANDLE:
-        return "Invalid handle";
-    case LZ_LOG_ERROR_OUT_OF_MEMORY:
-        return "Out of memory";
-    case LZ_LOG_ERROR_FILE_NOT_FOUND:
-        return "File not found";
-    case LZ_LOG_ERROR_FILE_CREATE:
-        return "File create failed";
-    case LZ_LOG_ERROR_FILE_OPEN:
-        return "File open failed";
-    case LZ_LOG_ERROR_FILE_WRITE:
-        return "File write failed";
-    case LZ_LOG_ERROR_FILE_EXTEND:
-        return "File extend failed";
-    case LZ_LOG_ERROR_MMAP_FAILED:
-        return "Mmap failed";
-    case LZ_LOG_ERROR_MUNMAP_FAILED:
-        return "Munmap failed";
-    case LZ_LOG_ERROR_FILE_SIZE_EXCEED:
-        return "File size exceeded";
-    case LZ_LOG_ERROR_INVALID_MMAP:
-        return "Invalid mmap pointer";
-    case LZ_LOG_ERROR_DIR_ACCESS:
-        return "Directory access failed";
-    case LZ_LOG_ERROR_HANDLE_CLOSED:
-        return "Handle closed";
-    case LZ_LOG_ERROR_FILE_SWITCH:
-        return "File switch failed";
-    case LZ_LOG_ERROR_MUTEX_LOCK:
-        return "Mutex lock failed";
-    case LZ_LOG_ERROR_SYSTEM:
-        return "System error";
-    default:
-        return "Unknown error";
-    }
-}
-
-// ============================================================================
-// Write Implementation
-// ============================================================================
-
-/**
- * 流式加密（预留接口）
- * @param ctx 日志上下文
- * @param data 数据指针
- * @param len 数据长度
- * @return 错误码
- */
-static lz_log_error_t encrypt_data(lz_logger_context_t *ctx,
-                                   void *data,
-                                   uint32_t len,
-                                   uint32_t offset)
-{
-    // 如果没有初始化加密,直接返回(不加密)
-    if (!ctx->crypto_ctx.is_initialized)
-    {
-        return LZ_LOG_SUCCESS;
-    }
-
-    // AES-CTR 加密 (原地操作)
-    int result = lz_crypto_process(
-        &ctx->crypto_ctx,
-        (const uint8_t *)data,
-        (uint8_t *)data,
-        len,
-        offset);
-
-    return (result == 0) ? LZ_LOG_SUCCESS : LZ_LOG_ERROR_DIR_ACCESS; // 复用错误码
-}
-
-/**
- * 添加旧 offset_ptr 到延迟销毁
- * @param ctx 日志上下文
- * @param old_offset_ptr 旧的 offset_ptr 指针
- */
-static void add_old_offset_ptr(lz_logger_context_t *ctx, atomic_uint_least32_t *old_offset_ptr)
-{
-    // 清理旧的offset_ptr（如果存在）
-    atomic_uint_least32_t *prev_old_offset_ptr = atomic_load(&ctx->old_offset_ptr);
-    if (prev_old_offset_ptr != NULL)
-    {
-        void *old_mmap_base = get_mmap_base_from_offset_ptr(prev_old_offset_ptr);
-        uint32_t old_file_size = get_file_size_from_offset_ptr(prev_old_offset_ptr);
-        munmap(old_mmap_base, old_file_size);
-    }
-
-    // 保存新的old offset_ptr
-    atomic_store(&ctx->old_offset_ptr, old_offset_ptr);
-}
-
-/**
- * 切换到新的日志文件（无锁方式）
- * @param ctx 日志上下文
- * @return 错误码
- * @note 调用者必须持有 switch_mutex 锁
- */
-static lz_log_error_t switch_to_new_file(lz_logger_context_t *ctx)
+lz_log_error_t lz_logger_open_memory(uint32_t capacity,
+                                     const char *encrypt_key,
+                                     lz_logger_handle_t *out_handle)
 {
+    lz_logger_context_t *ctx = NULL;
     lz_log_error_t ret = LZ_LOG_SUCCESS;
-    int new_fd = -1;
-    atomic_uint_least32_t *new_offset_ptr = NULL;
-
-    // 保存旧的 offset_ptr（用于延迟清理）
-    atomic_uint_least32_t *old_offset_ptr = atomic_load(&ctx->cur_offset_ptr);
-
-    LZ_DEBUG_LOG("Starting file switch, old_file=%s", ctx->current_file_path);
+    bool mutex_ready = false;
 
     do
     {
-        // 获取当前日期
-        char date_str[16];
-        get_current_date_string(date_str, sizeof(date_str));
-
-        // 查找今日最新的日志文件编号
-        int max_num = -1;
-        ret = find_latest_log_number(ctx->log_dir, date_str, &max_num);
-        if (ret != LZ_LOG_SUCCESS)
+        // 参数校验：容量范围与文件大小一致
+        if (out_handle == NULL ||
+            capacity < LZ_LOG_MIN_FILE_SIZE || capacity > LZ_LOG_MAX_FILE_SIZE)
         {
-            LZ_DEBUG_LOG("Failed to find latest log number during switch");
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
             break;
         }
 
-        // 创建新文件（编号 +1）
-        int new_file_num = (max_num >= 0) ? (max_num + 1) : 0;
-
-        // 如果达到最大文件数量限制，删除0号文件并重用编号
-        if (new_file_num >= LZ_LOG_MAX_DAILY_FILES)
+        // 容量向上取整到 2 的幂，环内偏移用掩码计算
+        uint32_t ring_capacity = LZ_LOG_MIN_FILE_SIZE;
+        while (ring_capacity < capacity)
         {
-            char file_to_delete[768];
-            build_log_file_path(ctx->log_dir, date_str, 0,
-                                file_to_delete, sizeof(file_to_delete));
-
-            if (unlink(file_to_delete) == 0)
-            {
-                LZ_DEBUG_LOG("Deleted oldest log file: %s", file_to_delete);
-            }
-            else
-            {
-                LZ_DEBUG_LOG("Failed to delete oldest log file: %s (errno=%d)",
-                             file_to_delete, errno);
-            }
+            ring_capacity <<= 1;
+        }
 
-            // 重用0号文件编号
-            new_file_num = 0;
+        // 分配上下文结构
+        ctx = (lz_logger_context_t *)calloc(1, sizeof(lz_logger_context_t));
+        if (ctx == NULL)
+        {
+            LZ_DEBUG_LOG("Failed to allocate context memory");
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        lz_binlog_state_init(&ctx->binlog);
+        if (atomic_load(&g_intern_strings) && !lz_binlog_enable_strings(&ctx->binlog))
+        {
+            LZ_DEBUG_LOG("String dictionary disabled: out of memory");
+        }
+        if (!lz_binlog_enable_roster(&ctx->binlog))
+        {
+            LZ_DEBUG_LOG("Thread name replay disabled: out of memory");
         }
 
-        char new_file_path[768];
-        build_log_file_path(ctx->log_dir, date_str, new_file_num,
-                            new_file_path, sizeof(new_file_path));
+        atomic_store(&ctx->cur_segment, NULL);
+        atomic_store(&ctx->old_segment, NULL);
+        atomic_store(&ctx->ring_writers, 0);
+        atomic_store(&ctx->ring_frozen, false);
 
-        ret = create_and_extend_file(new_file_path, ctx->max_file_size, &new_fd, NULL);
-        if (ret != LZ_LOG_SUCCESS)
+        // 匿名映射：按需分配物理页，不产生任何文件 I/O（布局与循环文件相同）
+        uint32_t map_size = ring_map_size_for(ring_capacity);
+        void *ring = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED)
         {
+            LZ_DEBUG_LOG("Failed to map memory ring: errno=%d", errno);
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
             break;
         }
+        ring_format((uint8_t *)ring, ring_capacity, map_size);
+        ring_attach(ctx, (uint8_t *)ring, ring_capacity, map_size);
 
-        // 执行新的 mmap 映射
-        ret = do_mmap_mapping(new_fd, ctx->max_file_size, &new_offset_ptr);
-        if (ret != LZ_LOG_SUCCESS)
+        // 内存模式不切换文件，互斥锁用于串行化 dump
+        if (pthread_mutex_init(&ctx->switch_mutex, NULL) != 0)
         {
+            LZ_DEBUG_LOG("Failed to initialize mutex");
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
             break;
         }
+        mutex_ready = true;
 
-        // 关键：立即关闭新文件的 fd（mmap 后不再需要）
-        close(new_fd);
-        new_fd = -1;
-
-        LZ_DEBUG_LOG("New file created and mapped: %s", new_file_path);
-
-        // 如果启用加密，为新文件复制盐值（保持进程内盐值不变）
-        if (ctx->encrypt_key[0] != '\0' && ctx->crypto_ctx.salt_ptr != NULL)
+        // 环内保存明文，密钥只在 dump 时使用（每次 dump 生成新的主盐，这里只确定流密码）
+        if (encrypt_key != NULL && strlen(encrypt_key) > 0)
         {
-            // 设置salt_ptr指向新mmap的footer
-            void *new_mmap_base = get_mmap_base_from_offset_ptr(new_offset_ptr);
-            uint32_t new_file_size = get_file_size_from_offset_ptr(new_offset_ptr);
-            uint8_t *new_salt_ptr = (uint8_t *)new_mmap_base + new_file_size - LZ_LOG_FOOTER_SIZE;
-
-            // 复制现有盐值到新文件（保持盐值一致性）
-            memcpy(new_salt_ptr, ctx->crypto_ctx.salt_ptr, LZ_LOG_SALT_SIZE);
-
-            // 更新crypto_ctx的salt_ptr指向新文件
-            ctx->crypto_ctx.salt_ptr = new_salt_ptr;
+            strncpy(ctx->encrypt_key, encrypt_key, sizeof(ctx->encrypt_key) - 1);
+            lz_crypto_cache_retain(ctx->encrypt_key);
+            LZ_DEBUG_LOG("Encryption key provided");
 
-            LZ_DEBUG_LOG("Copied salt to new file (salt remains unchanged)");
+            ctx->cipher = resolve_cipher();
+            if (lz_crypto_generate_salt(ctx->cipher, ctx->memory_salt) != 0)
+            {
+                LZ_DEBUG_LOG("Failed to generate salt");
+                ret = LZ_LOG_ERROR_FILE_CREATE;
+                break;
+            }
+            ctx->crypto_ctx.salt_ptr = ctx->memory_salt;
         }
 
-        // 初始化新文件的偏移量为0
-        atomic_store(new_offset_ptr, 0);
-
-        // 关键：原子替换 cur_offset_ptr 指针（方案B的核心）
-        // 先替换指针，配合延迟 munmap，完美解决一致性问题
-        atomic_store(&ctx->cur_offset_ptr, new_offset_ptr);
-
-        // 更新当前文件路径
-        strncpy(ctx->current_file_path, new_file_path, sizeof(ctx->current_file_path) - 1);
-
-        LZ_DEBUG_LOG("Pointer switch completed, storing old offset_ptr for deferred cleanup");
+        strncpy(ctx->current_file_path, "<memory>", sizeof(ctx->current_file_path) - 1);
+        atomic_store(&ctx->is_closed, false);
 
-        // 将旧 offset_ptr 加入延迟销毁（不立即 munmap，避免竞态）
-        add_old_offset_ptr(ctx, old_offset_ptr);
+        LZ_DEBUG_LOG("Memory logger opened: capacity=%u", ring_capacity);
 
-        LZ_DEBUG_LOG("File switch completed successfully");
+        *out_handle = ctx;
 
     } while (0);
 
     // 错误处理：清理资源
     if (ret != LZ_LOG_SUCCESS)
     {
-        if (new_offset_ptr != NULL)
+        if (ctx != NULL)
         {
-            void *new_mmap_base = get_mmap_base_from_offset_ptr(new_offset_ptr);
-            uint32_t new_file_size = get_file_size_from_offset_ptr(new_offset_ptr);
-            munmap(new_mmap_base, new_file_size);
+            if (ctx->ring_base != NULL)
+            {
+                munmap(ctx->ring_base, ctx->ring_map_size);
+            }
+            if (mutex_ready)
+            {
+                pthread_mutex_destroy(&ctx->switch_mutex);
+            }
+            release_key(ctx);
+            lz_binlog_state_destroy(&ctx->binlog);
+            free(ctx);
         }
-        if (new_fd >= 0)
+
+        if (out_handle != NULL)
         {
-            close(new_fd);
+            *out_handle = NULL;
         }
     }
 
     return ret;
 }
-lz_log_error_t lz_logger_write(lz_logger_handle_t handle,
-                               const char *message,
-                               uint32_t len)
+
+lz_log_error_t lz_logger_open_circular(const char *log_dir,
+                                       uint32_t capacity,
+                                       const char *encrypt_key,
+                                       lz_logger_handle_t *out_handle,
+                                       int32_t *out_inner_error,
+                                       int32_t *out_sys_errno)
 {
+    lz_logger_context_t *ctx = NULL;
     lz_log_error_t ret = LZ_LOG_SUCCESS;
-    lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
+    int32_t inner_error = 0;
+    int32_t sys_errno = 0;
+    int fd = -1;
+    bool created = false;
 
     do
     {
-        // 参数校验
-        if (ctx == NULL)
+        // 参数校验：容量范围与文件大小一致
+        if (log_dir == NULL || out_handle == NULL ||
+            capacity < LZ_LOG_MIN_FILE_SIZE || capacity > LZ_LOG_MAX_FILE_SIZE)
         {
-            ret = LZ_LOG_ERROR_INVALID_HANDLE;
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
             break;
         }
 
-        if (message == NULL || len == 0)
+        // 检查目录访问权限
+        ret = check_directory_access(log_dir);
+        if (ret != LZ_LOG_SUCCESS)
         {
-            ret = LZ_LOG_ERROR_INVALID_PARAM;
             break;
         }
 
-        // 检查句柄是否已关闭
-        if (atomic_load(&ctx->is_closed))
+        // 容量向上取整到 2 的幂，环内偏移用掩码计算
+        uint32_t ring_capacity = LZ_LOG_MIN_FILE_SIZE;
+        while (ring_capacity < capacity)
         {
-            LZ_DEBUG_LOG("Write failed: handle is closed");
-            ret = LZ_LOG_ERROR_HANDLE_CLOSED;
+            ring_capacity <<= 1;
+        }
+
+        // 分配上下文结构
+        ctx = (lz_logger_context_t *)calloc(1, sizeof(lz_logger_context_t));
+        if (ctx == NULL)
+        {
+            LZ_DEBUG_LOG("Failed to allocate context memory");
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
             break;
         }
+        lz_binlog_state_init(&ctx->binlog);
+        if (atomic_load(&g_intern_strings) && !lz_binlog_enable_strings(&ctx->binlog))
+        {
+            LZ_DEBUG_LOG("String dictionary disabled: out of memory");
+        }
+        if (!lz_binlog_enable_roster(&ctx->binlog))
+        {
+            LZ_DEBUG_LOG("Thread name replay disabled: out of memory");
+        }
 
-        // 检查 cur_offset_ptr 有效性（防御性编程）
-        atomic_uint_least32_t *current_offset_ptr = atomic_load(&ctx->cur_offset_ptr);
-        if (current_offset_ptr == NULL)
+        atomic_store(&ctx->cur_segment, NULL);
+        atomic_store(&ctx->old_segment, NULL);
+        atomic_store(&ctx->ring_writers, 0);
+        atomic_store(&ctx->ring_frozen, false);
+
+        // 循环模式不切换文件，互斥锁用于串行化 dump
+        if (pthread_mutex_init(&ctx->switch_mutex, NULL) != 0)
         {
-            LZ_DEBUG_LOG("Write failed: invalid offset pointer");
-            ret = LZ_LOG_ERROR_INVALID_MMAP;
+            LZ_DEBUG_LOG("Failed to initialize mutex");
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
             break;
         }
 
-        // 缓存offset_ptr和file_size，减少重复的间接访问（性能优化）
-        atomic_uint_least32_t *cached_offset_ptr = current_offset_ptr;
-        uint32_t cached_file_size = get_file_size_from_offset_ptr(cached_offset_ptr);
-        uint32_t cached_max_data_size = cached_file_size - LZ_LOG_FOOTER_SIZE;
+        strncpy(ctx->log_dir, log_dir, sizeof(ctx->log_dir) - 1);
+
+        if (encrypt_key != NULL && strlen(encrypt_key) > 0)
+        {
+            strncpy(ctx->encrypt_key, encrypt_key, sizeof(ctx->encrypt_key) - 1);
+            lz_crypto_cache_retain(ctx->encrypt_key);
+            LZ_DEBUG_LOG("Encryption key provided");
+        }
+        ctx->cipher = resolve_cipher();
+
+        snprintf(ctx->current_file_path, sizeof(ctx->current_file_path), "%s%c%s",
+                 log_dir, PATH_SEPARATOR, LZ_LOG_CIRCULAR_FILE_NAME);
 
-        // 检查日志长度是否超过文件可用空间（超过则直接丢弃）
-        if (len > cached_max_data_size)
+        // 打开已存在的循环文件（沿用其容量）或新建
+        uint32_t map_size = 0;
+        ret = open_circular_file(ctx->current_file_path, ring_map_size_for(ring_capacity), ring_capacity,
+                                 &fd, &map_size, &ring_capacity, &created);
+        if (ret != LZ_LOG_SUCCESS)
         {
-            LZ_DEBUG_LOG("Drop log: len=%u exceeds max_data_size=%u", len, cached_max_data_size);
-            ret = LZ_LOG_ERROR_FILE_SIZE_EXCEED;
+            sys_errno = errno;
             break;
         }
 
-        // 无锁写入（使用 atomic_fetch_add）
-        while (true)
+        void *ring = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ring == MAP_FAILED)
         {
-            // 关键：原子读取 offset_ptr 指针（方案B核心）
-            // 一旦读取，后续操作都基于这个指针，保证上下文一致性
-            atomic_uint_least32_t *offset_ptr = atomic_load(&ctx->cur_offset_ptr);
+            sys_errno = errno;
+            LZ_DEBUG_LOG("Failed to map circular log: errno=%d", sys_errno);
+            ret = LZ_LOG_ERROR_MMAP_FAILED;
+            break;
+        }
 
-            // 检查offset_ptr是否变化，如果变化则更新缓存
-            if (offset_ptr != cached_offset_ptr)
-            {
-                cached_offset_ptr = offset_ptr;
-                cached_file_size = get_file_size_from_offset_ptr(cached_offset_ptr);
-                cached_max_data_size = cached_file_size - LZ_LOG_FOOTER_SIZE;
-            }
+        // 映射建立后不再需要文件描述符
+        close(fd);
+        fd = -1;
 
-            // 使用缓存的值，避免重复读取
-            uint32_t file_size = cached_file_size;
-            uint32_t max_data_size = cached_max_data_size;
+        if (created)
+        {
+            ring_format((uint8_t *)ring, ring_capacity, map_size);
+        }
+        ring_attach(ctx, (uint8_t *)ring, ring_capacity, map_size);
+        ctx->ring_persistent = true;
 
-            // 使用 atomic_fetch_add 原子预留空间（O(1)，无竞争）
-            uint32_t my_offset = atomic_fetch_add(offset_ptr, len);
-            uint32_t my_new_offset = my_offset + len;
+        // 初始化加密上下文(如果提供了密钥)，盐存放在 footer 中
+        if (ctx->encrypt_key[0] != '\0')
+        {
+            ctx->crypto_ctx.salt_ptr = ctx->ring_base + map_size - LZ_LOG_FOOTER_SIZE;
 
-            // 检查是否超出文件大小
-            if (my_new_offset > max_data_size)
+            // 新文件需要生成新盐
+            // 已有的循环文件沿用自己的流密码
+            if (created && lz_crypto_generate_salt(ctx->cipher, ctx->crypto_ctx.salt_ptr) != 0)
             {
-                // 注意: 不需要回滚 atomic_fetch_sub
-                // 原因: 1) 可能多个线程都已fetch_add超出,无法完全回滚
-                //       2) 切换新文件后会从0开始,旧offset值无关紧要
+                LZ_DEBUG_LOG("Failed to generate salt");
+                ret = LZ_LOG_ERROR_FILE_CREATE;
+                break;
+            }
+
+            if (lz_crypto_init(&ctx->crypto_ctx, ctx->encrypt_key, ctx->crypto_ctx.salt_ptr) != 0)
+            {
+                LZ_DEBUG_LOG("Failed to initialize encryption");
+                ret = LZ_LOG_ERROR_FILE_CREATE;
+                break;
+            }
+
+            ret = start_keystream(ctx, &ctx->crypto_ctx, atomic_load(ctx->ring_cursor));
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                sys_errno = errno;
+                LZ_DEBUG_LOG("Failed to start keystream: %d", ret);
+                break;
+            }
+        }
+
+        // 新文件的元数据（块索引之后的区域）立即落盘
+        if (created && msync(ctx->ring_base + ring_capacity, map_size - ring_capacity, MS_SYNC) != 0)
+        {
+            sys_errno = errno;
+            ret = LZ_LOG_ERROR_FILE_WRITE;
+            break;
+        }
+
+        atomic_store(&ctx->is_closed, false);
+
+        LZ_DEBUG_LOG("Circular logger opened: file=%s, capacity=%u, cursor=%llu, created=%d",
+                     ctx->current_file_path, ring_capacity,
+                     (unsigned long long)atomic_load(ctx->ring_cursor), created);
+
+        *out_handle = ctx;
+
+    } while (0);
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    // 错误处理：清理资源
+    if (ret != LZ_LOG_SUCCESS)
+    {
+        LZ_DEBUG_LOG("Open circular failed with error: %d", ret);
+        if (ctx != NULL)
+        {
+            if (ctx->ring_base != NULL)
+            {
+                munmap(ctx->ring_base, ctx->ring_map_size);
+            }
+            // 本次新建的循环文件未完成初始化，不留在磁盘上
+            if (created)
+            {
+                unlink(ctx->current_file_path);
+            }
+            lz_keystream_stop(ctx->keystream);
+            if (ctx->crypto_ctx.is_initialized)
+            {
+                lz_crypto_cleanup(&ctx->crypto_ctx);
+            }
+            if (ctx->log_dir[0] != '\0')
+            {
+                pthread_mutex_destroy(&ctx->switch_mutex);
+            }
+            release_key(ctx);
+            lz_binlog_state_destroy(&ctx->binlog);
+            free(ctx);
+        }
+
+        if (out_handle != NULL)
+        {
+            *out_handle = NULL;
+        }
+    }
+
+    // 输出错误码
+    if (out_inner_error != NULL)
+    {
+        *out_inner_error = inner_error;
+    }
+    if (out_sys_errno != NULL)
+    {
+        *out_sys_errno = sys_errno;
+    }
+
+    return ret;
+}
+
+const char *lz_logger_error_string(lz_log_error_t error)
+{
+    switch (error)
+    {
+    case LZ_LOG_SUCCESS:
+        return "Success";
+    case LZ_LOG_ERROR_INVALID_PARAM:
+        return "Invalid parameter";
+    case LZ_LOG_ERROR_INVALID_HANDLE:
+        return "Invalid handle";
+    case LZ_LOG_ERROR_OUT_OF_MEMORY:
+        return "Out of memory";
+    case LZ_LOG_ERROR_FILE_NOT_FOUND:
+        return "File not found";
+    case LZ_LOG_ERROR_FILE_CREATE:
+        return "File create failed";
+    case LZ_LOG_ERROR_FILE_OPEN:
+        return "File open failed";
+    case LZ_LOG_ERROR_FILE_WRITE:
+        return "File write failed";
+    case LZ_LOG_ERROR_FILE_EXTEND:
+        return "File extend failed";
+    case LZ_LOG_ERROR_MMAP_FAILED:
+        return "Mmap failed";
+    case LZ_LOG_ERROR_MUNMAP_FAILED:
+        return "Munmap failed";
+    case LZ_LOG_ERROR_FILE_SIZE_EXCEED:
+        return "File size exceeded";
+    case LZ_LOG_ERROR_INVALID_MMAP:
+        return "Invalid mmap pointer";
+    case LZ_LOG_ERROR_DIR_ACCESS:
+        return "Directory access failed";
+    case LZ_LOG_ERROR_HANDLE_CLOSED:
+        return "Handle closed";
+    case LZ_LOG_ERROR_FILE_SWITCH:
+        return "File switch failed";
+    case LZ_LOG_ERROR_MUTEX_LOCK:
+        return "Mutex lock failed";
+    case LZ_LOG_ERROR_SYSTEM:
+        return "System error";
+    default:
+        return "Unknown error";
+    }
+}
+
+// ============================================================================
+// Write Implementation
+// ============================================================================
+
+/**
+ * 流式加密
+ * @param ctx 日志上下文
+ * @param crypto 数据所在段（环）的加密上下文
+ * @param input 明文数据
+ * @param output 输出位置（可与 input 相同，原地加密）
+ * @param len 数据长度
+ * @param offset 文件偏移量（用于计算 counter）
+ * @return 错误码
+ */
+static lz_log_error_t encrypt_data(lz_logger_context_t *ctx,
+                                   lz_crypto_context_t *crypto,
+                                   const void *input,
+                                   void *output,
+                                   uint32_t len,
+                                   uint64_t offset)
+{
+    // 如果没有初始化加密,直接返回(不加密)
+    if (!crypto->is_initialized)
+    {
+        return LZ_LOG_SUCCESS;
+    }
+
+    // AES-CTR 加密（直接从消息加密到目标位置，避免明文先落入文件映射）
+    // 启用预生成密钥流时命中部分只做 XOR
+    int result;
+    if (ctx->keystream != NULL)
+    {
+        result = lz_keystream_xor(ctx->keystream, crypto,
+                                  (const uint8_t *)input, (uint8_t *)output, len, offset);
+    }
+    else
+    {
+        result = lz_crypto_process(crypto, (const uint8_t *)input, (uint8_t *)output, len, offset);
+    }
+
+    return (result == 0) ? LZ_LOG_SUCCESS : LZ_LOG_ERROR_DIR_ACCESS; // 复用错误码
+}
+
+/**
+ * 把数据写入已预留的区间 [offset, offset+len)
+ * @param ctx 日志上下文
+ * @param segment 预留空间所在的日志段
+ * @param data 数据（NULL 表示填充0）
+ * @param len 数据长度
+ * @param offset 预留起始偏移
+ * @param encrypt 是否加密（块流的块头部为明文）
+ * @return 错误码
+ * @note mmap 段一次完成；缓冲段在块边界处分段写入
+ */
+static lz_log_error_t write_reserved(lz_logger_context_t *ctx,
+                                     lz_segment_t *segment,
+                                     const uint8_t *data,
+                                     uint32_t len,
+                                     uint32_t offset,
+                                     bool encrypt)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+
+    while (len > 0)
+    {
+        uint32_t piece = 0;
+        uint8_t *write_ptr = lz_sink_acquire(segment, offset, len, &piece);
+
+        if (data == NULL)
+        {
+            memset(write_ptr, 0, piece); // 填充0或其他占位符数据
+            if (encrypt)
+            {
+                ret = encrypt_data(ctx, &segment->crypto, write_ptr, write_ptr, piece, offset);
+            }
+        }
+        else if (encrypt && segment->crypto.is_initialized)
+        {
+            // offset 已经是文件中的实际偏移量；密钥取自预留空间所在的段
+            ret = encrypt_data(ctx, &segment->crypto, data, write_ptr, piece, offset);
+            data += piece;
+        }
+        else
+        {
+            memcpy(write_ptr, data, piece);
+            data += piece;
+        }
+
+        // 无论成功与否都要提交，否则缓冲块永远不会写满
+        lz_sink_commit(segment, offset, piece);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            LZ_DEBUG_LOG("Encryption failed at offset %u", offset);
+            break;
+        }
+
+        offset += piece;
+        len -= piece;
+    }
+
+    return ret;
+}
+
+/**
+ * 记录块索引并推进「最旧记录」
+ * @param ctx 日志上下文
+ * @param pos 本条记录的逻辑偏移
+ * @param len 本条记录长度
+ * @note 只有跨越 4KB 块边界的记录需要做事，其余写入直接返回
+ */
+static void ring_mark_record(lz_logger_context_t *ctx, uint64_t pos, uint32_t len)
+{
+    uint64_t end = pos + len;
+    uint64_t block = end >> LZ_LOG_RING_BLOCK_SHIFT;
+    if ((pos >> LZ_LOG_RING_BLOCK_SHIFT) == block)
+    {
+        return;
+    }
+
+    uint64_t nblocks = ctx->ring_capacity >> LZ_LOG_RING_BLOCK_SHIFT;
+
+    // 下一条记录从 end 开始，它是块 block 中的第一条记录
+    atomic_store_explicit(&ctx->ring_index[block & (nblocks - 1)], end, memory_order_relaxed);
+
+    // 第一圈还没有覆盖旧数据
+    if (block < nblocks)
+    {
+        return;
+    }
+
+    // 本条记录开始覆盖上一圈的块 block - nblocks，最旧的完整记录是上一圈
+    // 下一个块中的第一条记录（块内没有记录起点时继续往后找）
+    uint64_t oldest = end;
+    for (uint64_t b = block - nblocks + 1; b < block; b++)
+    {
+        uint64_t first = atomic_load_explicit(&ctx->ring_index[b & (nblocks - 1)], memory_order_relaxed);
+        if ((first >> LZ_LOG_RING_BLOCK_SHIFT) == b)
+        {
+            oldest = first;
+            break;
+        }
+    }
+
+    // 多个线程可能同时跨越边界，只允许前进
+    uint64_t cur = atomic_load_explicit(ctx->ring_oldest, memory_order_relaxed);
+    while (cur < oldest &&
+           !atomic_compare_exchange_weak_explicit(ctx->ring_oldest, &cur, oldest,
+                                                  memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+}
+
+/**
+ * 查找最旧的完整记录
+ * @param ctx 日志上下文
+ * @param end 写入游标
+ * @return 最旧记录的逻辑偏移
+ */
+static uint64_t ring_oldest_record(lz_logger_context_t *ctx, uint64_t end)
+{
+    if (end <= ctx->ring_capacity)
+    {
+        return 0;
+    }
+
+    uint64_t floor = end - ctx->ring_capacity;
+    uint64_t oldest = atomic_load_explicit(ctx->ring_oldest, memory_order_relaxed);
+    if (oldest >= floor && oldest <= end)
+    {
+        return oldest;
+    }
+
+    // 扩展区中的值落后于游标（跨越边界的线程还没来得及更新）：从块索引重新查找
+    uint64_t nblocks = ctx->ring_capacity >> LZ_LOG_RING_BLOCK_SHIFT;
+    for (uint64_t b = floor >> LZ_LOG_RING_BLOCK_SHIFT; b <= (end >> LZ_LOG_RING_BLOCK_SHIFT); b++)
+    {
+        uint64_t first = atomic_load_explicit(&ctx->ring_index[b & (nblocks - 1)], memory_order_relaxed);
+        if ((first >> LZ_LOG_RING_BLOCK_SHIFT) == b && first >= floor && first <= end)
+        {
+            return first;
+        }
+    }
+
+    return end;
+}
+
+/**
+ * 把数据写入环中的一段（循环文件加密时计数器使用逻辑偏移）
+ * @param ctx 日志上下文
+ * @param start 环内偏移
+ * @param data 数据
+ * @param len 数据长度
+ * @param pos 逻辑偏移
+ * @return 错误码
+ */
+static lz_log_error_t ring_store(lz_logger_context_t *ctx, uint32_t start,
+                                 const char *data, uint32_t len, uint64_t pos)
+{
+    if (ctx->crypto_ctx.is_initialized)
+    {
+        return encrypt_data(ctx, &ctx->crypto_ctx, data, ctx->ring_base + start, len, pos);
+    }
+
+    memcpy(ctx->ring_base + start, data, len);
+    return LZ_LOG_SUCCESS;
+}
+
+/**
+ * 写入环形缓冲（覆盖最旧的数据）
+ * @param ctx 日志上下文
+ * @param message 日志内容
+ * @param len 日志长度（不超过环容量）
+ * @return 错误码
+ */
+static lz_log_error_t write_ring(lz_logger_context_t *ctx, const char *message, uint32_t len)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+
+    // 先登记再检查冻结标志（与 dump 的「先冻结再检查登记」配对，都用 seq_cst）
+    for (;;)
+    {
+        atomic_fetch_add(&ctx->ring_writers, 1);
+        if (!atomic_load(&ctx->ring_frozen))
+        {
+            break;
+        }
+        atomic_fetch_sub(&ctx->ring_writers, 1);
+        while (atomic_load_explicit(&ctx->ring_frozen, memory_order_relaxed))
+        {
+            sched_yield();
+        }
+    }
+
+    // 与文件模式相同的无锁预留
+    uint64_t pos = atomic_fetch_add_explicit(ctx->ring_cursor, len, memory_order_relaxed);
+    uint32_t start = (uint32_t)(pos & (ctx->ring_capacity - 1));
+    uint32_t first = ctx->ring_capacity - start;
+
+    if (first >= len)
+    {
+        ret = ring_store(ctx, start, message, len, pos);
+    }
+    else
+    {
+        // 跨越环尾：分两段写入
+        ret = ring_store(ctx, start, message, first, pos);
+        if (ret == LZ_LOG_SUCCESS)
+        {
+            ret = ring_store(ctx, 0, message + first, len - first, pos + first);
+        }
+    }
+
+    ring_mark_record(ctx, pos, len);
+
+    atomic_fetch_sub_explicit(&ctx->ring_writers, 1, memory_order_release);
+    return ret;
+}
+
+/**
+ * 添加旧日志段到延迟销毁
+ * @param ctx 日志上下文
+ * @param old_segment 旧的日志段
+ */
+static void add_old_segment(lz_logger_context_t *ctx, lz_segment_t *old_segment)
+{
+    // 清理旧的日志段（如果存在）
+    lz_segment_t *prev_old_segment = atomic_load(&ctx->old_segment);
+    if (prev_old_segment != NULL)
+    {
+        lz_sink_release_segment(prev_old_segment, false);
+    }
+
+    // 保存新的旧日志段
+    atomic_store(&ctx->old_segment, old_segment);
+}
+
+/**
+ * 切换到新的日志文件（无锁方式）
+ * @param ctx 日志上下文
+ * @return 错误码
+ * @note 调用者必须持有 switch_mutex 锁
+ */
+static lz_log_error_t switch_to_new_file(lz_logger_context_t *ctx)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    int new_fd = -1;
+    lz_segment_t *new_segment = NULL;
+
+    // 保存旧的日志段（用于延迟清理）
+    lz_segment_t *old_segment = atomic_load(&ctx->cur_segment);
+
+    LZ_DEBUG_LOG("Starting file switch, old_file=%s", ctx->current_file_path);
+
+    do
+    {
+        // 获取当前日期
+        uint32_t date = get_current_date_value();
+
+        // 创建新文件（今日编号 +1，不回绕）
+        char new_file_path[768];
+        uint32_t new_file_num = next_log_file_num(ctx->manifest, ctx->log_dir, date,
+                                                  new_file_path, sizeof(new_file_path));
+
+        // 如果启用加密，新文件沿用主盐、段编号 +1（主密钥已缓存，段密钥只需 HKDF）
+        bool encrypted = (ctx->encrypt_key[0] != '\0');
+        uint8_t salt[LZ_LOG_SALT_SIZE];
+        if (encrypted && lz_crypto_next_salt(old_segment->footer, LZ_CRYPTO_SALT_NEXT, salt) != 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_CREATE;
+            break;
+        }
+
+        ret = create_and_extend_file(new_file_path, ctx->max_file_size,
+                                     ctx->packer != NULL ? LZ_LOG_MAGIC_ENDB : LZ_LOG_MAGIC_ENDX,
+                                     &new_fd, encrypted ? salt : NULL);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        // 在新文件上打开日志段（fd 所有权转移给 sink）
+        ret = lz_sink_open_segment(ctx->sink, new_file_path, new_fd,
+                                   ctx->max_file_size, 0, &new_segment);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+        new_fd = -1;
+
+        LZ_DEBUG_LOG("New file created and opened: %s", new_file_path);
+
+        if (encrypted &&
+            lz_crypto_init(&new_segment->crypto, ctx->encrypt_key, new_segment->footer) != 0)
+        {
+            LZ_DEBUG_LOG("Failed to derive segment key");
+            ret = LZ_LOG_ERROR_FILE_CREATE;
+            break;
+        }
+
+        // 初始化新文件的偏移量为0
+        atomic_store(new_segment->offset_ptr, 0);
+
+        // 关键：原子替换 cur_segment 指针（方案B的核心）
+        // 先替换指针，配合延迟释放，完美解决一致性问题
+        atomic_store(&ctx->cur_segment, new_segment);
+
+        // 新文件从偏移 0 开始写，密钥流从头预生成
+        lz_keystream_reset(ctx->keystream, &new_segment->crypto, 0);
+
+        // 二进制日志：新文件中重新写入会话和格式定义
+        lz_binlog_next_epoch(&ctx->binlog);
+
+        // 更新当前文件路径
+        strncpy(ctx->current_file_path, new_file_path, sizeof(ctx->current_file_path) - 1);
+
+        // 清单：封存旧段，登记新段（先切换计数器，旧段的计数不再增长）
+        uint64_t now_ms = get_current_time_ms();
+        uint32_t old_used = atomic_load(old_segment->offset_ptr);
+        if (old_used > old_segment->capacity)
+        {
+            old_used = old_segment->capacity;
+        }
+        uint64_t old_seq = ctx->manifest_seq;
+        lz_manifest_append(ctx->manifest, date, new_file_num, ctx->max_file_size, 0,
+                           now_ms, &ctx->manifest_seq);
+        atomic_store(&ctx->level_counts, lz_manifest_level_counts(ctx->manifest, ctx->manifest_seq));
+        lz_manifest_update(ctx->manifest, old_seq, old_used, LZ_SEGMENT_STATE_SEALED, now_ms);
+
+        // 无论因大小还是时间切换，新文件都从当前时间重新计算下一个边界
+        atomic_store(&ctx->rotate_deadline, next_rotate_deadline(ctx->rotate_interval));
+
+        LZ_DEBUG_LOG("Pointer switch completed, storing old segment for deferred cleanup");
+
+        // 将旧日志段加入延迟销毁（不立即释放，避免竞态）
+        add_old_segment(ctx, old_segment);
+
+        // 通知后台线程（不等待）：旧段仍被映射，更早的段已释放，可以压实
+        lz_housekeeper_notify(ctx->housekeeper, ctx->manifest_seq, old_seq);
+
+        LZ_DEBUG_LOG("File switch completed successfully");
+
+    } while (0);
+
+    // 错误处理：清理资源
+    if (ret != LZ_LOG_SUCCESS)
+    {
+        if (new_segment != NULL)
+        {
+            lz_sink_release_segment(new_segment, false);
+        }
+        if (new_fd >= 0)
+        {
+            close(new_fd);
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * 按时间轮转（写入路径发现已越过缓存的边界时调用）
+ * @param ctx 日志上下文
+ * @param deadline 调用者读到的边界
+ *
+ * 与按大小切换共用 switch_to_new_file；失败时不影响本次写入，推迟一段时间再重试。
+ */
+static void rotate_on_deadline(lz_logger_context_t *ctx, int64_t deadline)
+{
+    if (pthread_mutex_lock(&ctx->switch_mutex) != 0)
+    {
+        LZ_DEBUG_LOG("Failed to lock switch_mutex");
+        return;
+    }
+
+    // 再次检查边界（可能其他线程已完成轮转）
+    if (atomic_load(&ctx->rotate_deadline) == deadline)
+    {
+        LZ_DEBUG_LOG("Time boundary reached, rotating: deadline=%lld", (long long)deadline);
+        if (switch_to_new_file(ctx) != LZ_LOG_SUCCESS)
+        {
+            LZ_DEBUG_LOG("Time rotation failed, retry in %d seconds", LZ_LOG_ROTATE_RETRY_SEC);
+            atomic_store(&ctx->rotate_deadline, get_coarse_time_sec() + LZ_LOG_ROTATE_RETRY_SEC);
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->switch_mutex);
+}
+
+/**
+ * 追加一个压缩好的块（压缩线程中的 lz_packer 回调，写入时压缩模式）
+ * @param user 日志上下文
+ * @param header 块头部
+ * @param payload 负载
+ * @return 错误码
+ *
+ * 只有压缩线程追加块，段内没有并发写入；为封存时的块索引预留空间，放不下时切换文件。
+ * 先写负载再写块头部：崩溃时读取方遇到无效的块头部即停止，不会读到半个负载。
+ */
+static lz_log_error_t inline_emit_block(void *user,
+                                        const lz_compress_block_header_t *header,
+                                        uint8_t *payload)
+{
+    lz_logger_context_t *ctx = (lz_logger_context_t *)user;
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    uint32_t payload_len = header->stored_size & ~LZ_COMPRESS_BLOCK_STORED;
+    uint32_t block_len = LZ_COMPRESS_BLOCK_HEADER_SIZE + payload_len;
+
+    int64_t deadline = atomic_load_explicit(&ctx->rotate_deadline, memory_order_relaxed);
+    if (deadline != 0 && get_coarse_time_sec() >= deadline)
+    {
+        lz_segment_t *before = atomic_load(&ctx->cur_segment);
+        rotate_on_deadline(ctx, deadline);
+        if (atomic_load(&ctx->cur_segment) != before)
+        {
+            ctx->inline_blocks = 0;
+        }
+    }
+
+    while (true)
+    {
+        lz_segment_t *segment = atomic_load(&ctx->cur_segment);
+        uint32_t offset = atomic_load(segment->offset_ptr);
+
+        // 块 + 封存时的块索引、扩展区都要放得下（footer 不占数据区）
+        uint64_t need = (uint64_t)offset + block_len +
+                        LZ_COMPRESS_TRAILER_SIZE(ctx->inline_blocks + 1) - LZ_LOG_FOOTER_SIZE;
+        if (need > segment->capacity)
+        {
+            if (offset == 0)
+            {
+                LZ_DEBUG_LOG("Drop block: len=%u exceeds capacity=%u", block_len, segment->capacity);
+                ret = LZ_LOG_ERROR_FILE_SIZE_EXCEED;
+                break;
+            }
+
+            if (pthread_mutex_lock(&ctx->switch_mutex) != 0)
+            {
+                ret = LZ_LOG_ERROR_MUTEX_LOCK;
+                break;
+            }
+            ret = switch_to_new_file(ctx);
+            pthread_mutex_unlock(&ctx->switch_mutex);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                LZ_DEBUG_LOG("File switch failed: %d", ret);
+                ret = LZ_LOG_ERROR_FILE_SWITCH;
+                break;
+            }
+            ctx->inline_blocks = 0;
+            continue;
+        }
+
+        atomic_fetch_add(segment->offset_ptr, block_len);
+        ret = write_reserved(ctx, segment, payload, payload_len,
+                             offset + LZ_COMPRESS_BLOCK_HEADER_SIZE, true);
+        if (ret == LZ_LOG_SUCCESS)
+        {
+            ret = write_reserved(ctx, segment, (const uint8_t *)header,
+                                 LZ_COMPRESS_BLOCK_HEADER_SIZE, offset, false);
+        }
+        ctx->inline_blocks++;
+        break;
+    }
+
+    return ret;
+}
+
+/**
+ * 写入一条记录（普通文件模式，段密钥已就绪）
+ * @param ctx 日志上下文
+ * @param message 日志内容
+ * @param len 日志长度（已检查不超过段容量）
+ * @return 错误码
+ */
+static lz_log_error_t write_record(lz_logger_context_t *ctx, const char *message, uint32_t len)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_segment_t *cached_segment = atomic_load(&ctx->cur_segment);
+
+    do
+    {
+        // 写入时压缩：只拷贝进暂存块，轮转和追加都在压缩线程中完成
+        if (ctx->packer != NULL)
+        {
+            ret = lz_packer_write(ctx->packer, message, len);
+            break;
+        }
+
+        // 按时间轮转：只比较缓存的边界与粗粒度时钟
+        int64_t deadline = atomic_load_explicit(&ctx->rotate_deadline, memory_order_relaxed);
+        if (deadline != 0 && get_coarse_time_sec() >= deadline)
+        {
+            rotate_on_deadline(ctx, deadline);
+        }
+
+        // 无锁写入（使用 atomic_fetch_add）
+        while (true)
+        {
+            // 关键：原子读取 cur_segment 指针（方案B核心）
+            // 一旦读取，后续操作都基于这个段，保证上下文一致性
+            lz_segment_t *segment = atomic_load(&ctx->cur_segment);
+            cached_segment = segment;
+            uint32_t max_data_size = segment->capacity;
+
+            // 使用 atomic_fetch_add 原子预留空间（O(1)，无竞争）
+            uint32_t my_offset = atomic_fetch_add(segment->offset_ptr, len);
+            uint32_t my_new_offset = my_offset + len;
+
+            // 检查是否超出文件大小
+            if (my_new_offset > max_data_size)
+            {
+                // 注意: 不需要回滚 atomic_fetch_sub
+                // 原因: 1) 可能多个线程都已fetch_add超出,无法完全回滚
+                //       2) 切换新文件后会从0开始,旧offset值无关紧要
                 //       3) 不回滚也不会有逻辑错误
                 if (my_offset < max_data_size)
                 {
-                    // 写入 my_offset 到 max_data_size 之间的数据
+                    // 写入 my_offset 到 max_data_size 之间的数据（填充0，加密时一并加密）
                     uint32_t valid_len = max_data_size - my_offset;
-                    if (valid_len > 0)
-                    {
-                        void *mmap_base = get_mmap_base_from_offset_ptr(offset_ptr);
-
-                        void *write_ptr = (uint8_t *)mmap_base + my_offset;
-                        memset(write_ptr, 0, valid_len); // 填充0或其他占位符数据
-
-                        // 如果启用了加密，处理填充数据的加密
-                        if (ctx->crypto_ctx.is_initialized)
-                        {
-                            encrypt_data(ctx, write_ptr, valid_len, my_offset);
-                        }
-                    }
+                    write_reserved(ctx, segment, NULL, valid_len, my_offset, true);
+                }
+
+                LZ_DEBUG_LOG("Need file switch: offset=%u, len=%u, max=%u",
+                             my_offset, len, max_data_size);
+
+                // 需要切换文件，加锁处理
+                if (pthread_mutex_lock(&ctx->switch_mutex) != 0)
+                {
+                    LZ_DEBUG_LOG("Failed to lock switch_mutex");
+                    ret = LZ_LOG_ERROR_MUTEX_LOCK;
+                    break;
+                }
+
+                // 再次检查偏移量（可能其他线程已完成切换）
+                // 注意：这里需要重新读取 cur_segment，因为可能已被切换
+                segment = atomic_load(&ctx->cur_segment);
+                uint32_t current_offset = atomic_load(segment->offset_ptr);
+
+                // 如果段已切换或当前偏移量可以容纳，则无需切换
+                if (segment != cached_segment || current_offset + len <= max_data_size)
+                {
+                    pthread_mutex_unlock(&ctx->switch_mutex);
+                    LZ_DEBUG_LOG("Other thread completed switch, retrying");
+                    // 其他线程已完成切换，继续循环重试
+                    continue;
+                }
+
+                // 执行文件切换
+                LZ_DEBUG_LOG("Switching to new file...");
+                ret = switch_to_new_file(ctx);
+                pthread_mutex_unlock(&ctx->switch_mutex);
+
+                if (ret != LZ_LOG_SUCCESS)
+                {
+                    LZ_DEBUG_LOG("File switch failed: %d", ret);
+                    ret = LZ_LOG_ERROR_FILE_SWITCH;
+                    break;
                 }
 
-                LZ_DEBUG_LOG("Need file switch: offset=%u, len=%u, max=%u",
-                             my_offset, len, max_data_size);
+                LZ_DEBUG_LOG("File switch succeeded");
+                // 切换成功，继续循环重试写入
+                continue;
+            }
+
+            // fetch_add 成功，已预留空间 [my_offset, my_new_offset)
+            // 关键：写入地址由同一个 segment 计算（mmap 段即映射地址）
+            ret = write_reserved(ctx, segment, (const uint8_t *)message, len, my_offset, true);
+
+            break; // 写入完成
+        }
+
+    } while (0);
+
+    return ret;
+}
+
+// ============================================================================
+// Key Derivation
+// ============================================================================
+/*
+ * 主密钥未缓存时（没有其他使用同一密码的句柄已打开）PBKDF2 需要数十毫秒，放到后台线程中执行：
+ * lz_logger_open 立即返回，派生完成前的记录暂存在内存中，派生线程按顺序写出后
+ * 才把 key_state 置为就绪。暂存区满后写入线程等待派生完成。
+ */
+
+/**
+ * 暂存一条记录（段密钥在后台派生中）
+ * @param ctx 日志上下文
+ * @param message 日志内容
+ * @param len 日志长度
+ * @return 错误码
+ * @note 暂存区放不下（或分配失败）时等待派生完成后直接写入
+ */
+static lz_log_error_t key_backlog_write(lz_logger_context_t *ctx, const char *message, uint32_t len)
+{
+    if (pthread_mutex_lock(&ctx->key_mutex) != 0)
+    {
+        return LZ_LOG_ERROR_MUTEX_LOCK;
+    }
+
+    while (atomic_load(&ctx->key_state) == LZ_LOG_KEY_PENDING)
+    {
+        if (ctx->key_backlog == NULL)
+        {
+            ctx->key_backlog = (uint8_t *)malloc(LZ_LOG_KEY_BACKLOG_SIZE);
+        }
+        if (ctx->key_backlog != NULL &&
+            (uint64_t)ctx->key_backlog_used + sizeof(uint32_t) + len <= LZ_LOG_KEY_BACKLOG_SIZE)
+        {
+            memcpy(ctx->key_backlog + ctx->key_backlog_used, &len, sizeof(uint32_t));
+            memcpy(ctx->key_backlog + ctx->key_backlog_used + sizeof(uint32_t), message, len);
+            ctx->key_backlog_used += (uint32_t)sizeof(uint32_t) + len;
+            pthread_mutex_unlock(&ctx->key_mutex);
+            return LZ_LOG_SUCCESS;
+        }
+        pthread_cond_wait(&ctx->key_cond, &ctx->key_mutex);
+    }
+
+    int state = atomic_load(&ctx->key_state);
+    pthread_mutex_unlock(&ctx->key_mutex);
+
+    return (state == LZ_LOG_KEY_READY) ? write_record(ctx, message, len) : LZ_LOG_ERROR_FILE_CREATE;
+}
+
+/**
+ * 派生线程：派生当前段的密钥，按顺序写出暂存的记录
+ */
+static void *key_derivation_main(void *arg)
+{
+    lz_logger_context_t *ctx = (lz_logger_context_t *)arg;
+    lz_segment_t *segment = atomic_load(&ctx->cur_segment);
+    int state = LZ_LOG_KEY_READY;
+
+    if (lz_crypto_init(&segment->crypto, ctx->encrypt_key, segment->footer) != 0)
+    {
+        LZ_DEBUG_LOG("Failed to initialize encryption");
+        state = LZ_LOG_KEY_FAILED;
+    }
+    else if (ctx->packer == NULL &&
+             start_keystream(ctx, &segment->crypto, atomic_load(segment->offset_ptr)) != LZ_LOG_SUCCESS)
+    {
+        // 预生成密钥流只影响性能，失败时直接计算
+        LZ_DEBUG_LOG("Failed to start keystream");
+    }
+
+    pthread_mutex_lock(&ctx->key_mutex);
+
+    // 持锁写出：期间到达的写入继续暂存在后面，保证顺序
+    uint32_t pos = 0;
+    while (state == LZ_LOG_KEY_READY && pos < ctx->key_backlog_used)
+    {
+        uint32_t len = 0;
+        memcpy(&len, ctx->key_backlog + pos, sizeof(uint32_t));
+        pos += (uint32_t)sizeof(uint32_t);
+        write_record(ctx, (const char *)ctx->key_backlog + pos, len);
+        pos += len;
+    }
+
+    // 写入时压缩：暂存的记录都进了本线程的分片，先提交，
+    // 否则各写入线程之后的记录可能先于这些记录落盘
+    if (pos > 0 && ctx->packer != NULL)
+    {
+        lz_packer_flush(ctx->packer);
+    }
+
+    if (ctx->key_backlog != NULL)
+    {
+        memset(ctx->key_backlog, 0, ctx->key_backlog_used);
+        free(ctx->key_backlog);
+        ctx->key_backlog = NULL;
+        ctx->key_backlog_used = 0;
+    }
+
+    atomic_store_explicit(&ctx->key_state, state, memory_order_release);
+    pthread_cond_broadcast(&ctx->key_cond);
+    pthread_mutex_unlock(&ctx->key_mutex);
+
+    LZ_DEBUG_LOG("Key derivation finished: state=%d, backlog=%u", state, pos);
+    return NULL;
+}
+
+/**
+ * 启动后台派生（lz_logger_open 的最后一步）
+ * @param ctx 日志上下文（当前段已打开，footer 中已有段盐）
+ * @note 线程创建失败时在当前线程中派生
+ */
+static void start_key_derivation(lz_logger_context_t *ctx)
+{
+    atomic_store(&ctx->key_state, LZ_LOG_KEY_PENDING);
+    if (pthread_create(&ctx->key_thread, NULL, key_derivation_main, ctx) == 0)
+    {
+        ctx->key_thread_started = true;
+        return;
+    }
+
+    LZ_DEBUG_LOG("Failed to create key thread, deriving synchronously");
+    key_derivation_main(ctx);
+}
+
+/**
+ * 等待后台派生完成（刷新、导出前调用，保证暂存的记录已写入段）
+ * @param ctx 日志上下文
+ */
+static void wait_key_ready(lz_logger_context_t *ctx)
+{
+    if (atomic_load_explicit(&ctx->key_state, memory_order_acquire) != LZ_LOG_KEY_PENDING)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&ctx->key_mutex);
+    while (atomic_load(&ctx->key_state) == LZ_LOG_KEY_PENDING)
+    {
+        pthread_cond_wait(&ctx->key_cond, &ctx->key_mutex);
+    }
+    pthread_mutex_unlock(&ctx->key_mutex);
+}
+
+lz_log_error_t lz_logger_write(lz_logger_handle_t handle,
+                               const char *message,
+                               uint32_t len)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
+
+    do
+    {
+        // 参数校验
+        if (ctx == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_HANDLE;
+            break;
+        }
+
+        if (message == NULL || len == 0)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        // 检查句柄是否已关闭
+        if (atomic_load(&ctx->is_closed))
+        {
+            LZ_DEBUG_LOG("Write failed: handle is closed");
+            ret = LZ_LOG_ERROR_HANDLE_CLOSED;
+            break;
+        }
+
+        // 环形模式：写入环形缓冲
+        if (ctx->ring_base != NULL)
+        {
+            if (len > ctx->ring_capacity)
+            {
+                ret = LZ_LOG_ERROR_FILE_SIZE_EXCEED;
+                break;
+            }
+            ret = write_ring(ctx, message, len);
+            break;
+        }
+
+        // 检查 cur_segment 有效性（防御性编程）
+        lz_segment_t *cached_segment = atomic_load(&ctx->cur_segment);
+        if (cached_segment == NULL)
+        {
+            LZ_DEBUG_LOG("Write failed: invalid segment");
+            ret = LZ_LOG_ERROR_INVALID_MMAP;
+            break;
+        }
+
+        // 检查日志长度是否超过文件可用空间（超过则直接丢弃）
+        if (len > cached_segment->capacity)
+        {
+            LZ_DEBUG_LOG("Drop log: len=%u exceeds max_data_size=%u", len, cached_segment->capacity);
+            ret = LZ_LOG_ERROR_FILE_SIZE_EXCEED;
+            break;
+        }
+
+        // 段密钥在后台派生中：暂存记录（派生完成后按顺序写入）
+        if (atomic_load_explicit(&ctx->key_state, memory_order_acquire) != LZ_LOG_KEY_READY)
+        {
+            ret = key_backlog_write(ctx, message, len);
+            break;
+        }
+
+        ret = write_record(ctx, message, len);
+    } while (0);
+
+    return ret;
+}
+
+lz_log_error_t lz_logger_write_level(lz_logger_handle_t handle,
+                                     lz_log_level_t level,
+                                     const char *message,
+                                     uint32_t len)
+{
+    lz_log_error_t ret = lz_logger_write(handle, message, len);
+
+    // 写入成功后累加当前日志段的级别计数（环形模式没有清单，计数器为 NULL）
+    if (ret == LZ_LOG_SUCCESS && (unsigned)level < LZ_LOG_LEVEL_COUNT)
+    {
+        lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
+        atomic_uint_least32_t *counts = atomic_load_explicit(&ctx->level_counts, memory_order_acquire);
+        if (counts != NULL)
+        {
+            atomic_fetch_add_explicit(&counts[level], 1, memory_order_relaxed);
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * 二进制日志的当前纪元
+ * @param ctx 日志上下文
+ * @return 纪元编号
+ *
+ * 文件模式每次切换文件开始新纪元；环形模式按写入游标每半个环开始一个纪元，
+ * 这样被覆盖的定义会在下半个环中重新写入。
+ */
+static uint64_t binlog_epoch(lz_logger_context_t *ctx)
+{
+    if (ctx->ring_base != NULL)
+    {
+        // ring_capacity 为 2 的幂：右移代替除以半个环
+        uint64_t cursor = atomic_load_explicit(ctx->ring_cursor, memory_order_relaxed);
+        unsigned half_shift = (unsigned)__builtin_ctz(ctx->ring_capacity) - 1;
+        return ctx->binlog.epoch_base | (uint32_t)(cursor >> half_shift);
+    }
+    return atomic_load_explicit(&ctx->binlog.epoch, memory_order_relaxed);
+}
+
+/**
+ * 写入会话记录和格式定义（不带日志记录）
+ * @param ctx 日志上下文
+ * @param site 调用点
+ * @param flags LZ_BINLOG_EMIT_HEADER / LZ_BINLOG_EMIT_FORMAT 的组合
+ * @param scratch 格式化缓冲（记录已写入，可以复用；还没有借用时在这里借用）
+ * @return 错误码
+ */
+static lz_log_error_t binlog_write_defs(lz_logger_context_t *ctx, const lz_binlog_site_t *site, unsigned flags,
+                                        lz_format_scratch_t *scratch)
+{
+    if (scratch->data == NULL && !lz_format_scratch_acquire(scratch))
+    {
+        return LZ_LOG_ERROR_OUT_OF_MEMORY;
+    }
+    size_t len = lz_binlog_encode_defs(&ctx->binlog, site, flags, (uint8_t *)scratch->data, scratch->cap);
+    if (len > scratch->cap)
+    {
+        if (!lz_format_scratch_reserve(scratch, len))
+        {
+            return LZ_LOG_ERROR_OUT_OF_MEMORY;
+        }
+        lz_binlog_encode_defs(&ctx->binlog, site, flags, (uint8_t *)scratch->data, scratch->cap);
+    }
+    return lz_logger_write((lz_logger_handle_t)ctx, scratch->data, (uint32_t)len);
+}
+
+/**
+ * 写入行记录认领到的会话记录和字符串定义（不带行记录）
+ * @param ctx 日志上下文
+ * @param line 行记录
+ * @param scratch 格式化缓冲（行记录已写入，可以复用）
+ * @return 错误码
+ */
+static lz_log_error_t binlog_write_line_defs(lz_logger_context_t *ctx, const lz_binlog_line_t *line,
+                                             lz_format_scratch_t *scratch)
+{
+    size_t len = lz_binlog_encode_line_defs(&ctx->binlog, line, (uint8_t *)scratch->data, scratch->cap);
+    if (len > scratch->cap)
+    {
+        if (!lz_format_scratch_reserve(scratch, len))
+        {
+            return LZ_LOG_ERROR_OUT_OF_MEMORY;
+        }
+        lz_binlog_encode_line_defs(&ctx->binlog, line, (uint8_t *)scratch->data, scratch->cap);
+    }
+    return lz_logger_write((lz_logger_handle_t)ctx, scratch->data, (uint32_t)len);
+}
+
+/**
+ * 环形模式：认领到会话记录的写入之后补写近期其他线程的线程名定义
+ * @param ctx 日志上下文
+ * @param flags 本次认领的结果（不含 LZ_BINLOG_EMIT_HEADER 时什么都不做）
+ * @param epoch 认领时的纪元
+ * @param scratch 格式化缓冲（记录已写入，可以复用；还没有借用时在这里借用）
+ * @return 错误码
+ */
+static lz_log_error_t binlog_write_roster(lz_logger_context_t *ctx, unsigned flags, uint64_t epoch,
+                                          lz_format_scratch_t *scratch)
+{
+    if (!(flags & LZ_BINLOG_EMIT_HEADER) || ctx->binlog.roster == NULL)
+    {
+        return LZ_LOG_SUCCESS;
+    }
+    if ((scratch->data == NULL && !lz_format_scratch_acquire(scratch)) ||
+        !lz_format_scratch_reserve(scratch, LZ_BINLOG_ROSTER_MAX_BYTES))
+    {
+        return LZ_LOG_ERROR_OUT_OF_MEMORY;
+    }
+    size_t len = lz_binlog_encode_roster(&ctx->binlog, epoch, (uint8_t *)scratch->data, scratch->cap);
+    if (len == 0)
+    {
+        return LZ_LOG_SUCCESS;
+    }
+    return lz_logger_write((lz_logger_handle_t)ctx, scratch->data, (uint32_t)len);
+}
+
+/** 一条日志的消息：printf 格式串 + va_list，或 "{}" 模板 + 类型化参数（args 为 NULL） */
+typedef struct
+{
+    const char *fmt;
+    va_list *args;         // printf 参数（每次格式化时复制一份，可重复使用）
+    const lz_arg_t *typed; // 类型化参数
+    int32_t count;
+} log_message_t;
+
+/** 格式化整行（返回值约定与 lz_format_line 相同） */
+static int64_t message_format_line(char *buf, size_t cap, const lz_format_record_t *record,
+                                   const log_message_t *msg)
+{
+    if (msg->args == NULL)
+    {
+        return lz_format_line_args(buf, cap, record, msg->fmt, msg->typed, msg->count);
+    }
+    va_list args;
+    va_copy(args, *msg->args);
+    int64_t len = lz_format_line(buf, cap, record, msg->fmt, args);
+    va_end(args);
+    return len;
+}
+
+/** 编码行记录（返回值约定与 lz_binlog_encode_line 相同） */
+static int64_t message_encode_line(lz_logger_context_t *ctx, const lz_binlog_line_t *line,
+                                   const lz_format_record_t *record, uint8_t *buf, size_t cap,
+                                   const log_message_t *msg)
+{
+    if (msg->args == NULL)
+    {
+        return lz_binlog_encode_line_args(&ctx->binlog, line, record, buf, cap, msg->fmt, msg->typed, msg->count);
+    }
+    va_list args;
+    va_copy(args, *msg->args);
+    int64_t len = lz_binlog_encode_line(&ctx->binlog, line, record, buf, cap, msg->fmt, args);
+    va_end(args);
+    return len;
+}
+
+/**
+ * 以行记录写入一条日志（开启字符串字典时由 log_message 调用）
+ * @param ctx 日志上下文
+ * @param record 元信息
+ * @param msg 消息
+ * @return 错误码
+ */
+static lz_log_error_t log_interned_line(lz_logger_context_t *ctx, const lz_format_record_t *record,
+                                        const log_message_t *msg)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_format_scratch_t scratch = {0};
+    size_t used = 0;
+
+    do
+    {
+        if (!lz_format_scratch_acquire(&scratch))
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        // 标签、文件、函数查字典得到编号；本纪元第一次使用的字符串把定义与记录一起写入
+        lz_binlog_line_t line;
+        lz_binlog_prepare_line(&ctx->binlog, record, &line);
+        uint64_t epoch = binlog_epoch(ctx);
+        lz_binlog_claim_line(&ctx->binlog, epoch, &line);
+
+        uint8_t *data = (uint8_t *)scratch.data;
+        int64_t len = message_encode_line(ctx, &line, record, data, scratch.cap, msg);
+
+        if (len >= (int64_t)scratch.cap && len <= (int64_t)UINT32_MAX)
+        {
+            // 超长：扩大线程缓冲后重新编码（不截断，之后同样长度的日志只编码一次）
+            if (!lz_format_scratch_reserve(&scratch, (size_t)len + 1))
+            {
+                ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            data = (uint8_t *)scratch.data;
+            len = message_encode_line(ctx, &line, record, data, scratch.cap, msg);
+        }
+
+        if (len < 0 || len > (int64_t)UINT32_MAX)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+        used = (size_t)len + 1;
+
+        ret = lz_logger_write_level((lz_logger_handle_t)ctx, record->level, (const char *)data, (uint32_t)len);
+        if (ret == LZ_LOG_SUCCESS)
+        {
+            ret = binlog_write_roster(ctx, line.flags, epoch, &scratch);
+        }
+
+        // 写入期间开始了新纪元：补写会话和字符串定义
+        uint64_t now_epoch = binlog_epoch(ctx);
+        if (ret == LZ_LOG_SUCCESS && now_epoch != epoch && lz_binlog_claim_line(&ctx->binlog, now_epoch, &line))
+        {
+            ret = binlog_write_line_defs(ctx, &line, &scratch);
+            if (ret == LZ_LOG_SUCCESS)
+            {
+                ret = binlog_write_roster(ctx, line.flags, now_epoch, &scratch);
+            }
+        }
+    } while (0);
+
+    lz_format_scratch_release(&scratch, used);
+    return ret;
+}
+
+/**
+ * 格式化并写入一条日志（lz_logger_logv / lz_logger_log_args 共用）
+ * @param handle 日志句柄
+ * @param record 元信息
+ * @param msg 消息
+ * @return 错误码
+ */
+static lz_log_error_t log_message(lz_logger_handle_t handle, const lz_format_record_t *record,
+                                  const log_message_t *msg)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_format_scratch_t scratch = {0};
+    size_t used = 0;
+
+    do
+    {
+        if (handle == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_HANDLE;
+            break;
+        }
+
+        // 开启了字符串字典：写入行记录
+        lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
+        if (ctx->binlog.dict != NULL)
+        {
+            ret = log_interned_line(ctx, record, msg);
+            break;
+        }
 
-                // 需要切换文件，加锁处理
-                if (pthread_mutex_lock(&ctx->switch_mutex) != 0)
-                {
-                    LZ_DEBUG_LOG("Failed to lock switch_mutex");
-                    ret = LZ_LOG_ERROR_MUTEX_LOCK;
-                    break;
-                }
+        // 格式化到线程缓冲
+        if (!lz_format_scratch_acquire(&scratch))
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        int64_t len = message_format_line(scratch.data, scratch.cap, record, msg);
 
-                // 再次检查偏移量（可能其他线程已完成切换）
-                // 注意：这里需要重新读取 offset_ptr，因为可能已被切换
-                offset_ptr = atomic_load(&ctx->cur_offset_ptr);
-                uint32_t current_offset = atomic_load(offset_ptr);
+        if (len >= (int64_t)scratch.cap && len <= (int64_t)UINT32_MAX)
+        {
+            // 超长：扩大线程缓冲后重新格式化（不截断，之后同样长度的日志只格式化一次）
+            if (!lz_format_scratch_reserve(&scratch, (size_t)len + 1))
+            {
+                ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            len = message_format_line(scratch.data, scratch.cap, record, msg);
+        }
 
-                // 如果指针已切换或当前偏移量可以容纳，则无需切换
-                if (offset_ptr != cached_offset_ptr || current_offset + len <= max_data_size)
-                {
-                    pthread_mutex_unlock(&ctx->switch_mutex);
-                    LZ_DEBUG_LOG("Other thread completed switch, retrying");
-                    // 其他线程已完成切换，继续循环重试
-                    continue;
-                }
+        if (len < 0 || len > (int64_t)UINT32_MAX)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+        used = (size_t)len + 1;
 
-                // 执行文件切换
-                LZ_DEBUG_LOG("Switching to new file...");
-                ret = switch_to_new_file(ctx);
-                pthread_mutex_unlock(&ctx->switch_mutex);
+        ret = lz_logger_write_level(handle, record->level, scratch.data, (uint32_t)len);
+    } while (0);
 
-                if (ret != LZ_LOG_SUCCESS)
-                {
-                    LZ_DEBUG_LOG("File switch failed: %d", ret);
-                    ret = LZ_LOG_ERROR_FILE_SWITCH;
-                    break;
-                }
+    lz_format_scratch_release(&scratch, used);
+    return ret;
+}
 
-                LZ_DEBUG_LOG("File switch succeeded");
-                // 切换成功，继续循环重试写入
-                continue;
-            }
+lz_log_error_t lz_logger_logv(lz_logger_handle_t handle,
+                              lz_log_level_t level,
+                              const char *tag,
+                              const char *file,
+                              int line,
+                              const char *func,
+                              const char *fmt,
+                              va_list args)
+{
+    // 行超长时参数还要再用一次：复制到局部变量（va_list 形参可能已退化为指针，不能直接取地址）
+    va_list copy;
+    va_copy(copy, args);
+    lz_format_record_t record = {level, tag, file, line, func};
+    log_message_t msg = {fmt, &copy, NULL, 0};
+    lz_log_error_t ret = log_message(handle, &record, &msg);
+    va_end(copy);
+    return ret;
+}
 
-            // fetch_add 成功，已预留空间 [my_offset, my_new_offset)
-            // 关键：通过 offset_ptr 反推 mmap_base（使用辅助函数）
-            void *mmap_base = get_mmap_base_from_offset_ptr(offset_ptr);
-            void *write_ptr = (uint8_t *)mmap_base + my_offset;
+lz_log_error_t lz_logger_log_args(lz_logger_handle_t handle,
+                                  lz_log_level_t level,
+                                  const char *tag,
+                                  const char *file,
+                                  int line,
+                                  const char *func,
+                                  const char *fmt,
+                                  const lz_arg_t *args,
+                                  int32_t count)
+{
+    if (args == NULL || count < 0)
+    {
+        count = 0;
+    }
+    lz_format_record_t record = {level, tag, file, line, func};
+    log_message_t msg = {fmt, NULL, args, count};
+    return log_message(handle, &record, &msg);
+}
+
+lz_log_error_t lz_logger_log(lz_logger_handle_t handle,
+                             lz_log_level_t level,
+                             const char *tag,
+                             const char *file,
+                             int line,
+                             const char *func,
+                             const char *fmt,
+                             ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    lz_log_error_t ret = lz_logger_logv(handle, level, tag, file, line, func, fmt, args);
+    va_end(args);
+    return ret;
+}
 
-            memcpy(write_ptr, message, len);
+lz_log_error_t lz_logger_log_binary(lz_logger_handle_t handle, lz_log_site_t *site, ...)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
+    lz_format_scratch_t scratch = {0};
+    size_t used = 0;
+    va_list args;
+    va_start(args, site);
 
-            // 流式加密（如果启用）
-            if (ctx->crypto_ctx.is_initialized)
+    do
+    {
+        if (ctx == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_HANDLE;
+            break;
+        }
+        if (site == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        lz_binlog_site_t *impl = lz_binlog_site(site);
+        if (impl == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        // 格式串不支持二进制写入（%n、位置参数、宽字符等）：按文本行写入
+        if (!impl->binary)
+        {
+            ret = lz_logger_logv(handle, site->level, site->tag, impl->file, site->line, site->func,
+                                 site->fmt, args);
+            break;
+        }
+
+        // 本纪元第一次使用该格式的线程负责把会话和格式定义与记录一起写入
+        uint64_t epoch = binlog_epoch(ctx);
+        lz_binlog_stamp_t stamp;
+        unsigned flags = lz_binlog_claim(&ctx->binlog, impl, epoch, &stamp);
+
+        // 二进制记录通常只有几十字节：先编码到栈上，放不下（定义、长字符串参数）时才借用线程缓冲
+        uint8_t local[LZ_LOG_BINLOG_STACK_SIZE];
+        uint8_t *data = local;
+        va_list retry;
+        va_copy(retry, args);
+        size_t len = lz_binlog_encode(&ctx->binlog, impl, flags, &stamp, local, sizeof(local), args);
+
+        if (len > sizeof(local) && len <= UINT32_MAX)
+        {
+            if (!lz_format_scratch_acquire(&scratch) || !lz_format_scratch_reserve(&scratch, len))
             {
-                // my_offset 已经是文件中的实际偏移量(包括盐区域)
-                ret = encrypt_data(ctx, write_ptr, len, my_offset);
-                if (ret != LZ_LOG_SUCCESS)
-                {
-                    LZ_DEBUG_LOG("Encryption failed at offset %u", my_offset);
-                    break;
-                }
+                va_end(retry);
+                ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+                break;
             }
+            data = (uint8_t *)scratch.data;
+            len = lz_binlog_encode(&ctx->binlog, impl, flags, &stamp, data, scratch.cap, retry);
+            used = len;
+        }
+        va_end(retry);
 
-            break; // 写入完成
+        if (len > UINT32_MAX)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        ret = lz_logger_write_level(handle, site->level, (const char *)data, (uint32_t)len);
+        if (ret == LZ_LOG_SUCCESS)
+        {
+            ret = binlog_write_roster(ctx, flags, epoch, &scratch);
         }
 
+        // 写入期间开始了新纪元（切换文件 / 环过半）：记录可能落在新纪元中，补写会话和格式定义
+        uint64_t now_epoch = binlog_epoch(ctx);
+        if (ret == LZ_LOG_SUCCESS && now_epoch != epoch)
+        {
+            unsigned extra = lz_binlog_claim(&ctx->binlog, impl, now_epoch, NULL);
+            if (extra != 0)
+            {
+                ret = binlog_write_defs(ctx, impl, extra, &scratch);
+            }
+            if (ret == LZ_LOG_SUCCESS)
+            {
+                ret = binlog_write_roster(ctx, extra, now_epoch, &scratch);
+            }
+        }
     } while (0);
 
+    va_end(args);
+    lz_format_scratch_release(&scratch, used);
     return ret;
 }
 
@@ -1239,268 +3002,549 @@ lz_log_error_t lz_logger_flush(lz_logger_handle_t handle)
             return LZ_LOG_ERROR_INVALID_HANDLE;
         }
 
-        atomic_uint_least32_t *offset_ptr = atomic_load(&ctx->cur_offset_ptr);
-        if (offset_ptr == NULL)
+        // 环形模式：循环文件同步整个映射，内存模式没有需要落盘的数据
+        if (ctx->ring_base != NULL)
+        {
+            if (ctx->ring_persistent && msync(ctx->ring_base, ctx->ring_map_size, MS_SYNC) != 0)
+            {
+                return LZ_LOG_ERROR_FILE_WRITE;
+            }
+            return LZ_LOG_SUCCESS;
+        }
+
+        // 段密钥在后台派生中：等暂存的记录写入段
+        wait_key_ready(ctx);
+
+        // 写入时压缩：先把暂存块压缩追加到文件
+        if (ctx->packer != NULL && lz_packer_flush(ctx->packer) != LZ_LOG_SUCCESS)
+        {
+            return LZ_LOG_ERROR_FILE_WRITE;
+        }
+
+        lz_segment_t *segment = atomic_load(&ctx->cur_segment);
+        if (segment == NULL)
         {
             return LZ_LOG_ERROR_INVALID_MMAP;
         }
 
-        void *mmap_base = get_mmap_base_from_offset_ptr(offset_ptr);
-        uint32_t file_size = get_file_size_from_offset_ptr(offset_ptr);
+        // 同步到磁盘（mmap: MS_SYNC；缓冲后端: 写出缓冲 + fdatasync）
+        if (lz_sink_sync(segment, true) != LZ_LOG_SUCCESS)
+        {
+            return LZ_LOG_ERROR_FILE_WRITE;
+        }
+
+        // 更新清单中的已用大小和时间范围
+        // 在 switch_mutex 内读取段序号：刷新期间发生了切换时，该段已由切换封存并记录了最终大小，
+        // 不能再把它的大小写到新段的条目里，也不能把已封存的条目改回活动状态
+        if (pthread_mutex_lock(&ctx->switch_mutex) != 0)
+        {
+            LZ_DEBUG_LOG("Failed to lock switch_mutex");
+            return LZ_LOG_ERROR_MUTEX_LOCK;
+        }
+        if (atomic_load(&ctx->cur_segment) == segment)
+        {
+            uint32_t used = atomic_load(segment->offset_ptr);
+            lz_manifest_update(ctx->manifest, ctx->manifest_seq,
+                               used > segment->capacity ? segment->capacity : used,
+                               LZ_SEGMENT_STATE_ACTIVE, get_current_time_ms());
+        }
+        pthread_mutex_unlock(&ctx->switch_mutex);
+
+    } while (0);
+
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_logger_close(lz_logger_handle_t handle)
+{
+    lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
+
+    do
+    {
+        if (ctx == NULL)
+        {
+            return LZ_LOG_ERROR_INVALID_HANDLE;
+        }
+
+        LZ_DEBUG_LOG("Closing logger: file=%s", ctx->current_file_path);
+
+        // 标记为已关闭（阻止新的写入）
+        atomic_store(&ctx->is_closed, true);
+
+        // 等待后台派生结束（暂存的记录在此之前写出）
+        if (ctx->key_thread_started)
+        {
+            pthread_join(ctx->key_thread, NULL);
+            ctx->key_thread_started = false;
+        }
+        bool file_mode = (ctx->ring_base == NULL);
+
+        // 写入时压缩：提交剩余的暂存块并停止压缩线程（之后段内不再有追加）
+        lz_packer_stop(ctx->packer);
+        ctx->packer = NULL;
+
+        // 刷新当前日志段（同步数据到磁盘）
+        lz_segment_t *segment = atomic_load(&ctx->cur_segment);
+        if (segment != NULL)
+        {
+            // 读取最终偏移量
+            uint32_t final_offset = atomic_load(segment->offset_ptr);
+            LZ_DEBUG_LOG("Flushing segment: final_offset=%u", final_offset);
+            lz_sink_sync(segment, true);
+            // 封存清单条目
+            lz_manifest_update(ctx->manifest, ctx->manifest_seq,
+                               final_offset > segment->capacity ? segment->capacity : final_offset,
+                               LZ_SEGMENT_STATE_SEALED, get_current_time_ms());
+            // 注意：不执行 munmap，让操作系统在进程退出时自动清理
+            // 这样避免了 close 时可能还有活跃写入的竞态问题
+            lz_sink_release_segment(segment, true);
+        }
+
+        // 刷新旧日志段（如果存在）
+        lz_segment_t *old_segment = atomic_load(&ctx->old_segment);
+        if (old_segment != NULL)
+        {
+            LZ_DEBUG_LOG("Flushing old segment: size=%u", old_segment->file_size);
+            lz_sink_sync(old_segment, true);
+            // 同样不执行 munmap
+            lz_sink_release_segment(old_segment, true);
+        }
+
+        // 释放环形映射（上下文随后也会释放，调用者需保证已停止写入）
+        if (ctx->ring_base != NULL)
+        {
+            if (ctx->ring_persistent)
+            {
+                msync(ctx->ring_base, ctx->ring_map_size, MS_SYNC);
+            }
+            munmap(ctx->ring_base, ctx->ring_map_size);
+            ctx->ring_base = NULL;
+        }
+
+        // 停止存储后端（缓冲后端的后台线程在这里退出）
+        lz_sink_destroy(ctx->sink);
+
+        // 停止保留策略后台线程（先于清单释放）
+        lz_housekeeper_stop(ctx->housekeeper);
+
+        // 停止密钥流生产线程（先于加密上下文清理）
+        lz_keystream_stop(ctx->keystream);
+        ctx->keystream = NULL;
+
+        // 释放目录清单
+        if (ctx->manifest != NULL)
+        {
+            lz_manifest_close(ctx->manifest);
+        }
+
+        // 清理加密上下文
+        if (ctx->crypto_ctx.is_initialized)
+        {
+            lz_crypto_cleanup(&ctx->crypto_ctx);
+        }
+
+        // 释放主密钥缓存的引用（最后一个使用该密码的句柄关闭时擦除缓存的主密钥）
+        release_key(ctx);
+
+        // 销毁互斥锁
+        pthread_mutex_destroy(&ctx->switch_mutex);
+        if (file_mode)
+        {
+            pthread_cond_destroy(&ctx->key_cond);
+            pthread_mutex_destroy(&ctx->key_mutex);
+        }
+
+        LZ_DEBUG_LOG("Logger closed successfully");
+
+        // 释放上下文
+        lz_binlog_state_destroy(&ctx->binlog);
+        free(ctx);
+
+    } while (0);
+
+    return LZ_LOG_SUCCESS;
+}
+
+/**
+ * 清理过期日志文件
+ * @param log_dir 日志目录路径
+ * @param days 保留天数（删除此天数之前的所有日志文件）
+ * @return 错误码
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_cleanup_expired_logs(
+    const char *log_dir,
+    int days)
+{
+
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_manifest_t *manifest = NULL;
+    lz_manifest_entry_t *entries = NULL;
+
+    do
+    {
+        // 参数验证
+        if (log_dir == NULL || days < 0)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        // 检查目录访问权限
+        ret = check_directory_access(log_dir);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        // 计算截止日期：日期早于等于 (今天 - days) 的文件删除
+        time_t now = time(NULL);
+        struct tm tm_cutoff;
+        if (localtime_r(&now, &tm_cutoff) == NULL)
+        {
+            ret = LZ_LOG_ERROR_SYSTEM;
+            break;
+        }
+        tm_cutoff.tm_mday -= days;
+        tm_cutoff.tm_hour = 12; // 使用中午12点避免夏令时问题
+        tm_cutoff.tm_isdst = -1;
+        if (mktime(&tm_cutoff) == -1)
+        {
+            ret = LZ_LOG_ERROR_SYSTEM;
+            break;
+        }
+        uint32_t cutoff = (uint32_t)((tm_cutoff.tm_year + 1900) * 10000 +
+                                     (tm_cutoff.tm_mon + 1) * 100 + tm_cutoff.tm_mday);
+
+        // 从清单中取日志段列表
+        ret = lz_manifest_open(log_dir, &manifest);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        entries = (lz_manifest_entry_t *)malloc(sizeof(lz_manifest_entry_t) * LZ_MANIFEST_CAPACITY);
+        if (entries == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        uint32_t count = lz_manifest_list(manifest, entries, LZ_MANIFEST_CAPACITY);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (entries[i].date > cutoff)
+            {
+                continue;
+            }
+
+            char file_path[1024];
+            lz_manifest_build_path(log_dir, &entries[i], file_path, sizeof(file_path));
+
+            // 删除文件（忽略错误，继续处理其他文件）
+            unlink(file_path);
+            lz_manifest_remove(manifest, entries[i].seq);
+        }
+
+        // 清单之外的过期文件（清单写满后被淘汰、或清单失效期间写入的）通过遍历目录删除
+        lz_manifest_sweep_untracked(manifest, cutoff);
 
-        // 使用 MS_SYNC 同步到磁盘
-        if (msync(mmap_base, file_size, MS_SYNC) != 0)
+    } while (0);
+
+    free(entries);
+    if (manifest != NULL)
+    {
+        lz_manifest_close(manifest);
+    }
+
+    return ret;
+}
+
+/**
+ * 完整写入文件（处理短写和 EINTR）
+ * @param fd 文件描述符
+ * @param data 数据
+ * @param len 数据长度
+ * @return 错误码
+ */
+static lz_log_error_t write_all_fd(int fd, const uint8_t *data, uint32_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written <= 0)
         {
+            if (written < 0 && errno == EINTR)
+            {
+                // 被信号中断，重试
+                continue;
+            }
             return LZ_LOG_ERROR_FILE_WRITE;
         }
+        data += written;
+        len -= (uint32_t)written;
+    }
+    return LZ_LOG_SUCCESS;
+}
 
-    } while (0);
+/**
+ * 在导出文件末尾写入 footer: [盐16字节][魔数4字节][文件大小4字节][已用大小4字节]
+ * @param fd 导出文件描述符
+ * @param salt 盐值（16字节）
+ * @param magic 魔数（普通文件 EndX，块流 EndB）
+ * @param file_size footer 中记录的文件大小
+ * @param used_size 已用大小
+ * @return 错误码
+ */
+static lz_log_error_t write_export_footer(int fd, const uint8_t *salt, uint32_t magic,
+                                          uint32_t file_size, uint32_t used_size)
+{
+    uint8_t footer[LZ_LOG_FOOTER_SIZE];
 
-    return LZ_LOG_SUCCESS;
+    memcpy(footer, salt, LZ_LOG_SALT_SIZE);
+    memcpy(footer + LZ_LOG_SALT_SIZE, &magic, sizeof(magic));
+    memcpy(footer + LZ_LOG_SALT_SIZE + 4, &file_size, sizeof(file_size));
+    memcpy(footer + LZ_LOG_SALT_SIZE + 8, &used_size, sizeof(used_size));
+
+    return write_all_fd(fd, footer, LZ_LOG_FOOTER_SIZE);
 }
 
-lz_log_error_t lz_logger_close(lz_logger_handle_t handle)
+/**
+ * 把日志段的已写入数据导出到指定路径（常规文件格式）
+ * @param segment 日志段
+ * @param used_size 导出的数据量
+ * @param path 导出文件路径（已存在则覆盖）
+ * @return 错误码
+ */
+static lz_log_error_t export_segment_to_path(lz_segment_t *segment, uint32_t used_size, const char *path)
 {
-    lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    int export_fd = -1;
 
     do
     {
-        if (ctx == NULL)
+        // 创建导出文件
+        export_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (export_fd < 0)
         {
-            return LZ_LOG_ERROR_INVALID_HANDLE;
+            ret = LZ_LOG_ERROR_FILE_CREATE;
+            break;
         }
 
-        LZ_DEBUG_LOG("Closing logger: file=%s", ctx->current_file_path);
-
-        // 标记为已关闭（阻止新的写入）
-        atomic_store(&ctx->is_closed, true);
+        // mmap 段直接从映射写出；缓冲段分块经 sink 读出（会先把缓冲中的数据落盘）
+        uint8_t read_buf[64 * 1024];
+        uint32_t total_written = 0;
 
-        // 刷新当前 mmap（同步数据到磁盘）
-        atomic_uint_least32_t *offset_ptr = atomic_load(&ctx->cur_offset_ptr);
-        if (offset_ptr != NULL)
+        while (total_written < used_size)
         {
-            // 读取最终偏移量
-            uint32_t final_offset = atomic_load(offset_ptr);
-            void *mmap_base = get_mmap_base_from_offset_ptr(offset_ptr);
-            uint32_t file_size = get_file_size_from_offset_ptr(offset_ptr);
-            LZ_DEBUG_LOG("Flushing mmap: final_offset=%u", final_offset);
-            msync(mmap_base, file_size, MS_SYNC);
-            // 注意：不执行 munmap，让操作系统在进程退出时自动清理
-            // 这样避免了 close 时可能还有活跃写入的竞态问题
+            const uint8_t *data_ptr = NULL;
+            uint32_t piece = used_size - total_written;
+
+            if (segment->map_base != NULL)
+            {
+                data_ptr = segment->map_base + total_written;
+            }
+            else
+            {
+                if (piece > sizeof(read_buf))
+                {
+                    piece = sizeof(read_buf);
+                }
+                ret = lz_sink_read(segment, total_written, read_buf, piece);
+                if (ret != LZ_LOG_SUCCESS)
+                {
+                    break;
+                }
+                data_ptr = read_buf;
+            }
+
+            ret = write_all_fd(export_fd, data_ptr, piece);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                break;
+            }
+            total_written += piece;
         }
 
-        // 刷新旧 mmap（如果存在）
-        atomic_uint_least32_t *old_offset_ptr = atomic_load(&ctx->old_offset_ptr);
-        if (old_offset_ptr != NULL)
+        if (ret != LZ_LOG_SUCCESS)
         {
-            void *old_mmap_base = get_mmap_base_from_offset_ptr(old_offset_ptr);
-            uint32_t old_file_size = get_file_size_from_offset_ptr(old_offset_ptr);
-            LZ_DEBUG_LOG("Flushing old mmap: size=%u", old_file_size);
-            msync(old_mmap_base, old_file_size, MS_SYNC);
-            // 同样不执行 munmap
+            break;
         }
 
-        // 清理加密上下文
-        if (ctx->crypto_ctx.is_initialized)
+        // 盐和魔数从当前段的 footer 读取（mmap: 映射内；缓冲: footer 副本）
+        uint32_t magic = 0;
+        memcpy(&magic, segment->footer + LZ_LOG_SALT_SIZE, sizeof(magic));
+        ret = write_export_footer(export_fd, segment->footer, magic, segment->file_size, used_size);
+        if (ret != LZ_LOG_SUCCESS)
         {
-            lz_crypto_cleanup(&ctx->crypto_ctx);
+            break;
         }
 
-        // 销毁互斥锁
-        pthread_mutex_destroy(&ctx->switch_mutex);
-
-        LZ_DEBUG_LOG("Logger closed successfully");
+        LZ_DEBUG_LOG("Exported log with footer: used_size=%u", used_size);
 
-        // 释放上下文
-        free(ctx);
+        // 同步到磁盘
+        if (fsync(export_fd) != 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_WRITE;
+            break;
+        }
 
     } while (0);
 
-    return LZ_LOG_SUCCESS;
+    // 关闭导出文件
+    if (export_fd >= 0)
+    {
+        close(export_fd);
+    }
+
+    return ret;
 }
 
 /**
- * 解析日志文件名中的日期
- * @param filename 文件名（例如：2025-10-30-0.log）
- * @param out_year 输出年份
- * @param out_month 输出月份
- * @param out_day 输出日期
- * @return 是否解析成功
+ * 给环拍快照（按时间顺序，从最旧的完整记录开始）
+ * @param ctx 日志上下文
+ * @param snapshot 快照缓冲（至少 ring_capacity 字节）
+ * @param out_begin 输出快照起点的逻辑偏移
+ * @return 快照数据量
+ * @note 调用者持有 switch_mutex；拷贝期间写入线程短暂让出 CPU
  */
-static bool parse_log_filename_date(const char *filename,
-                                    int *out_year,
-                                    int *out_month,
-                                    int *out_day)
+static uint32_t ring_snapshot(lz_logger_context_t *ctx, uint8_t *snapshot, uint64_t *out_begin)
 {
-    // 验证文件名格式：yyyy-mm-dd-*.log
-    if (filename == NULL || strlen(filename) < 14)
-    {
-        return false;
-    }
+    atomic_store(&ctx->ring_frozen, true);
 
-    // 检查是否以 .log 结尾
-    const char *ext = strrchr(filename, '.');
-    if (ext == NULL || strcmp(ext, ".log") != 0)
+    // 等待已经登记的写入完成拷贝（它们的预留都在冻结之前）
+    while (atomic_load(&ctx->ring_writers) != 0)
     {
-        return false;
+        sched_yield();
     }
 
-    // 解析日期部分：yyyy-mm-dd
-    int year = 0, month = 0, day = 0;
-    if (sscanf(filename, "%4d-%2d-%2d-", &year, &month, &day) != 3)
-    {
-        return false;
-    }
+    uint64_t end = atomic_load_explicit(ctx->ring_cursor, memory_order_relaxed);
+    uint64_t begin = ring_oldest_record(ctx, end);
+    uint32_t used = (uint32_t)(end - begin);
+    uint32_t start = (uint32_t)(begin & (ctx->ring_capacity - 1));
+    uint32_t first = ctx->ring_capacity - start;
 
-    // 验证日期合法性
-    if (year < 2000 || year > 2100 ||
-        month < 1 || month > 12 ||
-        day < 1 || day > 31)
+    if (first >= used)
     {
-        return false;
+        memcpy(snapshot, ctx->ring_base + start, used);
     }
-
-    *out_year = year;
-    *out_month = month;
-    *out_day = day;
-
-    return true;
-}
-
-/**
- * 计算两个日期之间的天数差
- * @param year1, month1, day1 日期1
- * @param year2, month2, day2 日期2
- * @return 日期1 - 日期2 的天数差（可能为负数）
- */
-static int calculate_days_diff(int year1, int month1, int day1,
-                               int year2, int month2, int day2)
-{
-    // 使用 mktime 计算时间戳差异
-    struct tm tm1 = {0};
-    struct tm tm2 = {0};
-
-    tm1.tm_year = year1 - 1900;
-    tm1.tm_mon = month1 - 1;
-    tm1.tm_mday = day1;
-    tm1.tm_hour = 12; // 使用中午12点避免夏令时问题
-
-    tm2.tm_year = year2 - 1900;
-    tm2.tm_mon = month2 - 1;
-    tm2.tm_mday = day2;
-    tm2.tm_hour = 12;
-
-    time_t time1 = mktime(&tm1);
-    time_t time2 = mktime(&tm2);
-
-    if (time1 == -1 || time2 == -1)
+    else
     {
-        return 0;
+        memcpy(snapshot, ctx->ring_base + start, first);
+        memcpy(snapshot + first, ctx->ring_base, used - first);
     }
 
-    // 计算天数差（86400秒 = 1天）
-    double diff_seconds = difftime(time1, time2);
-    return (int)(diff_seconds / 86400.0);
+    atomic_store(&ctx->ring_frozen, false);
+
+    *out_begin = begin;
+    return used;
 }
 
 /**
- * 清理过期日志文件
- * @param log_dir 日志目录路径
- * @param days 保留天数（删除此天数之前的所有日志文件）
+ * 把环中的日志写成常规日志文件（数据 + footer）
+ * @param ctx 日志上下文
+ * @param path 目标文件路径（已存在则覆盖）
  * @return 错误码
  */
-FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_cleanup_expired_logs(
-    const char *log_dir,
-    int days)
+static lz_log_error_t dump_ring_to_path(lz_logger_context_t *ctx, const char *path)
 {
-
     lz_log_error_t ret = LZ_LOG_SUCCESS;
-    DIR *dir = NULL;
+    lz_crypto_context_t crypto;
+    uint8_t *snapshot = NULL;
+    int fd = -1;
+
+    memset(&crypto, 0, sizeof(crypto));
 
     do
     {
-        // 参数验证
-        if (log_dir == NULL || days < 0)
+        snapshot = (uint8_t *)malloc(ctx->ring_capacity);
+        if (snapshot == NULL)
         {
-            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
             break;
         }
 
-        // 检查目录访问权限
-        ret = check_directory_access(log_dir);
-        if (ret != LZ_LOG_SUCCESS)
+        // 串行化并发的 dump（冻结标志只有一个）
+        if (pthread_mutex_lock(&ctx->switch_mutex) != 0)
         {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
             break;
         }
+        uint64_t begin = 0;
+        uint32_t used_size = ring_snapshot(ctx, snapshot, &begin);
+        pthread_mutex_unlock(&ctx->switch_mutex);
 
-        // 获取当前日期
-        time_t now = time(NULL);
-        struct tm *tm_now = localtime(&now);
-        if (tm_now == NULL)
+        // 循环文件中是密文（计数器为逻辑偏移），先还原为明文
+        if (ctx->crypto_ctx.is_initialized && used_size > 0 &&
+            lz_crypto_process(&ctx->crypto_ctx, snapshot, snapshot, used_size, begin) != 0)
         {
-            ret = LZ_LOG_ERROR_SYSTEM;
+            ret = LZ_LOG_ERROR_FILE_WRITE;
             break;
         }
 
-        int current_year = tm_now->tm_year + 1900;
-        int current_month = tm_now->tm_mon + 1;
-        int current_day = tm_now->tm_mday;
-
-        // 打开目录
-        dir = opendir(log_dir);
-        if (dir == NULL)
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
         {
-            ret = LZ_LOG_ERROR_DIR_ACCESS;
+            ret = LZ_LOG_ERROR_FILE_CREATE;
             break;
         }
 
-        // 遍历目录
-        struct dirent *entry = NULL;
-        while ((entry = readdir(dir)) != NULL)
+        // 每次 dump 使用新的随机主盐和段编号派生密钥（快照都从偏移 0 加密，不能与其他文件共用密钥流），
+        // 文件可以用 decrypt_log.py 直接解密
+        uint8_t salt[LZ_LOG_SALT_SIZE];
+        memset(salt, 0, sizeof(salt));
+        if (ctx->encrypt_key[0] != '\0')
         {
-            // 跳过 . 和 ..
-            if (strcmp(entry->d_name, ".") == 0 ||
-                strcmp(entry->d_name, "..") == 0)
+            if (lz_crypto_next_salt(ctx->crypto_ctx.salt_ptr, LZ_CRYPTO_SALT_SNAPSHOT, salt) != 0 ||
+                lz_crypto_init(&crypto, ctx->encrypt_key, salt) != 0)
             {
-                continue;
+                LZ_DEBUG_LOG("Failed to initialize encryption for dump");
+                ret = LZ_LOG_ERROR_FILE_CREATE;
+                break;
             }
 
-            // 解析文件名中的日期
-            int file_year = 0, file_month = 0, file_day = 0;
-            if (!parse_log_filename_date(entry->d_name,
-                                         &file_year,
-                                         &file_month,
-                                         &file_day))
+            // dump 文件从偏移 0 开始，加密偏移与文件偏移一致
+            if (used_size > 0 && lz_crypto_process(&crypto, snapshot, snapshot, used_size, 0) != 0)
             {
-                // 跳过非日志文件
-                continue;
+                ret = LZ_LOG_ERROR_FILE_WRITE;
+                break;
             }
+        }
 
-            // 计算文件日期与当前日期的天数差
-            int days_diff = calculate_days_diff(current_year, current_month, current_day,
-                                                file_year, file_month, file_day);
+        ret = write_all_fd(fd, snapshot, used_size);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
 
-            // 如果文件日期早于保留天数，则删除
-            if (days_diff >= days)
-            {
-                char file_path[1024];
-                memset(file_path, 0, sizeof(file_path));
-                snprintf(file_path, sizeof(file_path) - 1, "%s/%s",
-                         log_dir, entry->d_name);
+        // footer 紧跟数据之后，文件大小即数据量加 footer
+        ret = write_export_footer(fd, salt, LZ_LOG_MAGIC_ENDX, used_size + LZ_LOG_FOOTER_SIZE, used_size);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
 
-                // 删除文件（忽略错误，继续处理其他文件）
-                unlink(file_path);
-            }
+        if (fsync(fd) != 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_WRITE;
+            break;
         }
 
+        LZ_DEBUG_LOG("Dumped ring: begin=%llu, used_size=%u", (unsigned long long)begin, used_size);
+
     } while (0);
 
-    // 关闭目录
-    if (dir != NULL)
+    if (crypto.is_initialized)
+    {
+        lz_crypto_cleanup(&crypto);
+    }
+
+    if (fd >= 0)
     {
-        closedir(dir);
+        close(fd);
     }
 
+    free(snapshot);
+
     return ret;
 }
 
@@ -1519,7 +3563,6 @@ FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_export_current_log(
 
     lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
     lz_log_error_t ret = LZ_LOG_SUCCESS;
-    int export_fd = -1;
     char export_path[1024];
 
     do
@@ -1538,28 +3581,45 @@ FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_export_current_log(
             break;
         }
 
-        // 原子读取 offset_ptr（和 write 路径一样，保证一致性）
-        atomic_uint_least32_t *offset_ptr = atomic_load(&ctx->cur_offset_ptr);
-        uint32_t used_size = atomic_load(offset_ptr);
+        // 内存模式没有日志目录，使用 lz_logger_dump 指定路径
+        if (ctx->ring_base != NULL && !ctx->ring_persistent)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
 
-        // 通过 offset_ptr 反推 mmap_base 和 file_size
-        void *mmap_base = get_mmap_base_from_offset_ptr(offset_ptr);
-        uint32_t file_size = get_file_size_from_offset_ptr(offset_ptr);
-        uint32_t max_data_size = file_size - LZ_LOG_FOOTER_SIZE;
+        // 段密钥在后台派生中：等暂存的记录写入段
+        wait_key_ready(ctx);
 
-        // 边界检查：used_size 不能超过文件可用空间
-        if (used_size > max_data_size)
+        // 写入时压缩：先把暂存块压缩追加到文件
+        if (ctx->packer != NULL)
         {
-            LZ_DEBUG_LOG("Invalid used_size: %u > max_data_size: %u", used_size, max_data_size);
-            ret = LZ_LOG_ERROR_FILE_SIZE_EXCEED;
-            break;
+            lz_packer_flush(ctx->packer);
         }
 
-        // 如果没有数据，直接返回成功
-        if (used_size == 0)
+        // 原子读取 cur_segment（和 write 路径一样，保证一致性）；循环日志没有日志段
+        lz_segment_t *segment = NULL;
+        uint32_t used_size = 0;
+        if (ctx->ring_base == NULL)
         {
-            ret = LZ_LOG_SUCCESS;
-            break;
+            segment = atomic_load(&ctx->cur_segment);
+            used_size = atomic_load(segment->offset_ptr);
+            uint32_t max_data_size = segment->capacity;
+
+            // 边界检查：used_size 不能超过文件可用空间
+            if (used_size > max_data_size)
+            {
+                LZ_DEBUG_LOG("Invalid used_size: %u > max_data_size: %u", used_size, max_data_size);
+                ret = LZ_LOG_ERROR_FILE_SIZE_EXCEED;
+                break;
+            }
+
+            // 如果没有数据，直接返回成功
+            if (used_size == 0)
+            {
+                ret = LZ_LOG_SUCCESS;
+                break;
+            }
         }
 
         // 构建导出文件路径
@@ -1569,97 +3629,101 @@ FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_export_current_log(
         // 删除已存在的 export.log（忽略错误）
         unlink(export_path);
 
-        // 创建导出文件
-        export_fd = open(export_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (export_fd < 0)
+        // 循环日志按时间顺序导出，普通日志导出当前日志段
+        if (ctx->ring_base != NULL)
         {
-            ret = LZ_LOG_ERROR_FILE_CREATE;
-            break;
+            ret = dump_ring_to_path(ctx, export_path);
         }
-
-        // 直接从 mmap 写入数据到文件（使用反推的 mmap_base）
-        ssize_t written = 0;
-        ssize_t total_written = 0;
-        const uint8_t *data_ptr = (const uint8_t *)mmap_base;
-
-        while (total_written < (ssize_t)used_size)
+        else
         {
-            written = write(export_fd, data_ptr + total_written, used_size - total_written);
-            if (written <= 0)
-            {
-                if (errno == EINTR)
-                {
-                    // 被信号中断，重试
-                    continue;
-                }
-                ret = LZ_LOG_ERROR_FILE_WRITE;
-                break;
-            }
-            total_written += written;
+            ret = export_segment_to_path(segment, used_size, export_path);
         }
-
         if (ret != LZ_LOG_SUCCESS)
         {
             break;
         }
 
-        // 写入footer: [盐16字节][魔数4字节][文件大小4字节][已用大小4字节]
-        // 从mmap的footer位置读取盐（使用反推的 mmap_base，file_size 已在前面获取）
-        uint8_t *salt_ptr = (uint8_t *)mmap_base + file_size - LZ_LOG_FOOTER_SIZE;
-        if (write(export_fd, salt_ptr, LZ_LOG_SALT_SIZE) != LZ_LOG_SALT_SIZE)
+        // 复制导出文件路径到输出参数
+        size_t path_len = strlen(export_path);
+        if (path_len >= path_buffer_size)
         {
-            ret = LZ_LOG_ERROR_FILE_WRITE;
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
             break;
         }
+        strncpy(out_export_path, export_path, path_buffer_size - 1);
+        out_export_path[path_buffer_size - 1] = '\0';
 
-        // 写入魔数
-        uint32_t magic = LZ_LOG_MAGIC_ENDX;
-        if (write(export_fd, &magic, sizeof(magic)) != sizeof(magic))
+    } while (0);
+
+    return ret;
+}
+
+/**
+ * 把当前日志转储到指定文件
+ * @param handle 日志句柄
+ * @param path 目标文件路径（已存在则覆盖）
+ * @return 错误码
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_dump(lz_logger_handle_t handle, const char *path)
+{
+    lz_logger_context_t *ctx = (lz_logger_context_t *)handle;
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+
+    do
+    {
+        // 参数验证
+        if (ctx == NULL || path == NULL || path[0] == '\0')
         {
-            ret = LZ_LOG_ERROR_FILE_WRITE;
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
             break;
         }
 
-        // 写入文件大小
-        if (write(export_fd, &file_size, sizeof(file_size)) != sizeof(file_size))
+        // 检查是否已关闭
+        if (atomic_load(&ctx->is_closed))
         {
-            ret = LZ_LOG_ERROR_FILE_WRITE;
+            ret = LZ_LOG_ERROR_HANDLE_CLOSED;
             break;
         }
 
-        // 写入已用大小
-        if (write(export_fd, &used_size, sizeof(used_size)) != sizeof(used_size))
+        // 环形模式：按时间顺序写出快照
+        if (ctx->ring_base != NULL)
         {
-            ret = LZ_LOG_ERROR_FILE_WRITE;
+            ret = dump_ring_to_path(ctx, path);
             break;
         }
 
-        LZ_DEBUG_LOG("Exported log with footer: used_size=%u", used_size);
-
-        // 同步到磁盘
-        if (fsync(export_fd) != 0)
+        // 文件模式：与导出相同，写出当前日志段（写入时压缩先提交暂存块）
+        if (ctx->packer != NULL)
         {
-            ret = LZ_LOG_ERROR_FILE_WRITE;
-            break;
+            lz_packer_flush(ctx->packer);
         }
-
-        // 复制导出文件路径到输出参数
-        size_t path_len = strlen(export_path);
-        if (path_len >= path_buffer_size)
+        lz_segment_t *segment = atomic_load(&ctx->cur_segment);
+        uint32_t used_size = atomic_load(segment->offset_ptr);
+        if (used_size > segment->capacity)
         {
-            ret = LZ_LOG_ERROR_INVALID_PARAM;
-            break;
+            // 并发写入触发了切换，只导出容量内的数据
+            used_size = segment->capacity;
         }
-        strncpy(out_export_path, export_path, path_buffer_size - 1);
-        out_export_path[path_buffer_size - 1] = '\0';
+        ret = export_segment_to_path(segment, used_size, path);
 
     } while (0);
 
-    // 关闭导出文件
-    if (export_fd >= 0)
+    return ret;
+}
+
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_decompress_file(const char *src_path,
+                                                           const char *encrypt_key,
+                                                           const char *dst_path)
+{
+    if (src_path == NULL || dst_path == NULL)
     {
-        close(export_fd);
+        return LZ_LOG_ERROR_INVALID_PARAM;
     }
 
+    lz_log_error_t ret = lz_decompress_segment(src_path, encrypt_key, dst_path);
+    if (ret != LZ_LOG_SUCCESS)
+    {
+        LZ_DEBUG_LOG("Failed to decompress %s: %d", src_path, ret);
+    }
     return ret;
 }
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <stdatomic.h>
 
 #if _WIN32
@@ -12,6 +13,12 @@
 #define FFI_PLUGIN_EXPORT
 #endif
 
+#if defined(__GNUC__) || defined(__clang__)
+#define LZ_LOG_PRINTF_FORMAT(fmt_index, args_index) __attribute__((format(printf, fmt_index, args_index)))
+#else
+#define LZ_LOG_PRINTF_FORMAT(fmt_index, args_index)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -62,15 +69,79 @@ typedef struct lz_logger_context_t* lz_logger_handle_t;
 /** 最大文件大小：100MB */
 #define LZ_LOG_MAX_FILE_SIZE (100 * 1024 * 1024)
 
+/** 按时间轮转：每天（秒） */
+#define LZ_LOG_ROTATE_DAILY (24 * 60 * 60)
+
+/** 按时间轮转：每小时（秒） */
+#define LZ_LOG_ROTATE_HOURLY (60 * 60)
+
+/** 按时间轮转的最小间隔：1 分钟 */
+#define LZ_LOG_MIN_ROTATE_INTERVAL 60
+
 /** 文件尾部魔数标记 */
 #define LZ_LOG_MAGIC_ENDX 0x456E6478  // "Endx" in hex
 
+/** 循环日志文件尾部魔数标记 */
+#define LZ_LOG_MAGIC_ENDC 0x456E6443  // "EndC" in hex
+
+/** 压缩段文件尾部魔数标记（块压缩格式，见 lz_compress.h） */
+#define LZ_LOG_MAGIC_ENDZ 0x456E645A  // "EndZ" in hex
+
+/** 写入时压缩的日志文件尾部魔数标记（数据区为连续的压缩块，封存后补写块索引变为 EndZ） */
+#define LZ_LOG_MAGIC_ENDB 0x456E6442  // "EndB" in hex
+
+/** 循环日志文件 footer 前的扩展区大小（写入游标8字节 + 最旧记录偏移8字节 + 索引块大小4字节） */
+#define LZ_LOG_CIRCULAR_EXT_SIZE 20
+
 /** 加密盐大小 */
 #define LZ_LOG_SALT_SIZE 16
 
 /** 文件尾部元数据大小（盐16字节 + 魔数4字节 + 文件大小4字节 + 已用大小4字节） */
 #define LZ_LOG_FOOTER_SIZE 28
 
+/** 存储后端类型（文件格式相同，只影响数据如何落盘） */
+typedef enum {
+    LZ_LOG_SINK_MMAP = 0,     // MAP_SHARED 内存映射（默认，零拷贝）
+    LZ_LOG_SINK_PWRITE = 1,   // 双缓冲 + 后台线程 pwrite（适合 mmap 回写表现差的文件系统）
+    LZ_LOG_SINK_DIRECT = 2,   // 4KB 对齐双缓冲 + O_DIRECT（绕过页缓存，Apple 平台使用 F_NOCACHE）
+    LZ_LOG_SINK_URING = 3,    // 双缓冲 + io_uring 异步写入（仅 Linux，不可用时退化为 PWRITE）
+} lz_log_sink_type_t;
+
+/** 压缩模式 */
+typedef enum {
+    LZ_LOG_COMPRESS_NONE = 0,   // 不压缩（默认）
+    LZ_LOG_COMPRESS_SEALED = 1, // 封存后由后台维护线程压缩（写入期间为原文）
+    LZ_LOG_COMPRESS_INLINE = 2, // 写入时按块压缩后再追加到文件（磁盘上从不出现原文）
+} lz_log_compress_mode_t;
+
+/** 预生成密钥流：游标追上生产线程时的处理方式 */
+typedef enum {
+    LZ_LOG_KEYSTREAM_FALLBACK_COMPUTE = 0, // 写入线程直接计算这段密钥流（默认，不阻塞）
+    LZ_LOG_KEYSTREAM_FALLBACK_WAIT = 1,    // 生产线程即将生成时短暂等待（最多 1ms，超时后直接计算）
+} lz_log_keystream_fallback_t;
+
+/** 加密使用的流密码（记录在每个文件 footer 的盐中，解密工具按文件识别） */
+typedef enum {
+    LZ_LOG_CIPHER_AES_CTR = 0,  // AES-256-CTR（默认）
+    LZ_LOG_CIPHER_CHACHA20 = 1, // ChaCha20（AVX2 / NEON / 可移植实现）
+    LZ_LOG_CIPHER_AUTO = 2,     // CPU 有 AES 指令时用 AES-256-CTR，否则用 ChaCha20
+} lz_log_cipher_t;
+
+/** 预生成密钥流环的大小范围（2 的幂） */
+#define LZ_LOG_KEYSTREAM_MIN_SIZE (16 * 1024)
+#define LZ_LOG_KEYSTREAM_MAX_SIZE (16 * 1024 * 1024)
+
+/** 日志级别（与 iOS LZLogLevel、Android 日志级别取值一致） */
+typedef enum {
+    LZ_LOG_LEVEL_VERBOSE = 0,
+    LZ_LOG_LEVEL_DEBUG = 1,
+    LZ_LOG_LEVEL_INFO = 2,
+    LZ_LOG_LEVEL_WARN = 3,
+    LZ_LOG_LEVEL_ERROR = 4,
+    LZ_LOG_LEVEL_FATAL = 5,
+    LZ_LOG_LEVEL_COUNT = 6,
+} lz_log_level_t;
+
 // ============================================================================
 // Public APIs
 // ============================================================================
@@ -84,6 +155,123 @@ typedef struct lz_logger_context_t* lz_logger_handle_t;
  */
 FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_max_file_size(uint32_t size);
 
+/**
+ * 设置存储后端
+ * @param type 后端类型
+ * @return 错误码
+ * @note 在 lz_logger_open 时生效，已打开的句柄保持原有后端
+ * @note PWRITE/DIRECT 后端数据先进入内存缓冲（每块256KB，最多两块），
+ *       由后台线程写满即落盘，空闲时每秒落盘一次；进程崩溃时可能丢失未落盘部分
+ * @note DIRECT 后端文件大小向上对齐到4KB，文件最后4KB只存放 footer
+ * @note URING 后端把写满的块以「写入 + fdatasync」链式请求提交给 io_uring，
+ *       后台线程不阻塞在写入系统调用上；内核不支持或被禁用时自动退化为 PWRITE
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_sink_type(lz_log_sink_type_t type);
+
+/**
+ * 设置按时间轮转的间隔
+ * @param seconds 间隔秒数：0 表示只按大小轮转；否则范围 [60, 86400]，默认 LZ_LOG_ROTATE_DAILY
+ * @return 错误码
+ * @note 在 lz_logger_open 时生效，已打开的句柄保持原有间隔
+ * @note 边界按本地时间从零点起对齐（如 3600 为每个整点），跨天时总会轮转，
+ *       保证文件名中的日期与内容一致
+ * @note 写入路径只比较缓存的下一个边界与粗粒度时钟，不调用 localtime
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_rotate_interval(uint32_t seconds);
+
+/**
+ * 设置日志保留策略（按总大小和/或天数）
+ * @param max_total_bytes 目录下日志文件总大小上限（0 表示不限制）
+ * @param max_days 保留天数，日期早于此天数的文件删除（0 表示不限制）
+ * @return 错误码
+ * @note 在 lz_logger_open 时生效；两项都为 0（默认）时不删除
+ * @note 由低优先级后台线程在打开和每次文件切换后执行，从最旧的文件开始分批删除，
+ *       不阻塞写入；当前正在写入的文件不会被删除
+ * @note 总大小按文件的预分配大小计算，实际上限会向上取整到整个文件
+ * @note 目录清单最多跟踪最近 2048 个文件：更早的文件不计入总大小，
+ *       只按天数删除（每天遍历一次目录）；只设置总大小时它们会一直保留
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_retention(uint64_t max_total_bytes, uint32_t max_days);
+
+/**
+ * 设置日志压缩模式
+ * @param mode 压缩模式（默认 LZ_LOG_COMPRESS_NONE）
+ * @return 错误码
+ * @note 在 lz_logger_open 时生效，已打开的句柄保持原有设置；只影响普通文件模式
+ * @note SEALED：由后台维护线程把不再写入的文件压缩为块压缩格式（魔数 EndZ，每块约64KB独立压缩，
+ *       文件尾部带块索引），文件名不变；加密时先压缩再用新盐加密
+ * @note INLINE：写入线程只把记录拷贝进按线程分片的 64KB 暂存块，由压缩线程压缩后追加到文件
+ *       （魔数 EndB，块头部带原文/压缩大小和首末记录时间），封存后补写块索引变为 EndZ；
+ *       不同线程的记录按块交错；未写满的块每秒提交一次，进程崩溃时最多丢失这段时间内的记录；
+ *       打开时总是创建新文件，不续写已有文件
+ * @note 压缩使用当前句柄的密钥，同一目录下的文件应使用同一密钥
+ * @note 压缩后的文件可用 tools/decrypt_log.py 直接解密，
+ *       或用 lz_logger_decompress_file 还原为普通日志文件
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_compression(lz_log_compress_mode_t mode);
+
+/**
+ * 设置预生成的加密密钥流
+ * @param ring_size 密钥流环大小（字节，2 的幂，范围 [16KB, 16MB]；0 表示关闭，默认关闭）
+ * @param lookahead 在写入位置前方预生成的距离（字节，向上取整到 4KB，范围 (0, ring_size - 4KB]）
+ * @param fallback 写入追上预生成位置时的处理方式
+ * @return 错误码
+ * @note 在 lz_logger_open / lz_logger_open_circular 时生效，只在加密时启用；INLINE 压缩模式下不启用
+ *       （加密在压缩线程中进行）
+ * @note 启用后由后台线程按 4KB 块提前生成 AES-CTR 密钥流，写入线程加密只做一次 XOR；
+ *       额外占用 ring_size 字节内存和一个线程。写入速度持续超过生产速度时退化为直接计算
+ * @note ring_size 与 lookahead 之差是写入位置之后保留的密钥流，乱序完成的写入在其中仍能命中
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_keystream(uint32_t ring_size,
+                                                         uint32_t lookahead,
+                                                         lz_log_keystream_fallback_t fallback);
+
+/**
+ * 设置加密使用的流密码
+ * @param cipher 流密码（默认 LZ_LOG_CIPHER_AES_CTR）
+ * @return 错误码
+ * @note 在 lz_logger_open / lz_logger_open_circular / lz_logger_open_memory 时生效，只影响新建的文件：
+ *       当天已有文件的流密码不同时新建文件；已有的循环日志文件沿用自己的流密码
+ * @note 没有 AES 指令的设备（低端 ARM、部分虚拟机）上查表 AES 慢且受缓存计时影响，
+ *       ChaCha20 只用加法、异或和移位；两者都可以从任意偏移开始加解密
+ * @note 流密码记录在段盐的标记中，tools/decrypt_log.py / decrypt_log.rb 按文件自动识别
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_cipher(lz_log_cipher_t cipher);
+
+/**
+ * 设置字符串字典（标签、文件名、函数名只在每个文件中第一次出现时写入）
+ * @param enabled 非 0 开启（默认关闭）
+ * @return 错误码
+ * @note 在 lz_logger_open / lz_logger_open_circular / lz_logger_open_memory 时生效，已打开的句柄保持原有设置
+ * @note 开启后 lz_logger_log / lz_logger_logv 写入行记录（首字节 0xFD）：标签、文件、函数查句柄内的
+ *       无锁字典得到编号，每个文件（环形模式每半个环）第一次使用时附带一次定义，之后只写 varint 编号；
+ *       消息仍在写入时格式化。超过 255 字节的字符串或字典已满（768 项）时内联写入
+ * @note 需要用 tools/decrypt_log.py 或 tools/lz_log_decode 还原为文本行；
+ *       lz_logger_write 写入的内容不受影响
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_string_interning(int32_t enabled);
+
+/**
+ * 设置当前线程的名称（每个线程设置一次，之后该线程的每条日志都带上名称）
+ * @param name 名称（NULL 或空串表示清除；超过 31 字节时按 UTF-8 字符边界截断）
+ * @return 错误码
+ * @note 对所有句柄生效，只影响调用线程。文本行的线程字段变为 T:线程ID(名称)；
+ *       二进制记录和行记录中仍只写线程 ID，名称在每个文件（环形模式每半个环）中每个线程附带一次；
+ *       环形模式每半个环还会补写最近写过日志的其他线程（最多 64 个）的名称
+ * @note 线程 ID 和名称缓存在线程局部变量中，每条日志不再调用 gettid / pthread_threadid_np；
+ *       fork 后子进程中第一次写日志时重新读取线程 ID
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_thread_name(const char *name);
+
+/**
+ * 立即擦除进程内缓存的所有主密钥
+ * @return 错误码
+ * @note 主密钥（PBKDF2 的结果）按密码缓存，只在有已打开的句柄使用该密码时保留，
+ *       最后一个使用该密码的句柄关闭时自动擦除；本函数用于不等关闭就清除（例如退出登录）。
+ *       仍打开的句柄不受影响，下次切换文件时重新执行 PBKDF2
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_clear_key_cache(void);
+
 /**
  * 打开/创建日志系统
  * @param log_dir 日志目录路径（必须已存在）
@@ -100,6 +288,10 @@ FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_set_max_file_size(uint32_t size);
  * [日志数据区域 N字节]
  * [魔数 ENDX 4字节]
  * [已使用大小 4字节]
+ *
+ * @note 加密时每个文件使用独立的段密钥（主密钥 PBKDF2 + 每段 HKDF）。进程内第一次使用该密钥时
+ *       主密钥在后台线程中派生，函数不等待；派生完成前写入的记录暂存在内存中（最多 256KB，
+ *       超出时写入线程等待派生完成），lz_logger_flush / 导出会先等待派生完成
  */
 FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_open(
     const char *log_dir,
@@ -109,6 +301,60 @@ FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_open(
     int32_t *out_sys_errno
 );
 
+/**
+ * 打开内存日志（飞行记录仪模式）
+ * @param capacity 环形缓冲容量（范围同文件大小，向上取整到2的幂）
+ * @param encrypt_key 加密密钥（可为NULL表示不加密，仅在 dump 时使用）
+ * @param out_handle 输出句柄指针
+ * @return 错误码
+ *
+ * 日志只写入内存中的环形缓冲，写满后覆盖最旧的记录，运行期间没有任何文件 I/O。
+ * 需要时调用 lz_logger_dump 把缓冲中的日志写成常规日志文件。
+ * - lz_logger_write / lz_logger_flush / lz_logger_close 用法与文件模式相同
+ * - lz_logger_export_current_log 不适用（没有日志目录），返回 LZ_LOG_ERROR_INVALID_PARAM
+ *
+ * @note 设置密钥时环形缓冲中仍是明文，只有 dump 出的文件是加密的；进程内存可被读取
+ *       （core dump、调试器、内存快照）时日志内容可见，对此敏感时应使用 lz_logger_open_circular
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_open_memory(
+    uint32_t capacity,
+    const char *encrypt_key,
+    lz_logger_handle_t *out_handle
+);
+
+/**
+ * 打开/创建单文件循环日志
+ * @param log_dir 日志目录路径（必须已存在）
+ * @param capacity 数据区容量（范围同文件大小，向上取整到2的幂）
+ * @param encrypt_key 加密密钥（可为NULL表示不加密）
+ * @param out_handle 输出句柄指针
+ * @param out_inner_error 输出内部错误码（可为NULL）
+ * @param out_sys_errno 输出系统errno（可为NULL）
+ * @return 错误码
+ *
+ * 日志写入目录下唯一的预分配文件 circular.log，写满后回到文件开头覆盖最旧的记录，
+ * 不再轮转、不创建新文件，磁盘占用固定。
+ * - 文件已存在且格式有效时沿用其容量并从上次的位置继续写入（capacity 只在新建时生效）
+ * - 始终使用 mmap 写入，不受 lz_logger_set_sink_type 影响
+ * - 加密计数器使用逻辑偏移（不回绕），覆盖写入不会复用密钥流
+ * - lz_logger_export_current_log / lz_logger_dump 按时间顺序导出为常规日志文件
+ *
+ * 文件结构（N 为数据区容量，块索引每 4KB 数据一项）：
+ * [数据区 N字节，按 逻辑偏移 % N 存放]
+ * [块索引：每项8字节，该块内第一条记录的逻辑偏移]
+ * [写入游标 8字节][最旧记录的逻辑偏移 8字节][索引块大小 4字节]
+ * [盐16字节][魔数 EndC 4字节][文件大小4字节][数据区容量4字节]
+ * 读取时从「最旧记录」读到「写入游标」即为按时间顺序的全部日志。
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_open_circular(
+    const char *log_dir,
+    uint32_t capacity,
+    const char *encrypt_key,
+    lz_logger_handle_t *out_handle,
+    int32_t *out_inner_error,
+    int32_t *out_sys_errno
+);
+
 /**
  * 写入日志
  * @param handle 日志句柄
@@ -122,6 +368,224 @@ FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_write(
     uint32_t len
 );
 
+/**
+ * 写入日志并按级别计数
+ * @param handle 日志句柄
+ * @param level 日志级别（超出范围时只写入不计数）
+ * @param message 日志内容
+ * @param len 日志长度
+ * @return 错误码
+ *
+ * 与 lz_logger_write 相同，额外在目录清单（manifest）中累加当前日志段的级别直方图。
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_write_level(
+    lz_logger_handle_t handle,
+    lz_log_level_t level,
+    const char *message,
+    uint32_t len
+);
+
+/**
+ * 格式化并写入一条日志（各平台封装共用的行格式）
+ * @param handle 日志句柄
+ * @param level 日志级别
+ * @param tag 标签（可为 NULL）
+ * @param file 文件名（可为 NULL，只传文件名不带路径）
+ * @param line 行号（0 表示不显示）
+ * @param func 函数名（可为 NULL 或空串，此时省略该字段）
+ * @param fmt 消息格式串（printf 语法）
+ * @return 错误码
+ *
+ * 行格式：yyyy-MM-dd HH:mm:ss.SSS [LEVEL] T:线程ID [file:line] [func] [tag] message\n
+ * - 线程设置了名称（lz_logger_set_thread_name）时线程字段为 T:线程ID(名称)
+ * - 时间戳、线程 ID 和各字段直接拼接，消息只经过一次格式化，随后与 lz_logger_write_level 相同
+ *   （一次拷贝或加密写入文件，按级别计数）
+ * - 格式化到当前线程复用的缓冲（初始 4KB，放不下时扩大并保留，上限 1MB，
+ *   空闲 30 秒后在该线程下次写日志时缩回），同样长度的长消息只格式化一次、不分配内存；任何级别都不截断
+ * - 不做级别过滤（由调用方按自己的级别设置过滤）
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_log(
+    lz_logger_handle_t handle,
+    lz_log_level_t level,
+    const char *tag,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    ...
+) LZ_LOG_PRINTF_FORMAT(7, 8);
+
+/**
+ * lz_logger_log 的 va_list 版本
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_logv(
+    lz_logger_handle_t handle,
+    lz_log_level_t level,
+    const char *tag,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args
+) LZ_LOG_PRINTF_FORMAT(7, 0);
+
+/** 类型化参数的类型 */
+typedef enum {
+    LZ_ARG_I64 = 0, // 有符号十进制
+    LZ_ARG_U64 = 1, // 无符号十进制
+    LZ_ARG_HEX = 2, // 十六进制（小写，不补 0，不带 0x）
+    LZ_ARG_F64 = 3, // 浮点数（能精确还原的最短十进制，如 0.1、1.5e-7）
+    LZ_ARG_STR = 4, // 字符串
+} lz_arg_type_t;
+
+/** 类型化参数（用 lz_arg_i64 / lz_arg_u64 / lz_arg_hex / lz_arg_f64 / lz_arg_str 构造） */
+typedef struct {
+    int32_t type; // lz_arg_type_t
+    int32_t len;  // LZ_ARG_STR 的字节数，-1 表示以 0 结尾
+    union {
+        int64_t i64;
+        uint64_t u64;
+        double f64;
+        const char *str;
+    } value;
+} lz_arg_t;
+
+static inline lz_arg_t lz_arg_i64(int64_t value) {
+    lz_arg_t arg;
+    arg.type = LZ_ARG_I64;
+    arg.len = 0;
+    arg.value.i64 = value;
+    return arg;
+}
+
+static inline lz_arg_t lz_arg_u64(uint64_t value) {
+    lz_arg_t arg;
+    arg.type = LZ_ARG_U64;
+    arg.len = 0;
+    arg.value.u64 = value;
+    return arg;
+}
+
+static inline lz_arg_t lz_arg_hex(uint64_t value) {
+    lz_arg_t arg;
+    arg.type = LZ_ARG_HEX;
+    arg.len = 0;
+    arg.value.u64 = value;
+    return arg;
+}
+
+static inline lz_arg_t lz_arg_f64(double value) {
+    lz_arg_t arg;
+    arg.type = LZ_ARG_F64;
+    arg.len = 0;
+    arg.value.f64 = value;
+    return arg;
+}
+
+/** 字符串（NULL 输出为 "(null)"；len 为 -1 时以 0 结尾） */
+static inline lz_arg_t lz_arg_strn(const char *str, int32_t len) {
+    lz_arg_t arg;
+    arg.type = LZ_ARG_STR;
+    arg.len = len;
+    arg.value.str = str;
+    return arg;
+}
+
+static inline lz_arg_t lz_arg_str(const char *str) {
+    return lz_arg_strn(str, -1);
+}
+
+/**
+ * 按类型化参数格式化并写入一条日志（行格式与 lz_logger_log 相同）
+ * @param handle 日志句柄
+ * @param level 日志级别
+ * @param tag 标签（可为 NULL）
+ * @param file 文件名（可为 NULL）
+ * @param line 行号（0 表示不显示）
+ * @param func 函数名（可为 NULL 或空串）
+ * @param fmt 消息模板，每个 "{}" 依次替换为一个参数；参数不足时 "{}" 原样输出，多余的参数忽略
+ * @param args 参数数组（count 为 0 时可为 NULL）
+ * @param count 参数个数
+ * @return 错误码
+ *
+ * 数值由内置的转换函数直接写入（整数查两位数字表，十六进制 SIMD 展开，浮点数为最短还原表示），
+ * 不经过 printf，适合延迟、ID、字节数、浮点指标较多的日志。开启字符串字典时同样写入行记录。
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_log_args(
+    lz_logger_handle_t handle,
+    lz_log_level_t level,
+    const char *tag,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    const lz_arg_t *args,
+    int32_t count
+);
+
+/** 二进制日志的调用点（由 LZ_LOG_BINARY 为每个调用点定义一个静态实例，字段均为编译期常量） */
+typedef struct {
+    const char *fmt;      // 消息格式串（printf 语法）
+    const char *tag;      // 标签
+    const char *file;     // 源文件（可带目录，登记时只保留文件名）
+    const char *func;     // 函数名
+    int line;             // 行号
+    lz_log_level_t level; // 日志级别
+    void *impl;           // 内部使用（登记信息），静态初始化为 NULL
+} lz_log_site_t;
+
+/**
+ * 以二进制形式写入一条日志（延迟格式化，通常通过 LZ_LOG_BINARY 调用）
+ * @param handle 日志句柄
+ * @param site 调用点（第一次调用时登记格式串，得到格式编号）
+ * @param ... 与 site->fmt 对应的参数
+ * @return 错误码
+ *
+ * 只写入格式编号、时间差、线程 ID 和原始参数（整数为 varint，字符串为长度 + 内容），
+ * 不在写入线程中格式化。每个文件中格式第一次出现时附带一次格式定义，
+ * 用 tools/lz_log_decode 或 tools/decrypt_log.py 还原为与 lz_logger_log 相同的文本行。
+ * 格式串含 %n、位置参数（%1$d）、宽字符（%ls）等时回退为 lz_logger_log。
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_log_binary(
+    lz_logger_handle_t handle,
+    lz_log_site_t *site,
+    ...
+);
+
+/** 只用于让编译器按 printf 规则检查 LZ_LOG_BINARY 的参数，不会被调用 */
+static inline void lz_log_check_format(const char *fmt, ...) LZ_LOG_PRINTF_FORMAT(1, 2);
+static inline void lz_log_check_format(const char *fmt, ...) { (void)fmt; }
+
+#ifdef __FILE_NAME__
+#define LZ_LOG_FILE_NAME __FILE_NAME__
+#else
+#define LZ_LOG_FILE_NAME __FILE__
+#endif
+
+/**
+ * 二进制日志：fmt 和 tag 必须是字符串常量
+ *
+ * 示例：LZ_LOG_BINARY(handle, LZ_LOG_LEVEL_INFO, "Net", "request %d took %lld us", id, cost);
+ */
+#define LZ_LOG_BINARY(handle, level, tag, fmt, ...) do { \
+        static lz_log_site_t lz_log_site_ = {fmt, tag, LZ_LOG_FILE_NAME, __func__, __LINE__, level, NULL}; \
+        if (0) { \
+            lz_log_check_format(fmt, ##__VA_ARGS__); \
+        } \
+        lz_logger_log_binary((handle), &lz_log_site_, ##__VA_ARGS__); \
+    } while (0)
+
+/**
+ * 类型化参数日志（至少一个参数）
+ *
+ * 示例：LZ_LOG_ARGS(handle, LZ_LOG_LEVEL_INFO, "Net", "request {} took {} ms", lz_arg_u64(id), lz_arg_f64(cost));
+ */
+#define LZ_LOG_ARGS(handle, level, tag, fmt, ...) do { \
+        const lz_arg_t lz_log_args_[] = {__VA_ARGS__}; \
+        lz_logger_log_args((handle), (level), (tag), LZ_LOG_FILE_NAME, __LINE__, __func__, (fmt), \
+                           lz_log_args_, (int32_t)(sizeof(lz_log_args_) / sizeof(lz_log_args_[0]))); \
+    } while (0)
+
 /**
  * 同步日志到磁盘
  * @param handle 日志句柄
@@ -151,6 +615,7 @@ FFI_PLUGIN_EXPORT const char* lz_logger_error_string(lz_log_error_t error);
  * 
  * 示例：days=7 表示保留最近7天的日志，删除7天前的所有日志文件
  * 根据文件名格式 yyyy-mm-dd-(num).log 解析日期并判断是否过期
+ * 先按目录清单删除，再遍历目录删除清单未跟踪的过期文件（最近创建的文件除外）
  */
 FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_cleanup_expired_logs(
     const char *log_dir,
@@ -165,6 +630,7 @@ FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_cleanup_expired_logs(
  * @return 错误码
  * 
  * 将当前正在写入的日志文件导出为 export.log
+ * - 循环日志按时间顺序导出；内存模式不支持（返回 LZ_LOG_ERROR_INVALID_PARAM）
  * - 如果 export.log 已存在，则先删除
  * - 直接从 mmap 读取数据，无需 flush
  * - 只导出已写入的数据部分（不包含 footer）
@@ -176,6 +642,40 @@ FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_export_current_log(
     uint32_t path_buffer_size
 );
 
+/**
+ * 把当前日志转储到指定文件
+ * @param handle 日志句柄
+ * @param path 目标文件路径（已存在则覆盖）
+ * @return 错误码
+ *
+ * 输出常规日志文件格式（数据 + footer），可用 tools/decrypt_log.py 解密。
+ * - 内存模式 / 循环文件：按时间顺序写出从最旧的完整记录开始的日志；
+ *   设置了密钥时每次 dump 生成新盐并加密
+ * - 文件模式：与 lz_logger_export_current_log 相同，只是路径由调用者指定
+ * - 可以在其他线程写入时调用；环形模式下写入线程只在环被拷贝到快照的
+ *   那一刻短暂让出 CPU，加密和写文件不阻塞写入（快照需要额外 capacity 字节内存）
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_dump(
+    lz_logger_handle_t handle,
+    const char *path
+);
+
+/**
+ * 把压缩后的日志文件还原为普通日志文件
+ * @param src_path 压缩后的日志文件路径（魔数 EndZ）
+ * @param encrypt_key 加密密钥（文件未加密时可为NULL）
+ * @param dst_path 输出文件路径（已存在则覆盖）
+ * @return 错误码
+ *
+ * 输出常规日志文件格式（数据 + footer），加密的文件用新盐重新加密，
+ * 可用 tools/decrypt_log.py 解密。不是压缩格式的文件返回 LZ_LOG_ERROR_INVALID_PARAM。
+ */
+FFI_PLUGIN_EXPORT lz_log_error_t lz_logger_decompress_file(
+    const char *src_path,
+    const char *encrypt_key,
+    const char *dst_path
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,869 @@
+#include "lz_manifest.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifndef LZ_DEBUG_LOG
+#define LZ_DEBUG_LOG(fmt, ...)                                      \
+    fprintf(stderr, "[LZLogger] lz_manifest.c:%d %s() - " fmt "\n", \
+            __LINE__, __func__, ##__VA_ARGS__)
+#endif
+
+// ============================================================================
+// Internal Structures
+// ============================================================================
+
+/** 清单映射的总大小 */
+#define MANIFEST_MAP_SIZE (sizeof(lz_manifest_header_t) + \
+                           (size_t)LZ_MANIFEST_CAPACITY * sizeof(lz_manifest_entry_t))
+
+/** 参与校验的条目字段长度（seq .. state） */
+#define MANIFEST_CHECKSUM_BYTES offsetof(lz_manifest_entry_t, checksum)
+
+/** 清单上下文（同一目录在进程内共享） */
+struct lz_manifest_t
+{
+    char log_dir[512];
+    lz_manifest_header_t *header;
+    lz_manifest_entry_t *entries;
+    int refs;                  // 引用计数（g_manifest_mutex 保护）
+    struct lz_manifest_t *next; // 已打开清单链表
+};
+
+/** 扫描目录时收集的日志文件 */
+typedef struct manifest_scan_item_t
+{
+    uint32_t date;
+    uint32_t file_num;
+    uint32_t file_size;
+    uint32_t used_size;
+    lz_segment_state_t state;
+    int64_t mtime_ns;
+} manifest_scan_item_t;
+
+_Static_assert(sizeof(lz_manifest_header_t) == 64, "manifest header must be 64 bytes");
+_Static_assert(sizeof(lz_manifest_entry_t) == 80, "manifest entry must be 80 bytes");
+
+/** 保护所有清单的打开/关闭和修改 */
+static pthread_mutex_t g_manifest_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** 进程内已打开的清单 */
+static lz_manifest_t *g_manifests = NULL;
+
+// ============================================================================
+// Utility Functions
+// ============================================================================
+
+/**
+ * 计算条目固定字段的 FNV-1a 校验和
+ */
+static uint32_t manifest_checksum(const lz_manifest_entry_t *entry)
+{
+    const uint8_t *p = (const uint8_t *)entry;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < MANIFEST_CHECKSUM_BYTES; i++)
+    {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * 序号对应的槽位
+ */
+static lz_manifest_entry_t *manifest_slot(lz_manifest_t *manifest, uint64_t seq)
+{
+    return &manifest->entries[seq % LZ_MANIFEST_CAPACITY];
+}
+
+/**
+ * 查找序号对应的有效条目（调用者持有 g_manifest_mutex）
+ * @return 不在清单中时返回 NULL
+ */
+static lz_manifest_entry_t *manifest_find(lz_manifest_t *manifest, uint64_t seq)
+{
+    lz_manifest_header_t *header = manifest->header;
+    if (seq < header->head || seq >= header->tail)
+    {
+        return NULL;
+    }
+
+    lz_manifest_entry_t *entry = manifest_slot(manifest, seq);
+    if (entry->seq != seq || entry->state == LZ_SEGMENT_STATE_FREE)
+    {
+        return NULL;
+    }
+    return entry;
+}
+
+/**
+ * 释放条目并推进 head 越过开头的空槽位（调用者持有 g_manifest_mutex）
+ */
+static void manifest_release(lz_manifest_t *manifest, lz_manifest_entry_t *entry)
+{
+    lz_manifest_header_t *header = manifest->header;
+
+    entry->state = LZ_SEGMENT_STATE_FREE;
+    entry->checksum = manifest_checksum(entry);
+
+    while (header->head < header->tail &&
+           manifest_slot(manifest, header->head)->state == LZ_SEGMENT_STATE_FREE)
+    {
+        header->head++;
+    }
+}
+
+/**
+ * 校验已映射的清单（头部 + 所有有效条目）
+ */
+static bool manifest_validate(lz_manifest_t *manifest)
+{
+    lz_manifest_header_t *header = manifest->header;
+
+    if (header->magic != LZ_MANIFEST_MAGIC ||
+        header->version != LZ_MANIFEST_VERSION ||
+        header->entry_size != sizeof(lz_manifest_entry_t) ||
+        header->capacity != LZ_MANIFEST_CAPACITY ||
+        header->head > header->tail ||
+        header->tail - header->head > LZ_MANIFEST_CAPACITY)
+    {
+        return false;
+    }
+
+    for (uint64_t seq = header->head; seq < header->tail; seq++)
+    {
+        lz_manifest_entry_t *entry = manifest_slot(manifest, seq);
+        if (entry->seq != seq ||
+            entry->state > LZ_SEGMENT_STATE_COMPRESSED ||
+            entry->checksum != manifest_checksum(entry))
+        {
+            LZ_DEBUG_LOG("Manifest entry %llu is corrupt", (unsigned long long)seq);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * 解析日志文件名：yyyy-mm-dd-(num).log
+ * @return 是否为日志文件
+ */
+static bool manifest_parse_name(const char *name, uint32_t *out_date, uint32_t *out_num)
+{
+    unsigned int year = 0, month = 0, day = 0, num = 0;
+    int consumed = 0;
+
+    if (sscanf(name, "%4u-%2u-%2u-%u.log%n", &year, &month, &day, &num, &consumed) != 4 ||
+        name[consumed] != '\0' || consumed < 14)
+    {
+        return false;
+    }
+
+    if (year < 2000 || year > 2100 || month < 1 || month > 12 || day < 1 || day > 31)
+    {
+        return false;
+    }
+
+    *out_date = year * 10000 + month * 100 + day;
+    *out_num = num;
+    return true;
+}
+
+/**
+ * 扫描结果排序：按日期和文件编号（压缩、整理会改写旧文件，最后修改时间不代表写入顺序）
+ */
+static int manifest_scan_compare(const void *a, const void *b)
+{
+    const manifest_scan_item_t *x = (const manifest_scan_item_t *)a;
+    const manifest_scan_item_t *y = (const manifest_scan_item_t *)b;
+
+    if (x->date != y->date)
+    {
+        return x->date < y->date ? -1 : 1;
+    }
+    if (x->file_num != y->file_num)
+    {
+        return x->file_num < y->file_num ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * 读取日志文件 footer 中的文件大小、已用大小和段状态（普通文件和块流为已封存，EndZ 为已压缩）
+ * @return footer 无效时返回 false
+ */
+static bool manifest_read_footer(int dir_fd, const char *name, uint32_t *out_file_size, uint32_t *out_used,
+                                 lz_segment_state_t *out_state)
+{
+    bool ok = false;
+    int fd = openat(dir_fd, name, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    uint8_t footer[LZ_LOG_FOOTER_SIZE];
+    if (fstat(fd, &st) == 0 && st.st_size >= LZ_LOG_FOOTER_SIZE &&
+        pread(fd, footer, sizeof(footer), st.st_size - LZ_LOG_FOOTER_SIZE) == (ssize_t)sizeof(footer))
+    {
+        uint32_t magic = 0, used = 0;
+        memcpy(&magic, footer + LZ_LOG_SALT_SIZE, sizeof(magic));
+        memcpy(&used, footer + LZ_LOG_SALT_SIZE + 8, sizeof(used));
+        if (magic == LZ_LOG_MAGIC_ENDX || magic == LZ_LOG_MAGIC_ENDB)
+        {
+            uint32_t capacity = (uint32_t)st.st_size - LZ_LOG_FOOTER_SIZE;
+            *out_file_size = (uint32_t)st.st_size;
+            *out_used = used > capacity ? capacity : used;
+            *out_state = LZ_SEGMENT_STATE_SEALED;
+            ok = true;
+        }
+        else if (magic == LZ_LOG_MAGIC_ENDZ)
+        {
+            *out_file_size = (uint32_t)st.st_size;
+            *out_used = used;
+            *out_state = LZ_SEGMENT_STATE_COMPRESSED;
+            ok = true;
+        }
+    }
+
+    close(fd);
+    return ok;
+}
+
+/**
+ * 遍历目录重建清单（段标记为已封存或已压缩，级别计数未知记为 0）
+ * @param manifest 已映射的清单
+ * @return 错误码
+ */
+static lz_log_error_t manifest_rebuild(lz_manifest_t *manifest)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    DIR *dir = NULL;
+    manifest_scan_item_t *items = NULL;
+    uint32_t count = 0;
+    uint32_t cap = 0;
+
+    do
+    {
+        dir = opendir(manifest->log_dir);
+        if (dir == NULL)
+        {
+            ret = LZ_LOG_ERROR_DIR_ACCESS;
+            break;
+        }
+
+        struct dirent *de = NULL;
+        while ((de = readdir(dir)) != NULL)
+        {
+            manifest_scan_item_t item;
+            memset(&item, 0, sizeof(item));
+            if (!manifest_parse_name(de->d_name, &item.date, &item.file_num))
+            {
+                continue;
+            }
+
+            struct stat st;
+            if (fstatat(dirfd(dir), de->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+            {
+                continue;
+            }
+            if (!manifest_read_footer(dirfd(dir), de->d_name, &item.file_size, &item.used_size, &item.state))
+            {
+                continue;
+            }
+#if defined(__APPLE__)
+            item.mtime_ns = (int64_t)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+            item.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+
+            if (count == cap)
+            {
+                uint32_t new_cap = cap == 0 ? 64 : cap * 2;
+                manifest_scan_item_t *grown = (manifest_scan_item_t *)realloc(items, new_cap * sizeof(*items));
+                if (grown == NULL)
+                {
+                    ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                items = grown;
+                cap = new_cap;
+            }
+            items[count++] = item;
+        }
+
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        if (count > 1)
+        {
+            qsort(items, count, sizeof(*items), manifest_scan_compare);
+        }
+
+        // 超出容量时只保留最新的部分
+        uint32_t first = count > LZ_MANIFEST_CAPACITY ? count - LZ_MANIFEST_CAPACITY : 0;
+
+        memset(manifest->header, 0, MANIFEST_MAP_SIZE);
+
+        // 已有文件中最大的文件名，新文件编号从它之后继续
+        lz_manifest_header_t *header = manifest->header;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (items[i].date > header->last_date ||
+                (items[i].date == header->last_date && items[i].file_num >= header->last_num))
+            {
+                header->last_date = items[i].date;
+                header->last_num = items[i].file_num;
+            }
+        }
+
+        for (uint32_t i = first; i < count; i++)
+        {
+            uint64_t seq = i - first;
+            lz_manifest_entry_t *entry = manifest_slot(manifest, seq);
+            entry->seq = seq;
+            entry->first_ms = 0; // 创建时间未知
+            entry->last_ms = (uint64_t)(items[i].mtime_ns / 1000000);
+            entry->date = items[i].date;
+            entry->file_num = items[i].file_num;
+            entry->file_size = items[i].file_size;
+            entry->used_size = items[i].used_size;
+            entry->state = items[i].state;
+            entry->checksum = manifest_checksum(entry);
+            if (items[i].state == LZ_SEGMENT_STATE_COMPRESSED ||
+                items[i].file_size == items[i].used_size + LZ_LOG_FOOTER_SIZE)
+            {
+                entry->flags = LZ_SEGMENT_FLAG_COMPACTED;
+            }
+        }
+
+        header->entry_size = sizeof(lz_manifest_entry_t);
+        header->capacity = LZ_MANIFEST_CAPACITY;
+        header->version = LZ_MANIFEST_VERSION;
+        header->head = 0;
+        header->tail = count - first;
+        // 魔数最后写入：重建中途崩溃时下次打开仍会重建
+        header->magic = LZ_MANIFEST_MAGIC;
+
+        LZ_DEBUG_LOG("Manifest rebuilt from directory scan: %u segments", count - first);
+
+    } while (0);
+
+    if (dir != NULL)
+    {
+        closedir(dir);
+    }
+    free(items);
+
+    return ret;
+}
+
+/**
+ * 映射清单文件（不存在时创建）
+ * @return 错误码
+ */
+static lz_log_error_t manifest_map(lz_manifest_t *manifest)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    char path[768];
+    int fd = -1;
+
+    do
+    {
+        snprintf(path, sizeof(path), "%s/%s", manifest->log_dir, LZ_MANIFEST_FILE_NAME);
+
+        fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_OPEN;
+            break;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_OPEN;
+            break;
+        }
+
+        // 大小不符（新建、截断或旧版本）：调整大小，随后的校验会触发重建
+        if ((size_t)st.st_size != MANIFEST_MAP_SIZE && ftruncate(fd, (off_t)MANIFEST_MAP_SIZE) != 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_EXTEND;
+            break;
+        }
+
+        void *map = mmap(NULL, MANIFEST_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            ret = LZ_LOG_ERROR_MMAP_FAILED;
+            break;
+        }
+
+        manifest->header = (lz_manifest_header_t *)map;
+        manifest->entries = (lz_manifest_entry_t *)((uint8_t *)map + sizeof(lz_manifest_header_t));
+
+    } while (0);
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return ret;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+lz_log_error_t lz_manifest_open(const char *log_dir, lz_manifest_t **out_manifest)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_manifest_t *manifest = NULL;
+
+    if (log_dir == NULL || out_manifest == NULL)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+    *out_manifest = NULL;
+
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    do
+    {
+        // 同一目录已打开：共享同一份映射
+        for (lz_manifest_t *it = g_manifests; it != NULL; it = it->next)
+        {
+            if (strcmp(it->log_dir, log_dir) == 0)
+            {
+                it->refs++;
+                *out_manifest = it;
+                break;
+            }
+        }
+        if (*out_manifest != NULL)
+        {
+            break;
+        }
+
+        manifest = (lz_manifest_t *)calloc(1, sizeof(lz_manifest_t));
+        if (manifest == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        strncpy(manifest->log_dir, log_dir, sizeof(manifest->log_dir) - 1);
+
+        ret = manifest_map(manifest);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        if (!manifest_validate(manifest))
+        {
+            ret = manifest_rebuild(manifest);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                break;
+            }
+        }
+
+        manifest->refs = 1;
+        manifest->next = g_manifests;
+        g_manifests = manifest;
+        *out_manifest = manifest;
+        manifest = NULL;
+
+    } while (0);
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+
+    if (manifest != NULL)
+    {
+        if (manifest->header != NULL)
+        {
+            munmap(manifest->header, MANIFEST_MAP_SIZE);
+        }
+        free(manifest);
+    }
+
+    return ret;
+}
+
+void lz_manifest_close(lz_manifest_t *manifest)
+{
+    if (manifest == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    if (--manifest->refs > 0)
+    {
+        pthread_mutex_unlock(&g_manifest_mutex);
+        return;
+    }
+
+    // 从链表移除
+    for (lz_manifest_t **it = &g_manifests; *it != NULL; it = &(*it)->next)
+    {
+        if (*it == manifest)
+        {
+            *it = manifest->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+
+    munmap(manifest->header, MANIFEST_MAP_SIZE);
+    free(manifest);
+}
+
+bool lz_manifest_newest(lz_manifest_t *manifest, lz_manifest_entry_t *out_entry)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_header_t *header = manifest->header;
+    for (uint64_t seq = header->tail; seq > header->head; seq--)
+    {
+        lz_manifest_entry_t *entry = manifest_find(manifest, seq - 1);
+        if (entry != NULL)
+        {
+            memcpy(out_entry, entry, sizeof(*out_entry));
+            found = true;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+
+    return found;
+}
+
+bool lz_manifest_last_name(lz_manifest_t *manifest, uint32_t *out_date, uint32_t *out_num)
+{
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_header_t *header = manifest->header;
+    bool found = header->last_date != 0;
+    *out_date = header->last_date;
+    *out_num = header->last_num;
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+
+    return found;
+}
+
+lz_log_error_t lz_manifest_append(lz_manifest_t *manifest,
+                                  uint32_t date,
+                                  uint32_t file_num,
+                                  uint32_t file_size,
+                                  uint32_t used_size,
+                                  uint64_t now_ms,
+                                  uint64_t *out_seq)
+{
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_header_t *header = manifest->header;
+
+    // 文件名被复用时，旧条目指向的内容已不存在
+    for (uint64_t seq = header->head; seq < header->tail; seq++)
+    {
+        lz_manifest_entry_t *entry = manifest_find(manifest, seq);
+        if (entry != NULL && entry->date == date && entry->file_num == file_num)
+        {
+            manifest_release(manifest, entry);
+        }
+    }
+
+    // 写满时淘汰最旧的条目
+    if (header->tail - header->head >= LZ_MANIFEST_CAPACITY)
+    {
+        LZ_DEBUG_LOG("Manifest full, evicting segment %llu", (unsigned long long)header->head);
+        manifest_release(manifest, manifest_slot(manifest, header->head));
+        if (header->tail - header->head >= LZ_MANIFEST_CAPACITY)
+        {
+            header->head++;
+        }
+    }
+
+    // 先写完整条目，再推进 tail
+    uint64_t seq = header->tail;
+    lz_manifest_entry_t *entry = manifest_slot(manifest, seq);
+    entry->seq = seq;
+    entry->first_ms = now_ms;
+    entry->last_ms = now_ms;
+    entry->date = date;
+    entry->file_num = file_num;
+    entry->file_size = file_size;
+    entry->used_size = used_size;
+    entry->state = LZ_SEGMENT_STATE_ACTIVE;
+    entry->checksum = manifest_checksum(entry);
+    entry->flags = 0;
+    for (int i = 0; i < LZ_LOG_LEVEL_COUNT; i++)
+    {
+        atomic_store_explicit(&entry->level_counts[i], 0, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_release);
+    header->tail = seq + 1;
+    header->last_date = date;
+    header->last_num = file_num;
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+
+    *out_seq = seq;
+    return LZ_LOG_SUCCESS;
+}
+
+void lz_manifest_update(lz_manifest_t *manifest,
+                        uint64_t seq,
+                        uint32_t used_size,
+                        lz_segment_state_t state,
+                        uint64_t now_ms)
+{
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_entry_t *entry = manifest_find(manifest, seq);
+    if (entry != NULL)
+    {
+        entry->used_size = used_size;
+        entry->state = state;
+        entry->last_ms = now_ms;
+        entry->checksum = manifest_checksum(entry);
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+}
+
+void lz_manifest_mark_compacted(lz_manifest_t *manifest,
+                                uint64_t seq,
+                                uint32_t file_size,
+                                uint32_t used_size)
+{
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_entry_t *entry = manifest_find(manifest, seq);
+    if (entry != NULL)
+    {
+        entry->file_size = file_size;
+        entry->used_size = used_size;
+        entry->flags |= LZ_SEGMENT_FLAG_COMPACTED;
+        entry->checksum = manifest_checksum(entry);
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+}
+
+void lz_manifest_mark_compressed(lz_manifest_t *manifest,
+                                 uint64_t seq,
+                                 uint32_t file_size,
+                                 uint32_t used_size)
+{
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_entry_t *entry = manifest_find(manifest, seq);
+    if (entry != NULL)
+    {
+        entry->file_size = file_size;
+        entry->used_size = used_size;
+        entry->state = LZ_SEGMENT_STATE_COMPRESSED;
+        entry->flags |= LZ_SEGMENT_FLAG_COMPACTED;
+        entry->checksum = manifest_checksum(entry);
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+}
+
+void lz_manifest_remove(lz_manifest_t *manifest, uint64_t seq)
+{
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_entry_t *entry = manifest_find(manifest, seq);
+    if (entry != NULL)
+    {
+        manifest_release(manifest, entry);
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+}
+
+void lz_manifest_remove_batch(lz_manifest_t *manifest, const uint64_t *seqs, uint32_t count)
+{
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        lz_manifest_entry_t *entry = manifest_find(manifest, seqs[i]);
+        if (entry != NULL)
+        {
+            manifest_release(manifest, entry);
+        }
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+}
+
+atomic_uint_least32_t *lz_manifest_level_counts(lz_manifest_t *manifest, uint64_t seq)
+{
+    atomic_uint_least32_t *counts = NULL;
+
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_entry_t *entry = manifest_find(manifest, seq);
+    if (entry != NULL)
+    {
+        counts = entry->level_counts;
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+
+    return counts;
+}
+
+uint32_t lz_manifest_list(lz_manifest_t *manifest, lz_manifest_entry_t *out_entries, uint32_t max_entries)
+{
+    uint32_t count = 0;
+
+    pthread_mutex_lock(&g_manifest_mutex);
+
+    lz_manifest_header_t *header = manifest->header;
+    for (uint64_t seq = header->head; seq < header->tail && count < max_entries; seq++)
+    {
+        lz_manifest_entry_t *entry = manifest_find(manifest, seq);
+        if (entry != NULL)
+        {
+            memcpy(&out_entries[count++], entry, sizeof(*entry));
+        }
+    }
+
+    pthread_mutex_unlock(&g_manifest_mutex);
+
+    return count;
+}
+
+/**
+ * 文件名键排序（日期在高 32 位，编号在低 32 位）
+ */
+static int manifest_key_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+uint32_t lz_manifest_sweep_untracked(lz_manifest_t *manifest, uint32_t cutoff)
+{
+    uint32_t deleted = 0;
+    uint32_t count = 0;
+    uint64_t newest_key = 0;
+    DIR *dir = NULL;
+    uint64_t *keys = NULL;
+
+    do
+    {
+        keys = (uint64_t *)malloc(sizeof(uint64_t) * LZ_MANIFEST_CAPACITY);
+        if (keys == NULL)
+        {
+            break;
+        }
+
+        // 在锁内取出已跟踪的文件名，遍历目录时不持锁
+        pthread_mutex_lock(&g_manifest_mutex);
+        lz_manifest_header_t *header = manifest->header;
+        for (uint64_t seq = header->head; seq < header->tail; seq++)
+        {
+            lz_manifest_entry_t *entry = manifest_find(manifest, seq);
+            if (entry != NULL)
+            {
+                keys[count++] = ((uint64_t)entry->date << 32) | entry->file_num;
+            }
+        }
+        newest_key = ((uint64_t)header->last_date << 32) | header->last_num;
+        pthread_mutex_unlock(&g_manifest_mutex);
+
+        if (count > 1)
+        {
+            qsort(keys, count, sizeof(uint64_t), manifest_key_compare);
+        }
+
+        dir = opendir(manifest->log_dir);
+        if (dir == NULL)
+        {
+            break;
+        }
+
+        struct dirent *de = NULL;
+        while ((de = readdir(dir)) != NULL)
+        {
+            uint32_t date = 0, file_num = 0;
+            if (!manifest_parse_name(de->d_name, &date, &file_num) || date > cutoff)
+            {
+                continue;
+            }
+
+            // 文件编号单调递增：不早于最近一次追加的文件可能正在写入（或在扫描开始后才创建）
+            uint64_t key = ((uint64_t)date << 32) | file_num;
+            if (key >= newest_key ||
+                bsearch(&key, keys, count, sizeof(uint64_t), manifest_key_compare) != NULL)
+            {
+                continue;
+            }
+
+            if (unlinkat(dirfd(dir), de->d_name, 0) == 0)
+            {
+                deleted++;
+            }
+        }
+
+        if (deleted > 0)
+        {
+            LZ_DEBUG_LOG("Deleted %u untracked log files", deleted);
+        }
+
+    } while (0);
+
+    if (dir != NULL)
+    {
+        closedir(dir);
+    }
+    free(keys);
+
+    return deleted;
+}
+
+void lz_manifest_build_name(const lz_manifest_entry_t *entry, char *out_name, size_t name_size)
+{
+    snprintf(out_name, name_size, "%04u-%02u-%02u-%u.log",
+             entry->date / 10000, (entry->date / 100) % 100, entry->date % 100,
+             entry->file_num);
+}
+
+void lz_manifest_build_path(const char *log_dir,
+                            const lz_manifest_entry_t *entry,
+                            char *out_path,
+                            size_t path_size)
+{
+    char name[64];
+    lz_manifest_build_name(entry, name, sizeof(name));
+    snprintf(out_path, path_size, "%s/%s", log_dir, name);
+}
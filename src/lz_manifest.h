@@ -0,0 +1,215 @@
+#ifndef LZ_MANIFEST_H
+#define LZ_MANIFEST_H
+
+#include "lz_logger.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 目录清单（Manifest）
+// ============================================================================
+/*
+ * 日志目录下的 lz_logger.manifest 记录每个日志段的序号、时间范围、大小、
+ * 级别直方图和状态。打开、切换、清理不再 stat 探测或遍历目录。
+ *
+ * 文件结构（整体 mmap，MAP_SHARED）：
+ *   [头部 64 字节][条目 × LZ_MANIFEST_CAPACITY]
+ * 条目按序号存放在环形槽位中（槽位 = seq % 容量），[head, tail) 为有效序号范围。
+ *
+ * 一致性：
+ * - 追加时先写完整条目（含校验和）再推进 tail，崩溃时新条目不可见
+ * - 条目的固定字段带校验和，级别计数在写入路径上原子累加，不参与校验
+ * - 打开时头部或任一有效条目校验失败（或清单不存在）则遍历目录重建
+ *
+ * 同一进程内同一目录只映射一次（引用计数共享），所有修改由全局互斥锁串行化；
+ * 不支持多个进程同时写同一目录（与日志文件本身的约束一致）。
+ */
+
+/** 清单文件名 */
+#define LZ_MANIFEST_FILE_NAME "lz_logger.manifest"
+
+/** 清单魔数 "LZMF" */
+#define LZ_MANIFEST_MAGIC 0x464D5A4C
+
+/** 清单格式版本 */
+#define LZ_MANIFEST_VERSION 1
+
+/**
+ * 最多记录的日志段数量（写满后淘汰最旧的条目，对应文件不再被跟踪）
+ * 未被跟踪的文件不计入容量配额，只在按天数过期后由 lz_manifest_sweep_untracked 删除
+ */
+#define LZ_MANIFEST_CAPACITY 2048
+
+/** 日志段状态 */
+typedef enum {
+    LZ_SEGMENT_STATE_FREE = 0,       // 空槽位 / 已删除
+    LZ_SEGMENT_STATE_ACTIVE = 1,     // 正在写入
+    LZ_SEGMENT_STATE_SEALED = 2,     // 已封存（不再写入）
+    LZ_SEGMENT_STATE_COMPRESSED = 3, // 已压缩
+} lz_segment_state_t;
+
+/** 段标记：已压实（数据区之后的空间已截掉，footer 紧跟数据） */
+#define LZ_SEGMENT_FLAG_COMPACTED 0x1
+
+/** 清单头部（64 字节） */
+typedef struct lz_manifest_header_t
+{
+    uint32_t magic;       // LZ_MANIFEST_MAGIC
+    uint32_t version;     // LZ_MANIFEST_VERSION
+    uint32_t entry_size;  // sizeof(lz_manifest_entry_t)
+    uint32_t capacity;    // 条目槽位数
+    uint64_t head;        // 最旧的有效序号
+    uint64_t tail;        // 下一个序号
+    uint32_t last_date;   // 最近一次追加的文件名日期 yyyymmdd（段被删除后仍保留）
+    uint32_t last_num;    // 最近一次追加的文件名编号
+    uint8_t reserved[24];
+} lz_manifest_header_t;
+
+/** 清单条目（80 字节） */
+typedef struct lz_manifest_entry_t
+{
+    uint64_t seq;       // 段序号（单调递增）
+    uint64_t first_ms;  // 段创建时间（Unix 毫秒，重建得到的条目为 0）
+    uint64_t last_ms;   // 最后更新时间（封存/刷新/关闭时写入）
+    uint32_t date;      // 文件名中的日期 yyyymmdd
+    uint32_t file_num;  // 文件名中的编号
+    uint32_t file_size; // 文件大小
+    uint32_t used_size; // 已用大小（封存/刷新/关闭时写入）
+    uint32_t state;     // lz_segment_state_t
+    uint32_t checksum;  // 以上字段的 FNV-1a 校验和
+    atomic_uint_least32_t level_counts[LZ_LOG_LEVEL_COUNT]; // 各级别日志条数
+    uint32_t flags;     // LZ_SEGMENT_FLAG_*（不参与校验）
+    uint32_t reserved[1];
+} lz_manifest_entry_t;
+
+typedef struct lz_manifest_t lz_manifest_t;
+
+/**
+ * 打开目录清单（不存在或损坏时遍历目录重建）
+ * @param log_dir 日志目录
+ * @param out_manifest 输出清单（同一目录在进程内共享，引用计数）
+ * @return 错误码
+ */
+lz_log_error_t lz_manifest_open(const char *log_dir, lz_manifest_t **out_manifest);
+
+/**
+ * 释放一次引用（最后一个引用解除映射）
+ */
+void lz_manifest_close(lz_manifest_t *manifest);
+
+/**
+ * 获取最新的有效条目
+ * @param out_entry 输出条目副本
+ * @return 清单为空时返回 false
+ */
+bool lz_manifest_newest(lz_manifest_t *manifest, lz_manifest_entry_t *out_entry);
+
+/**
+ * 获取最近一次追加的文件名（即使对应的段已被删除）
+ * @param out_date 输出日期 yyyymmdd
+ * @param out_num 输出编号
+ * @return 从未追加过时返回 false
+ */
+bool lz_manifest_last_name(lz_manifest_t *manifest, uint32_t *out_date, uint32_t *out_num);
+
+/**
+ * 追加一个新的活动段（同名的旧条目会被移除）
+ * @param date 文件名中的日期 yyyymmdd
+ * @param file_num 文件名中的编号
+ * @param file_size 文件大小
+ * @param used_size 已用大小
+ * @param now_ms 当前时间（Unix 毫秒）
+ * @param out_seq 输出新段序号
+ * @return 错误码
+ */
+lz_log_error_t lz_manifest_append(lz_manifest_t *manifest,
+                                  uint32_t date,
+                                  uint32_t file_num,
+                                  uint32_t file_size,
+                                  uint32_t used_size,
+                                  uint64_t now_ms,
+                                  uint64_t *out_seq);
+
+/**
+ * 更新段的已用大小、状态和最后更新时间（序号已不在清单中时忽略）
+ */
+void lz_manifest_update(lz_manifest_t *manifest,
+                        uint64_t seq,
+                        uint32_t used_size,
+                        lz_segment_state_t state,
+                        uint64_t now_ms);
+
+/**
+ * 记录段已压实（更新文件大小和已用大小，并设置 LZ_SEGMENT_FLAG_COMPACTED）
+ */
+void lz_manifest_mark_compacted(lz_manifest_t *manifest,
+                                uint64_t seq,
+                                uint32_t file_size,
+                                uint32_t used_size);
+
+/**
+ * 记录段已压缩（更新文件大小和已用大小，状态改为已压缩，并设置 LZ_SEGMENT_FLAG_COMPACTED）
+ */
+void lz_manifest_mark_compressed(lz_manifest_t *manifest,
+                                 uint64_t seq,
+                                 uint32_t file_size,
+                                 uint32_t used_size);
+
+/**
+ * 从清单中移除一个段（调用者负责删除文件）
+ */
+void lz_manifest_remove(lz_manifest_t *manifest, uint64_t seq);
+
+/**
+ * 批量移除段（一次加锁）
+ * @param seqs 段序号数组
+ * @param count 数量
+ */
+void lz_manifest_remove_batch(lz_manifest_t *manifest, const uint64_t *seqs, uint32_t count);
+
+/**
+ * 获取段的级别计数器（写入路径直接原子累加）
+ * @return 序号已不在清单中时返回 NULL
+ */
+atomic_uint_least32_t *lz_manifest_level_counts(lz_manifest_t *manifest, uint64_t seq);
+
+/**
+ * 按从旧到新的顺序复制有效条目
+ * @param out_entries 输出数组
+ * @param max_entries 数组容量
+ * @return 复制的条目数
+ */
+uint32_t lz_manifest_list(lz_manifest_t *manifest, lz_manifest_entry_t *out_entries, uint32_t max_entries);
+
+/**
+ * 删除目录中未被清单跟踪、且已过期的日志文件
+ * （被淘汰的条目、清单失效或重建时超出容量的文件）
+ * 最近一次追加的文件名及更新的文件不会删除，避免误删正在写入的段
+ * @param cutoff 截止日期 yyyymmdd，日期不晚于它的文件删除
+ * @return 删除的文件数
+ */
+uint32_t lz_manifest_sweep_untracked(lz_manifest_t *manifest, uint32_t cutoff);
+
+/**
+ * 构造条目对应的日志文件名（yyyy-mm-dd-N.log，不含目录）
+ */
+void lz_manifest_build_name(const lz_manifest_entry_t *entry, char *out_name, size_t name_size);
+
+/**
+ * 构造条目对应的日志文件路径
+ */
+void lz_manifest_build_path(const char *log_dir,
+                            const lz_manifest_entry_t *entry,
+                            char *out_path,
+                            size_t path_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_MANIFEST_H
@@ -0,0 +1,69 @@
+#ifndef LZ_NUMFMT_H
+#define LZ_NUMFMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 数值格式化
+// ============================================================================
+/*
+ * 日志行和类型化参数（lz_logger_log_args）使用的数值转换，不经过 printf：
+ *
+ * - 十进制整数：按位数从低到高每次写入两位（查两位数字表），位数由最高位位置查表得到
+ * - 十六进制：16 个半字节一次展开为 ASCII（x86-64 SSE2 / AArch64 NEON，其他平台按 64 位整数并行）
+ * - 浮点数：能精确还原为原值的最短十进制（Ryu 算法，128 位乘法 + 5 的幂表），
+ *   输出规则与 JavaScript 的 Number.prototype.toString 相同：
+ *   1e-6 <= |v| < 1e21 时为定点（"0.001" "1.5" "100"），否则为科学计数（"1e+21" "1.5e-7"）；
+ *   另有 "nan" "inf" "-inf" "-0"
+ *
+ * 所有函数都不写结尾 0，out 至少 LZ_NUMFMT_MAX_SIZE 字节。
+ */
+
+/** 单个数值的最大输出长度（浮点数最长 25 字节） */
+#define LZ_NUMFMT_MAX_SIZE 32
+
+/** 两位十进制数字表："00" "01" ... "99" */
+extern const char lz_numfmt_digit_pairs[200];
+
+/**
+ * 无符号十进制
+ * @param out 输出缓冲
+ * @param value 数值
+ * @return 写入的字节数
+ */
+size_t lz_numfmt_u64(char *out, uint64_t value);
+
+/**
+ * 有符号十进制
+ * @param out 输出缓冲
+ * @param value 数值
+ * @return 写入的字节数
+ */
+size_t lz_numfmt_i64(char *out, int64_t value);
+
+/**
+ * 十六进制（小写，不补 0，不带 0x）
+ * @param out 输出缓冲
+ * @param value 数值
+ * @return 写入的字节数
+ */
+size_t lz_numfmt_hex(char *out, uint64_t value);
+
+/**
+ * 浮点数（能精确还原的最短十进制）
+ * @param out 输出缓冲
+ * @param value 数值
+ * @return 写入的字节数
+ */
+size_t lz_numfmt_f64(char *out, double value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_NUMFMT_H
@@ -0,0 +1,514 @@
+#include "lz_packer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+#ifndef LZ_DEBUG_LOG
+#define LZ_DEBUG_LOG(fmt, ...)                                     \
+    fprintf(stderr, "[LZLogger] lz_packer.c:%d %s() - " fmt "\n", \
+            __LINE__, __func__, ##__VA_ARGS__)
+#endif
+
+// ============================================================================
+// Internal Structures
+// ============================================================================
+
+/** 压缩任务：一块暂存数据或一条超大记录 */
+typedef struct packer_job_t
+{
+    uint8_t *buf;      // 数据（压缩线程可原地加密）
+    uint32_t len;      // 数据长度
+    bool owned;        // 超大记录单独分配的缓冲（用完释放，不回收到空闲池）
+    uint64_t first_ms; // 第一条记录的时间
+    uint64_t last_ms;  // 最后一条记录的时间
+} packer_job_t;
+
+/** 分片：一块正在写入的暂存缓冲 */
+typedef struct packer_shard_t
+{
+    pthread_mutex_t mutex;
+    uint8_t *buf;      // 当前暂存块（LZ_COMPRESS_MAX_BLOCK 字节）
+    uint32_t fill;     // 已写入字节数
+    uint64_t first_ms; // 块内第一条记录的时间
+    uint64_t last_ms;  // 块内最后一条记录的时间
+} packer_shard_t;
+
+/** 压缩管线上下文 */
+struct lz_packer_t
+{
+    lz_packer_emit_fn emit; // 块追加回调
+    void *user;             // 回调用户数据
+
+    packer_shard_t shards[LZ_PACKER_SHARDS];
+    uint8_t *pool[LZ_PACKER_BUFFERS]; // 全部暂存缓冲（释放用）
+    uint8_t *packed;                  // 压缩输出缓冲（压缩线程独占）
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;  // 有新任务 / 停止
+    pthread_cond_t idle_cond;  // 有缓冲回收 / 任务完成
+    uint8_t *free_bufs[LZ_PACKER_BUFFERS]; // 空闲缓冲栈（mutex 保护）
+    uint32_t free_count;                    // 空闲缓冲数（mutex 保护）
+    packer_job_t queue[LZ_PACKER_QUEUE_SIZE]; // 任务队列（mutex 保护）
+    uint32_t queue_head;                      // 队首下标（mutex 保护）
+    uint32_t queue_count;                     // 队列长度（mutex 保护）
+    uint64_t submitted;                       // 已入队任务数（mutex 保护）
+    uint64_t completed;                       // 已完成任务数（mutex 保护）
+    lz_log_error_t last_error;                // 最近一次追加失败的错误码（mutex 保护）
+    bool stop;                                // 停止标记（mutex 保护）
+};
+
+// ============================================================================
+// Utility Functions
+// ============================================================================
+
+/**
+ * 获取粗粒度的当前时间（写入路径使用）
+ * @return Unix 毫秒
+ */
+static inline uint64_t packer_now_ms(void)
+{
+    struct timespec ts;
+#if defined(CLOCK_REALTIME_COARSE)
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+/**
+ * 按线程选择分片（同一线程总是落在同一分片）
+ */
+static inline packer_shard_t *packer_shard(lz_packer_t *packer)
+{
+    uintptr_t id = (uintptr_t)pthread_self();
+    id ^= id >> 17;
+    id *= 0x9E3779B1u;
+    return &packer->shards[(id >> 8) % LZ_PACKER_SHARDS];
+}
+
+/**
+ * 任务入队（队列满时等待）
+ * @note 调用者持有 packer->mutex
+ */
+static void packer_enqueue_locked(lz_packer_t *packer, const packer_job_t *job)
+{
+    while (packer->queue_count == LZ_PACKER_QUEUE_SIZE)
+    {
+        pthread_cond_wait(&packer->idle_cond, &packer->mutex);
+    }
+
+    uint32_t tail = (packer->queue_head + packer->queue_count) % LZ_PACKER_QUEUE_SIZE;
+    packer->queue[tail] = *job;
+    packer->queue_count++;
+    packer->submitted++;
+    pthread_cond_signal(&packer->work_cond);
+}
+
+/**
+ * 提交分片的当前块并换上一块空闲缓冲（没有空闲缓冲时等待压缩线程回收）
+ * @note 调用者持有分片锁，且 shard->fill > 0
+ */
+static void packer_submit_shard(lz_packer_t *packer, packer_shard_t *shard)
+{
+    packer_job_t job = {shard->buf, shard->fill, false, shard->first_ms, shard->last_ms};
+
+    pthread_mutex_lock(&packer->mutex);
+    packer_enqueue_locked(packer, &job);
+    while (packer->free_count == 0)
+    {
+        pthread_cond_wait(&packer->idle_cond, &packer->mutex);
+    }
+    shard->buf = packer->free_bufs[--packer->free_count];
+    pthread_mutex_unlock(&packer->mutex);
+
+    shard->fill = 0;
+}
+
+/**
+ * 定期提交未写满的块（在压缩线程中调用，不等待）
+ *
+ * 写入线程可能持有分片锁等待空闲缓冲，而缓冲只有压缩线程能回收，
+ * 所以这里只 trylock，并且只在有空闲缓冲和队列空间时提交。
+ */
+static void packer_flush_idle(lz_packer_t *packer)
+{
+    for (int i = 0; i < LZ_PACKER_SHARDS; i++)
+    {
+        packer_shard_t *shard = &packer->shards[i];
+        if (pthread_mutex_trylock(&shard->mutex) != 0)
+        {
+            continue;
+        }
+
+        if (shard->fill > 0)
+        {
+            pthread_mutex_lock(&packer->mutex);
+            if (packer->free_count > 0 && packer->queue_count < LZ_PACKER_QUEUE_SIZE)
+            {
+                packer_job_t job = {shard->buf, shard->fill, false, shard->first_ms, shard->last_ms};
+                packer_enqueue_locked(packer, &job);
+                shard->buf = packer->free_bufs[--packer->free_count];
+                shard->fill = 0;
+            }
+            pthread_mutex_unlock(&packer->mutex);
+        }
+
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+/**
+ * 压缩一个任务并逐块追加（超大记录按块大小切分）
+ * @return 错误码
+ */
+static lz_log_error_t packer_emit_job(lz_packer_t *packer, packer_job_t *job)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+
+    for (uint32_t pos = 0; pos < job->len; pos += LZ_COMPRESS_MAX_BLOCK)
+    {
+        uint32_t len = job->len - pos < LZ_COMPRESS_MAX_BLOCK ? job->len - pos : LZ_COMPRESS_MAX_BLOCK;
+        uint8_t *raw = job->buf + pos;
+
+        // 压缩后不变小的块原样存储
+        uint32_t packed_len = lz_compress_block(raw, len, packer->packed, len);
+
+        lz_compress_block_header_t header;
+        header.stored_size = packed_len > 0 ? packed_len : (len | LZ_COMPRESS_BLOCK_STORED);
+        header.raw_size = len;
+        header.first_ms = job->first_ms;
+        header.last_ms = job->last_ms;
+
+        lz_log_error_t emit_ret = packer->emit(packer->user, &header, packed_len > 0 ? packer->packed : raw);
+        if (emit_ret != LZ_LOG_SUCCESS)
+        {
+            LZ_DEBUG_LOG("Failed to append block: %d", emit_ret);
+            ret = emit_ret;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * 压缩线程：出队、压缩、追加，定期提交未写满的块
+ */
+static void *packer_thread(void *arg)
+{
+    lz_packer_t *packer = (lz_packer_t *)arg;
+    uint64_t next_flush_ms = packer_now_ms() + LZ_PACKER_FLUSH_INTERVAL_MS;
+
+    pthread_mutex_lock(&packer->mutex);
+    while (true)
+    {
+        if (packer->queue_count == 0 && !packer->stop)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)LZ_PACKER_FLUSH_INTERVAL_MS * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&packer->work_cond, &packer->mutex, &deadline);
+        }
+
+        // 写入持续不断时队列不会空，仍按时间提交其他分片中未写满的块
+        if (!packer->stop && packer_now_ms() >= next_flush_ms)
+        {
+            pthread_mutex_unlock(&packer->mutex);
+            packer_flush_idle(packer);
+            next_flush_ms = packer_now_ms() + LZ_PACKER_FLUSH_INTERVAL_MS;
+            pthread_mutex_lock(&packer->mutex);
+        }
+
+        if (packer->queue_count == 0)
+        {
+            if (packer->stop)
+            {
+                break;
+            }
+            continue;
+        }
+
+        packer_job_t job = packer->queue[packer->queue_head];
+        packer->queue_head = (packer->queue_head + 1) % LZ_PACKER_QUEUE_SIZE;
+        packer->queue_count--;
+        pthread_mutex_unlock(&packer->mutex);
+
+        lz_log_error_t ret = packer_emit_job(packer, &job);
+
+        pthread_mutex_lock(&packer->mutex);
+        if (job.owned)
+        {
+            free(job.buf);
+        }
+        else
+        {
+            packer->free_bufs[packer->free_count++] = job.buf;
+        }
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            packer->last_error = ret;
+        }
+        packer->completed++;
+        pthread_cond_broadcast(&packer->idle_cond);
+    }
+    pthread_mutex_unlock(&packer->mutex);
+
+    return NULL;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+lz_log_error_t lz_packer_start(lz_packer_emit_fn emit, void *user, lz_packer_t **out_packer)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_packer_t *packer = NULL;
+    int shards_ready = 0;
+    int init_step = 0;
+
+    do
+    {
+        if (emit == NULL || out_packer == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        packer = (lz_packer_t *)calloc(1, sizeof(lz_packer_t));
+        if (packer == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        packer->emit = emit;
+        packer->user = user;
+
+        packer->packed = (uint8_t *)malloc(LZ_COMPRESS_MAX_BLOCK);
+        if (packer->packed == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        for (int i = 0; i < LZ_PACKER_BUFFERS; i++)
+        {
+            packer->pool[i] = (uint8_t *)malloc(LZ_COMPRESS_MAX_BLOCK);
+            if (packer->pool[i] == NULL)
+            {
+                ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+        }
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        // 每个分片先取一块，其余进入空闲栈
+        for (int i = 0; i < LZ_PACKER_BUFFERS; i++)
+        {
+            if (i < LZ_PACKER_SHARDS)
+            {
+                packer->shards[i].buf = packer->pool[i];
+            }
+            else
+            {
+                packer->free_bufs[packer->free_count++] = packer->pool[i];
+            }
+        }
+
+        for (; shards_ready < LZ_PACKER_SHARDS; shards_ready++)
+        {
+            if (pthread_mutex_init(&packer->shards[shards_ready].mutex, NULL) != 0)
+            {
+                ret = LZ_LOG_ERROR_MUTEX_LOCK;
+                break;
+            }
+        }
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        if (pthread_mutex_init(&packer->mutex, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 1;
+
+        if (pthread_cond_init(&packer->work_cond, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 2;
+
+        if (pthread_cond_init(&packer->idle_cond, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 3;
+
+        if (pthread_create(&packer->thread, NULL, packer_thread, packer) != 0)
+        {
+            ret = LZ_LOG_ERROR_SYSTEM;
+            break;
+        }
+
+        *out_packer = packer;
+
+    } while (0);
+
+    if (ret != LZ_LOG_SUCCESS && packer != NULL)
+    {
+        if (init_step >= 3)
+        {
+            pthread_cond_destroy(&packer->idle_cond);
+        }
+        if (init_step >= 2)
+        {
+            pthread_cond_destroy(&packer->work_cond);
+        }
+        if (init_step >= 1)
+        {
+            pthread_mutex_destroy(&packer->mutex);
+        }
+        for (int i = 0; i < shards_ready; i++)
+        {
+            pthread_mutex_destroy(&packer->shards[i].mutex);
+        }
+        for (int i = 0; i < LZ_PACKER_BUFFERS; i++)
+        {
+            free(packer->pool[i]);
+        }
+        free(packer->packed);
+        free(packer);
+    }
+
+    return ret;
+}
+
+lz_log_error_t lz_packer_write(lz_packer_t *packer, const void *data, uint32_t len)
+{
+    if (packer == NULL || data == NULL || len == 0)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    packer_shard_t *shard = packer_shard(packer);
+    uint64_t now_ms = packer_now_ms();
+
+    // 超大记录：单独成为一个任务（先提交当前块，保持线程内顺序）
+    if (len > LZ_COMPRESS_MAX_BLOCK)
+    {
+        uint8_t *copy = (uint8_t *)malloc(len);
+        if (copy == NULL)
+        {
+            return LZ_LOG_ERROR_OUT_OF_MEMORY;
+        }
+        memcpy(copy, data, len);
+
+        pthread_mutex_lock(&shard->mutex);
+        if (shard->fill > 0)
+        {
+            packer_submit_shard(packer, shard);
+        }
+        packer_job_t job = {copy, len, true, now_ms, now_ms};
+        pthread_mutex_lock(&packer->mutex);
+        packer_enqueue_locked(packer, &job);
+        pthread_mutex_unlock(&packer->mutex);
+        pthread_mutex_unlock(&shard->mutex);
+
+        return LZ_LOG_SUCCESS;
+    }
+
+    pthread_mutex_lock(&shard->mutex);
+
+    // 记录不跨块：放不下时先提交当前块
+    if (shard->fill + len > LZ_COMPRESS_MAX_BLOCK)
+    {
+        packer_submit_shard(packer, shard);
+    }
+    if (shard->fill == 0)
+    {
+        shard->first_ms = now_ms;
+    }
+    memcpy(shard->buf + shard->fill, data, len);
+    shard->fill += len;
+    shard->last_ms = now_ms;
+
+    pthread_mutex_unlock(&shard->mutex);
+
+    return LZ_LOG_SUCCESS;
+}
+
+lz_log_error_t lz_packer_flush(lz_packer_t *packer)
+{
+    if (packer == NULL)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < LZ_PACKER_SHARDS; i++)
+    {
+        packer_shard_t *shard = &packer->shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        if (shard->fill > 0)
+        {
+            packer_submit_shard(packer, shard);
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
+
+    // 等待此前提交的任务全部追加完成
+    pthread_mutex_lock(&packer->mutex);
+    uint64_t target = packer->submitted;
+    while (packer->completed < target)
+    {
+        pthread_cond_wait(&packer->idle_cond, &packer->mutex);
+    }
+    lz_log_error_t ret = packer->last_error;
+    packer->last_error = LZ_LOG_SUCCESS;
+    pthread_mutex_unlock(&packer->mutex);
+
+    return ret;
+}
+
+void lz_packer_stop(lz_packer_t *packer)
+{
+    if (packer == NULL)
+    {
+        return;
+    }
+
+    lz_packer_flush(packer);
+
+    pthread_mutex_lock(&packer->mutex);
+    packer->stop = true;
+    pthread_cond_signal(&packer->work_cond);
+    pthread_mutex_unlock(&packer->mutex);
+    pthread_join(packer->thread, NULL);
+
+    pthread_cond_destroy(&packer->idle_cond);
+    pthread_cond_destroy(&packer->work_cond);
+    pthread_mutex_destroy(&packer->mutex);
+    for (int i = 0; i < LZ_PACKER_SHARDS; i++)
+    {
+        pthread_mutex_destroy(&packer->shards[i].mutex);
+    }
+    for (int i = 0; i < LZ_PACKER_BUFFERS; i++)
+    {
+        free(packer->pool[i]);
+    }
+    free(packer->packed);
+    free(packer);
+}
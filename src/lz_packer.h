@@ -0,0 +1,90 @@
+#ifndef LZ_PACKER_H
+#define LZ_PACKER_H
+
+#include "lz_logger.h"
+#include "lz_compress.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 写入时块压缩管线（Packer）
+// ============================================================================
+/*
+ * 写入线程只把记录拷贝进暂存块，压缩和落盘由独立的压缩线程完成：
+ *
+ *   lz_packer_write:  按线程选分片 → 分片锁内 memcpy 到当前暂存块
+ *                     → 块写满时换一块空闲缓冲，写满的块入队（不等待压缩）
+ *   压缩线程:         出队 → lz_compress_block → 回调 emit 把「块头部 + 负载」追加到日志段
+ *
+ * - 同一线程的记录总在同一分片，文件中按块保持线程内顺序；不同线程的记录按块交错，
+ *   块头部的首/末记录时间用于合并排序
+ * - 记录不跨块：放不下时先提交当前块；超过块大小的记录单独成为一个任务，按 64KB 切块连续追加
+ * - 缓冲用尽时写入线程等待压缩线程回收（与缓冲后端的槽位回收相同的背压方式）
+ * - 压缩线程每 LZ_PACKER_FLUSH_INTERVAL_MS 把未写满的块提交一次，低频日志也能及时落盘；
+ *   进程崩溃时最多丢失这段时间内暂存的记录
+ */
+
+/** 分片数 */
+#define LZ_PACKER_SHARDS 4
+
+/** 暂存缓冲总数（每个分片一块正在写入，其余在队列中或等待回收） */
+#define LZ_PACKER_BUFFERS (LZ_PACKER_SHARDS * 2)
+
+/** 任务队列容量（暂存缓冲 + 超大记录） */
+#define LZ_PACKER_QUEUE_SIZE (LZ_PACKER_BUFFERS * 2)
+
+/** 未写满的块的定期提交间隔（毫秒） */
+#define LZ_PACKER_FLUSH_INTERVAL_MS 1000
+
+typedef struct lz_packer_t lz_packer_t;
+
+/**
+ * 追加一个压缩好的块（在压缩线程中调用）
+ * @param user lz_packer_start 传入的用户数据
+ * @param header 块头部（明文）
+ * @param payload 负载（header->stored_size 去掉最高位的长度，回调可原地加密）
+ * @return 错误码（失败时该块被丢弃）
+ */
+typedef lz_log_error_t (*lz_packer_emit_fn)(void *user,
+                                            const lz_compress_block_header_t *header,
+                                            uint8_t *payload);
+
+/**
+ * 启动压缩管线
+ * @param emit 块追加回调
+ * @param user 回调用户数据
+ * @param out_packer 输出句柄
+ * @return 错误码
+ */
+lz_log_error_t lz_packer_start(lz_packer_emit_fn emit, void *user, lz_packer_t **out_packer);
+
+/**
+ * 写入一条记录（拷贝进当前线程分片的暂存块）
+ * @param packer 句柄
+ * @param data 数据
+ * @param len 长度
+ * @return 错误码
+ */
+lz_log_error_t lz_packer_write(lz_packer_t *packer, const void *data, uint32_t len);
+
+/**
+ * 提交所有暂存块并等待它们追加完成
+ * @param packer 句柄
+ * @return 错误码（期间有块追加失败时返回最近一次的错误）
+ */
+lz_log_error_t lz_packer_flush(lz_packer_t *packer);
+
+/**
+ * 提交剩余数据、停止压缩线程并释放资源
+ * @param packer 句柄（可为NULL）
+ */
+void lz_packer_stop(lz_packer_t *packer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_PACKER_H
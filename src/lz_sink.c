@@ -0,0 +1,1272 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // O_DIRECT
+#endif
+
+#include "lz_sink.h"
+#include "lz_uring.h"
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#ifndef LZ_DEBUG_LOG
+#define LZ_DEBUG_LOG(fmt, ...)                                  \
+    fprintf(stderr, "[LZLogger] lz_sink.c:%d %s() - " fmt "\n", \
+            __LINE__, __func__, ##__VA_ARGS__)
+#endif
+
+// ============================================================================
+// Internal Structures
+// ============================================================================
+
+/** sink 上下文 */
+struct lz_sink_t
+{
+    lz_log_sink_type_t type;
+
+    pthread_mutex_t io_mutex;  // 保护段链表以及所有文件 I/O
+    lz_segment_t *segments;    // 已注册的缓冲段（mmap 段不注册）
+
+    pthread_mutex_t wake_mutex; // 仅用于休眠/唤醒，不在持有期间做 I/O
+    pthread_cond_t wake_cond;   // 唤醒后台落盘线程
+    pthread_cond_t slot_cond;   // 通知等待槽位回收的写入线程
+    atomic_uint kicks;          // 唤醒计数（写满一块 +1）
+    bool stop;                  // 停止标志（wake_mutex 保护）
+
+    bool thread_started;
+    pthread_t thread;
+
+    // URING 后端（io_uring 不可用时为 NULL，退化为同步 pwrite）
+    lz_uring_t *uring;
+    bool uring_fixed_buffers;  // 缓冲池是否注册成功
+    bool uring_fixed_files;    // 稀疏文件表是否注册成功
+    uint8_t *uring_pool[LZ_SINK_URING_SEGMENTS * LZ_SINK_SLOT_COUNT]; // 缓冲池（io_mutex 保护分配）
+    bool uring_pool_used[LZ_SINK_URING_SEGMENTS];
+};
+
+/** URING 槽位写入状态 */
+#define SINK_URING_SLOT_IDLE 0
+#define SINK_URING_SLOT_INFLIGHT 1
+#define SINK_URING_SLOT_DONE 2
+
+/** URING 请求类型（编码在 user_data 低 3 位，0/1 为槽位写入，4/5 为槽位的部分落盘写入） */
+#define SINK_URING_OP_FSYNC 2
+#define SINK_URING_OP_FOOTER 3
+#define SINK_URING_OP_PARTIAL 4
+#define SINK_URING_OP_MASK 7
+
+/** 有请求未被内核接受时的退避时间（毫秒，不持锁等待，完成事件会提前唤醒） */
+#define SINK_URING_RETRY_MS 1
+
+// ============================================================================
+// Utility Functions
+// ============================================================================
+
+static inline bool sink_is_buffered(lz_log_sink_type_t type)
+{
+    return type == LZ_LOG_SINK_PWRITE || type == LZ_LOG_SINK_DIRECT || type == LZ_LOG_SINK_URING;
+}
+
+static inline uint32_t sink_min_u32(uint32_t a, uint32_t b)
+{
+    return a < b ? a : b;
+}
+
+static inline uint32_t sink_align_up(uint32_t value, uint32_t align)
+{
+    return (value + align - 1) / align * align;
+}
+
+/**
+ * 完整写入（处理短写和 EINTR）
+ */
+static lz_log_error_t sink_pwrite_all(int fd, const uint8_t *buf, uint32_t len, uint32_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t written = pwrite(fd, buf, len, (off_t)offset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return LZ_LOG_ERROR_FILE_WRITE;
+        }
+        buf += written;
+        offset += (uint32_t)written;
+        len -= (uint32_t)written;
+    }
+    return LZ_LOG_SUCCESS;
+}
+
+/**
+ * 完整读取（处理短读和 EINTR）
+ */
+static lz_log_error_t sink_pread_all(int fd, uint8_t *buf, uint32_t len, uint32_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t nread = pread(fd, buf, len, (off_t)offset);
+        if (nread < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (nread <= 0)
+        {
+            return LZ_LOG_ERROR_FILE_OPEN;
+        }
+        buf += nread;
+        offset += (uint32_t)nread;
+        len -= (uint32_t)nread;
+    }
+    return LZ_LOG_SUCCESS;
+}
+
+/**
+ * 计算块 k 的期望提交字节数（首块需扣除打开时已有的数据）
+ */
+static inline uint32_t sink_chunk_expected(const lz_segment_t *seg, uint32_t chunk)
+{
+    uint32_t start = chunk * LZ_SINK_CHUNK_SIZE;
+    uint32_t end = sink_min_u32(start + LZ_SINK_CHUNK_SIZE, seg->capacity);
+    uint32_t from = start > seg->base_offset ? start : seg->base_offset;
+    return end > from ? end - from : 0;
+}
+
+/**
+ * 唤醒后台落盘线程
+ */
+static void sink_kick(lz_sink_t *sink)
+{
+    pthread_mutex_lock(&sink->wake_mutex);
+    atomic_fetch_add(&sink->kicks, 1);
+    pthread_cond_signal(&sink->wake_cond);
+    pthread_mutex_unlock(&sink->wake_mutex);
+
+    if (sink->uring != NULL)
+    {
+        lz_uring_notify(sink->uring);
+    }
+}
+
+// ============================================================================
+// Buffered Sink (PWRITE / DIRECT)
+// ============================================================================
+
+/**
+ * 把 footer（含 used_size）写入文件末尾
+ * @note 调用者必须持有 io_mutex
+ */
+static lz_log_error_t sink_write_footer(lz_segment_t *seg)
+{
+    uint32_t used_size = seg->durable_end;
+    memcpy(seg->footer + LZ_LOG_FOOTER_SIZE - sizeof(uint32_t), &used_size, sizeof(used_size));
+    return sink_pwrite_all(seg->fd, seg->tail_block, seg->tail_size, seg->file_size - seg->tail_size);
+}
+
+/**
+ * 块 flush_chunk 已写入文件：推进 durable_end 并把槽位回收给 chunk + SLOT_COUNT
+ * @note 调用者必须持有 io_mutex
+ */
+static void sink_recycle_slot(lz_segment_t *seg)
+{
+    lz_sink_t *sink = seg->sink;
+    uint32_t chunk = seg->flush_chunk;
+    lz_sink_slot_t *slot = &seg->slots[chunk % LZ_SINK_SLOT_COUNT];
+    uint32_t end = sink_min_u32(chunk * LZ_SINK_CHUNK_SIZE + LZ_SINK_CHUNK_SIZE, seg->capacity);
+
+    if (end > seg->durable_end)
+    {
+        seg->durable_end = end;
+    }
+
+    // 回收槽位给 chunk + SLOT_COUNT（清零，避免部分落盘时写出旧数据）
+    memset(slot->buf, 0, LZ_SINK_CHUNK_SIZE);
+    atomic_store_explicit(&slot->committed, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->chunk, chunk + LZ_SINK_SLOT_COUNT, memory_order_release);
+    seg->flush_chunk++;
+
+    pthread_mutex_lock(&sink->wake_mutex);
+    pthread_cond_broadcast(&sink->slot_cond);
+    pthread_mutex_unlock(&sink->wake_mutex);
+}
+
+// ============================================================================
+// URING Sink
+// ============================================================================
+
+/**
+ * 获取提交请求使用的文件（优先注册文件表索引）
+ */
+static inline int sink_uring_fd(const lz_segment_t *seg, bool *out_fixed)
+{
+    *out_fixed = seg->uring_fixed_file;
+    return seg->uring_fixed_file ? seg->uring_index : seg->fd;
+}
+
+/**
+ * 收割所有完成事件（只更新状态，槽位回收由 sink_uring_advance 按顺序进行）
+ * @note 调用者必须持有 io_mutex
+ */
+static void sink_uring_reap(lz_sink_t *sink)
+{
+    uint64_t user_data = 0;
+    int32_t res = 0;
+
+    while (lz_uring_peek(sink->uring, &user_data, &res))
+    {
+        lz_segment_t *seg = (lz_segment_t *)(uintptr_t)(user_data & ~(uint64_t)SINK_URING_OP_MASK);
+        uint32_t op = (uint32_t)(user_data & SINK_URING_OP_MASK);
+        seg->uring_inflight--;
+
+        if (op < SINK_URING_OP_FSYNC)
+        {
+            lz_sink_slot_t *slot = &seg->slots[op];
+            uint32_t start = atomic_load_explicit(&slot->chunk, memory_order_relaxed) * LZ_SINK_CHUNK_SIZE;
+            uint32_t len = sink_min_u32(start + LZ_SINK_CHUNK_SIZE, seg->capacity) - start;
+            uint32_t done = res > 0 ? sink_min_u32((uint32_t)res, len) : 0;
+
+            if (done < len)
+            {
+                // 失败或短写：同步补写剩余部分（链上的 fdatasync 会被取消）
+                LZ_DEBUG_LOG("io_uring write incomplete: res=%d, len=%u, retry with pwrite", res, len);
+                sink_pwrite_all(seg->fd, slot->buf + done, len - done, start + done);
+            }
+            seg->uring_slot_state[op] = SINK_URING_SLOT_DONE;
+        }
+        else if (op == SINK_URING_OP_FOOTER)
+        {
+            seg->uring_footer_inflight = false;
+        }
+        else if (op >= SINK_URING_OP_PARTIAL)
+        {
+            // 部分落盘失败时不补写：数据仍在槽位中，随整块写入
+            if (res < 0 || (uint32_t)res < seg->uring_partial_len[op - SINK_URING_OP_PARTIAL])
+            {
+                LZ_DEBUG_LOG("io_uring partial write incomplete: res=%d", res);
+                seg->uring_partial_failed = true;
+            }
+            seg->uring_partial_inflight--;
+            if (seg->uring_partial_inflight == 0 && !seg->uring_partial_failed &&
+                seg->uring_partial_end > seg->durable_end)
+            {
+                seg->durable_end = seg->uring_partial_end;
+            }
+        }
+        else if (res < 0 && res != -ECANCELED)
+        {
+            LZ_DEBUG_LOG("io_uring fdatasync failed: res=%d", res);
+        }
+    }
+}
+
+/**
+ * 按顺序回收已完成写入的块
+ * @return 是否有进展
+ * @note 调用者必须持有 io_mutex
+ */
+static bool sink_uring_advance(lz_segment_t *seg)
+{
+    bool progressed = false;
+
+    while (seg->flush_chunk < seg->uring_submit_chunk &&
+           seg->uring_slot_state[seg->flush_chunk % LZ_SINK_SLOT_COUNT] == SINK_URING_SLOT_DONE)
+    {
+        seg->uring_slot_state[seg->flush_chunk % LZ_SINK_SLOT_COUNT] = SINK_URING_SLOT_IDLE;
+        sink_recycle_slot(seg);
+        progressed = true;
+    }
+
+    return progressed;
+}
+
+/**
+ * 异步落盘：回收已完成的块、提交写满的块（写入 → fdatasync 链）、更新 footer
+ * @note 调用者必须持有 io_mutex；不会阻塞在 I/O 上
+ */
+static lz_log_error_t sink_uring_drain(lz_segment_t *seg)
+{
+    lz_sink_t *sink = seg->sink;
+    lz_uring_t *ring = sink->uring;
+    bool fixed_file = false;
+    int fd = sink_uring_fd(seg, &fixed_file);
+    bool queued = false;
+
+    sink_uring_advance(seg);
+
+    // 1. 提交写满的块：块写入与 fdatasync 链接，数据落盘与下一批填充重叠
+    //    （部分落盘写入在途时等它完成，避免同一范围的两次写入乱序）
+    while (seg->uring_partial_inflight == 0 &&
+           seg->uring_submit_chunk < seg->flush_chunk + LZ_SINK_SLOT_COUNT &&
+           seg->uring_submit_chunk * LZ_SINK_CHUNK_SIZE < seg->capacity &&
+           lz_uring_sq_space(ring) >= 2)
+    {
+        uint32_t chunk = seg->uring_submit_chunk;
+        uint32_t index = chunk % LZ_SINK_SLOT_COUNT;
+        lz_sink_slot_t *slot = &seg->slots[index];
+
+        if (atomic_load_explicit(&slot->chunk, memory_order_acquire) != chunk ||
+            atomic_load_explicit(&slot->committed, memory_order_acquire) != sink_chunk_expected(seg, chunk))
+        {
+            break;
+        }
+
+        uint32_t start = chunk * LZ_SINK_CHUNK_SIZE;
+        uint32_t end = sink_min_u32(start + LZ_SINK_CHUNK_SIZE, seg->capacity);
+        int buf_index = (sink->uring_fixed_buffers && seg->uring_index >= 0)
+                            ? seg->uring_index * LZ_SINK_SLOT_COUNT + (int)index
+                            : -1;
+
+        lz_uring_prep_write(ring, fd, fixed_file, slot->buf, end - start, start,
+                            buf_index, true, (uintptr_t)seg | index);
+        lz_uring_prep_fdatasync(ring, fd, fixed_file, false, (uintptr_t)seg | SINK_URING_OP_FSYNC);
+
+        seg->uring_slot_state[index] = SINK_URING_SLOT_INFLIGHT;
+        seg->uring_inflight += 2;
+        seg->uring_submit_chunk++;
+        queued = true;
+    }
+
+    // 2. footer 记录已完成写入的数据末尾（同一时刻只有一个 footer 写入在途）
+    uint32_t staged_used = 0;
+    memcpy(&staged_used, seg->uring_footer_stage + LZ_LOG_FOOTER_SIZE - sizeof(uint32_t), sizeof(staged_used));
+    if (!seg->uring_footer_inflight && staged_used != seg->durable_end && lz_uring_sq_space(ring) >= 1)
+    {
+        staged_used = seg->durable_end;
+        memcpy(seg->uring_footer_stage, seg->footer, LZ_LOG_FOOTER_SIZE);
+        memcpy(seg->uring_footer_stage + LZ_LOG_FOOTER_SIZE - sizeof(uint32_t), &staged_used, sizeof(staged_used));
+
+        lz_uring_prep_write(ring, fd, fixed_file, seg->uring_footer_stage, LZ_LOG_FOOTER_SIZE,
+                            seg->file_size - LZ_LOG_FOOTER_SIZE, -1, false,
+                            (uintptr_t)seg | SINK_URING_OP_FOOTER);
+        seg->uring_footer_inflight = true;
+        seg->uring_inflight++;
+        queued = true;
+    }
+
+    if (!queued && lz_uring_pending(ring) == 0)
+    {
+        return LZ_LOG_SUCCESS;
+    }
+
+    lz_log_error_t ret = lz_uring_submit(ring);
+    if (ret != LZ_LOG_SUCCESS)
+    {
+        LZ_DEBUG_LOG("io_uring submit failed: errno=%d", errno);
+    }
+    return ret;
+}
+
+/**
+ * 空闲时的部分落盘：把未满块中已预留的部分作为写入请求提交（拷贝中的记录稍后随整块重写）
+ * 全部完成后推进 durable_end，下一轮 sink_uring_drain 更新 footer
+ * @note 调用者必须持有 io_mutex，且该段没有在途请求
+ */
+static lz_log_error_t sink_uring_partial(lz_segment_t *seg)
+{
+    lz_sink_t *sink = seg->sink;
+    lz_uring_t *ring = sink->uring;
+    bool fixed_file = false;
+    int fd = sink_uring_fd(seg, &fixed_file);
+    uint32_t reserved = sink_min_u32(atomic_load(seg->offset_ptr), seg->capacity);
+
+    seg->uring_partial_failed = false;
+    for (uint32_t chunk = seg->flush_chunk;
+         chunk < seg->flush_chunk + LZ_SINK_SLOT_COUNT && reserved > seg->durable_end &&
+         lz_uring_sq_space(ring) >= 1;
+         chunk++)
+    {
+        uint32_t index = chunk % LZ_SINK_SLOT_COUNT;
+        lz_sink_slot_t *slot = &seg->slots[index];
+        uint32_t start = chunk * LZ_SINK_CHUNK_SIZE;
+        if (start >= reserved ||
+            atomic_load_explicit(&slot->chunk, memory_order_acquire) != chunk)
+        {
+            break;
+        }
+
+        uint32_t end = sink_min_u32(reserved, start + LZ_SINK_CHUNK_SIZE);
+        int buf_index = (sink->uring_fixed_buffers && seg->uring_index >= 0)
+                            ? seg->uring_index * LZ_SINK_SLOT_COUNT + (int)index
+                            : -1;
+
+        lz_uring_prep_write(ring, fd, fixed_file, slot->buf, end - start, start,
+                            buf_index, false, (uintptr_t)seg | (SINK_URING_OP_PARTIAL + index));
+        seg->uring_partial_len[index] = end - start;
+        seg->uring_partial_end = end;
+        seg->uring_partial_inflight++;
+        seg->uring_inflight++;
+    }
+
+    if (seg->uring_partial_inflight == 0)
+    {
+        return LZ_LOG_SUCCESS;
+    }
+
+    lz_log_error_t ret = lz_uring_submit(ring);
+    if (ret != LZ_LOG_SUCCESS)
+    {
+        LZ_DEBUG_LOG("io_uring submit failed: errno=%d", errno);
+    }
+    return ret;
+}
+
+/**
+ * 等待段的所有在途请求完成（同步落盘、导出、释放前调用）
+ * @note 调用者必须持有 io_mutex
+ */
+static void sink_uring_quiesce(lz_segment_t *seg)
+{
+    lz_sink_t *sink = seg->sink;
+
+    while (seg->uring_inflight > 0)
+    {
+        // 先收割再提交：完成队列腾出空间后内核才能接受留在 SQ 中的请求
+        sink_uring_reap(sink);
+        if (seg->uring_inflight == 0)
+        {
+            break;
+        }
+        if (lz_uring_pending(sink->uring) > 0)
+        {
+            lz_uring_submit(sink->uring);
+            if (lz_uring_pending(sink->uring) > 0)
+            {
+                // 内核资源暂时不足：同步路径只能在这里等待，短暂休眠后重试
+                struct timespec ts = {0, SINK_URING_RETRY_MS * 1000000L};
+                nanosleep(&ts, NULL);
+                continue;
+            }
+        }
+        lz_uring_wait(sink->uring);
+    }
+    sink_uring_advance(seg);
+}
+
+/**
+ * 落盘已写满的块；partial 为 true 时同时写出当前未满块中已预留的部分
+ * @note 调用者必须持有 io_mutex
+ */
+static lz_log_error_t sink_drain_segment(lz_segment_t *seg, bool partial)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    bool progressed = false;
+    lz_sink_t *sink = seg->sink;
+
+    // URING：常规落盘走异步提交；同步落盘（刷新、读取、释放）先等在途请求完成，再走下面的同步路径
+    if (sink->uring != NULL)
+    {
+        if (!partial)
+        {
+            return sink_uring_drain(seg);
+        }
+        uint32_t before = seg->durable_end;
+        sink_uring_quiesce(seg);
+        progressed = (seg->durable_end != before);
+    }
+
+    // 1. 按顺序写出已满的块并回收槽位
+    while (seg->flush_chunk * LZ_SINK_CHUNK_SIZE < seg->capacity)
+    {
+        uint32_t chunk = seg->flush_chunk;
+        lz_sink_slot_t *slot = &seg->slots[chunk % LZ_SINK_SLOT_COUNT];
+
+        if (atomic_load_explicit(&slot->chunk, memory_order_acquire) != chunk ||
+            atomic_load_explicit(&slot->committed, memory_order_acquire) != sink_chunk_expected(seg, chunk))
+        {
+            break;
+        }
+
+        uint32_t start = chunk * LZ_SINK_CHUNK_SIZE;
+        uint32_t end = sink_min_u32(start + LZ_SINK_CHUNK_SIZE, seg->capacity);
+        ret = sink_pwrite_all(seg->fd, slot->buf, end - start, start);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            LZ_DEBUG_LOG("Chunk write failed: chunk=%u, errno=%d", chunk, errno);
+            break;
+        }
+
+        sink_recycle_slot(seg);
+        progressed = true;
+    }
+
+    // 2. 部分落盘：写出仍在槽位中的已预留数据（拷贝中的记录稍后随整块重写）
+    if (ret == LZ_LOG_SUCCESS && partial)
+    {
+        uint32_t reserved = sink_min_u32(atomic_load(seg->offset_ptr), seg->capacity);
+        for (uint32_t chunk = seg->flush_chunk;
+             chunk < seg->flush_chunk + LZ_SINK_SLOT_COUNT && reserved > seg->durable_end;
+             chunk++)
+        {
+            lz_sink_slot_t *slot = &seg->slots[chunk % LZ_SINK_SLOT_COUNT];
+            uint32_t start = chunk * LZ_SINK_CHUNK_SIZE;
+            if (start >= reserved ||
+                atomic_load_explicit(&slot->chunk, memory_order_acquire) != chunk)
+            {
+                break;
+            }
+
+            uint32_t end = sink_min_u32(reserved, start + LZ_SINK_CHUNK_SIZE);
+            uint32_t write_end = end;
+            if (lz_sink_type(sink) == LZ_LOG_SINK_DIRECT)
+            {
+                write_end = sink_align_up(end, LZ_SINK_DIRECT_ALIGN);
+            }
+
+            ret = sink_pwrite_all(seg->fd, slot->buf, write_end - start, start);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                LZ_DEBUG_LOG("Partial write failed: chunk=%u, errno=%d", chunk, errno);
+                break;
+            }
+
+            if (end > seg->durable_end)
+            {
+                seg->durable_end = end;
+            }
+            progressed = true;
+        }
+    }
+
+    // 3. 更新 footer 中的 used_size
+    if (progressed)
+    {
+        lz_log_error_t footer_ret = sink_write_footer(seg);
+        if (ret == LZ_LOG_SUCCESS)
+        {
+            ret = footer_ret;
+        }
+    }
+
+    seg->uring_submit_chunk = seg->flush_chunk;
+    return ret;
+}
+
+/**
+ * 后台落盘线程：写满的块立即落盘，空闲时按间隔做部分落盘
+ */
+static void *sink_drain_thread(void *arg)
+{
+    lz_sink_t *sink = (lz_sink_t *)arg;
+    unsigned int seen_kicks = 0;
+
+    pthread_mutex_lock(&sink->wake_mutex);
+    while (!sink->stop)
+    {
+        bool timed_out = false;
+        if (atomic_load(&sink->kicks) == seen_kicks)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += LZ_SINK_FLUSH_INTERVAL_MS / 1000;
+            deadline.tv_nsec += (long)(LZ_SINK_FLUSH_INTERVAL_MS % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            timed_out = pthread_cond_timedwait(&sink->wake_cond, &sink->wake_mutex, &deadline) == ETIMEDOUT;
+            if (sink->stop)
+            {
+                break;
+            }
+        }
+        seen_kicks = atomic_load(&sink->kicks);
+        pthread_mutex_unlock(&sink->wake_mutex);
+
+        pthread_mutex_lock(&sink->io_mutex);
+        for (lz_segment_t *seg = sink->segments; seg != NULL; seg = seg->next)
+        {
+            sink_drain_segment(seg, timed_out);
+        }
+        pthread_mutex_unlock(&sink->io_mutex);
+
+        pthread_mutex_lock(&sink->wake_mutex);
+    }
+    pthread_mutex_unlock(&sink->wake_mutex);
+
+    return NULL;
+}
+
+/**
+ * URING 后台线程：空闲时等待完成事件或写满通知，只提交请求，不做同步写入
+ */
+static void *sink_uring_thread(void *arg)
+{
+    lz_sink_t *sink = (lz_sink_t *)arg;
+    bool retry = false; // 上一轮有请求未被内核接受
+
+    while (true)
+    {
+        pthread_mutex_lock(&sink->wake_mutex);
+        bool stop = sink->stop;
+        pthread_mutex_unlock(&sink->wake_mutex);
+        if (stop)
+        {
+            break;
+        }
+
+        // 有请求未被内核接受时在锁外短暂退避（完成事件会提前唤醒），下一轮收割后重新提交
+        bool woken = lz_uring_idle_wait(sink->uring, retry ? SINK_URING_RETRY_MS : LZ_SINK_FLUSH_INTERVAL_MS);
+        bool timed_out = !woken && !retry;
+
+        pthread_mutex_lock(&sink->io_mutex);
+        sink_uring_reap(sink);
+        for (lz_segment_t *seg = sink->segments; seg != NULL; seg = seg->next)
+        {
+            sink_uring_drain(seg);
+            // 空闲超时且没有在途请求时才做部分落盘，同样经 io_uring 提交，不在这里等待 I/O
+            if (timed_out && seg->uring_inflight == 0)
+            {
+                sink_uring_partial(seg);
+            }
+        }
+        retry = lz_uring_pending(sink->uring) > 0;
+        pthread_mutex_unlock(&sink->io_mutex);
+    }
+
+    return NULL;
+}
+
+uint8_t *lz_sink_buffered_acquire(lz_segment_t *seg, uint32_t offset, uint32_t len, uint32_t *out_len)
+{
+    uint32_t chunk = offset / LZ_SINK_CHUNK_SIZE;
+    uint32_t chunk_start = chunk * LZ_SINK_CHUNK_SIZE;
+    lz_sink_slot_t *slot = &seg->slots[chunk % LZ_SINK_SLOT_COUNT];
+
+    // 槽位仍被 chunk - SLOT_COUNT 占用：先短暂自旋，再阻塞等待后台线程回收
+    if (atomic_load_explicit(&slot->chunk, memory_order_acquire) != chunk)
+    {
+        lz_sink_t *sink = seg->sink;
+        for (int spin = 0; spin < 64; spin++)
+        {
+            sched_yield();
+            if (atomic_load_explicit(&slot->chunk, memory_order_acquire) == chunk)
+            {
+                break;
+            }
+        }
+
+        if (atomic_load_explicit(&slot->chunk, memory_order_acquire) != chunk)
+        {
+            pthread_mutex_lock(&sink->wake_mutex);
+            while (atomic_load_explicit(&slot->chunk, memory_order_acquire) != chunk)
+            {
+                pthread_cond_wait(&sink->slot_cond, &sink->wake_mutex);
+            }
+            pthread_mutex_unlock(&sink->wake_mutex);
+        }
+    }
+
+    uint32_t room = chunk_start + LZ_SINK_CHUNK_SIZE - offset;
+    *out_len = sink_min_u32(len, room);
+    return slot->buf + (offset - chunk_start);
+}
+
+void lz_sink_buffered_commit(lz_segment_t *seg, uint32_t offset, uint32_t len)
+{
+    uint32_t chunk = offset / LZ_SINK_CHUNK_SIZE;
+    lz_sink_slot_t *slot = &seg->slots[chunk % LZ_SINK_SLOT_COUNT];
+
+    uint32_t committed = atomic_fetch_add_explicit(&slot->committed, len, memory_order_acq_rel) + len;
+    if (committed == sink_chunk_expected(seg, chunk))
+    {
+        // 最后一个完成拷贝的线程负责唤醒后台落盘
+        sink_kick(seg->sink);
+    }
+}
+
+/**
+ * 打开缓冲段：分配槽位、预读首块已有数据、读取 footer
+ */
+static lz_log_error_t sink_open_buffered(lz_sink_t *sink,
+                                         const char *file_path,
+                                         int fd,
+                                         lz_segment_t *seg)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    bool direct = (sink->type == LZ_LOG_SINK_DIRECT);
+    size_t align = direct ? LZ_SINK_DIRECT_ALIGN : sizeof(void *);
+
+    do
+    {
+        // URING：优先使用 sink 预先注册的缓冲池
+        if (sink->uring != NULL)
+        {
+            pthread_mutex_lock(&sink->io_mutex);
+            for (int i = 0; i < LZ_SINK_URING_SEGMENTS; i++)
+            {
+                if (!sink->uring_pool_used[i])
+                {
+                    sink->uring_pool_used[i] = true;
+                    seg->uring_index = i;
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&sink->io_mutex);
+        }
+
+        for (int i = 0; i < LZ_SINK_SLOT_COUNT; i++)
+        {
+            if (seg->uring_index >= 0)
+            {
+                seg->slots[i].buf = sink->uring_pool[seg->uring_index * LZ_SINK_SLOT_COUNT + i];
+                memset(seg->slots[i].buf, 0, LZ_SINK_CHUNK_SIZE);
+                continue;
+            }
+
+            void *buf = NULL;
+            if (posix_memalign(&buf, align, LZ_SINK_CHUNK_SIZE) != 0)
+            {
+                ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            memset(buf, 0, LZ_SINK_CHUNK_SIZE);
+            seg->slots[i].buf = (uint8_t *)buf;
+        }
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        // 末尾块：PWRITE 只需 footer 本身；DIRECT 需要整块对齐写入
+        if (direct)
+        {
+            void *tail = NULL;
+            if (posix_memalign(&tail, LZ_SINK_DIRECT_ALIGN, LZ_SINK_DIRECT_ALIGN) != 0)
+            {
+                ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            memset(tail, 0, LZ_SINK_DIRECT_ALIGN);
+            seg->tail_block = (uint8_t *)tail;
+            seg->tail_size = LZ_SINK_DIRECT_ALIGN;
+            seg->footer = seg->tail_block + LZ_SINK_DIRECT_ALIGN - LZ_LOG_FOOTER_SIZE;
+        }
+        else
+        {
+            seg->tail_block = seg->footer_copy;
+            seg->tail_size = LZ_LOG_FOOTER_SIZE;
+            seg->footer = seg->footer_copy;
+        }
+
+        ret = sink_pread_all(fd, seg->footer, LZ_LOG_FOOTER_SIZE, seg->file_size - LZ_LOG_FOOTER_SIZE);
+        if (ret != LZ_LOG_SUCCESS)
+        {
+            break;
+        }
+
+        // 初始化槽位：首块包含打开时已有的数据，需要预读（整块重写时保持原内容）
+        uint32_t first_chunk = seg->base_offset / LZ_SINK_CHUNK_SIZE;
+        for (uint32_t i = 0; i < LZ_SINK_SLOT_COUNT; i++)
+        {
+            uint32_t chunk = first_chunk + i;
+            atomic_init(&seg->slots[chunk % LZ_SINK_SLOT_COUNT].chunk, chunk);
+            atomic_init(&seg->slots[chunk % LZ_SINK_SLOT_COUNT].committed, 0);
+        }
+
+        uint32_t preload = seg->base_offset - first_chunk * LZ_SINK_CHUNK_SIZE;
+        if (preload > 0)
+        {
+            ret = sink_pread_all(fd, seg->slots[first_chunk % LZ_SINK_SLOT_COUNT].buf,
+                                 preload, first_chunk * LZ_SINK_CHUNK_SIZE);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                break;
+            }
+        }
+
+        seg->flush_chunk = first_chunk;
+        seg->uring_submit_chunk = first_chunk;
+        seg->durable_end = seg->base_offset;
+        atomic_init(&seg->cursor, seg->base_offset);
+        seg->offset_ptr = &seg->cursor;
+        seg->read_fd = fd;
+        seg->fd = fd;
+
+        if (direct)
+        {
+#if defined(__APPLE__)
+            // Apple 平台没有 O_DIRECT，使用 F_NOCACHE 绕过统一缓冲区缓存
+            fcntl(fd, F_NOCACHE, 1);
+#elif defined(O_DIRECT)
+            int direct_fd = open(file_path, O_WRONLY | O_DIRECT);
+            if (direct_fd >= 0)
+            {
+                seg->fd = direct_fd;
+            }
+            else
+            {
+                // 文件系统不支持 O_DIRECT（如 tmpfs）时退化为对齐的 pwrite
+                LZ_DEBUG_LOG("O_DIRECT unsupported, falling back to pwrite (errno=%d)", errno);
+            }
+#else
+            (void)file_path;
+#endif
+        }
+
+        if (seg->uring_index >= 0 && sink->uring_fixed_files)
+        {
+            seg->uring_fixed_file = lz_uring_update_file(sink->uring, (uint32_t)seg->uring_index, seg->fd);
+        }
+        memcpy(seg->uring_footer_stage, seg->footer, LZ_LOG_FOOTER_SIZE);
+
+    } while (0);
+
+    return ret;
+}
+
+/**
+ * 释放缓冲段的内存与文件描述符
+ * @note 调用者必须持有 io_mutex（缓冲池归还）
+ */
+static void sink_free_buffered(lz_segment_t *seg)
+{
+    lz_sink_t *sink = seg->sink;
+
+    if (seg->uring_index >= 0)
+    {
+        // 缓冲池归还给 sink，注册文件表槽位清空
+        if (seg->uring_fixed_file)
+        {
+            lz_uring_update_file(sink->uring, (uint32_t)seg->uring_index, -1);
+        }
+        sink->uring_pool_used[seg->uring_index] = false;
+        seg->uring_index = -1;
+        seg->uring_fixed_file = false;
+    }
+    else
+    {
+        for (int i = 0; i < LZ_SINK_SLOT_COUNT; i++)
+        {
+            free(seg->slots[i].buf);
+        }
+    }
+    for (int i = 0; i < LZ_SINK_SLOT_COUNT; i++)
+    {
+        seg->slots[i].buf = NULL;
+    }
+    if (seg->tail_block != NULL && seg->tail_block != seg->footer_copy)
+    {
+        free(seg->tail_block);
+    }
+    seg->tail_block = NULL;
+    if (seg->fd >= 0 && seg->fd != seg->read_fd)
+    {
+        close(seg->fd);
+    }
+    if (seg->read_fd >= 0)
+    {
+        close(seg->read_fd);
+    }
+    seg->fd = -1;
+    seg->read_fd = -1;
+}
+
+/**
+ * 释放 URING 后端资源（调用者需保证没有在途请求）
+ */
+static void sink_uring_teardown(lz_sink_t *sink)
+{
+    if (sink->uring != NULL)
+    {
+        lz_uring_destroy(sink->uring);
+        sink->uring = NULL;
+    }
+    for (uint32_t i = 0; i < LZ_SINK_URING_SEGMENTS * LZ_SINK_SLOT_COUNT; i++)
+    {
+        free(sink->uring_pool[i]);
+        sink->uring_pool[i] = NULL;
+    }
+    sink->uring_fixed_buffers = false;
+    sink->uring_fixed_files = false;
+}
+
+/**
+ * 初始化 URING 后端：创建 ring、分配并注册缓冲池、注册稀疏文件表
+ * @note 任何一步失败都只是降级（无 ring 时退化为 PWRITE，注册失败时使用普通写入）
+ */
+static void sink_uring_setup(lz_sink_t *sink)
+{
+    if (lz_uring_create(LZ_SINK_URING_ENTRIES, &sink->uring) != LZ_LOG_SUCCESS)
+    {
+        LZ_DEBUG_LOG("io_uring unavailable, falling back to pwrite (errno=%d)", errno);
+        sink->uring = NULL;
+        return;
+    }
+
+    uint32_t pool_count = LZ_SINK_URING_SEGMENTS * LZ_SINK_SLOT_COUNT;
+    for (uint32_t i = 0; i < pool_count; i++)
+    {
+        void *buf = NULL;
+        if (posix_memalign(&buf, LZ_SINK_DIRECT_ALIGN, LZ_SINK_CHUNK_SIZE) != 0)
+        {
+            LZ_DEBUG_LOG("io_uring buffer pool allocation failed, falling back to pwrite");
+            sink_uring_teardown(sink);
+            return;
+        }
+        sink->uring_pool[i] = (uint8_t *)buf;
+    }
+
+    sink->uring_fixed_buffers = lz_uring_register_buffers(sink->uring, sink->uring_pool,
+                                                          LZ_SINK_CHUNK_SIZE, pool_count);
+    sink->uring_fixed_files = lz_uring_register_files(sink->uring, LZ_SINK_URING_SEGMENTS);
+    LZ_DEBUG_LOG("io_uring ready: fixed_buffers=%d, fixed_files=%d",
+                 sink->uring_fixed_buffers, sink->uring_fixed_files);
+}
+
+// ============================================================================
+// Public Functions
+// ============================================================================
+
+lz_log_error_t lz_sink_create(lz_log_sink_type_t type, lz_sink_t **out_sink)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_sink_t *sink = NULL;
+    int init_step = 0;
+
+    do
+    {
+        if (out_sink == NULL || (type != LZ_LOG_SINK_MMAP && !sink_is_buffered(type)))
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        sink = (lz_sink_t *)calloc(1, sizeof(lz_sink_t));
+        if (sink == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        sink->type = type;
+        atomic_init(&sink->kicks, 0);
+
+        if (pthread_mutex_init(&sink->io_mutex, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 1;
+
+        if (pthread_mutex_init(&sink->wake_mutex, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 2;
+
+        if (pthread_cond_init(&sink->wake_cond, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 3;
+
+        if (pthread_cond_init(&sink->slot_cond, NULL) != 0)
+        {
+            ret = LZ_LOG_ERROR_MUTEX_LOCK;
+            break;
+        }
+        init_step = 4;
+
+        if (type == LZ_LOG_SINK_URING)
+        {
+            sink_uring_setup(sink);
+        }
+
+        // mmap 后端由内核负责回写，不需要后台线程
+        if (sink_is_buffered(type))
+        {
+            void *(*thread_func)(void *) = (sink->uring != NULL) ? sink_uring_thread : sink_drain_thread;
+            if (pthread_create(&sink->thread, NULL, thread_func, sink) != 0)
+            {
+                ret = LZ_LOG_ERROR_SYSTEM;
+                break;
+            }
+            sink->thread_started = true;
+        }
+
+        *out_sink = sink;
+
+    } while (0);
+
+    if (ret != LZ_LOG_SUCCESS && sink != NULL)
+    {
+        sink_uring_teardown(sink);
+        if (init_step >= 4)
+        {
+            pthread_cond_destroy(&sink->slot_cond);
+        }
+        if (init_step >= 3)
+        {
+            pthread_cond_destroy(&sink->wake_cond);
+        }
+        if (init_step >= 2)
+        {
+            pthread_mutex_destroy(&sink->wake_mutex);
+        }
+        if (init_step >= 1)
+        {
+            pthread_mutex_destroy(&sink->io_mutex);
+        }
+        free(sink);
+    }
+
+    return ret;
+}
+
+void lz_sink_destroy(lz_sink_t *sink)
+{
+    if (sink == NULL)
+    {
+        return;
+    }
+
+    if (sink->thread_started)
+    {
+        pthread_mutex_lock(&sink->wake_mutex);
+        sink->stop = true;
+        pthread_cond_signal(&sink->wake_cond);
+        pthread_mutex_unlock(&sink->wake_mutex);
+        if (sink->uring != NULL)
+        {
+            lz_uring_notify(sink->uring);
+        }
+        pthread_join(sink->thread, NULL);
+        sink->thread_started = false;
+    }
+
+    while (sink->segments != NULL)
+    {
+        lz_sink_release_segment(sink->segments, false);
+    }
+
+    sink_uring_teardown(sink);
+
+    pthread_cond_destroy(&sink->slot_cond);
+    pthread_cond_destroy(&sink->wake_cond);
+    pthread_mutex_destroy(&sink->wake_mutex);
+    pthread_mutex_destroy(&sink->io_mutex);
+    free(sink);
+}
+
+lz_log_sink_type_t lz_sink_type(const lz_sink_t *sink)
+{
+    return sink->type;
+}
+
+uint32_t lz_sink_capacity(lz_log_sink_type_t type, uint32_t file_size)
+{
+    if (type == LZ_LOG_SINK_DIRECT)
+    {
+        // DIRECT：最后一个对齐块只存放 footer，数据区保持对齐
+        if (file_size % LZ_SINK_DIRECT_ALIGN != 0 || file_size < 2 * LZ_SINK_DIRECT_ALIGN)
+        {
+            return 0;
+        }
+        return file_size - LZ_SINK_DIRECT_ALIGN;
+    }
+
+    return file_size > LZ_LOG_FOOTER_SIZE ? file_size - LZ_LOG_FOOTER_SIZE : 0;
+}
+
+uint32_t lz_sink_adjust_file_size(lz_log_sink_type_t type, uint32_t file_size)
+{
+    if (type == LZ_LOG_SINK_DIRECT)
+    {
+        return sink_align_up(file_size, LZ_SINK_DIRECT_ALIGN);
+    }
+    return file_size;
+}
+
+lz_log_error_t lz_sink_open_segment(lz_sink_t *sink,
+                                    const char *file_path,
+                                    int fd,
+                                    uint32_t file_size,
+                                    uint32_t used_size,
+                                    lz_segment_t **out_seg)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_segment_t *seg = NULL;
+
+    do
+    {
+        if (sink == NULL || fd < 0 || out_seg == NULL)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        uint32_t capacity = lz_sink_capacity(sink->type, file_size);
+        if (capacity == 0 || used_size > capacity)
+        {
+            ret = LZ_LOG_ERROR_FILE_SIZE_EXCEED;
+            break;
+        }
+
+        seg = (lz_segment_t *)calloc(1, sizeof(lz_segment_t));
+        if (seg == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        seg->sink = sink;
+        seg->file_size = file_size;
+        seg->capacity = capacity;
+        seg->base_offset = used_size;
+        seg->fd = -1;
+        seg->read_fd = -1;
+        seg->uring_index = -1;
+
+        if (sink->type == LZ_LOG_SINK_MMAP)
+        {
+            // 执行 mmap 映射（读写、共享）
+            void *ptr = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (ptr == MAP_FAILED)
+            {
+                ret = LZ_LOG_ERROR_MMAP_FAILED;
+                break;
+            }
+
+            seg->map_base = (uint8_t *)ptr;
+            seg->footer = seg->map_base + file_size - LZ_LOG_FOOTER_SIZE;
+            // 偏移量指针位置：footer 最后4字节（used_size字段）
+            seg->offset_ptr = (atomic_uint_least32_t *)(seg->map_base + file_size - sizeof(uint32_t));
+
+            // mmap 完成后即可关闭文件描述符
+            close(fd);
+        }
+        else
+        {
+            ret = sink_open_buffered(sink, file_path, fd, seg);
+            if (ret != LZ_LOG_SUCCESS)
+            {
+                if (seg->fd != fd && seg->fd >= 0)
+                {
+                    close(seg->fd);
+                }
+                seg->fd = -1;
+                seg->read_fd = -1; // fd 所有权仍在调用者
+                pthread_mutex_lock(&sink->io_mutex);
+                sink_free_buffered(seg);
+                pthread_mutex_unlock(&sink->io_mutex);
+                break;
+            }
+
+            pthread_mutex_lock(&sink->io_mutex);
+            seg->next = sink->segments;
+            sink->segments = seg;
+            pthread_mutex_unlock(&sink->io_mutex);
+        }
+
+        *out_seg = seg;
+
+    } while (0);
+
+    if (ret != LZ_LOG_SUCCESS && seg != NULL)
+    {
+        free(seg);
+    }
+
+    return ret;
+}
+
+void lz_sink_release_segment(lz_segment_t *seg, bool keep_mapping)
+{
+    if (seg == NULL)
+    {
+        return;
+    }
+
+    lz_crypto_cleanup(&seg->crypto);
+
+    if (seg->map_base != NULL)
+    {
+        if (!keep_mapping)
+        {
+            munmap(seg->map_base, seg->file_size);
+        }
+        free(seg);
+        return;
+    }
+
+    lz_sink_t *sink = seg->sink;
+    pthread_mutex_lock(&sink->io_mutex);
+
+    // 从链表摘除，后台线程不再访问该段
+    for (lz_segment_t **pp = &sink->segments; *pp != NULL; pp = &(*pp)->next)
+    {
+        if (*pp == seg)
+        {
+            *pp = seg->next;
+            break;
+        }
+    }
+
+    sink_drain_segment(seg, true);
+    sink_free_buffered(seg);
+
+    pthread_mutex_unlock(&sink->io_mutex);
+    free(seg);
+}
+
+lz_log_error_t lz_sink_sync(lz_segment_t *seg, bool durable)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+
+    if (seg == NULL)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    if (seg->map_base != NULL)
+    {
+        if (msync(seg->map_base, seg->file_size, durable ? MS_SYNC : MS_ASYNC) != 0)
+        {
+            ret = LZ_LOG_ERROR_FILE_WRITE;
+        }
+        return ret;
+    }
+
+    pthread_mutex_lock(&seg->sink->io_mutex);
+    ret = sink_drain_segment(seg, true);
+    if (ret == LZ_LOG_SUCCESS && durable && fdatasync(seg->fd) != 0)
+    {
+        ret = LZ_LOG_ERROR_FILE_WRITE;
+    }
+    pthread_mutex_unlock(&seg->sink->io_mutex);
+
+    return ret;
+}
+
+lz_log_error_t lz_sink_read(lz_segment_t *seg, uint32_t offset, void *buf, uint32_t len)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+
+    if (seg == NULL || buf == NULL || offset + len > seg->capacity)
+    {
+        return LZ_LOG_ERROR_INVALID_PARAM;
+    }
+
+    if (seg->map_base != NULL)
+    {
+        memcpy(buf, seg->map_base + offset, len);
+        return LZ_LOG_SUCCESS;
+    }
+
+    // 先把缓冲中的数据写出，再从文件读取
+    pthread_mutex_lock(&seg->sink->io_mutex);
+    ret = sink_drain_segment(seg, true);
+    if (ret == LZ_LOG_SUCCESS)
+    {
+        ret = sink_pread_all(seg->read_fd, (uint8_t *)buf, len, offset);
+    }
+    pthread_mutex_unlock(&seg->sink->io_mutex);
+
+    return ret;
+}
@@ -0,0 +1,218 @@
+#ifndef LZ_SINK_H
+#define LZ_SINK_H
+
+#include "lz_logger.h"
+#include "lz_crypto.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// 存储后端（Sink）抽象
+// ============================================================================
+/*
+ * 日志核心只负责「预留空间 + 拷贝 + 加密」，数据最终如何落到文件由 sink 决定：
+ *
+ * - LZ_LOG_SINK_MMAP:   MAP_SHARED 映射整个文件，预留的偏移即映射地址，零拷贝
+ * - LZ_LOG_SINK_PWRITE: 两块内存缓冲轮换，写满的块由后台线程 pwrite 落盘
+ * - LZ_LOG_SINK_DIRECT: 同 PWRITE，但缓冲按 4KB 对齐并以 O_DIRECT 写入，绕过页缓存
+ * - LZ_LOG_SINK_URING:  同 PWRITE，但写满的块以「写入 + fdatasync」链式请求提交给 io_uring，
+ *                       完成后再回收槽位；缓冲来自 sink 预先注册的缓冲池；空闲时的部分落盘
+ *                       同样作为写入请求提交，完成前不提交该段的整块写入
+ *
+ * 所有 sink 共用同一份文件格式（数据区 + 28 字节 footer），写入游标统一为
+ * segment->offset_ptr，因此 lz_logger_write 的无锁预留逻辑无需区分后端。
+ *
+ * 写入流程（核心侧）：
+ *   off = atomic_fetch_add(seg->offset_ptr, len);
+ *   while (len) { dst = lz_sink_acquire(seg, off, len, &n); memcpy + 加密; lz_sink_commit(seg, off, n); ... }
+ *
+ * mmap 段的 acquire/commit 是内联的指针运算，不引入额外开销。
+ */
+
+/** 缓冲后端单块大小：256KB（O_DIRECT 对齐的整数倍） */
+#define LZ_SINK_CHUNK_SIZE (256 * 1024)
+
+/** O_DIRECT 对齐粒度 */
+#define LZ_SINK_DIRECT_ALIGN 4096
+
+/** 缓冲后端后台刷盘间隔（毫秒），保证低频日志也能及时落盘 */
+#define LZ_SINK_FLUSH_INTERVAL_MS 1000
+
+/** 缓冲后端的缓冲块数量（双缓冲） */
+#define LZ_SINK_SLOT_COUNT 2
+
+/** URING 后端缓冲池可同时容纳的段数（当前段 + 延迟释放的旧段 + 切换中的新段） */
+#define LZ_SINK_URING_SEGMENTS 4
+
+/** URING 后端 SQ 深度 */
+#define LZ_SINK_URING_ENTRIES 32
+
+typedef struct lz_sink_t lz_sink_t;
+
+/** 缓冲块槽位 */
+typedef struct lz_sink_slot_t
+{
+    uint8_t *buf;                       // 块缓冲区（DIRECT 模式按 4KB 对齐）
+    atomic_uint_least32_t chunk;        // 当前占用该槽位的块序号
+    atomic_uint_least32_t committed;    // 该块已提交（拷贝完成）的字节数
+} lz_sink_slot_t;
+
+/** 日志段：一个已打开的日志文件 */
+typedef struct lz_segment_t
+{
+    atomic_uint_least32_t *offset_ptr; // 写入游标（mmap: footer 中的 used_size；缓冲: cursor）
+    uint8_t *footer;                   // 28 字节 footer（mmap: 映射内；缓冲: footer_copy）
+    uint8_t *map_base;                 // mmap 基地址（缓冲后端为 NULL）
+    uint32_t file_size;                // 文件大小
+    uint32_t capacity;                 // 可写数据区大小
+    lz_sink_t *sink;                   // 所属 sink
+    lz_crypto_context_t crypto;        // 段密钥（由日志模块按 footer 中的段盐派生；未加密时未初始化）
+
+    // 以下字段仅缓冲后端使用
+    int fd;                                 // 数据写入 fd（DIRECT 模式带 O_DIRECT）
+    int read_fd;                            // 读取 fd（导出用，不带 O_DIRECT）
+    uint32_t base_offset;                   // 打开时已有的数据量
+    uint32_t flush_chunk;                   // 下一个待落盘的块序号（io_mutex 保护）
+    uint32_t durable_end;                   // 已写入文件的数据末尾（io_mutex 保护）
+    atomic_uint_least32_t cursor;           // 写入游标本体
+    lz_sink_slot_t slots[LZ_SINK_SLOT_COUNT];
+    uint8_t *tail_block;                    // 文件末尾块（DIRECT: 对齐块，footer 位于其尾部）
+    uint32_t tail_size;                     // 末尾块大小（PWRITE: footer 大小；DIRECT: 对齐粒度）
+    uint8_t footer_copy[LZ_LOG_FOOTER_SIZE];
+
+    // 以下字段仅 URING 后端使用（io_mutex 保护）
+    int uring_index;                        // 缓冲池 / 注册文件表索引（-1 表示未使用缓冲池）
+    bool uring_fixed_file;                  // 是否以注册文件表索引提交请求
+    uint32_t uring_submit_chunk;            // 下一个待提交的块序号
+    uint32_t uring_inflight;                // 在途请求数
+    uint8_t uring_slot_state[LZ_SINK_SLOT_COUNT]; // 槽位写入状态：空闲 / 在途 / 已完成
+    bool uring_footer_inflight;             // footer 写入是否在途
+    uint8_t uring_footer_stage[LZ_LOG_FOOTER_SIZE]; // 在途 footer 的快照
+    uint32_t uring_partial_inflight;        // 在途的部分落盘写入数（完成前不提交整块写入）
+    uint32_t uring_partial_len[LZ_SINK_SLOT_COUNT]; // 各槽位部分落盘写入的长度
+    uint32_t uring_partial_end;             // 部分落盘写到的数据末尾（全部完成后计入 durable_end）
+    bool uring_partial_failed;              // 部分落盘写入失败或短写（不推进 durable_end）
+
+    struct lz_segment_t *next;              // sink 内的段链表
+} lz_segment_t;
+
+/**
+ * 创建 sink（缓冲后端会启动后台落盘线程）
+ * @param type 后端类型
+ * @param out_sink 输出 sink
+ * @return 错误码
+ */
+lz_log_error_t lz_sink_create(lz_log_sink_type_t type, lz_sink_t **out_sink);
+
+/**
+ * 销毁 sink（停止后台线程并释放所有仍注册的段）
+ * @param sink sink
+ */
+void lz_sink_destroy(lz_sink_t *sink);
+
+/**
+ * 获取 sink 类型
+ */
+lz_log_sink_type_t lz_sink_type(const lz_sink_t *sink);
+
+/**
+ * 计算指定后端下文件的可写数据区大小
+ * @param type 后端类型
+ * @param file_size 文件大小
+ * @return 可写数据区大小（文件不满足后端要求时返回 0）
+ */
+uint32_t lz_sink_capacity(lz_log_sink_type_t type, uint32_t file_size);
+
+/**
+ * 按后端要求调整文件大小（DIRECT 需要对齐）
+ */
+uint32_t lz_sink_adjust_file_size(lz_log_sink_type_t type, uint32_t file_size);
+
+/**
+ * 在已创建（已预分配 + 写好 footer）的文件上打开日志段
+ * @param sink sink
+ * @param file_path 文件路径（DIRECT 模式需要以 O_DIRECT 重新打开）
+ * @param fd 文件描述符（调用成功后所有权转移给 sink）
+ * @param file_size 文件大小
+ * @param used_size 文件中已有的数据量
+ * @param out_seg 输出日志段
+ * @return 错误码
+ */
+lz_log_error_t lz_sink_open_segment(lz_sink_t *sink,
+                                    const char *file_path,
+                                    int fd,
+                                    uint32_t file_size,
+                                    uint32_t used_size,
+                                    lz_segment_t **out_seg);
+
+/**
+ * 释放日志段（缓冲后端会先把剩余数据和 footer 写入文件）
+ * @param seg 日志段
+ * @param keep_mapping 是否保留 mmap 映射（close 时保留，避免仍在写入的线程访问已解除的映射）
+ */
+void lz_sink_release_segment(lz_segment_t *seg, bool keep_mapping);
+
+/**
+ * 同步日志段
+ * @param seg 日志段
+ * @param durable 是否保证落到存储设备（msync MS_SYNC / fdatasync）
+ * @return 错误码
+ */
+lz_log_error_t lz_sink_sync(lz_segment_t *seg, bool durable);
+
+/**
+ * 从日志段读取已写入的数据（用于导出）
+ * @param seg 日志段
+ * @param offset 起始偏移
+ * @param buf 输出缓冲区
+ * @param len 读取长度
+ * @return 错误码
+ */
+lz_log_error_t lz_sink_read(lz_segment_t *seg, uint32_t offset, void *buf, uint32_t len);
+
+/** 缓冲后端的 acquire 慢路径（可能等待槽位回收） */
+uint8_t *lz_sink_buffered_acquire(lz_segment_t *seg, uint32_t offset, uint32_t len, uint32_t *out_len);
+
+/** 缓冲后端的 commit 慢路径 */
+void lz_sink_buffered_commit(lz_segment_t *seg, uint32_t offset, uint32_t len);
+
+/**
+ * 获取预留区间 [offset, offset+len) 的可写地址
+ * @param seg 日志段
+ * @param offset 预留起始偏移
+ * @param len 剩余长度
+ * @param out_len 本次可连续写入的长度（缓冲后端在块边界处截断）
+ * @return 可写地址
+ */
+static inline uint8_t *lz_sink_acquire(lz_segment_t *seg, uint32_t offset, uint32_t len, uint32_t *out_len)
+{
+    if (seg->map_base != NULL)
+    {
+        *out_len = len;
+        return seg->map_base + offset;
+    }
+    return lz_sink_buffered_acquire(seg, offset, len, out_len);
+}
+
+/**
+ * 提交已拷贝完成的区间（缓冲后端据此判断块是否写满）
+ */
+static inline void lz_sink_commit(lz_segment_t *seg, uint32_t offset, uint32_t len)
+{
+    if (seg->map_base == NULL)
+    {
+        lz_sink_buffered_commit(seg, offset, len);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_SINK_H
@@ -0,0 +1,558 @@
+#include "lz_uring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define LZ_URING_AVAILABLE 1
+#endif
+#endif
+#endif
+
+#ifdef LZ_URING_AVAILABLE
+
+// ============================================================================
+// Internal Structures
+// ============================================================================
+
+/** 共享内存中的 SQ / CQ 视图 */
+struct lz_uring_t
+{
+    int ring_fd;
+    int cq_event_fd; // 完成事件通知（注册到 ring）
+    int kick_fd;     // 外部唤醒（写入线程写满一块时通知）
+
+    // SQ
+    _Atomic(unsigned) *sq_head;
+    _Atomic(unsigned) *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entries;
+    unsigned sq_local_tail; // 已准备但未发布的尾指针
+    unsigned sq_to_submit;  // 已发布但未提交给内核的数量
+
+    // CQ
+    _Atomic(unsigned) *cq_head;
+    _Atomic(unsigned) *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // 映射区域
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+// ============================================================================
+// Utility Functions
+// ============================================================================
+
+static inline int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static inline int uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * 取一个空闲 SQE（SQ 满时返回 NULL）
+ */
+static struct io_uring_sqe *uring_get_sqe(lz_uring_t *ring)
+{
+    unsigned head = atomic_load_explicit(ring->sq_head, memory_order_acquire);
+    if (ring->sq_local_tail - head >= ring->sq_entries)
+    {
+        return NULL;
+    }
+
+    unsigned index = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+// ============================================================================
+// Public Functions
+// ============================================================================
+
+bool lz_uring_supported(void)
+{
+    return true;
+}
+
+lz_log_error_t lz_uring_create(uint32_t entries, lz_uring_t **out_ring)
+{
+    lz_log_error_t ret = LZ_LOG_SUCCESS;
+    lz_uring_t *ring = NULL;
+
+    do
+    {
+        if (out_ring == NULL || entries == 0)
+        {
+            ret = LZ_LOG_ERROR_INVALID_PARAM;
+            break;
+        }
+
+        ring = (lz_uring_t *)calloc(1, sizeof(lz_uring_t));
+        if (ring == NULL)
+        {
+            ret = LZ_LOG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        ring->ring_fd = -1;
+        ring->cq_event_fd = -1;
+        ring->kick_fd = -1;
+
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 2;
+
+        ring->ring_fd = uring_setup(entries, &params);
+        if (ring->ring_fd < 0)
+        {
+            // ENOSYS（内核不支持）/ EPERM（seccomp 或 io_uring_disabled）
+            ret = LZ_LOG_ERROR_SYSTEM;
+            break;
+        }
+
+        ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap && ring->cq_ring_size > ring->sq_ring_size)
+        {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+
+        ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+        if (ring->sq_ring == MAP_FAILED)
+        {
+            ring->sq_ring = NULL;
+            ret = LZ_LOG_ERROR_MMAP_FAILED;
+            break;
+        }
+
+        if (single_mmap)
+        {
+            ring->cq_ring = ring->sq_ring;
+        }
+        else
+        {
+            ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+            if (ring->cq_ring == MAP_FAILED)
+            {
+                ring->cq_ring = NULL;
+                ret = LZ_LOG_ERROR_MMAP_FAILED;
+                break;
+            }
+        }
+
+        ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+        if (ring->sqes == MAP_FAILED)
+        {
+            ring->sqes = NULL;
+            ret = LZ_LOG_ERROR_MMAP_FAILED;
+            break;
+        }
+
+        uint8_t *sq = (uint8_t *)ring->sq_ring;
+        ring->sq_head = (_Atomic(unsigned) *)(sq + params.sq_off.head);
+        ring->sq_tail = (_Atomic(unsigned) *)(sq + params.sq_off.tail);
+        ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+        ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+        ring->sq_entries = params.sq_entries;
+        ring->sq_local_tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+
+        uint8_t *cq = (uint8_t *)ring->cq_ring;
+        ring->cq_head = (_Atomic(unsigned) *)(cq + params.cq_off.head);
+        ring->cq_tail = (_Atomic(unsigned) *)(cq + params.cq_off.tail);
+        ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+        ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+        // 后台线程空闲时同时等待「完成事件」和「外部唤醒」两个 eventfd
+        ring->cq_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        ring->kick_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (ring->cq_event_fd < 0 || ring->kick_fd < 0 ||
+            uring_register(ring->ring_fd, IORING_REGISTER_EVENTFD, &ring->cq_event_fd, 1) != 0)
+        {
+            ret = LZ_LOG_ERROR_SYSTEM;
+            break;
+        }
+
+        *out_ring = ring;
+
+    } while (0);
+
+    if (ret != LZ_LOG_SUCCESS && ring != NULL)
+    {
+        lz_uring_destroy(ring);
+    }
+
+    return ret;
+}
+
+void lz_uring_destroy(lz_uring_t *ring)
+{
+    if (ring == NULL)
+    {
+        return;
+    }
+
+    if (ring->sqes != NULL)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL)
+    {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->ring_fd >= 0)
+    {
+        close(ring->ring_fd);
+    }
+    if (ring->cq_event_fd >= 0)
+    {
+        close(ring->cq_event_fd);
+    }
+    if (ring->kick_fd >= 0)
+    {
+        close(ring->kick_fd);
+    }
+    free(ring);
+}
+
+bool lz_uring_register_buffers(lz_uring_t *ring, uint8_t *const *bufs, uint32_t len, uint32_t count)
+{
+    struct iovec iov[16];
+    if (count == 0 || count > sizeof(iov) / sizeof(iov[0]))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = len;
+    }
+
+    // 旧内核把注册缓冲区计入 RLIMIT_MEMLOCK，超限时返回 ENOMEM
+    return uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS, iov, count) == 0;
+}
+
+bool lz_uring_register_files(lz_uring_t *ring, uint32_t count)
+{
+    int fds[16];
+    if (count == 0 || count > sizeof(fds) / sizeof(fds[0]))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        fds[i] = -1; // 稀疏文件表
+    }
+
+    return uring_register(ring->ring_fd, IORING_REGISTER_FILES, fds, count) == 0;
+}
+
+bool lz_uring_update_file(lz_uring_t *ring, uint32_t index, int fd)
+{
+    struct io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.fds = (uint64_t)(uintptr_t)&fd;
+
+    return uring_register(ring->ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+}
+
+uint32_t lz_uring_sq_space(lz_uring_t *ring)
+{
+    unsigned head = atomic_load_explicit(ring->sq_head, memory_order_acquire);
+    return ring->sq_entries - (ring->sq_local_tail - head);
+}
+
+bool lz_uring_prep_write(lz_uring_t *ring, int fd, bool fixed_file,
+                         const void *buf, uint32_t len, uint64_t offset,
+                         int buf_index, bool link, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    if (sqe == NULL)
+    {
+        return false;
+    }
+
+    sqe->opcode = (buf_index >= 0) ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->buf_index = (buf_index >= 0) ? (uint16_t)buf_index : 0;
+    sqe->flags = (fixed_file ? IOSQE_FIXED_FILE : 0) | (link ? IOSQE_IO_LINK : 0);
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool lz_uring_prep_fdatasync(lz_uring_t *ring, int fd, bool fixed_file, bool link, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    if (sqe == NULL)
+    {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->flags = (fixed_file ? IOSQE_FIXED_FILE : 0) | (link ? IOSQE_IO_LINK : 0);
+    sqe->user_data = user_data;
+    return true;
+}
+
+lz_log_error_t lz_uring_submit(lz_uring_t *ring)
+{
+    // 发布已准备的 SQE（release 保证内核看到完整的 SQE 内容）
+    unsigned tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    ring->sq_to_submit += ring->sq_local_tail - tail;
+    atomic_store_explicit(ring->sq_tail, ring->sq_local_tail, memory_order_release);
+
+    while (ring->sq_to_submit > 0)
+    {
+        int submitted = uring_enter(ring->ring_fd, ring->sq_to_submit, 0, 0);
+        if (submitted < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EBUSY)
+            {
+                // 内核暂时不能接受：留在 SQ 中，由调用者收割完成事件后重试
+                break;
+            }
+            return LZ_LOG_ERROR_FILE_WRITE;
+        }
+        ring->sq_to_submit -= (unsigned)submitted;
+    }
+
+    return LZ_LOG_SUCCESS;
+}
+
+uint32_t lz_uring_pending(lz_uring_t *ring)
+{
+    return ring->sq_to_submit;
+}
+
+void lz_uring_wait(lz_uring_t *ring)
+{
+    unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+    if (atomic_load_explicit(ring->cq_tail, memory_order_acquire) != head)
+    {
+        return;
+    }
+
+    while (uring_enter(ring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno == EINTR)
+    {
+    }
+}
+
+void lz_uring_notify(lz_uring_t *ring)
+{
+    uint64_t one = 1;
+    while (write(ring->kick_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+    {
+    }
+}
+
+bool lz_uring_idle_wait(lz_uring_t *ring, int timeout_ms)
+{
+    struct pollfd fds[2];
+    fds[0].fd = ring->cq_event_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = ring->kick_fd;
+    fds[1].events = POLLIN;
+
+    int rc = poll(fds, 2, timeout_ms);
+    if (rc <= 0)
+    {
+        return false;
+    }
+
+    // 清空计数（非阻塞）
+    uint64_t value = 0;
+    if (fds[0].revents & POLLIN)
+    {
+        (void)!read(ring->cq_event_fd, &value, sizeof(value));
+    }
+    if (fds[1].revents & POLLIN)
+    {
+        (void)!read(ring->kick_fd, &value, sizeof(value));
+    }
+    return true;
+}
+
+bool lz_uring_peek(lz_uring_t *ring, uint64_t *out_user_data, int32_t *out_res)
+{
+    unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+    if (atomic_load_explicit(ring->cq_tail, memory_order_acquire) == head)
+    {
+        return false;
+    }
+
+    struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+    *out_user_data = cqe->user_data;
+    *out_res = cqe->res;
+    atomic_store_explicit(ring->cq_head, head + 1, memory_order_release);
+    return true;
+}
+
+#else // !LZ_URING_AVAILABLE
+
+// 非 Linux 平台：始终不可用，sink 退回同步 pwrite
+
+struct lz_uring_t
+{
+    int unused;
+};
+
+bool lz_uring_supported(void)
+{
+    return false;
+}
+
+lz_log_error_t lz_uring_create(uint32_t entries, lz_uring_t **out_ring)
+{
+    (void)entries;
+    (void)out_ring;
+    return LZ_LOG_ERROR_SYSTEM;
+}
+
+void lz_uring_destroy(lz_uring_t *ring)
+{
+    (void)ring;
+}
+
+bool lz_uring_register_buffers(lz_uring_t *ring, uint8_t *const *bufs, uint32_t len, uint32_t count)
+{
+    (void)ring;
+    (void)bufs;
+    (void)len;
+    (void)count;
+    return false;
+}
+
+bool lz_uring_register_files(lz_uring_t *ring, uint32_t count)
+{
+    (void)ring;
+    (void)count;
+    return false;
+}
+
+bool lz_uring_update_file(lz_uring_t *ring, uint32_t index, int fd)
+{
+    (void)ring;
+    (void)index;
+    (void)fd;
+    return false;
+}
+
+uint32_t lz_uring_sq_space(lz_uring_t *ring)
+{
+    (void)ring;
+    return 0;
+}
+
+bool lz_uring_prep_write(lz_uring_t *ring, int fd, bool fixed_file,
+                         const void *buf, uint32_t len, uint64_t offset,
+                         int buf_index, bool link, uint64_t user_data)
+{
+    (void)ring;
+    (void)fd;
+    (void)fixed_file;
+    (void)buf;
+    (void)len;
+    (void)offset;
+    (void)buf_index;
+    (void)link;
+    (void)user_data;
+    return false;
+}
+
+bool lz_uring_prep_fdatasync(lz_uring_t *ring, int fd, bool fixed_file, bool link, uint64_t user_data)
+{
+    (void)ring;
+    (void)fd;
+    (void)fixed_file;
+    (void)link;
+    (void)user_data;
+    return false;
+}
+
+lz_log_error_t lz_uring_submit(lz_uring_t *ring)
+{
+    (void)ring;
+    return LZ_LOG_ERROR_SYSTEM;
+}
+
+uint32_t lz_uring_pending(lz_uring_t *ring)
+{
+    (void)ring;
+    return 0;
+}
+
+void lz_uring_wait(lz_uring_t *ring)
+{
+    (void)ring;
+}
+
+void lz_uring_notify(lz_uring_t *ring)
+{
+    (void)ring;
+}
+
+bool lz_uring_idle_wait(lz_uring_t *ring, int timeout_ms)
+{
+    (void)ring;
+    (void)timeout_ms;
+    return false;
+}
+
+bool lz_uring_peek(lz_uring_t *ring, uint64_t *out_user_data, int32_t *out_res)
+{
+    (void)ring;
+    (void)out_user_data;
+    (void)out_res;
+    return false;
+}
+
+#endif // LZ_URING_AVAILABLE
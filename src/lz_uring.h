@@ -0,0 +1,130 @@
+#ifndef LZ_URING_H
+#define LZ_URING_H
+
+#include "lz_logger.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// io_uring 最小封装（仅 Linux）
+// ============================================================================
+/*
+ * 只实现 LZ_LOG_SINK_URING 需要的部分：写入（可用注册缓冲区/注册文件）、
+ * fdatasync、提交和收割完成事件。直接使用系统调用，不依赖 liburing。
+ *
+ * 线程约定：
+ * - 准备 SQE、提交、收割 CQE 必须由调用者串行化（sink 中由 io_mutex 保护）
+ * - lz_uring_wait / lz_uring_idle_wait / lz_uring_notify 不访问 SQ/CQ，可以在不持锁的情况下调用
+ *
+ * 非 Linux 平台或内核不支持（ENOSYS / seccomp 拦截 / io_uring_disabled）时
+ * lz_uring_create 返回错误，调用者退回到同步 pwrite。
+ */
+
+typedef struct lz_uring_t lz_uring_t;
+
+/** 当前平台是否编译了 io_uring 支持 */
+bool lz_uring_supported(void);
+
+/**
+ * 创建 io_uring 实例
+ * @param entries SQ 深度（CQ 深度为其两倍）
+ * @param out_ring 输出实例
+ * @return 错误码（不可用时返回 LZ_LOG_ERROR_SYSTEM）
+ */
+lz_log_error_t lz_uring_create(uint32_t entries, lz_uring_t **out_ring);
+
+/**
+ * 销毁 io_uring 实例（调用者需保证没有在途请求）
+ */
+void lz_uring_destroy(lz_uring_t *ring);
+
+/**
+ * 注册固定缓冲区（失败时调用者改用普通写入）
+ * @param bufs 缓冲区地址数组
+ * @param len 每个缓冲区大小
+ * @param count 缓冲区数量
+ * @return 是否成功
+ */
+bool lz_uring_register_buffers(lz_uring_t *ring, uint8_t *const *bufs, uint32_t len, uint32_t count);
+
+/**
+ * 注册稀疏文件表（所有槽位初始为空，之后用 lz_uring_update_file 填入）
+ * @return 是否成功
+ */
+bool lz_uring_register_files(lz_uring_t *ring, uint32_t count);
+
+/**
+ * 更新文件表中的一个槽位（fd 为 -1 表示清空）
+ * @return 是否成功
+ */
+bool lz_uring_update_file(lz_uring_t *ring, uint32_t index, int fd);
+
+/**
+ * SQ 剩余可准备的请求数
+ */
+uint32_t lz_uring_sq_space(lz_uring_t *ring);
+
+/**
+ * 准备写入请求
+ * @param fd 文件描述符，fixed_file 为 true 时为文件表索引
+ * @param buf_index 注册缓冲区索引（-1 表示普通写入）
+ * @param link 是否与下一个请求链接（下一个请求在本请求成功后才执行）
+ * @param user_data 完成事件中返回的用户数据
+ * @return SQ 已满时返回 false
+ */
+bool lz_uring_prep_write(lz_uring_t *ring, int fd, bool fixed_file,
+                         const void *buf, uint32_t len, uint64_t offset,
+                         int buf_index, bool link, uint64_t user_data);
+
+/**
+ * 准备 fdatasync 请求
+ * @return SQ 已满时返回 false
+ */
+bool lz_uring_prep_fdatasync(lz_uring_t *ring, int fd, bool fixed_file, bool link, uint64_t user_data);
+
+/**
+ * 提交所有已准备的请求（不等待完成）
+ * @return 错误码
+ * @note 内核暂时不能接受（EAGAIN 资源不足 / EBUSY 完成队列已满）时不重试，剩余请求留在 SQ 中，
+ *       由 lz_uring_pending 报告；调用者收割完成事件或在锁外退避后再次调用
+ */
+lz_log_error_t lz_uring_submit(lz_uring_t *ring);
+
+/**
+ * 已准备但还没有被内核接受的请求数
+ */
+uint32_t lz_uring_pending(lz_uring_t *ring);
+
+/**
+ * 阻塞等待至少一个完成事件
+ */
+void lz_uring_wait(lz_uring_t *ring);
+
+/**
+ * 唤醒在 lz_uring_idle_wait 中等待的线程（可在任意线程调用）
+ */
+void lz_uring_notify(lz_uring_t *ring);
+
+/**
+ * 空闲等待：直到有完成事件、被 lz_uring_notify 唤醒或超时
+ * @param timeout_ms 超时（毫秒）
+ * @return 超时返回 false
+ */
+bool lz_uring_idle_wait(lz_uring_t *ring, int timeout_ms);
+
+/**
+ * 取出一个完成事件（无事件时返回 false，不进入内核）
+ * @param out_user_data 请求的 user_data
+ * @param out_res 结果（写入字节数或负的 errno）
+ */
+bool lz_uring_peek(lz_uring_t *ring, uint64_t *out_user_data, int32_t *out_res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_URING_H
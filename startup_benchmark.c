@@ -0,0 +1,163 @@
+/**
+ * 启动延迟测试（time-to-first-log）
+ *
+ * 统计从 lz_logger_open 开始到第一条日志写入完成的耗时：
+ *   - open：lz_logger_open 返回
+ *   - 首条写入：第一次 lz_logger_write 返回（应用感知到的启动开销）
+ *   - 首条落盘：随后 lz_logger_flush 返回（第一条日志已加密并持久化）
+ * 场景：明文、加密冷启动（进程内第一次派生主密钥）、加密热启动（主密钥已缓存），
+ * 每次都在空目录中新建日志文件。冷启动通过 lz_logger_clear_key_cache 模拟；主密钥只在有句柄使用该密码时
+ * 缓存，热启动期间另开一个同密码的内存句柄保持缓存。
+ *
+ * 编译（Linux）：
+ *   gcc -O2 -Wall -o startup_benchmark startup_benchmark.c \
+ *       src/lz_logger.c src/lz_crypto.c src/lz_sink.c src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -lcrypto
+ * 编译（macOS）：
+ *   gcc -O2 -Wall -o startup_benchmark startup_benchmark.c \
+ *       src/lz_logger.c src/lz_crypto.c src/lz_sink.c src/lz_uring.c src/lz_manifest.c src/lz_housekeeper.c src/lz_compress.c src/lz_packer.c src/lz_keystream.c src/lz_format.c src/lz_binlog.c src/lz_numfmt.c -I. -pthread -framework Security
+ */
+#include "src/lz_logger.h"
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define TEST_LOG_DIR "/tmp/lz_logger_startup_bench"
+#define ITERATIONS 20
+
+static const char *first_message =
+    "2025-11-02 15:30:45.123 T:1a2b3c [MainActivity.kt:45] [onCreate] [App] Application started successfully\n";
+
+typedef struct {
+    const char *name;
+    const char *key;
+    int cold;
+} startup_case_t;
+
+static const startup_case_t cases[] = {
+    {"明文", NULL, 0},
+    {"加密（冷启动）", "test_encryption_key_12345678", 1},
+    {"加密（热启动）", "test_encryption_key_12345678", 0},
+};
+static const int num_cases = 3;
+
+// 获取当前时间（微秒）
+static uint64_t get_timestamp_us() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// 创建测试目录
+static int create_test_dir() {
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s", TEST_LOG_DIR, TEST_LOG_DIR);
+    return system(cmd);
+}
+
+/**
+ * 运行一个场景
+ * @param c 场景
+ * @return 成功返回 0
+ */
+static int run_case(const startup_case_t *c) {
+    uint64_t open_total = 0, write_total = 0, flush_total = 0;
+    uint64_t write_max = 0;
+
+    // 热启动：同密码的内存句柄保持缓存引用，再先派生一次，使主密钥进入缓存
+    lz_logger_handle_t pin = NULL;
+    if (c->key != NULL && !c->cold) {
+        lz_logger_handle_t handle = NULL;
+        int32_t inner_error = 0, sys_errno = 0;
+        if (lz_logger_open_memory(LZ_LOG_MIN_FILE_SIZE, c->key, &pin) != LZ_LOG_SUCCESS) {
+            return -1;
+        }
+        if (create_test_dir() != 0 ||
+            lz_logger_open(TEST_LOG_DIR, c->key, &handle, &inner_error, &sys_errno) != LZ_LOG_SUCCESS) {
+            lz_logger_close(pin);
+            return -1;
+        }
+        lz_logger_close(handle);
+    }
+
+    int failed = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (create_test_dir() != 0) {
+            failed = 1;
+            break;
+        }
+        if (c->cold) {
+            lz_logger_clear_key_cache();
+        }
+
+        lz_logger_handle_t handle = NULL;
+        int32_t inner_error = 0, sys_errno = 0;
+
+        uint64_t start = get_timestamp_us();
+        lz_log_error_t ret = lz_logger_open(TEST_LOG_DIR, c->key, &handle, &inner_error, &sys_errno);
+        uint64_t open_end = get_timestamp_us();
+        if (ret != LZ_LOG_SUCCESS) {
+            printf("| %s | 打开失败: %s (inner=%d, errno=%d) | | | |\n",
+                   c->name, lz_logger_error_string(ret), inner_error, sys_errno);
+            failed = 1;
+            break;
+        }
+
+        lz_logger_write(handle, first_message, (uint32_t)strlen(first_message));
+        uint64_t write_end = get_timestamp_us();
+
+        lz_logger_flush(handle);
+        uint64_t flush_end = get_timestamp_us();
+
+        lz_logger_close(handle);
+
+        open_total += open_end - start;
+        write_total += write_end - start;
+        flush_total += flush_end - start;
+        if (write_end - start > write_max) {
+            write_max = write_end - start;
+        }
+    }
+
+    if (pin != NULL) {
+        lz_logger_close(pin);
+    }
+    if (failed) {
+        return -1;
+    }
+
+    printf("| %s | %.0f | %.0f | %llu | %.0f |\n",
+           c->name,
+           (double)open_total / ITERATIONS,
+           (double)write_total / ITERATIONS,
+           (unsigned long long)write_max,
+           (double)flush_total / ITERATIONS);
+    return 0;
+}
+
+int main() {
+    printf("\n");
+    printf("# LZ Logger 启动延迟测试\n\n");
+    printf("**每个场景:** %d 次（每次新建日志文件）  \n", ITERATIONS);
+    printf("**耗时:** 均从 lz_logger_open 开始计时，单位微秒\n\n");
+
+    printf("| 场景 | open (μs) | 首条写入 (μs) | 首条写入最大 (μs) | 首条落盘 (μs) |\n");
+    printf("|------|------|------|------|------|\n");
+
+    int failed = 0;
+    for (int i = 0; i < num_cases; i++) {
+        if (run_case(&cases[i]) != 0) {
+            failed = 1;
+        }
+    }
+
+    create_test_dir();
+
+    printf("\n---\n\n");
+    if (failed) {
+        printf("❌ **部分场景失败**\n\n");
+        return 1;
+    }
+    printf("✅ **所有测试完成！**\n\n");
+    return 0;
+}
@@ -63,7 +63,7 @@ int main() {
 }
 EOF
 
-gcc test_encrypted.c lz_logger.c lz_crypto.c -o test_write \
+gcc test_encrypted.c lz_logger.c lz_crypto.c lz_sink.c lz_uring.c lz_manifest.c lz_housekeeper.c lz_compress.c lz_packer.c lz_keystream.c lz_format.c lz_binlog.c lz_numfmt.c -o test_write \
     -I. -DDEBUG_ENABLED=1 -std=c11 -framework Security -lpthread
 
 ./test_write
@@ -1,19 +1,23 @@
 #!/usr/bin/env python3
 """
 LZ Logger 日志解密工具
-支持 AES-CTR 加密的日志文件解密
+支持 AES-CTR 加密的日志文件解密, 以及后台压缩后的日志文件 (块压缩格式, 魔数 EndZ);
+二进制日志记录 (LZ_LOG_BINARY) 默认还原为文本行
 """
 
 import sys
 import os
 import struct
 import hashlib
+import hmac
 import argparse
+import re
+import time
 from getpass import getpass
 from pathlib import Path
 
 try:
-    from Crypto.Cipher import AES
+    from Crypto.Cipher import AES, ChaCha20
     from Crypto.Protocol.KDF import PBKDF2
     from Crypto.Hash import SHA256
 except ImportError:
@@ -26,19 +30,45 @@ CRYPTO_KEY_SIZE = 32
 CRYPTO_BLOCK_SIZE = 16
 CRYPTO_SALT_SIZE = 16
 PBKDF2_ITERATIONS = 10000
+CRYPTO_SALT_TAG = b'LZK2'  # v2 盐: 每段独立密钥 (AES-256-CTR)
+CRYPTO_SALT_TAG_CHACHA20 = b'LZC2'  # v2 盐: 每段独立密钥 (ChaCha20)
+CRYPTO_SALT_TAG_SIZE = 4
+CRYPTO_HKDF_INFO = b'lz_logger segment key'
 MAGIC_ENDX = 0x456E6478
+MAGIC_ENDC = 0x456E6443  # 单文件循环日志
 FOOTER_SIZE = 28  # 盐16字节 + 魔数4字节 + 文件大小4字节 + 已用大小4字节
+CIRCULAR_EXT_SIZE = 20  # 写入游标8字节 + 最旧记录偏移8字节 + 索引块大小4字节
+MAGIC_ENDZ = 0x456E645A  # 压缩段
+MAGIC_ENDB = 0x456E6442  # 写入时压缩的块流 (尚未补写块索引)
+COMPRESS_EXT_SIZE = 16  # 块大小4字节 + 块数4字节 + 块索引偏移4字节 + 标记4字节
+COMPRESS_BLOCK_HEADER_SIZE = 24  # 负载大小4字节 + 原文大小4字节 + 首/末记录时间各8字节
+COMPRESS_BLOCK_STORED = 0x80000000  # 负载为原文
+COMPRESS_FLAG_ENCRYPTED = 0x1
+COMPRESS_MAX_BLOCK = 64 * 1024
 
 
 def derive_key(password: str, salt: bytes) -> bytes:
-    """从密码派生密钥 (PBKDF2-HMAC-SHA256)"""
-    return PBKDF2(
+    """
+    从密码派生密钥
+    v2 盐 ("LZK2" + 主盐8字节 + 段编号4字节): 主密钥 = PBKDF2(密码, 段编号置 0 的盐),
+        段密钥 = HKDF-SHA256(主密钥, salt=完整盐, info="lz_logger segment key")
+    旧版盐: 密钥 = PBKDF2-HMAC-SHA256(密码, 盐)
+    """
+    if salt[:CRYPTO_SALT_TAG_SIZE] in (CRYPTO_SALT_TAG, CRYPTO_SALT_TAG_CHACHA20):
+        kdf_salt = salt[:CRYPTO_SALT_SIZE - 4] + b'\x00' * 4
+    else:
+        kdf_salt = salt
+    master = PBKDF2(
         password.encode('utf-8'),
-        salt,
+        kdf_salt,
         dkLen=CRYPTO_KEY_SIZE,
         count=PBKDF2_ITERATIONS,
         hmac_hash_module=SHA256
     )
+    if kdf_salt is salt:
+        return master
+    prk = hmac.new(salt, master, hashlib.sha256).digest()
+    return hmac.new(prk, CRYPTO_HKDF_INFO + b'\x01', hashlib.sha256).digest()
 
 
 def decrypt_aes_ctr(key: bytes, data: bytes, offset: int = 0) -> bytes:
@@ -72,13 +102,187 @@ def decrypt_aes_ctr(key: bytes, data: bytes, offset: int = 0) -> bytes:
     return cipher.encrypt(data)
 
 
+def decrypt_chacha20(key: bytes, data: bytes, offset: int = 0) -> bytes:
+    """
+    ChaCha20 解密 (原始 ChaCha20: 64 位块号 = 偏移 // 64, nonce 为 8 字节 0)
+    """
+    cipher = ChaCha20.new(key=key, nonce=b'\x00' * 8)
+    cipher.seek(offset)
+    return cipher.encrypt(data)
+
+
+def decrypt_stream(key: bytes, salt: bytes, data: bytes, offset: int = 0) -> bytes:
+    """按段盐的标记选择流密码解密"""
+    if salt[:CRYPTO_SALT_TAG_SIZE] == CRYPTO_SALT_TAG_CHACHA20:
+        return decrypt_chacha20(key, data, offset)
+    return decrypt_aes_ctr(key, data, offset)
+
+
+def read_circular_data(f, file_size: int, capacity: int):
+    """
+    读取循环日志的数据 (按时间顺序)
+    文件格式: [数据区 capacity 字节][块索引][写入游标8字节][最旧记录8字节][索引块大小4字节][footer]
+    数据按 逻辑偏移 % capacity 存放, 加密计数器使用逻辑偏移
+
+    Returns:
+        (data, 起始逻辑偏移)
+    """
+    f.seek(file_size - FOOTER_SIZE - CIRCULAR_EXT_SIZE)
+    cursor, oldest, block_size = struct.unpack('<QQI', f.read(CIRCULAR_EXT_SIZE))
+
+    begin = 0
+    if cursor > capacity:
+        floor = cursor - capacity
+        begin = oldest
+        if not (floor <= oldest <= cursor):
+            # 扩展区中的最旧记录落后于游标: 从块索引查找
+            nblocks = capacity // block_size
+            f.seek(capacity)
+            index = struct.unpack(f'<{nblocks}Q', f.read(nblocks * 8))
+            begin = cursor
+            for b in range(floor // block_size, cursor // block_size + 1):
+                first = index[b % nblocks]
+                if first // block_size == b and floor <= first <= cursor:
+                    begin = first
+                    break
+
+    # 从最旧记录读到写入游标, 在数据区末尾处回绕
+    data = bytearray()
+    pos = begin
+    while pos < cursor:
+        physical = pos % capacity
+        length = min(cursor - pos, capacity - physical)
+        f.seek(physical)
+        data += f.read(length)
+        pos += length
+
+    return bytes(data), begin
+
+
+def lz4_block_decompress(src: bytes, raw_size: int) -> bytes:
+    """解压一个 LZ4 block (无帧头)"""
+    out = bytearray()
+    pos = 0
+    end = len(src)
+    while pos < end:
+        token = src[pos]
+        pos += 1
+
+        # 字面量
+        lit_len = token >> 4
+        if lit_len == 15:
+            while True:
+                b = src[pos]
+                pos += 1
+                lit_len += b
+                if b != 255:
+                    break
+        out += src[pos:pos + lit_len]
+        pos += lit_len
+        if pos >= end:
+            break
+
+        # 匹配 (偏移2字节小端, 可能与输出重叠)
+        offset = src[pos] | (src[pos + 1] << 8)
+        pos += 2
+        match_len = token & 0x0F
+        if match_len == 15:
+            while True:
+                b = src[pos]
+                pos += 1
+                match_len += b
+                if b != 255:
+                    break
+        match_len += 4
+        if offset == 0 or offset > len(out):
+            raise ValueError("压缩数据损坏: 匹配偏移越界")
+        start = len(out) - offset
+        if offset >= match_len:
+            out += out[start:start + match_len]
+        else:
+            for i in range(match_len):
+                out.append(out[start + i])
+
+    if len(out) != raw_size:
+        raise ValueError(f"压缩数据损坏: 解压后 {len(out)} 字节, 期望 {raw_size} 字节")
+    return bytes(out)
+
+
+def scan_block_stream(f, used_size: int):
+    """
+    沿块头部遍历块流 (EndB), 返回每块的偏移
+    遇到无效的块头部 (崩溃时未写完的块) 即停止
+    """
+    index = []
+    pos = 0
+    while pos + COMPRESS_BLOCK_HEADER_SIZE <= used_size:
+        f.seek(pos)
+        stored_size, raw_size, _, _ = struct.unpack('<IIQQ', f.read(COMPRESS_BLOCK_HEADER_SIZE))
+        payload_size = stored_size & ~COMPRESS_BLOCK_STORED
+        if (raw_size == 0 or raw_size > COMPRESS_MAX_BLOCK or
+                payload_size == 0 or payload_size > COMPRESS_MAX_BLOCK or
+                (stored_size & COMPRESS_BLOCK_STORED and payload_size != raw_size) or
+                pos + COMPRESS_BLOCK_HEADER_SIZE + payload_size > used_size):
+            break
+        index.append(pos)
+        pos += COMPRESS_BLOCK_HEADER_SIZE + payload_size
+    return index
+
+
+def read_compressed_file(f, password: str) -> bytes:
+    """
+    读取压缩段 (EndZ) 或块流 (EndB) 并逐块解密、解压
+    文件格式: [块...][块索引 N×4字节][块大小4字节][块数4字节][块索引偏移4字节][标记4字节][footer]
+    块流没有块索引和扩展区, 沿块头部遍历到已用大小; 盐非全 0 即为加密
+    每块: [负载大小4字节 (最高位=原样存储)][原文大小4字节][首/末记录时间各8字节][负载]
+    加密时只加密负载, 计数器使用负载在文件中的偏移
+    """
+    f.seek(0, os.SEEK_END)
+    file_size = f.tell()
+    f.seek(file_size - FOOTER_SIZE)
+    footer = f.read(FOOTER_SIZE)
+    salt = footer[:CRYPTO_SALT_SIZE]
+    magic, _, used_size = struct.unpack('<III', footer[CRYPTO_SALT_SIZE:])
+
+    if magic == MAGIC_ENDB:
+        index = scan_block_stream(f, min(used_size, file_size - FOOTER_SIZE))
+        encrypted = salt != bytes(CRYPTO_SALT_SIZE)
+    else:
+        f.seek(file_size - FOOTER_SIZE - COMPRESS_EXT_SIZE)
+        _, block_count, index_offset, flags = struct.unpack('<IIII', f.read(COMPRESS_EXT_SIZE))
+        f.seek(index_offset)
+        index = struct.unpack(f'<{block_count}I', f.read(block_count * 4))
+        encrypted = bool(flags & COMPRESS_FLAG_ENCRYPTED)
+
+    key = None
+    if encrypted:
+        print("正在派生密钥...")
+        key = derive_key(password, salt)
+
+    data = bytearray()
+    for offset in index:
+        f.seek(offset)
+        stored_size, raw_size, _, _ = struct.unpack('<IIQQ', f.read(COMPRESS_BLOCK_HEADER_SIZE))
+        payload_size = stored_size & ~COMPRESS_BLOCK_STORED
+        payload = f.read(payload_size)
+        if key is not None:
+            payload = decrypt_stream(key, salt, payload, offset=offset + COMPRESS_BLOCK_HEADER_SIZE)
+        if stored_size & COMPRESS_BLOCK_STORED:
+            data += payload
+        else:
+            data += lz4_block_decompress(payload, raw_size)
+
+    return bytes(data)
+
+
 def read_log_file(file_path: str):
     """
     读取日志文件
     文件格式: [数据区域][盐16字节][魔数4字节][文件大小4字节][已用大小4字节]
+    循环日志 (魔数 EndC) 的最后一个字段为数据区容量, 见 read_circular_data
     
     Returns:
-        (salt, encrypted_data, used_size, file_size_from_footer)
+        (salt, encrypted_data, used_size, file_size_from_footer, data_offset)
     """
     with open(file_path, 'rb') as f:
         # 获取文件大小
@@ -96,13 +300,21 @@ def read_log_file(file_path: str):
         salt = footer[:CRYPTO_SALT_SIZE]
         magic, footer_file_size, used_size = struct.unpack('<III', footer[CRYPTO_SALT_SIZE:])
         
-        if magic != MAGIC_ENDX:
-            print(f"警告: 文件尾部魔数不匹配 (期望 0x{MAGIC_ENDX:08X}, 实际 0x{magic:08X})")
-            # 不报错,尝试继续
-        
         # 验证footer中的文件大小
         if footer_file_size != file_size:
             print(f"警告: footer中文件大小({footer_file_size})与实际文件大小({file_size})不匹配")
+
+        if magic == MAGIC_ENDC:
+            encrypted_data, data_offset = read_circular_data(f, file_size, used_size)
+            return salt, encrypted_data, len(encrypted_data), footer_file_size, data_offset
+
+        if magic == MAGIC_ENDZ or magic == MAGIC_ENDB:
+            # 压缩段 / 块流: 由 decrypt_log_file 逐块解密解压
+            return salt, None, used_size, footer_file_size, 0
+
+        if magic != MAGIC_ENDX:
+            print(f"警告: 文件尾部魔数不匹配 (期望 0x{MAGIC_ENDX:08X}, 实际 0x{magic:08X})")
+            # 不报错,尝试继续
         
         # 计算数据区域大小
         data_size = file_size - FOOTER_SIZE
@@ -115,7 +327,7 @@ def read_log_file(file_path: str):
         if 0 < used_size < len(encrypted_data):
             encrypted_data = encrypted_data[:used_size]
         
-        return salt, encrypted_data, used_size, footer_file_size
+        return salt, encrypted_data, used_size, footer_file_size, 0
 
 
 def remove_trailing_zeros(data: bytes) -> bytes:
@@ -125,29 +337,418 @@ def remove_trailing_zeros(data: bytes) -> bytes:
     return data.rstrip(b'\x00')
 
 
-def decrypt_log_file(input_file: str, output_file: str, password: str):
+# ============================================================================
+# 二进制日志 (LZ_LOG_BINARY) 还原
+# ============================================================================
+# 二进制记录与文本行混在同一数据流中, 以 UTF-8 中不会出现的字节开头:
+#   记录: 0xFE varint(长度) | varint(格式编号) zigzag(时间差ms) varint(线程ID) 参数...
+#   控制: 0xFF varint(长度) | 类型(1字节) 内容...
+#     会话 (1): 会话ID(8字节, LE) varint(基准时间 Unix ms) zigzag(时区偏移, 分钟)
+#     格式 (2): varint(格式编号) 级别(1字节) varint(行号) str(文件) str(函数) str(标签) str(格式串)
+#     字符串 (3): varint(字符串编号) str(内容)
+#   行记录 (字符串字典): 0xFD varint(长度) | 级别(1字节) zigzag(时间差ms) varint(线程ID)
+#     field(文件) varint(行号) field(函数) field(标签) 消息; field = varint(字符串编号), 为 0 时后跟 str(内容)
+# 与 src/lz_binlog.h 保持一致
+
+BINLOG_LINE = 0xFD
+BINLOG_RECORD = 0xFE
+BINLOG_CONTROL = 0xFF
+BINLOG_CTRL_SESSION = 1
+BINLOG_CTRL_FORMAT = 2
+BINLOG_CTRL_STRING = 3
+BINLOG_CTRL_THREAD = 4
+BINLOG_MAX_ARGS = 32
+BINLOG_LEAD = re.compile(rb'[\xfd\xfe\xff]')
+LEVEL_NAMES = [b'VERBOSE', b'DEBUG', b'INFO', b'WARN', b'ERROR', b'FATAL']
+
+
+class BinlogReader:
+    """负载读取游标, 越界时抛出 ValueError"""
+
+    def __init__(self, data: bytes, pos: int, end: int):
+        self.data = data
+        self.pos = pos
+        self.end = end
+
+    def byte(self) -> int:
+        if self.pos >= self.end:
+            raise ValueError('truncated')
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def varint(self) -> int:
+        value = 0
+        for shift in range(0, 64, 7):
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return value
+        raise ValueError('bad varint')
+
+    def zigzag(self) -> int:
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+    def raw(self, n: int) -> bytes:
+        if n > self.end - self.pos:
+            raise ValueError('truncated')
+        s = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return s
+
+    def str(self) -> bytes:
+        return self.raw(self.varint())
+
+
+def parse_binlog_format(fmt: bytes):
+    """
+    解析格式串 (与 lz_binlog_parse_format 的规则相同)
+    返回 (参数编码列表, 转换说明列表), 不支持二进制写入的格式串返回 None。
+    参数编码: 'i' 有符号, 'u' 无符号, 'd' 浮点, 's' 字符串;
+    转换说明: (起始, 结束, 标志, 宽度, 精度, 转换字符, 宽度参数序号, 精度参数序号, 值参数序号)
+    """
+    args = []
+    specs = []
+    i = 0
+    n = len(fmt)
+    while i < n:
+        if fmt[i] != 0x25:  # '%'
+            i += 1
+            continue
+        if len(specs) >= BINLOG_MAX_ARGS:
+            return None
+        start = i
+        i += 1
+        flags_start = i
+        while i < n and fmt[i:i + 1] in (b'-', b'+', b' ', b'#', b'0', b"'"):
+            i += 1
+        flags = fmt[flags_start:i].replace(b"'", b'')
+
+        width, width_arg = b'', -1
+        if i < n and fmt[i:i + 1] == b'*':
+            width_arg = len(args)
+            args.append('i')
+            i += 1
+        else:
+            w = i
+            while i < n and 0x30 <= fmt[i] <= 0x39:
+                i += 1
+            width = fmt[w:i]
+        if i < n and fmt[i:i + 1] == b'$':
+            return None  # 位置参数
+
+        precision, precision_arg = None, -1
+        if i < n and fmt[i:i + 1] == b'.':
+            i += 1
+            if i < n and fmt[i:i + 1] == b'*':
+                precision_arg = len(args)
+                args.append('i')
+                i += 1
+            else:
+                p = i
+                while i < n and 0x30 <= fmt[i] <= 0x39:
+                    i += 1
+                precision = fmt[p:i] or b'0'
+
+        length = b''
+        if i < n and fmt[i:i + 1] in (b'h', b'l'):
+            length = fmt[i:i + 2] if fmt[i + 1:i + 2] == fmt[i:i + 1] else fmt[i:i + 1]
+            i += len(length)
+        elif i < n and fmt[i:i + 1] in (b'q', b'j', b'z', b't', b'L'):
+            length = fmt[i:i + 1]
+            i += 1
+        if i >= n:
+            return None
+
+        conv = fmt[i:i + 1]
+        i += 1
+        if conv == b'%':
+            specs.append((start, i, flags, width, precision, conv, -1, -1, -1))
+            continue
+        if len(args) >= BINLOG_MAX_ARGS:
+            return None
+        if conv in (b'd', b'i'):
+            wire = 'i'
+        elif conv in (b'u', b'o', b'x', b'X', b'p'):
+            wire = 'u'
+        elif conv in (b'c', b's'):
+            if length:
+                return None  # 宽字符
+            wire = 'u' if conv == b'c' else 's'
+        elif conv in (b'e', b'E', b'f', b'F', b'g', b'G', b'a', b'A'):
+            wire = 'd'
+        else:
+            return None  # %n、%m 及未知转换
+        specs.append((start, i, flags, width, precision, conv, width_arg, precision_arg, len(args)))
+        args.append(wire)
+    return args, specs
+
+
+def format_binlog_value(flags: bytes, width: bytes, precision, conv: bytes, value) -> bytes:
+    """按 printf 规则输出一个参数 (Python 的 % 与 C 不一致的转换单独处理)"""
+    if conv in (b'a', b'A'):
+        text = float.hex(value).encode()
+        text = text.upper() if conv == b'A' else text
+    elif conv == b'p':
+        text = b'0x%x' % value if value else b'(nil)'
+    elif conv == b'o' and b'#' in flags:
+        text = b'0%o' % value if value else b'0'
+    else:
+        spec = b'%' + flags + width
+        if precision is not None and conv != b's':
+            spec += b'.' + precision
+        spec += b'd' if conv in (b'i', b'u') else conv
+        return spec % value
+    # 只按宽度对齐
+    pad = int(width or b'0') - len(text)
+    if pad <= 0:
+        return text
+    return text + b' ' * pad if b'-' in flags else b' ' * pad + text
+
+
+def render_binlog_message(fmt: bytes, parsed, r: BinlogReader) -> bytes:
+    """读取一条记录的参数并还原 message"""
+    wires, specs = parsed
+    values = []
+    for wire in wires:
+        if wire == 'i':
+            values.append(r.zigzag())
+        elif wire == 'u':
+            values.append(r.varint())
+        elif wire == 'd':
+            values.append(struct.unpack('<d', r.raw(8))[0])
+        else:
+            values.append(r.str())
+
+    out = []
+    literal = 0
+    for start, end, flags, width, precision, conv, width_arg, precision_arg, value_arg in specs:
+        out.append(fmt[literal:start])
+        literal = end
+        if conv == b'%':
+            out.append(b'%')
+            continue
+        if width_arg >= 0:
+            w = values[width_arg]
+            if w < 0:
+                flags, w = flags + b'-', -w
+            width = b'%d' % w
+        if precision_arg >= 0:
+            p = values[precision_arg]
+            precision = b'%d' % p if p >= 0 else None
+        out.append(format_binlog_value(flags, width, precision, conv, values[value_arg]))
+    out.append(fmt[literal:])
+    return b''.join(out)
+
+
+def binlog_timestamp(session, delta_ms: int) -> bytes:
+    """本地时间 yyyy-MM-dd HH:mm:ss.SSS (按会话记录的时区偏移)"""
+    _, base_ms, tz_minutes = session
+    ms = base_ms + delta_ms + tz_minutes * 60000
+    t = time.gmtime(ms // 1000)
+    return b'%04d-%02d-%02d %02d:%02d:%02d.%03d' % (
+        t.tm_year, t.tm_mon, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, ms % 1000)
+
+
+def binlog_thread(session, tid: int) -> bytes:
+    """线程字段: 线程ID(十六进制), 有线程名定义时为 线程ID(名称)"""
+    name = session[3].get(tid) if session else None
+    return b'%x(%s)' % (tid, name) if name else b'%x' % tid
+
+
+def render_binlog_line(session, r: BinlogReader) -> bytes:
+    """还原一条行记录 (字符串字典); 定义已被覆盖 (环形缓冲) 的字段输出编号"""
+    strings = session[2] if session else {}
+
+    def field():
+        sid = r.varint()
+        if sid == 0:
+            return r.str()
+        return strings.get(sid, b'<string #%d>' % sid)
+
+    level, delta_ms, tid = r.byte(), r.zigzag(), r.varint()
+    file = field()
+    line = r.varint()
+    func, tag = field(), field()
+    timestamp = binlog_timestamp(session[0], delta_ms) if session else b'0000-00-00 00:00:00.000'
+    parts = [timestamp, b' [', LEVEL_NAMES[level] if level < len(LEVEL_NAMES) else b'UNKNOWN',
+             b'] T:', binlog_thread(session, tid), b' [', file or b'unknown']
+    if line > 0:
+        parts.append(b':%d' % line)
+    parts.append(b'] [')
+    if func:
+        parts += [func, b'] [']
+    parts += [tag, b'] ', r.raw(r.end - r.pos), b'\n']
+    return b''.join(parts)
+
+
+def iter_binlog_items(data: bytes):
+    """
+    遍历数据流, 依次产生 (首字节, 起始, 结束):
+    文本为 (0, 起始, 结束), 二进制记录 / 控制记录为 (首字节, 负载起始, 负载结束);
+    记录被截断时产生 (-1, 位置, 数据长度) 并结束
+    """
+    pos = 0
+    n = len(data)
+    while pos < n:
+        m = BINLOG_LEAD.search(data, pos)
+        if m is None:
+            yield 0, pos, n
+            return
+        if m.start() > pos:
+            yield 0, pos, m.start()
+        pos = m.start()
+        r = BinlogReader(data, pos + 1, n)
+        try:
+            length = r.varint()
+            if length > n - r.pos:
+                raise ValueError('truncated')
+        except ValueError:
+            yield -1, pos, n
+            return
+        yield data[pos], r.pos, r.pos + length
+        pos = r.pos + length
+
+
+def decode_binary_records(data: bytes) -> bytes:
+    """
+    把二进制记录和行记录 (字符串字典) 还原为与 lz_logger_log 相同的文本行, 文本行原样保留。
+    先收集整个文件中每个会话的格式定义, 再逐条还原。
+    """
+    if BINLOG_LEAD.search(data) is None:
+        return data
+
+    # 第一遍: 会话和格式定义
+    sessions = {}
+    first_session = None
+    current = None
+    for lead, start, end in iter_binlog_items(data):
+        if lead != BINLOG_CONTROL:
+            continue
+        r = BinlogReader(data, start, end)
+        try:
+            ctrl = r.byte()
+            if ctrl == BINLOG_CTRL_SESSION:
+                sid = struct.unpack('<Q', r.raw(8))[0]
+                if sid not in sessions:
+                    sessions[sid] = ((sid, r.varint(), r.zigzag()), {}, {}, {})
+                current = sessions[sid]
+                first_session = first_session or current
+            elif ctrl == BINLOG_CTRL_FORMAT and current is not None:
+                fid = r.varint()
+                if fid not in current[1]:
+                    level, line = r.byte(), r.varint()
+                    file, func, tag, fmt = r.str(), r.str(), r.str(), r.str()
+                    current[1][fid] = (level, line, file, func, tag, fmt, parse_binlog_format(fmt))
+            elif ctrl == BINLOG_CTRL_STRING and current is not None:
+                sid = r.varint()
+                current[2].setdefault(sid, r.str())
+            elif ctrl == BINLOG_CTRL_THREAD and current is not None:
+                tid = r.varint()
+                current[3].setdefault(tid, r.str())
+        except ValueError:
+            continue
+
+    # 第二遍: 还原 (文件开头的记录归入第一个会话: 环形缓冲中会话记录可能已被覆盖;
+    # 线程 ID 可能被新线程复用, 线程名定义按出现顺序覆盖第一遍收集的结果)
+    out = []
+    current = first_session
+    for lead, start, end in iter_binlog_items(data):
+        if lead == 0:
+            out.append(data[start:end])
+            continue
+        if lead < 0:
+            out.append(b'[binary record truncated]\n')
+            break
+        r = BinlogReader(data, start, end)
+        if lead == BINLOG_CONTROL:
+            try:
+                ctrl = r.byte()
+                if ctrl == BINLOG_CTRL_SESSION:
+                    current = sessions.get(struct.unpack('<Q', r.raw(8))[0], current)
+                elif ctrl == BINLOG_CTRL_THREAD and current is not None:
+                    tid = r.varint()
+                    current[3][tid] = r.str()
+            except ValueError:
+                pass
+            continue
+        if lead == BINLOG_LINE:
+            try:
+                out.append(render_binlog_line(current, r))
+            except ValueError:
+                out.append(b'[binary record truncated]\n')
+            continue
+
+        try:
+            fid, delta_ms, tid = r.varint(), r.zigzag(), r.varint()
+        except ValueError:
+            out.append(b'[binary record truncated]\n')
+            continue
+        definition = current[1].get(fid) if current else None
+        timestamp = binlog_timestamp(current[0], delta_ms) if current else b'0000-00-00 00:00:00.000'
+        if definition is None or definition[6] is None:
+            out.append(b'%s [UNKNOWN] T:%s [unknown] [] [binary record: format #%d not found]\n'
+                       % (timestamp, binlog_thread(current, tid), fid))
+            continue
+
+        level, line, file, func, tag, fmt, parsed = definition
+        # yyyy-MM-dd HH:mm:ss.SSS [LEVEL] T:tid [file:line] [func] [tag] message
+        parts = [timestamp, b' [', LEVEL_NAMES[level] if level < len(LEVEL_NAMES) else b'UNKNOWN',
+                 b'] T:', binlog_thread(current, tid), b' [', file or b'unknown']
+        if line > 0:
+            parts.append(b':%d' % line)
+        parts.append(b'] [')
+        if func:
+            parts += [func, b'] [']
+        parts += [tag, b'] ']
+        try:
+            parts.append(render_binlog_message(fmt, parsed, r))
+        except (ValueError, TypeError, OverflowError):
+            parts.append(b'[binary record truncated]')
+        parts.append(b'\n')
+        out.append(b''.join(parts))
+    return b''.join(out)
+
+
+def decrypt_log_file(input_file: str, output_file: str, password: str, keep_binary: bool = False):
     """解密日志文件"""
     print(f"正在读取文件: {input_file}")
     
     try:
-        salt, encrypted_data, used_size, footer_file_size = read_log_file(input_file)
+        salt, encrypted_data, used_size, footer_file_size, data_offset = read_log_file(input_file)
     except Exception as e:
         print(f"错误: 读取文件失败 - {e}")
         return False
     
-    print(f"文件大小: {len(encrypted_data)} 字节 (已使用: {used_size} 字节, footer文件大小: {footer_file_size} 字节)")
-    print(f"盐值: {salt.hex()}")
-    
-    # 派生密钥
-    print("正在派生密钥...")
-    key = derive_key(password, salt)
-    
-    # 解密数据 (数据从文件开头开始,偏移量为0)
-    print("正在解密...")
-    decrypted_data = decrypt_aes_ctr(key, encrypted_data, offset=0)
+    if encrypted_data is None:
+        # 压缩段
+        print(f"压缩文件 (footer文件大小: {footer_file_size} 字节)")
+        print("正在解密解压...")
+        try:
+            with open(input_file, 'rb') as f:
+                decrypted_data = read_compressed_file(f, password)
+        except Exception as e:
+            print(f"错误: 解压失败 - {e}")
+            return False
+    else:
+        print(f"文件大小: {len(encrypted_data)} 字节 (已使用: {used_size} 字节, footer文件大小: {footer_file_size} 字节)")
+        print(f"盐值: {salt.hex()}")
+
+        # 派生密钥
+        print("正在派生密钥...")
+        key = derive_key(password, salt)
+
+        # 解密数据 (普通日志从文件开头开始,偏移量为0; 循环日志从最旧记录的逻辑偏移开始)
+        print("正在解密...")
+        decrypted_data = decrypt_stream(key, salt, encrypted_data, offset=data_offset)
     
     # 移除尾部填充字节
     decrypted_data = remove_trailing_zeros(decrypted_data)
+
+    # 还原二进制日志记录
+    if not keep_binary:
+        decrypted_data = decode_binary_records(decrypted_data)
     
     # 写入输出文件
     with open(output_file, 'wb') as f:
@@ -158,7 +759,16 @@ def decrypt_log_file(input_file: str, output_file: str, password: str):
     return True
 
 
-def batch_decrypt(input_dir: str, output_dir: str, password: str):
+def log_file_sort_key(path: Path):
+    """按 (日期, 编号) 排序：编号不再限制在个位数，不能按字符串排序"""
+    stem = path.stem
+    date, sep, num = stem.rpartition('-')
+    if sep and num.isdigit():
+        return (date, int(num), stem)
+    return (stem, -1, stem)
+
+
+def batch_decrypt(input_dir: str, output_dir: str, password: str, keep_binary: bool = False):
     """批量解密目录下的所有 .log 文件"""
     input_path = Path(input_dir)
     output_path = Path(output_dir)
@@ -180,11 +790,11 @@ def batch_decrypt(input_dir: str, output_dir: str, password: str):
     print("-" * 60)
     
     success_count = 0
-    for log_file in sorted(log_files):
+    for log_file in sorted(log_files, key=log_file_sort_key):
         output_file = output_path / f"{log_file.stem}_decrypted.txt"
         print(f"\n处理: {log_file.name}")
         
-        if decrypt_log_file(str(log_file), str(output_file), password):
+        if decrypt_log_file(str(log_file), str(output_file), password, keep_binary):
             success_count += 1
     
     print("-" * 60)
@@ -212,6 +822,8 @@ def main():
     parser.add_argument('-d', '--dir', help='输入日志目录 (批量解密)')
     parser.add_argument('-o', '--output', help='输出文件/目录 (单文件模式下可选,默认为原文件名.decrypt.扩展名)')
     parser.add_argument('-p', '--password', help='解密密码 (不提供则交互式输入)')
+    parser.add_argument('--keep-binary', action='store_true',
+                        help='不还原二进制日志记录 (LZ_LOG_BINARY), 原样输出 (可交给 lz_log_decode 处理)')
     
     args = parser.parse_args()
     
@@ -244,11 +856,11 @@ def main():
                 path = Path(args.file)
                 output_file = str(path.parent / f"{path.stem}.decrypt{path.suffix}")
             
-            if not decrypt_log_file(args.file, output_file, password):
+            if not decrypt_log_file(args.file, output_file, password, args.keep_binary):
                 sys.exit(1)
         else:
             # 批量解密
-            batch_decrypt(args.dir, args.output, password)
+            batch_decrypt(args.dir, args.output, password, args.keep_binary)
     except KeyboardInterrupt:
         print("\n\n操作已取消")
         sys.exit(1)
@@ -2,7 +2,7 @@
 # frozen_string_literal: true
 #
 # LZ Logger 日志解密工具 (Ruby 版本)
-# 支持 AES-CTR 加密的日志文件解密
+# 支持 AES-CTR 加密的日志文件解密, 以及后台压缩后的日志文件 (块压缩格式, 魔数 EndZ)
 #
 
 require 'openssl'
@@ -17,7 +17,12 @@ CRYPTO_KEY_SIZE = 32
 CRYPTO_BLOCK_SIZE = 16
 CRYPTO_SALT_SIZE = 16
 PBKDF2_ITERATIONS = 10000
+CRYPTO_SALT_TAG = 'LZK2'.b # v2 盐: 每段独立密钥 (AES-256-CTR)
+CRYPTO_SALT_TAG_CHACHA20 = 'LZC2'.b # v2 盐: 每段独立密钥 (ChaCha20)
+CHACHA20_BLOCK_SIZE = 64
+CRYPTO_HKDF_INFO = 'lz_logger segment key'.b
 MAGIC_ENDX = 0x456E6478
+MAGIC_ENDC = 0x456E6443 # 单文件循环日志
 FOOTER_SIZE = CRYPTO_SALT_SIZE + 4 + 4 + 4 # 盐16字节 + 魔数4字节 + 文件大小4字节 + 已用大小4字节
 
 # 解包格式:
@@ -25,23 +30,50 @@ FOOTER_SIZE = CRYPTO_SALT_SIZE + 4 + 4 + 4 # 盐16字节 + 魔数4字节 + 文
 # 'III' 是三个 Little-Endian 32-bit unsigned integer (UINT32)
 FOOTER_FORMAT = 'a16III' # salt, magic, file_size, used_size (Little-Endian)
 
+# 循环日志 footer 前的扩展区: 写入游标8字节 + 最旧记录偏移8字节 + 索引块大小4字节
+CIRCULAR_EXT_SIZE = 8 + 8 + 4
+CIRCULAR_EXT_FORMAT = 'Q<Q<L<'
+
+# 压缩段 (魔数 EndZ) footer 前的扩展区: 块大小4字节 + 块数4字节 + 块索引偏移4字节 + 标记4字节
+MAGIC_ENDZ = 0x456E645A
+COMPRESS_EXT_SIZE = 16
+COMPRESS_EXT_FORMAT = 'L<L<L<L<'
+# 块头部: 负载大小4字节 (最高位=原样存储) + 原文大小4字节 + 首/末记录时间各8字节
+COMPRESS_BLOCK_HEADER_SIZE = 24
+COMPRESS_BLOCK_HEADER_FORMAT = 'L<L<Q<Q<'
+COMPRESS_BLOCK_STORED = 0x80000000
+COMPRESS_FLAG_ENCRYPTED = 0x1
+COMPRESS_MAX_BLOCK = 64 * 1024
+# 写入时压缩的块流 (尚未补写块索引和扩展区)
+MAGIC_ENDB = 0x456E6442
+
 # --- 核心函数 ---
 
 ##
-# 从密码派生密钥 (PBKDF2-HMAC-SHA256)
+# 从密码派生密钥
+# v2 盐 ("LZK2" + 主盐8字节 + 段编号4字节): 主密钥 = PBKDF2(密码, 段编号置 0 的盐),
+#   段密钥 = HKDF-SHA256(主密钥, salt=完整盐, info="lz_logger segment key")
+# 旧版盐: 密钥 = PBKDF2-HMAC-SHA256(密码, 盐)
 # **兼容性修复:** 使用 OpenSSL::PKCS5.pbkdf2_hmac 显式指定 SHA256 算法。
 # @param password [String] 用户密码
 # @param salt [String] 16字节盐值
 # @return [String] 32字节密钥
 #
 def derive_key(password, salt)
-  OpenSSL::PKCS5.pbkdf2_hmac(
+  salt = salt.b
+  v2 = [CRYPTO_SALT_TAG, CRYPTO_SALT_TAG_CHACHA20].include?(salt.byteslice(0, CRYPTO_SALT_TAG.bytesize))
+  kdf_salt = v2 ? salt.byteslice(0, CRYPTO_SALT_SIZE - 4) + ("\0" * 4) : salt
+  master = OpenSSL::PKCS5.pbkdf2_hmac(
     password,
-    salt,
+    kdf_salt,
     PBKDF2_ITERATIONS,
     CRYPTO_KEY_SIZE,
     OpenSSL::Digest::SHA256.new # 显式指定 SHA256 算法
   )
+  return master unless v2
+
+  prk = OpenSSL::HMAC.digest('SHA256', salt, master)
+  OpenSSL::HMAC.digest('SHA256', prk, CRYPTO_HKDF_INFO + "\x01".b)
 end
 
 ##
@@ -82,11 +114,209 @@ def decrypt_aes_ctr(key, data, offset = 0)
   decrypted
 end
 
+##
+# ChaCha20 解密/加密 (原始 ChaCha20: 64 位块号 = 偏移 / 64, nonce 为 8 字节 0)
+# OpenSSL 的 IV 为 [块号低 32 位][块号高 32 位][nonce 8 字节] (小端), 低 32 位溢出时进位到高 32 位
+# @param key [String] 32字节密钥
+# @param data [String] 加密数据
+# @param offset [Integer] 文件偏移量 (用于计算块号)
+# @return [String] 解密后的数据
+#
+def decrypt_chacha20(key, data, offset = 0)
+  block_number = offset / CHACHA20_BLOCK_SIZE
+  block_offset = offset % CHACHA20_BLOCK_SIZE
+
+  cipher = OpenSSL::Cipher.new('chacha20')
+  cipher.decrypt
+  cipher.key = key
+  cipher.iv = [block_number & 0xFFFFFFFF, block_number >> 32].pack('V2') + ("\0" * 8)
+  cipher.update("\0" * block_offset) if block_offset > 0
+
+  decrypted = cipher.update(data)
+  decrypted << cipher.final
+  decrypted
+end
+
+##
+# 按段盐的标记选择流密码解密
+#
+def decrypt_stream(key, salt, data, offset = 0)
+  if salt.b.byteslice(0, CRYPTO_SALT_TAG_CHACHA20.bytesize) == CRYPTO_SALT_TAG_CHACHA20
+    decrypt_chacha20(key, data, offset)
+  else
+    decrypt_aes_ctr(key, data, offset)
+  end
+end
+
+##
+# 读取循环日志的数据 (按时间顺序)
+# 文件格式: [数据区 capacity 字节][块索引][写入游标8字节][最旧记录8字节][索引块大小4字节][footer]
+# 数据按 逻辑偏移 % capacity 存放, 加密计数器使用逻辑偏移
+# @param f [File] 已打开的文件
+# @param file_size [Integer] 文件大小
+# @param capacity [Integer] 数据区容量
+# @return [Array] [data, 起始逻辑偏移]
+#
+def read_circular_data(f, file_size, capacity)
+  f.seek(file_size - FOOTER_SIZE - CIRCULAR_EXT_SIZE)
+  cursor, oldest, block_size = f.read(CIRCULAR_EXT_SIZE).unpack(CIRCULAR_EXT_FORMAT)
+
+  start = 0
+  if cursor > capacity
+    floor = cursor - capacity
+    start = oldest
+    unless oldest >= floor && oldest <= cursor
+      # 扩展区中的最旧记录落后于游标: 从块索引查找
+      nblocks = capacity / block_size
+      f.seek(capacity)
+      index = f.read(nblocks * 8).unpack("Q<#{nblocks}")
+      start = cursor
+      ((floor / block_size)..(cursor / block_size)).each do |b|
+        first = index[b % nblocks]
+        if first / block_size == b && first >= floor && first <= cursor
+          start = first
+          break
+        end
+      end
+    end
+  end
+
+  # 从最旧记录读到写入游标, 在数据区末尾处回绕
+  data = String.new(encoding: Encoding::BINARY)
+  pos = start
+  while pos < cursor
+    physical = pos % capacity
+    length = [cursor - pos, capacity - physical].min
+    f.seek(physical)
+    data << f.read(length)
+    pos += length
+  end
+
+  [data, start]
+end
+
+##
+# 解压一个 LZ4 block (无帧头)
+# @param src [String] 压缩数据
+# @param raw_size [Integer] 原文大小
+# @return [String] 解压后的数据
+#
+def lz4_block_decompress(src, raw_size)
+  bytes = src.bytes
+  out = []
+  pos = 0
+  while pos < bytes.size
+    token = bytes[pos]
+    pos += 1
+
+    # 字面量
+    lit_len = token >> 4
+    if lit_len == 15
+      loop do
+        b = bytes[pos]
+        pos += 1
+        lit_len += b
+        break if b != 255
+      end
+    end
+    out.concat(bytes[pos, lit_len])
+    pos += lit_len
+    break if pos >= bytes.size
+
+    # 匹配 (偏移2字节小端, 可能与输出重叠)
+    offset = bytes[pos] | (bytes[pos + 1] << 8)
+    pos += 2
+    match_len = token & 0x0F
+    if match_len == 15
+      loop do
+        b = bytes[pos]
+        pos += 1
+        match_len += b
+        break if b != 255
+      end
+    end
+    match_len += 4
+    raise '压缩数据损坏: 匹配偏移越界' if offset.zero? || offset > out.size
+
+    start = out.size - offset
+    match_len.times { |i| out << out[start + i] }
+  end
+
+  raise "压缩数据损坏: 解压后 #{out.size} 字节, 期望 #{raw_size} 字节" if out.size != raw_size
+
+  out.pack('C*')
+end
+
+##
+# 沿块头部遍历块流 (EndB), 遇到无效的块头部 (崩溃时未写完的块) 即停止
+# @param f [File] 已打开的文件
+# @param used_size [Integer] 已用大小
+# @return [Array] 每块的偏移
+#
+def scan_block_stream(f, used_size)
+  index = []
+  pos = 0
+  while pos + COMPRESS_BLOCK_HEADER_SIZE <= used_size
+    f.seek(pos)
+    stored_size, raw_size, = f.read(COMPRESS_BLOCK_HEADER_SIZE).unpack(COMPRESS_BLOCK_HEADER_FORMAT)
+    stored = (stored_size & COMPRESS_BLOCK_STORED) != 0
+    payload_size = stored_size & ~COMPRESS_BLOCK_STORED
+    break if raw_size.zero? || raw_size > COMPRESS_MAX_BLOCK ||
+             payload_size.zero? || payload_size > COMPRESS_MAX_BLOCK ||
+             (stored && payload_size != raw_size) ||
+             pos + COMPRESS_BLOCK_HEADER_SIZE + payload_size > used_size
+
+    index << pos
+    pos += COMPRESS_BLOCK_HEADER_SIZE + payload_size
+  end
+  index
+end
+
+##
+# 读取压缩段 (EndZ) 或块流 (EndB) 并逐块解密、解压
+# 文件格式: [块...][块索引 N×4字节][扩展区16字节][footer]
+# 块流没有块索引和扩展区, 沿块头部遍历到已用大小; 盐非全 0 即为加密
+# 加密时只加密负载, 计数器使用负载在文件中的偏移
+# @param f [File] 已打开的文件
+# @param password [String] 密码
+# @return [String] 解压后的数据
+#
+def read_compressed_file(f, password)
+  file_size = f.size
+  f.seek(file_size - FOOTER_SIZE)
+  salt, magic, _, used_size = f.read(FOOTER_SIZE).unpack(FOOTER_FORMAT)
+
+  if magic == MAGIC_ENDB
+    index = scan_block_stream(f, [used_size, file_size - FOOTER_SIZE].min)
+    encrypted = salt != ("\0" * CRYPTO_SALT_SIZE)
+  else
+    f.seek(file_size - FOOTER_SIZE - COMPRESS_EXT_SIZE)
+    _, block_count, index_offset, flags = f.read(COMPRESS_EXT_SIZE).unpack(COMPRESS_EXT_FORMAT)
+    f.seek(index_offset)
+    index = block_count.zero? ? [] : f.read(block_count * 4).unpack("L<#{block_count}")
+    encrypted = (flags & COMPRESS_FLAG_ENCRYPTED) != 0
+  end
+
+  key = nil
+  key = derive_key(password, salt) if encrypted
+
+  data = String.new(encoding: Encoding::BINARY)
+  index.each do |offset|
+    f.seek(offset)
+    stored_size, raw_size, = f.read(COMPRESS_BLOCK_HEADER_SIZE).unpack(COMPRESS_BLOCK_HEADER_FORMAT)
+    payload = f.read(stored_size & ~COMPRESS_BLOCK_STORED)
+    payload = decrypt_stream(key, salt, payload, offset + COMPRESS_BLOCK_HEADER_SIZE) if key
+    data << ((stored_size & COMPRESS_BLOCK_STORED) != 0 ? payload : lz4_block_decompress(payload, raw_size))
+  end
+  data
+end
+
 ##
 # 读取日志文件
 # 文件格式: [数据区域][盐16字节][魔数4字节][文件大小4字节][已用大小4字节]
+# 循环日志 (魔数 EndC) 的最后一个字段为数据区容量, 见 read_circular_data
 # @param file_path [String] 文件路径
-# @return [Array] [salt, encrypted_data, used_size, file_size_from_footer]
+# @return [Array] [salt, encrypted_data, used_size, file_size_from_footer, data_offset]
 #
 def read_log_file(file_path)
   File.open(file_path, 'rb') do |f|
@@ -103,15 +333,23 @@ def read_log_file(file_path)
     # unpack 使用 FOOTER_FORMAT ('a16III')
     salt, magic, footer_file_size, used_size = footer.unpack(FOOTER_FORMAT)
 
-    if magic != MAGIC_ENDX
-      warn "警告: 文件尾部魔数不匹配 (期望 0x#{MAGIC_ENDX.to_s(16).upcase}, 实际 0x#{magic.to_s(16).upcase})"
-    end
-
     # 验证 footer 中的文件大小
     if footer_file_size != file_size
       warn "警告: footer 中文件大小(#{footer_file_size})与实际文件大小(#{file_size})不匹配"
     end
 
+    if magic == MAGIC_ENDC
+      encrypted_data, data_offset = read_circular_data(f, file_size, used_size)
+      return salt, encrypted_data, encrypted_data.bytesize, footer_file_size, data_offset
+    end
+
+    # 压缩段 / 块流: 由 decrypt_log_file 逐块解密解压
+    return salt, nil, used_size, footer_file_size, 0 if magic == MAGIC_ENDZ || magic == MAGIC_ENDB
+
+    if magic != MAGIC_ENDX
+      warn "警告: 文件尾部魔数不匹配 (期望 0x#{MAGIC_ENDX.to_s(16).upcase}, 实际 0x#{magic.to_s(16).upcase})"
+    end
+
     # 计算数据区域大小
     data_size = file_size - FOOTER_SIZE
 
@@ -124,7 +362,7 @@ def read_log_file(file_path)
       encrypted_data = encrypted_data[0...used_size]
     end
 
-    return salt, encrypted_data, used_size, footer_file_size
+    return salt, encrypted_data, used_size, footer_file_size, 0
   end
 end
 
@@ -148,24 +386,32 @@ def decrypt_log_file(input_file, output_file, password)
   puts "正在读取文件: #{input_file}"
 
   begin
-    salt, encrypted_data, used_size, footer_file_size = read_log_file(input_file)
+    salt, encrypted_data, used_size, footer_file_size, data_offset = read_log_file(input_file)
   rescue StandardError => e
     puts "错误: 读取文件失败 - #{e.message}"
     return false
   end
 
-  puts "文件大小: #{encrypted_data.bytesize} 字节 (已使用: #{used_size} 字节, footer 文件大小: #{footer_file_size} 字节)"
-  puts "盐值: #{salt.unpack('H*').first}"
-
-  # 派生密钥
-  print "正在派生密钥..."
-  key = derive_key(password, salt)
-  puts " 完成"
-
-  # 解密数据 (数据从文件开头开始,偏移量为0)
-  print "正在解密..."
-  decrypted_data = decrypt_aes_ctr(key, encrypted_data, 0)
-  puts " 完成"
+  if encrypted_data.nil?
+    # 压缩段
+    puts "压缩文件 (footer 文件大小: #{footer_file_size} 字节)"
+    print "正在解密解压..."
+    decrypted_data = File.open(input_file, 'rb') { |f| read_compressed_file(f, password) }
+    puts " 完成"
+  else
+    puts "文件大小: #{encrypted_data.bytesize} 字节 (已使用: #{used_size} 字节, footer 文件大小: #{footer_file_size} 字节)"
+    puts "盐值: #{salt.unpack('H*').first}"
+
+    # 派生密钥
+    print "正在派生密钥..."
+    key = derive_key(password, salt)
+    puts " 完成"
+
+    # 解密数据 (普通日志从文件开头开始,偏移量为0; 循环日志从最旧记录的逻辑偏移开始)
+    print "正在解密..."
+    decrypted_data = decrypt_stream(key, salt, encrypted_data, data_offset)
+    puts " 完成"
+  end
 
   # 移除尾部填充字节
   decrypted_data = remove_trailing_zeros(decrypted_data)
@@ -182,6 +428,19 @@ rescue StandardError => e
   false
 end
 
+##
+# 按 (日期, 编号) 排序：编号不再限制在个位数，不能按字符串排序
+# @param path [Pathname] 日志文件路径
+#
+def log_file_sort_key(path)
+  stem = path.basename('.log').to_s
+  if (m = stem.match(/\A(.*)-(\d+)\z/))
+    [m[1], m[2].to_i, stem]
+  else
+    [stem, -1, stem]
+  end
+end
+
 ##
 # 批量解密目录下的所有 .log 文件
 # @param input_dir [String] 输入目录
@@ -201,7 +460,7 @@ def batch_decrypt(input_dir, output_dir, password)
   FileUtils.mkdir_p(output_path)
 
   # 查找所有 .log 文件
-  log_files = Dir.glob(input_path.join('*.log')).map { |f| Pathname.new(f) }.sort
+  log_files = Dir.glob(input_path.join('*.log')).map { |f| Pathname.new(f) }.sort_by { |f| log_file_sort_key(f) }
   if log_files.empty?
     puts "警告: 目录中没有找到 .log 文件: #{input_dir}"
     return
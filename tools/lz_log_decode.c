@@ -0,0 +1,876 @@
+/**
+ * 二进制日志还原工具
+ *
+ * 把 LZ_LOG_BINARY 写入的二进制记录和开启字符串字典后的行记录还原为与 lz_logger_log 相同的文本行，
+ * 文本行原样输出。输入为解密后的日志明文（decrypt_log.py --keep-binary / decrypt_log.rb 的输出，
+ * 或未加密的日志文件），不指定输入文件时读取标准输入。
+ *
+ * 用法：
+ *   lz_log_decode [输入文件...] [-o 输出文件]
+ *
+ * 编译（CMake）：
+ *   cmake -S src -B build && cmake --build build --target lz_log_decode
+ * 编译（Linux，手动）：
+ *   gcc -O2 -Wall -o lz_log_decode tools/lz_log_decode.c src/lz_binlog.c src/lz_format.c src/lz_numfmt.c -I. -pthread
+ */
+#include "src/lz_binlog.h"
+#include "src/lz_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** 字典中的一个字符串 */
+typedef struct {
+    char *s; // NULL 表示未定义
+    size_t len;
+} dict_string_t;
+
+/** 线程名定义 */
+typedef struct {
+    uint64_t tid;
+    char name[LZ_FORMAT_THREAD_NAME_MAX + 1];
+} thread_name_t;
+
+/** 一个会话（一次打开）的基准时间、格式定义、字符串字典和线程名 */
+typedef struct {
+    uint64_t id;
+    int64_t base_ms;
+    int64_t tz_minutes;
+    uint32_t num_formats;
+    struct format_def **formats; // 按格式编号索引
+    uint32_t num_strings;
+    dict_string_t *strings;      // 按字符串编号索引
+    size_t num_threads;
+    thread_name_t *threads;
+} session_t;
+
+/** 一个格式定义 */
+typedef struct format_def {
+    uint8_t level;
+    uint32_t line;
+    char *file;
+    char *func;
+    char *tag;
+    char *fmt;
+    bool binary;
+    lz_binlog_format_t parsed;
+} format_def_t;
+
+typedef struct {
+    session_t *items;
+    size_t count;
+} session_list_t;
+
+/** 读取游标：越界后 ok 置为 false，之后的读取都返回 0 */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok;
+} reader_t;
+
+static uint64_t read_varint(reader_t *r) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p >= r->end) {
+            r->ok = false;
+            return 0;
+        }
+        uint8_t b = *r->p++;
+        value |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return value;
+        }
+    }
+    r->ok = false;
+    return 0;
+}
+
+static int64_t read_zigzag(reader_t *r) {
+    uint64_t v = read_varint(r);
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static uint8_t read_byte(reader_t *r) {
+    if (r->p >= r->end) {
+        r->ok = false;
+        return 0;
+    }
+    return *r->p++;
+}
+
+/**
+ * 读取字符串（varint 长度 + 内容）
+ * @param r 游标
+ * @param len 输出长度
+ * @return 指向输入缓冲的内容，越界返回 NULL
+ */
+static const char *read_str(reader_t *r, size_t *len) {
+    uint64_t n = read_varint(r);
+    if (!r->ok || n > (uint64_t)(r->end - r->p)) {
+        r->ok = false;
+        *len = 0;
+        return NULL;
+    }
+    const char *s = (const char *)r->p;
+    r->p += n;
+    *len = (size_t)n;
+    return s;
+}
+
+static char *read_str_dup(reader_t *r) {
+    size_t len = 0;
+    const char *s = read_str(r, &len);
+    char *copy = (char *)malloc(len + 1);
+    if (copy == NULL) {
+        fprintf(stderr, "内存不足\n");
+        exit(1);
+    }
+    if (s != NULL) {
+        memcpy(copy, s, len);
+    }
+    copy[len] = '\0';
+    return copy;
+}
+
+/**
+ * 读取一个帧（首字节 0xFE / 0xFF 之后的 varint 长度 + 负载）
+ * @param data 输入
+ * @param size 输入大小
+ * @param pos 帧首字节的位置，成功时移到帧之后
+ * @param payload 输出负载
+ * @return 成功返回 true；长度越界（截断的记录）返回 false
+ */
+static bool read_frame(const uint8_t *data, size_t size, size_t *pos, reader_t *payload) {
+    reader_t r = {data + *pos + 1, data + size, true};
+    uint64_t len = read_varint(&r);
+    if (!r.ok || len > (uint64_t)(r.end - r.p)) {
+        return false;
+    }
+    payload->p = r.p;
+    payload->end = r.p + len;
+    payload->ok = true;
+    *pos = (size_t)(r.p + len - data);
+    return true;
+}
+
+// ============================================================================
+// 第一遍：收集会话和格式定义
+// ============================================================================
+
+static session_t *add_session(session_list_t *list, reader_t *r) {
+    uint64_t id = 0;
+    for (int i = 0; i < 8; i++) {
+        id |= (uint64_t)read_byte(r) << (8 * i);
+    }
+    int64_t base_ms = (int64_t)read_varint(r);
+    int64_t tz_minutes = read_zigzag(r);
+    if (!r->ok) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        if (list->items[i].id == id) {
+            return &list->items[i];
+        }
+    }
+    session_t *items = (session_t *)realloc(list->items, (list->count + 1) * sizeof(session_t));
+    if (items == NULL) {
+        fprintf(stderr, "内存不足\n");
+        exit(1);
+    }
+    list->items = items;
+    session_t *s = &list->items[list->count++];
+    memset(s, 0, sizeof(*s));
+    s->id = id;
+    s->base_ms = base_ms;
+    s->tz_minutes = tz_minutes;
+    return s;
+}
+
+static void add_format(session_t *session, reader_t *r) {
+    uint64_t id = read_varint(r);
+    if (!r->ok || id == 0 || id > UINT32_MAX) {
+        return;
+    }
+    if (id < session->num_formats && session->formats[id] != NULL) {
+        return; // 同一会话的格式定义在每个纪元重复写入，内容相同
+    }
+
+    format_def_t *def = (format_def_t *)calloc(1, sizeof(format_def_t));
+    if (def == NULL) {
+        fprintf(stderr, "内存不足\n");
+        exit(1);
+    }
+    def->level = read_byte(r);
+    def->line = (uint32_t)read_varint(r);
+    def->file = read_str_dup(r);
+    def->func = read_str_dup(r);
+    def->tag = read_str_dup(r);
+    def->fmt = read_str_dup(r);
+    if (!r->ok) {
+        free(def->file);
+        free(def->func);
+        free(def->tag);
+        free(def->fmt);
+        free(def);
+        return;
+    }
+    def->binary = lz_binlog_parse_format(def->fmt, &def->parsed);
+
+    if (id >= session->num_formats) {
+        uint32_t n = session->num_formats ? session->num_formats : 64;
+        while (n <= id) {
+            n *= 2;
+        }
+        format_def_t **formats = (format_def_t **)realloc(session->formats, n * sizeof(format_def_t *));
+        if (formats == NULL) {
+            fprintf(stderr, "内存不足\n");
+            exit(1);
+        }
+        memset(formats + session->num_formats, 0, (n - session->num_formats) * sizeof(format_def_t *));
+        session->formats = formats;
+        session->num_formats = n;
+    }
+    session->formats[id] = def;
+}
+
+static void add_string(session_t *session, reader_t *r) {
+    uint64_t id = read_varint(r);
+    size_t len = 0;
+    const char *s = read_str(r, &len);
+    if (!r->ok || id == 0 || id > UINT32_MAX) {
+        return;
+    }
+    if (id >= session->num_strings) {
+        uint32_t n = session->num_strings ? session->num_strings : 64;
+        while (n <= id) {
+            n *= 2;
+        }
+        dict_string_t *strings = (dict_string_t *)realloc(session->strings, n * sizeof(dict_string_t));
+        if (strings == NULL) {
+            fprintf(stderr, "内存不足\n");
+            exit(1);
+        }
+        memset(strings + session->num_strings, 0, (n - session->num_strings) * sizeof(dict_string_t));
+        session->strings = strings;
+        session->num_strings = n;
+    }
+    if (session->strings[id].s != NULL) {
+        return; // 每个纪元重复写入，内容相同
+    }
+    char *copy = (char *)malloc(len + 1);
+    if (copy == NULL) {
+        fprintf(stderr, "内存不足\n");
+        exit(1);
+    }
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    session->strings[id].s = copy;
+    session->strings[id].len = len;
+}
+
+/**
+ * 记录线程名定义
+ * @param session 所属会话
+ * @param r 控制记录负载（类型之后）
+ * @param replace 已有同一线程 ID 的定义时是否覆盖（第二遍按数据流顺序覆盖：线程 ID 可能被复用）
+ */
+static void set_thread_name(session_t *session, reader_t *r, bool replace) {
+    uint64_t tid = read_varint(r);
+    size_t len = 0;
+    const char *name = read_str(r, &len);
+    if (!r->ok) {
+        return;
+    }
+    thread_name_t *entry = NULL;
+    for (size_t i = 0; i < session->num_threads; i++) {
+        if (session->threads[i].tid == tid) {
+            entry = &session->threads[i];
+            break;
+        }
+    }
+    if (entry != NULL && !replace) {
+        return;
+    }
+    if (entry == NULL) {
+        thread_name_t *threads = (thread_name_t *)realloc(session->threads,
+                                                          (session->num_threads + 1) * sizeof(thread_name_t));
+        if (threads == NULL) {
+            fprintf(stderr, "内存不足\n");
+            exit(1);
+        }
+        session->threads = threads;
+        entry = &threads[session->num_threads++];
+        entry->tid = tid;
+    }
+    if (len > LZ_FORMAT_THREAD_NAME_MAX) {
+        len = LZ_FORMAT_THREAD_NAME_MAX;
+    }
+    memcpy(entry->name, name, len);
+    entry->name[len] = '\0';
+}
+
+/** 线程字段：线程ID（十六进制），线程名定义不为空时为 线程ID(名称) */
+static void write_thread(FILE *out, const session_t *session, uint64_t tid) {
+    fprintf(out, "%llx", (unsigned long long)tid);
+    for (size_t i = 0; session != NULL && i < session->num_threads; i++) {
+        if (session->threads[i].tid == tid) {
+            if (session->threads[i].name[0] != '\0') {
+                fprintf(out, "(%s)", session->threads[i].name);
+            }
+            break;
+        }
+    }
+}
+
+/** 首字节是否为二进制记录（行记录 / 格式化记录 / 控制记录） */
+static bool is_binary_lead(uint8_t b) {
+    return b == LZ_BINLOG_LINE || b == LZ_BINLOG_RECORD || b == LZ_BINLOG_CONTROL;
+}
+
+/**
+ * 遍历输入：文本行到换行（或下一个二进制记录）为止，二进制记录按帧长度跳过
+ * @param data 输入
+ * @param size 输入大小
+ * @param pos 当前位置，移到下一项之前
+ * @param text_len 输出：文本的长度（二进制记录为 0）
+ * @param frame 输出：二进制记录的负载
+ * @return 下一项的首字节（文本为 0），输入结束或记录截断返回 -1
+ */
+static int next_item(const uint8_t *data, size_t size, size_t *pos, size_t *text_len, reader_t *frame) {
+    // 跳过填充的 0（环形缓冲、块对齐）
+    while (*pos < size && data[*pos] == 0) {
+        (*pos)++;
+    }
+    if (*pos >= size) {
+        return -1;
+    }
+
+    uint8_t lead = data[*pos];
+    if (is_binary_lead(lead)) {
+        *text_len = 0;
+        return read_frame(data, size, pos, frame) ? lead : -1;
+    }
+
+    size_t start = *pos;
+    while (*pos < size && !is_binary_lead(data[*pos])) {
+        if (data[(*pos)++] == '\n') {
+            break;
+        }
+    }
+    *text_len = *pos - start;
+    return 0;
+}
+
+static void collect(const uint8_t *data, size_t size, session_list_t *sessions) {
+    size_t pos = 0, text_len = 0;
+    reader_t frame;
+    session_t *current = NULL;
+    int lead;
+    while ((lead = next_item(data, size, &pos, &text_len, &frame)) >= 0) {
+        if (lead != LZ_BINLOG_CONTROL) {
+            continue;
+        }
+        uint8_t type = read_byte(&frame);
+        if (type == LZ_BINLOG_CTRL_SESSION) {
+            current = add_session(sessions, &frame);
+        } else if (type == LZ_BINLOG_CTRL_FORMAT && current != NULL) {
+            add_format(current, &frame);
+        } else if (type == LZ_BINLOG_CTRL_STRING && current != NULL) {
+            add_string(current, &frame);
+        } else if (type == LZ_BINLOG_CTRL_THREAD && current != NULL) {
+            set_thread_name(current, &frame, false);
+        }
+    }
+}
+
+// ============================================================================
+// 第二遍：还原
+// ============================================================================
+
+/** 解码后的参数 */
+typedef struct {
+    lz_binlog_wire_t wire;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        struct {
+            const char *s;
+            size_t len;
+        } str;
+    } v;
+} arg_value_t;
+
+/** 本地时间 yyyy-MM-dd HH:mm:ss.SSS（按会话记录的时区偏移） */
+static void write_timestamp(FILE *out, const session_t *session, int64_t delta_ms) {
+    int64_t ms = session->base_ms + delta_ms + session->tz_minutes * 60000;
+    time_t sec = (time_t)(ms / 1000);
+    struct tm tm_info;
+    gmtime_r(&sec, &tm_info);
+    fprintf(out, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+            tm_info.tm_year + 1900, tm_info.tm_mon + 1, tm_info.tm_mday,
+            tm_info.tm_hour, tm_info.tm_min, tm_info.tm_sec, (int)(ms % 1000));
+}
+
+/**
+ * 按一个转换说明输出参数（去掉长度修饰符、* 替换为数值后交给 fprintf）
+ * @param out 输出
+ * @param fmt 格式串
+ * @param spec 转换说明
+ * @param args 参数
+ */
+static void write_spec(FILE *out, const char *fmt, const lz_binlog_spec_t *spec, const arg_value_t *args) {
+    if (spec->conversion == '%') {
+        fputc('%', out);
+        return;
+    }
+
+    char buf[96];
+    size_t n = 0;
+    size_t i = spec->start + 1;
+    buf[n++] = '%';
+
+    // 标志（' 千位分隔依赖 locale，去掉）
+    while (strchr("-+ #0'", fmt[i]) != NULL) {
+        if (fmt[i] != '\'') {
+            buf[n++] = fmt[i];
+        }
+        i++;
+    }
+
+    // 宽度
+    if (fmt[i] == '*') {
+        n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%lld", (long long)args[spec->width_arg].v.i);
+        i++;
+    } else {
+        while (fmt[i] >= '0' && fmt[i] <= '9' && n < 40) {
+            buf[n++] = fmt[i++];
+        }
+        while (fmt[i] >= '0' && fmt[i] <= '9') {
+            i++;
+        }
+    }
+
+    // 精度（字符串已按精度截断写入，不再使用）
+    if (fmt[i] == '.') {
+        i++;
+        if (fmt[i] == '*') {
+            int64_t precision = args[spec->precision_arg].v.i;
+            if (precision >= 0 && spec->conversion != 's') {
+                n += (size_t)snprintf(buf + n, sizeof(buf) - n, ".%lld", (long long)precision);
+            }
+            i++;
+        } else {
+            if (spec->conversion != 's') {
+                buf[n++] = '.';
+            }
+            while (fmt[i] >= '0' && fmt[i] <= '9') {
+                if (spec->conversion != 's' && n < 80) {
+                    buf[n++] = fmt[i];
+                }
+                i++;
+            }
+        }
+    }
+
+    const arg_value_t *value = &args[spec->value_arg];
+    char conversion = spec->conversion;
+    switch (value->wire) {
+    case LZ_BINLOG_WIRE_SIGNED:
+        snprintf(buf + n, sizeof(buf) - n, "ll%c", conversion);
+        fprintf(out, buf, (long long)value->v.i);
+        break;
+    case LZ_BINLOG_WIRE_UNSIGNED:
+        if (conversion == 'c') {
+            snprintf(buf + n, sizeof(buf) - n, "c");
+            fprintf(out, buf, (int)value->v.u);
+        } else if (conversion == 'p') {
+            snprintf(buf + n, sizeof(buf) - n, "p");
+            fprintf(out, buf, (void *)(uintptr_t)value->v.u);
+        } else {
+            snprintf(buf + n, sizeof(buf) - n, "ll%c", conversion);
+            fprintf(out, buf, (unsigned long long)value->v.u);
+        }
+        break;
+    case LZ_BINLOG_WIRE_DOUBLE:
+        snprintf(buf + n, sizeof(buf) - n, "%c", conversion);
+        fprintf(out, buf, value->v.d);
+        break;
+    case LZ_BINLOG_WIRE_STRING: {
+        // 记录中的字符串不以 0 结尾：复制一份再按宽度输出
+        char *copy = (char *)malloc(value->v.str.len + 1);
+        if (copy == NULL) {
+            fprintf(stderr, "内存不足\n");
+            exit(1);
+        }
+        memcpy(copy, value->v.str.s, value->v.str.len);
+        copy[value->v.str.len] = '\0';
+        snprintf(buf + n, sizeof(buf) - n, "s");
+        fprintf(out, buf, copy);
+        free(copy);
+        break;
+    }
+    }
+}
+
+/**
+ * 还原一条二进制记录
+ * @param out 输出
+ * @param session 所属会话（NULL 表示文件中没有会话记录）
+ * @param r 记录负载
+ */
+static void write_record(FILE *out, const session_t *session, reader_t *r) {
+    uint64_t id = read_varint(r);
+    int64_t delta_ms = read_zigzag(r);
+    uint64_t tid = read_varint(r);
+
+    const format_def_t *def = NULL;
+    if (session != NULL && id < session->num_formats) {
+        def = session->formats[id];
+    }
+    if (session == NULL || def == NULL || !def->binary || !r->ok) {
+        // 定义已被覆盖（环形缓冲）或记录不完整：保留编号便于排查
+        if (session != NULL) {
+            write_timestamp(out, session, delta_ms);
+        } else {
+            fputs("0000-00-00 00:00:00.000", out);
+        }
+        fputs(" [UNKNOWN] T:", out);
+        write_thread(out, session, tid);
+        fprintf(out, " [unknown] [] [binary record: format #%llu not found]\n", (unsigned long long)id);
+        return;
+    }
+
+    const lz_binlog_format_t *parsed = &def->parsed;
+    arg_value_t args[LZ_BINLOG_MAX_ARGS];
+    for (uint8_t i = 0; i < parsed->num_args; i++) {
+        args[i].wire = lz_binlog_arg_wire((lz_binlog_arg_t)parsed->args[i]);
+        switch (args[i].wire) {
+        case LZ_BINLOG_WIRE_SIGNED:
+            args[i].v.i = read_zigzag(r);
+            break;
+        case LZ_BINLOG_WIRE_UNSIGNED:
+            args[i].v.u = read_varint(r);
+            break;
+        case LZ_BINLOG_WIRE_DOUBLE: {
+            uint64_t bits = 0;
+            for (int b = 0; b < 8; b++) {
+                bits |= (uint64_t)read_byte(r) << (8 * b);
+            }
+            memcpy(&args[i].v.d, &bits, sizeof(bits));
+            break;
+        }
+        case LZ_BINLOG_WIRE_STRING:
+            args[i].v.str.s = read_str(r, &args[i].v.str.len);
+            if (args[i].v.str.s == NULL) {
+                args[i].v.str.s = "";
+            }
+            break;
+        }
+    }
+
+    // yyyy-MM-dd HH:mm:ss.SSS [LEVEL] T:tid [file:line] [func] [tag] message
+    write_timestamp(out, session, delta_ms);
+    fprintf(out, " [%s] T:", lz_format_level_name((lz_log_level_t)def->level));
+    write_thread(out, session, tid);
+    fprintf(out, " [%s", def->file[0] ? def->file : "unknown");
+    if (def->line > 0) {
+        fprintf(out, ":%u", def->line);
+    }
+    fputs("] [", out);
+    if (def->func[0]) {
+        fprintf(out, "%s] [", def->func);
+    }
+    fprintf(out, "%s] ", def->tag);
+
+    if (!r->ok) {
+        fputs("[binary record truncated]\n", out);
+        return;
+    }
+
+    size_t literal = 0;
+    for (uint8_t s = 0; s < parsed->num_specs; s++) {
+        const lz_binlog_spec_t *spec = &parsed->specs[s];
+        fwrite(def->fmt + literal, 1, spec->start - literal, out);
+        write_spec(out, def->fmt, spec, args);
+        literal = spec->end;
+    }
+    fputs(def->fmt + literal, out);
+    fputc('\n', out);
+}
+
+/**
+ * 读取行记录的一个字段（字符串编号，编号为 0 时后跟内容）
+ * @param r 游标
+ * @param session 所属会话（可为 NULL）
+ * @param len 输出长度
+ * @return 内容；编号未定义时返回 NULL，此时 len 为编号
+ */
+static const char *read_line_field(reader_t *r, const session_t *session, size_t *len) {
+    uint64_t id = read_varint(r);
+    if (id == 0) {
+        const char *s = read_str(r, len);
+        return s != NULL ? s : "";
+    }
+    if (session != NULL && id < session->num_strings && session->strings[id].s != NULL) {
+        *len = session->strings[id].len;
+        return session->strings[id].s;
+    }
+    *len = (size_t)id;
+    return NULL;
+}
+
+/** 输出一个字段；定义已被覆盖（环形缓冲）时输出编号 */
+static void write_field(FILE *out, const char *s, size_t len, const char *fallback) {
+    if (s == NULL) {
+        fprintf(out, "<string #%zu>", len);
+    } else if (len == 0 && fallback != NULL) {
+        fputs(fallback, out);
+    } else {
+        fwrite(s, 1, len, out);
+    }
+}
+
+/**
+ * 还原一条行记录（字符串字典）
+ * @param out 输出
+ * @param session 所属会话（NULL 表示文件中没有会话记录）
+ * @param r 记录负载
+ */
+static void write_line(FILE *out, const session_t *session, reader_t *r) {
+    uint8_t level = read_byte(r);
+    int64_t delta_ms = read_zigzag(r);
+    uint64_t tid = read_varint(r);
+    size_t file_len = 0, func_len = 0, tag_len = 0;
+    const char *file = read_line_field(r, session, &file_len);
+    uint64_t line = read_varint(r);
+    const char *func = read_line_field(r, session, &func_len);
+    const char *tag = read_line_field(r, session, &tag_len);
+
+    // yyyy-MM-dd HH:mm:ss.SSS [LEVEL] T:tid [file:line] [func] [tag] message
+    if (session != NULL) {
+        write_timestamp(out, session, delta_ms);
+    } else {
+        fputs("0000-00-00 00:00:00.000", out);
+    }
+    if (!r->ok) {
+        fputs(" [UNKNOWN] T:0 [unknown] [] [binary record truncated]\n", out);
+        return;
+    }
+    fprintf(out, " [%s] T:", lz_format_level_name((lz_log_level_t)level));
+    write_thread(out, session, tid);
+    fputs(" [", out);
+    write_field(out, file, file_len, "unknown");
+    if (line > 0) {
+        fprintf(out, ":%llu", (unsigned long long)line);
+    }
+    fputs("] [", out);
+    if (func == NULL || func_len > 0) {
+        write_field(out, func, func_len, NULL);
+        fputs("] [", out);
+    }
+    write_field(out, tag, tag_len, NULL);
+    fputs("] ", out);
+    fwrite(r->p, 1, (size_t)(r->end - r->p), out);
+    fputc('\n', out);
+}
+
+static void render(FILE *out, const uint8_t *data, size_t size, session_list_t *sessions) {
+    size_t pos = 0, text_len = 0;
+    reader_t frame;
+    // 文件开头的记录（环形缓冲中会话记录已被覆盖）归入第一个会话
+    session_t *current = sessions->count > 0 ? &sessions->items[0] : NULL;
+    int lead;
+    while (1) {
+        lead = next_item(data, size, &pos, &text_len, &frame);
+        if (lead < 0) {
+            if (pos < size) {
+                fputs("[binary record truncated]\n", out);
+            }
+            break;
+        }
+        if (lead == 0) {
+            fwrite(data + pos - text_len, 1, text_len, out);
+        } else if (lead == LZ_BINLOG_RECORD) {
+            write_record(out, current, &frame);
+        } else if (lead == LZ_BINLOG_LINE) {
+            write_line(out, current, &frame);
+        } else {
+            uint8_t type = read_byte(&frame);
+            if (type == LZ_BINLOG_CTRL_SESSION) {
+                uint64_t id = 0;
+                for (int i = 0; i < 8; i++) {
+                    id |= (uint64_t)read_byte(&frame) << (8 * i);
+                }
+                for (size_t i = 0; i < sessions->count; i++) {
+                    if (sessions->items[i].id == id) {
+                        current = &sessions->items[i];
+                    }
+                }
+            } else if (type == LZ_BINLOG_CTRL_THREAD && current != NULL) {
+                // 线程 ID 可能被新线程复用：按数据流顺序覆盖
+                set_thread_name(current, &frame, true);
+            }
+        }
+    }
+}
+
+/**
+ * 读取整个输入
+ * @param in 输入
+ * @param size 输出大小
+ * @return 缓冲（调用方释放），失败返回 NULL
+ */
+static uint8_t *read_all(FILE *in, size_t *size) {
+    size_t cap = 1 << 20, len = 0;
+    uint8_t *buf = (uint8_t *)malloc(cap);
+    while (buf != NULL) {
+        len += fread(buf + len, 1, cap - len, in);
+        if (len < cap) {
+            break;
+        }
+        cap *= 2;
+        uint8_t *grown = (uint8_t *)realloc(buf, cap);
+        if (grown == NULL) {
+            free(buf);
+            buf = NULL;
+            break;
+        }
+        buf = grown;
+    }
+    if (buf == NULL || ferror(in)) {
+        free(buf);
+        return NULL;
+    }
+    *size = len;
+    return buf;
+}
+
+static void free_sessions(session_list_t *sessions) {
+    for (size_t i = 0; i < sessions->count; i++) {
+        session_t *s = &sessions->items[i];
+        for (uint32_t id = 0; id < s->num_formats; id++) {
+            format_def_t *def = s->formats[id];
+            if (def != NULL) {
+                free(def->file);
+                free(def->func);
+                free(def->tag);
+                free(def->fmt);
+                free(def);
+            }
+        }
+        free(s->formats);
+        for (uint32_t id = 0; id < s->num_strings; id++) {
+            free(s->strings[id].s);
+        }
+        free(s->strings);
+        free(s->threads);
+    }
+    free(sessions->items);
+    sessions->items = NULL;
+    sessions->count = 0;
+}
+
+/**
+ * 未加密的日志文件（魔数 EndX，footer 中的文件大小与输入一致）只保留数据区，footer 不作为文本输出
+ * @param data 输入
+ * @param size 输入大小，是日志文件时改为已用大小
+ */
+static void strip_footer(const uint8_t *data, size_t *size) {
+    if (*size < LZ_LOG_FOOTER_SIZE) {
+        return;
+    }
+    const uint8_t *footer = data + *size - LZ_LOG_FOOTER_SIZE;
+    uint32_t magic = 0, file_size = 0, used = 0;
+    memcpy(&magic, footer + LZ_LOG_SALT_SIZE, sizeof(magic));
+    memcpy(&file_size, footer + LZ_LOG_SALT_SIZE + 4, sizeof(file_size));
+    memcpy(&used, footer + LZ_LOG_SALT_SIZE + 8, sizeof(used));
+    if (magic == LZ_LOG_MAGIC_ENDX && file_size == *size && used <= *size - LZ_LOG_FOOTER_SIZE) {
+        *size = used;
+    }
+}
+
+/**
+ * 还原一个输入
+ * @param in 输入
+ * @param name 输入名称（用于错误信息）
+ * @param out 输出
+ * @return 成功返回 0
+ */
+static int decode_stream(FILE *in, const char *name, FILE *out) {
+    size_t size = 0;
+    uint8_t *data = read_all(in, &size);
+    if (data == NULL) {
+        fprintf(stderr, "读取失败: %s\n", name);
+        return 1;
+    }
+    strip_footer(data, &size);
+
+    session_list_t sessions = {NULL, 0};
+    collect(data, size, &sessions);
+    render(out, data, size, &sessions);
+    free_sessions(&sessions);
+    free(data);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "用法: %s [输入文件...] [-o 输出文件]\n"
+            "  还原日志明文中的二进制记录（LZ_LOG_BINARY、字符串字典），文本行原样输出；\n"
+            "  不指定输入文件时读取标准输入，不指定 -o 时输出到标准输出\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *output = NULL;
+    const char *inputs[256];
+    int num_inputs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            return 2;
+        } else if (num_inputs < (int)(sizeof(inputs) / sizeof(inputs[0]))) {
+            inputs[num_inputs++] = argv[i];
+        }
+    }
+
+    FILE *out = stdout;
+    if (output != NULL) {
+        out = fopen(output, "wb");
+        if (out == NULL) {
+            perror(output);
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    if (num_inputs == 0) {
+        failed |= decode_stream(stdin, "<stdin>", out);
+    }
+    for (int i = 0; i < num_inputs; i++) {
+        FILE *in = strcmp(inputs[i], "-") == 0 ? stdin : fopen(inputs[i], "rb");
+        if (in == NULL) {
+            perror(inputs[i]);
+            failed = 1;
+            continue;
+        }
+        failed |= decode_stream(in, inputs[i], out);
+        if (in != stdin) {
+            fclose(in);
+        }
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return failed;
+}